@@ -12,6 +12,21 @@
 #include "tim.h"
 #include "usart.h"
 #include "cmsis_os.h"
+#include "TMC2226_bus.h"
+#include "TMC2226_step.h"
+#include "TMC2226_motion.h"
+#include "TMC2226_registers.h"
+
+/* Set to 1 (e.g. -DTMC_TRACE_ENABLED=1) to hand finished datagrams to TMC_trace, otherwise TMC_TRACE is empty */
+#ifndef TMC_TRACE_ENABLED
+#define TMC_TRACE_ENABLED 0
+#endif
+
+#if TMC_TRACE_ENABLED
+#define TMC_TRACE(transfer) TMC_trace(transfer)
+#else
+#define TMC_TRACE(transfer)
+#endif
 
 /**
  * \brief			Those are possible addresses of TMC2226 nodes
@@ -23,56 +38,75 @@ typedef enum {
 	TMC2226_ADDR_3 = 0x03u						/* MS1 and MS2 pin set to HIGH and HIGH correspondingly */
 } TMC2226_NodeAddress;
 
+/* Enumerators generated from TMC2226_REGISTERS, one per register and direction it allows */
+#define TMC_READ_REGISTER_ENUM(name, address, access, mask, reset) \
+	TMC_IF_READABLE_##access(R_##name = address,)
+#define TMC_WRITE_REGISTER_ENUM(name, address, access, mask, reset) \
+	TMC_IF_WRITABLE_##access(TMC_WRITE_NAME_##access(name) = address,)
+#define TMC_SHADOW_INDEX_ENUM(name, address, access, mask, reset) \
+	TMC_IF_WRITABLE_##access(SHADOW_##name,)
+#define TMC_REGISTER_ENUM(name, address, access, mask, reset) \
+	TMC_ADDRESS_##name = address, TMC_ACCESS_##name = TMC_ACCESS_MODE_##access,
+
 /**
- * \brief 			Those are possible READ registers in TMC2226
+ * \brief 			Those are possible READ registers in TMC2226, R_<name>
+ * \note			There is no R_ member for write only registers, so reading one does not compile
  */
 typedef enum {
-	/* General configuration registers */
-	R_GCONF = 0x00u,
-	R_GSTAT = 0x01u,							/* Status register */
-	R_IFCNT = 0x02u,
-	R_OTP_READ = 0x05u,
-	R_IOIN = 0x06u,
-	R_FACTORY_CONF = 0x07u,
-	/* Velocity Dependent Control */
-	R_TSTEP = 0x12u,
-	/* StallGuard Control */
-	R_SG_RESULT = 0x41u,
-	/* Sequencer Registers */
-	R_MSCNT = 0x6Au,
-	R_MSCURACT = 0x6Bu,
-	/*  Chopper Control Registers */
-	R_CHOPCONF = 0x6Cu,
-	R_DRV_STATUS = 0x6Fu,
-	R_PWMCONF = 0x70u,
-	R_PWM_SCALE = 0x71u,
-	R_PWM_AUTO = 0x72u
+	TMC2226_REGISTERS(TMC_READ_REGISTER_ENUM)
 } TMC2226_ReadRegisters;
 
 /**
- * \brief 			Those are possible WRITE registers in TMC2226
+ * \brief 			Those are possible WRITE registers in TMC2226, W_<name>
+ * \note			WC_GSTAT is write 1 to clear flag. There is no W_ member for read only
+ * 					registers, but C converts enums silently, so R_TSTEP passed here compiles and
+ * 					only -Wenum-conversion (part of -Wextra) warns. TMC_WRITE and friends below
+ * 					take the register name and refuse read only registers at compile time
  */
 typedef enum {
-	/* General configuration registers */
-	W_GCONF = 0x00u,
-	WC_GSTAT = 0x01u,							/* Status register. Write 1 bit to clear flag */
-	W_NODECONF = 0x03u,
-	W_OTP_PROG = 0x04u,
-	W_FACTORY_CONF = 0x07u,
-	/* Velocity Dependent Control */
-	W_IHOLD_IRUN = 0x10u,
-	W_TPOWERDOWN = 0x11u,
-	W_TPWMTHRS = 0x13u,
-	W_VACTUAL = 0x22u,
-	/* StallGuard Control */
-	W_TCOOLTHRS = 0x14u,
-	W_SGTHRS = 0x40u,
-	W_COOLCONF = 0x42u,
-	/*  Chopper Control Registers */
-	W_CHOPCONF = 0x6Cu,
-	W_PWMCONF = 0x70u
+	TMC2226_REGISTERS(TMC_WRITE_REGISTER_ENUM)
 } TMC2226_WriteRegisters;
 
+/**
+ * \brief			Slots of the register shadow kept in TMC_HandleTypeDef, one per WRITE register
+ * \note			GSTAT and OTP_PROG are actions rather than state, their slots only hold
+ * 					the value waiting to be written and go back to 0 once it is sent
+ */
+typedef enum {
+	TMC2226_REGISTERS(TMC_SHADOW_INDEX_ENUM)
+	SHADOW_COUNT,
+	SHADOW_NONE = 0xFFu							/* Address of no WRITE register */
+} TMC2226_ShadowIndex;
+
+/* Address and access mode of every register by name, TMC_ADDRESS_<name> and TMC_ACCESS_<name> */
+enum {
+	TMC2226_REGISTERS(TMC_REGISTER_ENUM)
+};
+
+/* Compile time check usable inside an expression, fails when register name does not allow mode */
+#define TMC_REQUIRE_ACCESS(name, mode) \
+	((void)sizeof(struct { _Static_assert(TMC_ACCESS_##name & (mode), #name " does not allow this access"); int unused; }))
+
+/*
+ * Register API taking the register name, TMC_WRITE(htmc, CHOPCONF, value). Writing a read only
+ * register such as TSTEP fails to compile whatever warnings are enabled
+ */
+#define TMC_WRITE(htmc, name, value) \
+	(TMC_REQUIRE_ACCESS(name, TMC_ACCESS_WRITE), \
+	TMC_write_register((htmc), (TMC2226_WriteRegisters)TMC_ADDRESS_##name, (value)))
+#define TMC_MODIFY(htmc, name, mask, value) \
+	(TMC_REQUIRE_ACCESS(name, TMC_ACCESS_WRITE), \
+	TMC_modify_register((htmc), (TMC2226_WriteRegisters)TMC_ADDRESS_##name, (mask), (value)))
+#define TMC_POST(htmc, name, value) \
+	(TMC_REQUIRE_ACCESS(name, TMC_ACCESS_WRITE), \
+	TMC_post_register((htmc), (TMC2226_WriteRegisters)TMC_ADDRESS_##name, (value)))
+#define TMC_SHADOW(htmc, name) \
+	(TMC_REQUIRE_ACCESS(name, TMC_ACCESS_WRITE), \
+	TMC_get_shadow((htmc), (TMC2226_WriteRegisters)TMC_ADDRESS_##name))
+#define TMC_READ(htmc, name) \
+	(TMC_REQUIRE_ACCESS(name, TMC_ACCESS_READ), \
+	read_access((htmc), (TMC2226_ReadRegisters)TMC_ADDRESS_##name))
+
 /*
  * \brief			Possible values for MRES in CHOPCONF register
  * \note			For getting resolution just use simple calculation
@@ -98,26 +132,80 @@ typedef enum {
 typedef struct {
 	TIM_HandleTypeDef* htim;					/* TIMER handler pointer */
 	UART_HandleTypeDef* huart;					/* UART handler pointer */
+	TMC_BusTypeDef* hbus;						/* Single wire bus the node is attached to */
+	TMC_StepEngineTypeDef* hstep;				/* STEP/DIR pulse engine, NULL when htim has none registered */
 	TMC2226_NodeAddress	node_address;			/* This is a node address */
 	uint16_t engine_steps_per_full_turn; 		/* engine resolution */
 	TMC2226_MRES_steps microstep_resolution; 	/* micro-steps per full step */
 
-	float clock_constant;
+	uint32_t vactual_scale;						/* VACTUAL per milli-rpm, follows microstep_resolution */
+	uint8_t vactual_scale_q;					/* Fraction bits of vactual_scale */
+	TMC_MotionLimits motion_limits;				/* Limits used by position moves, in microsteps */
 
-	uint32_t	reg_GCONF_val;
-	uint32_t 	reg_NODECONF_val;
-	uint32_t 	reg_CHOPCONF_val;
+	uint32_t	shadow[SHADOW_COUNT];			/* Values of WRITE registers as the driver sees them after flush */
+	uint16_t	dirty;							/* Bit per shadow slot that differs from the driver */
+	uint8_t		verify_writes;					/* TMC_flush confirms writes with IFCNT readback */
 } TMC_HandleTypeDef;
 
 
+/**
+ * \brief			Register read that is in flight on the bus
+ * \note			Has to stay valid until TMC_read_await returns, because the bus worker
+ * 					writes the reply straight into it
+ */
+typedef struct {
+	TMC2226_ReadRegisters register_address;
+	TMC_TransferTypeDef transfer;
+	uint32_t value;								/* Masked register value, valid after successful await */
+} TMC_ReadFuture;
+
+
 /* ################ API ################ */
 void TMC_Init(TMC_HandleTypeDef* htmc, TMC2226_NodeAddress node_addr, TIM_HandleTypeDef* htim,
 		UART_HandleTypeDef* huart, uint16_t engine_steps_per_full_turn);
 
 void TMC_set_speed_by_UART(TMC_HandleTypeDef* htmc, float rpm_speed);
 
+void TMC_set_speed_mrpm(TMC_HandleTypeDef* htmc, int32_t milli_rpm);
+
+TMC_BusStatus TMC_post_register(TMC_HandleTypeDef* htmc, TMC2226_WriteRegisters register_address, uint32_t value);
+
 void TMC_set_angle(TMC_HandleTypeDef* htmc, uint16_t angle);
 
+HAL_StatusTypeDef TMC_move_steps(TMC_HandleTypeDef* htmc, int32_t steps);
+
+void TMC_write_register(TMC_HandleTypeDef* htmc, TMC2226_WriteRegisters register_address, uint32_t value);
+
+void TMC_modify_register(TMC_HandleTypeDef* htmc, TMC2226_WriteRegisters register_address,
+		uint32_t mask, uint32_t value);
+
+uint32_t TMC_get_shadow(TMC_HandleTypeDef* htmc, TMC2226_WriteRegisters register_address);
+
+TMC_BusStatus TMC_flush(TMC_HandleTypeDef* htmc);
+
+TMC_BusStatus TMC_flush_verified(TMC_HandleTypeDef* htmc);
+
+void TMC_set_microstep_resolution(TMC_HandleTypeDef* htmc, TMC2226_MRES_steps resolution);
+
+void TMC_set_toff(TMC_HandleTypeDef* htmc, uint8_t toff);
+
+void TMC_set_current(TMC_HandleTypeDef* htmc, uint8_t ihold, uint8_t irun, uint8_t iholddelay);
+
+void TMC_set_shaft(TMC_HandleTypeDef* htmc, uint8_t inverse);
+
+TMC_BusStatus TMC_read_async(TMC_HandleTypeDef* htmc, TMC2226_ReadRegisters register_address,
+		TMC_ReadFuture* future);
+
+uint8_t TMC_read_ready(TMC_ReadFuture* future);
+
+TMC_BusStatus TMC_read_await(TMC_ReadFuture* future);
+
+TMC_BusStatus TMC_read_await_all(TMC_ReadFuture* futures, uint8_t count);
+
+uint32_t TMC_link_bringup(TMC_HandleTypeDef* htmc);
+
+uint8_t TMC_node_id(TMC_HandleTypeDef* htmc);
+
 
 // Not implemented yet
 void TMC_enable_driver(uint8_t node_address);
@@ -130,17 +218,68 @@ void TMC_disable_driver(uint8_t node_address);
 #define TMC2226_READ 0x00
 #define TMC2226_WRITE 0x80
 
+/* Motion limits set by TMC_Init, for 200 step motor at 256 microsteps that is half a turn per second,
+ * reached in half a second, with acceleration ramped up in 0.1 s */
+#define TMC_DEFAULT_MAX_VELOCITY 25600u
+#define TMC_DEFAULT_ACCELERATION 51200u
+#define TMC_DEFAULT_JERK 512000u
+
+/* Internal 12 MHz clock makes one VACTUAL LSB 12 MHz / 2^24 = 0.715 microsteps/s, in thousandths */
+#define TMC_CLOCK_CONSTANT_MILLI 715u
+
+/* VACTUAL is 24 bit signed */
+#define TMC_VACTUAL_MAX 0x7FFFFF
+
+/* Verified writes needed at a baud rate before link bring-up accepts it */
+#define TMC_LINK_PROBE_WRITES 3u
+
+/* Failed IFCNT checks each group of TMC_flush_verified may take before it gives up */
+#define TMC_VERIFY_RETRIES 4u
+
+/* Bus mailbox slots of streamed setpoint registers, below TMC_BUS_MAILBOX_SLOTS */
+#define TMC_MAILBOX_VACTUAL 0u
+#define TMC_MAILBOX_IHOLD_IRUN 1u
+
+/* How many dirty registers TMC_flush queues on the bus at once */
+#define TMC_FLUSH_BATCH 4u
+
 /* ################ Low Level functions ################ */
-uint32_t read_access(TMC_HandleTypeDef* htmc, TMC2226_ReadRegisters register_address,
-		uint64_t *received_datagram, uint32_t *sent_datagram);
+uint32_t read_access(TMC_HandleTypeDef* htmc, TMC2226_ReadRegisters register_address);
+
+void write_access(TMC_HandleTypeDef* htmc, TMC2226_WriteRegisters register_address, uint32_t data);
 
-void write_access(TMC_HandleTypeDef* htmc, TMC2226_WriteRegisters register_address,
-		uint32_t data, uint64_t *sent_datagram);
+void TMC_trace(const TMC_TransferTypeDef* transfer);
+
+void build_read_datagram(TMC_HandleTypeDef* htmc, TMC2226_ReadRegisters register_address, uint8_t* datagram);
 
 uint8_t calculate_CRC(uint8_t* datagram, uint8_t datagram_length);
 
+extern const uint8_t TMC2226_CRC_table[256];
+
+/**
+ * \brief			Folds one more byte into CRC, CRC of a datagram starts from 0
+ * \param[in]		crc: CRC of bytes processed so far
+ * \param[in]		byte: next byte of the datagram
+ * \return			CRC including given byte
+ * \note			TMC2226 feeds bytes LSB first into polynomial 0x07, so the byte is bit
+ * 					reversed (single RBIT instruction) before the MSB first table lookup.
+ * 					Cheap enough to be called from UART interrupt for every received byte
+ */
+static inline uint8_t update_CRC(uint8_t crc, uint8_t byte)
+{
+	return TMC2226_CRC_table[crc ^ (uint8_t)(__RBIT(byte) >> 24)];
+}
+
+uint32_t read_timeout_ms(TMC_HandleTypeDef* htmc);
+
+void update_vactual_scale(TMC_HandleTypeDef* htmc);
+
+int32_t mrpm_to_vactual(TMC_HandleTypeDef* htmc, int32_t milli_rpm);
+
+TMC2226_ShadowIndex get_shadow_index(TMC2226_WriteRegisters register_address);
+
 uint32_t get_mask_for_given_register(TMC2226_ReadRegisters register_address);
 
-uint32_t apply_mask_and_convert(uint32_t mask, uint64_t received_datagram);
+uint32_t apply_mask_and_convert(uint32_t mask, const uint8_t* reply);
 
 #endif /* INC_TMC2226_H_ */
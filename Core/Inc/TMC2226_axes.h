@@ -0,0 +1,47 @@
+/*
+ * TMC2226_axes.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+
+#ifndef INC_TMC2226_AXES_H_
+#define INC_TMC2226_AXES_H_
+
+#include "main.h"
+#include "tim.h"
+#include "usart.h"
+#include "TMC2226.h"
+
+/* Axes one machine can have, every node of every bus */
+#define TMC_AXES_MAX				(TMC_BUS_MAX_COUNT * TMC_BUS_NODE_COUNT)
+
+/**
+ * \brief			Axes of one machine spread over several single wire buses
+ * \note			Every bus has its own worker, so transfers to axes on different buses
+ * 					are on the wire at the same time and setpoint throughput grows with
+ * 					the number of buses
+ */
+typedef struct {
+	UART_HandleTypeDef* huarts[TMC_BUS_MAX_COUNT];	/* Buses in the order axes are dealt to them */
+	uint8_t bus_count;
+	TMC_HandleTypeDef* axes[TMC_AXES_MAX];		/* In the order of TMC_axes_add */
+	uint8_t axis_count;
+	uint8_t axes_on_bus[TMC_BUS_MAX_COUNT];
+	TMC_ReadFuture reads[TMC_AXES_MAX];			/* In flight requests of TMC_axes_read */
+} TMC_AxesTypeDef;
+
+
+/* ################ API ################ */
+HAL_StatusTypeDef TMC_axes_init(TMC_AxesTypeDef* haxes, UART_HandleTypeDef* const* huarts, uint8_t bus_count);
+
+HAL_StatusTypeDef TMC_axes_add(TMC_AxesTypeDef* haxes, TMC_HandleTypeDef* htmc, TIM_HandleTypeDef* htim,
+		uint16_t engine_steps_per_full_turn);
+
+uint32_t TMC_axes_link_bringup(TMC_AxesTypeDef* haxes);
+
+void TMC_axes_set_speed_mrpm(TMC_AxesTypeDef* haxes, const int32_t* milli_rpm);
+
+TMC_BusStatus TMC_axes_read(TMC_AxesTypeDef* haxes, TMC2226_ReadRegisters register_address, uint32_t* values);
+
+#endif /* INC_TMC2226_AXES_H_ */
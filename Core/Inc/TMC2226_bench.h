@@ -0,0 +1,45 @@
+/*
+ * TMC2226_bench.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+
+#ifndef INC_TMC2226_BENCH_H_
+#define INC_TMC2226_BENCH_H_
+
+#include "main.h"
+#include "TMC2226.h"
+
+/* Set to 1 (e.g. -DTMC_BENCH_ENABLED=1) to run the suite once at start of the stepper task */
+#ifndef TMC_BENCH_ENABLED
+#define TMC_BENCH_ENABLED			0
+#endif
+
+/* Number of measured paths, TMC_bench_run fills that many results */
+#define TMC_BENCH_COUNT				7u
+
+/* Iterations per path used by the stepper task */
+#define TMC_BENCH_ITERATIONS		100u
+
+/**
+ * \brief			Cost of one driver path measured with DWT cycle counter
+ * \note			Cycles are core cycles on target, on host the cycle counter follows the
+ * 					monotonic clock scaled to SystemCoreClock so the same numbers compare
+ */
+typedef struct {
+	const char* name;
+	uint32_t iterations;
+	uint32_t cycles;							/* All iterations together, loop overhead included */
+	uint32_t heap_taken;						/* RTOS heap bytes the path took, 0 when allocation free */
+} TMC_BenchResult;
+
+
+/* ################ API ################ */
+uint8_t TMC_bench_run(TMC_HandleTypeDef* htmc, uint32_t iterations, TMC_BenchResult* results);
+
+uint32_t TMC_bench_ns_x10(const TMC_BenchResult* result);
+
+void TMC_bench_print(const TMC_BenchResult* results, uint8_t count);
+
+#endif /* INC_TMC2226_BENCH_H_ */
@@ -0,0 +1,196 @@
+/*
+ * TMC2226_bus.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+
+#ifndef INC_TMC2226_BUS_H_
+#define INC_TMC2226_BUS_H_
+
+#include "main.h"
+#include "usart.h"
+#include "cmsis_os.h"
+
+/* How many single wire UART buses can be registered at once, each has its own worker thread */
+#define TMC_BUS_MAX_COUNT			2u
+
+/* Longest datagram that travels over the bus (write access) */
+#define TMC_BUS_MAX_DATAGRAM		8u
+
+/* How many transfers of each priority can wait for the bus worker at once */
+#define TMC_BUS_QUEUE_LENGTH		8u
+
+/* How many nodes can share one bus (ADDR_0..ADDR_3) */
+#define TMC_BUS_NODE_COUNT			4u
+
+/* Latest value wins slots per node, one per streamed register (setpoints) */
+#define TMC_BUS_MAILBOX_SLOTS		2u
+
+/* Idle time between consecutive frames, lets the node that just replied release the line */
+#define TMC_BUS_INTERFRAME_GAP_BITS	4u
+
+/* Longest rest of the gap the worker busy waits, longer rests sleep a tick so lower priorities run */
+#define TMC_BUS_GAP_SPIN_MAX_US		100u
+
+/* Thread flag used to wake up the thread that submitted a transfer */
+#define TMC_BUS_FLAG_DONE			0x0001u
+/* Thread flag used by UART interrupts to wake up the bus worker */
+#define TMC_BUS_FLAG_UART			0x0002u
+/* Thread flag used to tell the bus worker a new transfer was queued */
+#define TMC_BUS_FLAG_QUEUED			0x0004u
+
+/* Rates tried by link bring-up in ascending order, TMC2226 auto-bauds on the sync nibble of every datagram */
+#define TMC_BUS_BAUD_RATES			{ 9600u, 19200u, 57600u, 115200u, 230400u, 500000u }
+
+/*
+ * Consecutive failed transfers after which the worker drops the bus to the next lower rate. CRC
+ * and line errors count, timeouts only once more than one node timed out, one absent node
+ * must not slow the bus down for the others. Alone on its bus or right after recovery, a node
+ * that already replied at a lower rate counts its timeouts too, it went silent because of the rate
+ */
+#define TMC_BUS_FALLBACK_ERRORS		3u
+
+/* Clean transfers at a fallback rate after which the worker tries the next higher rate again */
+#define TMC_BUS_RECOVERY_TRANSFERS	1000u
+
+/* Recovery wait doubles every time the higher rate fails again, up to this many times */
+#define TMC_BUS_RECOVERY_BACKOFF_MAX	6u
+
+/* Extra time added on top of the theoretical wire time of a transfer */
+#define TMC_BUS_TIMEOUT_MARGIN_MS	5u
+
+/* Every reply starts with sync nibble and reserved bits followed by master address, receiver hunts for them */
+#define TMC_BUS_REPLY_SYNC			0x05u
+#define TMC_BUS_REPLY_ADDRESS		0xFFu
+
+/**
+ * \brief			Result of a single bus transfer
+ */
+typedef enum {
+	TMC_BUS_OK = 0x00u,
+	TMC_BUS_BUSY = 0x01u,						/* Transfer queue is full */
+	TMC_BUS_TIMEOUT = 0x02u,					/* Node did not answer before the deadline */
+	TMC_BUS_ERROR = 0x03u,						/* HAL refused the transfer or reported line error */
+	TMC_BUS_CRC_ERROR = 0x04u,					/* Reply received but its CRC does not match */
+	TMC_BUS_PENDING = 0x05u						/* Transfer is queued or on the wire */
+} TMC_BusStatus;
+
+/**
+ * \brief			Order in which the bus worker serves queued transfers
+ */
+typedef enum {
+	TMC_BUS_PRIORITY_HIGH = 0x00u,				/* Motion setpoints */
+	TMC_BUS_PRIORITY_NORMAL = 0x01u,			/* Configuration writes */
+	TMC_BUS_PRIORITY_LOW = 0x02u,				/* Status reads */
+	TMC_BUS_PRIORITY_COUNT = 0x03u
+} TMC_BusPriority;
+
+/**
+ * \brief			Per node transfer statistics collected by the bus worker
+ * \note			Latency is counted from TMC_bus_submit until the worker completes the transfer,
+ * 					so it includes time spent behind other nodes in the queue
+ */
+typedef struct {
+	uint32_t transfers;							/* Completed transfers, failed ones included */
+	uint32_t failures;							/* Transfers that did not end with TMC_BUS_OK */
+	uint32_t last_latency_us;
+	uint32_t max_latency_us;
+	uint32_t total_latency_us;					/* Divide by transfers to get the average */
+	uint32_t superseded;						/* Mailbox values overwritten before they were sent */
+} TMC_BusNodeStats;
+
+/**
+ * \brief			Single datagram exchange, owned by the caller until it completes
+ * \note			Structure is handed over to the bus worker by pointer, so it must stay
+ * 					valid until status leaves TMC_BUS_PENDING
+ */
+typedef struct {
+	uint8_t tx_datagram[TMC_BUS_MAX_DATAGRAM];	/* Datagram to be sent */
+	uint8_t tx_length;							/* 0 makes the worker switch UART to baud_rate instead of sending */
+	uint8_t rx_datagram[TMC_BUS_MAX_DATAGRAM];	/* Reply with its CRC already checked */
+	uint8_t rx_length;							/* Expected reply length including CRC, 0 for write access */
+	uint32_t timeout;							/* Deadline in ms counted from the moment transfer hits the wire */
+	uint32_t baud_rate;							/* Used only when tx_length is 0 */
+	TMC_BusPriority priority;
+	uint32_t submit_cycles;						/* Cycle counter value at submission, used for latency */
+	osThreadId_t owner;							/* Thread notified with TMC_BUS_FLAG_DONE on completion */
+	volatile TMC_BusStatus status;
+} TMC_TransferTypeDef;
+
+/**
+ * \brief			Latest write datagram posted for one register of one node
+ * \note			Posting over a full slot replaces the datagram, so only the newest value
+ * 					ever reaches the wire and the backlog can not grow
+ */
+typedef struct {
+	uint8_t datagram[TMC_BUS_MAX_DATAGRAM];
+	uint8_t length;
+	uint32_t post_cycles;						/* Cycle counter value at the latest post, used for latency */
+	volatile uint8_t full;
+} TMC_BusMailbox;
+
+/**
+ * \brief			Single wire UART bus shared by TMC2226 nodes
+ * \note			Receiver is off while a datagram is sent, so the echo of the single wire line
+ * 					never reaches it. Reply is picked out of the line byte by byte in the UART
+ * 					interrupt: sync, master address, payload and CRC folded in as bytes arrive
+ */
+typedef struct {
+	UART_HandleTypeDef* huart;					/* UART handler pointer */
+	osThreadId_t worker;						/* Thread that owns the UART */
+	osMessageQueueId_t queue[TMC_BUS_PRIORITY_COUNT];	/* Pending TMC_TransferTypeDef pointers */
+	TMC_TransferTypeDef* current;				/* Transfer that is on the wire */
+	volatile TMC_BusStatus status;				/* Result of the current transfer, written from ISR */
+	uint8_t rx_buffer[TMC_BUS_MAX_DATAGRAM];	/* Reply collected so far, starts with the sync byte */
+	uint8_t rx_byte;							/* Single byte reception buffer, re-armed after every byte */
+	uint8_t rx_index;							/* Position of the next reply byte, 0 while hunting for sync */
+	uint8_t rx_crc;								/* CRC of rx_buffer[0..rx_index) */
+	TMC_BusNodeStats node_stats[TMC_BUS_NODE_COUNT];
+	TMC_BusMailbox mailbox[TMC_BUS_NODE_COUNT][TMC_BUS_MAILBOX_SLOTS];
+	TMC_TransferTypeDef mailbox_transfer;		/* Worker owned copy of the mailbox being sent */
+	uint8_t mailbox_cursor;						/* Round robin position over all mailboxes */
+	uint8_t mailbox_turn;						/* Mailboxes and queues take turns when both have work */
+	uint32_t frame_end_cycles;					/* Cycle counter when the last transfer finished, starts the gap */
+	uint8_t error_streak;						/* Consecutive failures, reset by every successful transfer */
+	uint8_t timeout_nodes;						/* Bit per node that timed out since the last success */
+	uint8_t node_mask;							/* Bit per node attached with TMC_bus_attach */
+	uint32_t reply_rates[TMC_BUS_NODE_COUNT];	/* Lowest rate each node replied at, 0 until it did */
+	uint32_t fallbacks;							/* Automatic baud rate reductions so far */
+	uint32_t recoveries;						/* Automatic returns to a higher rate so far */
+	uint32_t baud_rate_limit;					/* Rate set by TMC_bus_set_baud_rate, recovery stops there */
+	uint32_t clean_streak;						/* Successful transfers in a row, drives recovery */
+	uint8_t recovery_backoff;					/* Recovery waits TMC_BUS_RECOVERY_TRANSFERS << this */
+	uint8_t recovered;							/* Current rate was reached by recovery and is not proven yet */
+} TMC_BusTypeDef;
+
+
+/* ################ API ################ */
+TMC_BusTypeDef* TMC_bus_get(UART_HandleTypeDef* huart);
+
+uint8_t TMC_bus_index(TMC_BusTypeDef* hbus);
+
+void TMC_bus_attach(TMC_BusTypeDef* hbus, uint8_t node_address);
+
+TMC_BusStatus TMC_bus_submit(TMC_BusTypeDef* hbus, TMC_TransferTypeDef* transfer);
+
+TMC_BusStatus TMC_bus_await(TMC_TransferTypeDef* transfer);
+
+TMC_BusStatus TMC_bus_post(TMC_BusTypeDef* hbus, uint8_t slot, const uint8_t* tx_datagram, uint8_t tx_length);
+
+TMC_BusStatus TMC_bus_set_baud_rate(TMC_BusTypeDef* hbus, uint32_t baud_rate);
+
+uint32_t TMC_bus_get_baud_rate(TMC_BusTypeDef* hbus);
+
+void TMC_bus_get_node_stats(TMC_BusTypeDef* hbus, uint8_t node_address, TMC_BusNodeStats* stats);
+
+void TMC_bus_reset_stats(TMC_BusTypeDef* hbus);
+
+uint32_t TMC_bus_wire_time_ms(TMC_BusTypeDef* hbus, uint16_t bit_times);
+
+/* ################ Interrupt context ################ */
+void TMC_bus_TxCpltCallback(UART_HandleTypeDef* huart);
+void TMC_bus_RxCpltCallback(UART_HandleTypeDef* huart);
+void TMC_bus_ErrorCallback(UART_HandleTypeDef* huart);
+
+#endif /* INC_TMC2226_BUS_H_ */
@@ -0,0 +1,55 @@
+/*
+ * TMC2226_capture.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+
+#ifndef INC_TMC2226_CAPTURE_H_
+#define INC_TMC2226_CAPTURE_H_
+
+#include "main.h"
+#include "TMC2226_stream_protocol.h"
+
+/* Records the ring holds, the oldest are overwritten, has to be a power of 2 */
+#define TMC_CAPTURE_RECORDS			64u
+
+/**
+ * \brief			One datagram or event seen by a bus, see TMC_STREAM_FRAME_CAPTURE
+ */
+typedef struct {
+	uint32_t cycles;							/* Cycle counter at the end of the datagram or event */
+	uint32_t data;								/* Data bytes of 8 byte datagram, 0 otherwise */
+	uint16_t baud_rate_100;						/* Bus rate in units of 100 baud */
+	uint8_t event;								/* TMC_CaptureEvent */
+	uint8_t bus;								/* TMC_bus_index */
+	uint8_t node;								/* Node address the datagram went to or came from */
+	uint8_t register_byte;						/* Third byte of the datagram, write bit included */
+	uint8_t length;								/* Datagram length, 0 for events without datagram */
+	uint8_t crc;								/* Last byte of the datagram */
+} TMC_CaptureRecord;
+
+/**
+ * \brief			Counters of the capture ring
+ */
+typedef struct {
+	uint32_t recorded;							/* Records taken since reset, index of the next one */
+	uint32_t missed;							/* Records not taken because the ring was frozen */
+} TMC_CaptureStats;
+
+
+/* ################ API ################ */
+void TMC_capture_record(TMC_CaptureEvent event, uint8_t bus, uint8_t node, uint8_t register_byte,
+		const uint8_t* datagram, uint8_t length, uint32_t baud_rate);
+
+void TMC_capture_freeze(uint8_t frozen);
+
+uint32_t TMC_capture_oldest(void);
+
+uint8_t TMC_capture_encode(uint32_t* index, uint8_t* payload);
+
+void TMC_capture_clear(void);
+
+void TMC_capture_get_stats(TMC_CaptureStats* stats);
+
+#endif /* INC_TMC2226_CAPTURE_H_ */
@@ -0,0 +1,53 @@
+/*
+ * TMC2226_motion.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+
+#ifndef INC_TMC2226_MOTION_H_
+#define INC_TMC2226_MOTION_H_
+
+#include "main.h"
+#include "TMC2226_step.h"
+
+/* Acceleration (and the mirrored deceleration) ramp is sampled into this many constant rate segments */
+#define TMC_MOTION_RAMP_SEGMENTS	16u
+
+/* Acceleration ramp, cruise and deceleration ramp */
+#define TMC_MOTION_MAX_SEGMENTS		(2u * TMC_MOTION_RAMP_SEGMENTS + 1u)
+
+/**
+ * \brief			Kinematic limits of a move, all in microsteps
+ */
+typedef struct {
+	uint32_t max_velocity;						/* microsteps/s */
+	uint32_t acceleration;						/* microsteps/s^2, 0 starts at max_velocity right away */
+	uint32_t jerk;								/* microsteps/s^3, 0 gives trapezoidal profile, otherwise S-curve */
+} TMC_MotionLimits;
+
+/**
+ * \brief			Precomputed move, ready to be played by the step engine
+ * \note			Table is read from interrupt while the move runs, so it must not be
+ * 					replanned or go out of scope before the move ends
+ */
+typedef struct {
+	TMC_StepSegment segments[TMC_MOTION_MAX_SEGMENTS];
+	uint16_t segment_count;
+	int8_t direction;							/* +1 or -1 */
+	uint32_t distance;							/* Total microsteps, sum of all segments */
+	uint32_t peak_velocity;						/* Cruise velocity, lower than max_velocity for short moves */
+	uint64_t ramp_time_us;						/* Duration of a single ramp, hours for tiny accelerations */
+} TMC_MotionProfile;
+
+
+/* ################ API ################ */
+void TMC_motion_plan(TMC_MotionProfile* profile, int32_t distance, const TMC_MotionLimits* limits);
+
+HAL_StatusTypeDef TMC_motion_start(TMC_StepEngineTypeDef* hstep, const TMC_MotionProfile* profile,
+		TMC_StepDoneCallback done_callback, void* done_context);
+
+HAL_StatusTypeDef TMC_motion_move(TMC_StepEngineTypeDef* hstep, int32_t distance, const TMC_MotionLimits* limits,
+		TMC_StepDoneCallback done_callback, void* done_context);
+
+#endif /* INC_TMC2226_MOTION_H_ */
@@ -0,0 +1,445 @@
+/*
+ * TMC2226_registers.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+
+#ifndef INC_TMC2226_REGISTERS_H_
+#define INC_TMC2226_REGISTERS_H_
+
+#include <stdint.h>
+
+/*
+ * Bit layouts of TMC2226 registers, named like CMSIS device headers:
+ * <REGISTER>_<FIELD>_Pos is the lowest bit, <REGISTER>_<FIELD>_Msk the field in place,
+ * <REGISTER>_MASK all bits the datasheet defines, used to mask read replies
+ *
+ * Everything else known about a register sits in TMC2226_REGISTERS below, enums of
+ * TMC2226.h, the register shadow and the shell register names are generated from it
+ */
+
+/* Extracts field from register value, TMC_FIELD_GET(value, TMC_DRV_STATUS_CS_ACTUAL) */
+#define TMC_FIELD_GET(value, field)			(((uint32_t)(value) & field##_Msk) >> field##_Pos)
+
+/* Places field value at its position, TMC_FIELD_SET(TMC_CHOPCONF_MRES, 4u) */
+#define TMC_FIELD_SET(field, value)			(((uint32_t)(value) << field##_Pos) & field##_Msk)
+
+/* ################ GCONF 0x00 ################ */
+#define TMC_GCONF_I_SCALE_ANALOG_Pos		0u
+#define TMC_GCONF_I_SCALE_ANALOG_Msk		(0x1u << TMC_GCONF_I_SCALE_ANALOG_Pos)
+#define TMC_GCONF_INTERNAL_RSENSE_Pos		1u
+#define TMC_GCONF_INTERNAL_RSENSE_Msk		(0x1u << TMC_GCONF_INTERNAL_RSENSE_Pos)
+#define TMC_GCONF_EN_SPREADCYCLE_Pos		2u
+#define TMC_GCONF_EN_SPREADCYCLE_Msk		(0x1u << TMC_GCONF_EN_SPREADCYCLE_Pos)
+#define TMC_GCONF_SHAFT_Pos					3u
+#define TMC_GCONF_SHAFT_Msk					(0x1u << TMC_GCONF_SHAFT_Pos)
+#define TMC_GCONF_INDEX_OTPW_Pos			4u
+#define TMC_GCONF_INDEX_OTPW_Msk			(0x1u << TMC_GCONF_INDEX_OTPW_Pos)
+#define TMC_GCONF_INDEX_STEP_Pos			5u
+#define TMC_GCONF_INDEX_STEP_Msk			(0x1u << TMC_GCONF_INDEX_STEP_Pos)
+#define TMC_GCONF_PDN_DISABLE_Pos			6u
+#define TMC_GCONF_PDN_DISABLE_Msk			(0x1u << TMC_GCONF_PDN_DISABLE_Pos)
+#define TMC_GCONF_MSTEP_REG_SELECT_Pos		7u
+#define TMC_GCONF_MSTEP_REG_SELECT_Msk		(0x1u << TMC_GCONF_MSTEP_REG_SELECT_Pos)
+#define TMC_GCONF_MULTISTEP_FILT_Pos		8u
+#define TMC_GCONF_MULTISTEP_FILT_Msk		(0x1u << TMC_GCONF_MULTISTEP_FILT_Pos)
+#define TMC_GCONF_TEST_MODE_Pos				9u
+#define TMC_GCONF_TEST_MODE_Msk				(0x1u << TMC_GCONF_TEST_MODE_Pos)
+#define TMC_GCONF_MASK						0x000003FFu
+
+/* ################ GSTAT 0x01 ################ */
+#define TMC_GSTAT_RESET_Pos					0u
+#define TMC_GSTAT_RESET_Msk					(0x1u << TMC_GSTAT_RESET_Pos)
+#define TMC_GSTAT_DRV_ERR_Pos				1u
+#define TMC_GSTAT_DRV_ERR_Msk				(0x1u << TMC_GSTAT_DRV_ERR_Pos)
+#define TMC_GSTAT_UV_CP_Pos					2u
+#define TMC_GSTAT_UV_CP_Msk					(0x1u << TMC_GSTAT_UV_CP_Pos)
+#define TMC_GSTAT_MASK						0x00000007u
+
+/* ################ IFCNT 0x02 ################ */
+#define TMC_IFCNT_MASK						0x000000FFu
+
+/* ################ NODECONF 0x03 ################ */
+#define TMC_NODECONF_SENDDELAY_Pos			8u
+#define TMC_NODECONF_SENDDELAY_Msk			(0xFu << TMC_NODECONF_SENDDELAY_Pos)
+#define TMC_NODECONF_MASK					0x00000F00u
+
+/* ################ OTP_PROG 0x04 ################ */
+#define TMC_OTP_PROG_OTPBIT_Pos				0u
+#define TMC_OTP_PROG_OTPBIT_Msk				(0x7u << TMC_OTP_PROG_OTPBIT_Pos)
+#define TMC_OTP_PROG_OTPBYTE_Pos			4u
+#define TMC_OTP_PROG_OTPBYTE_Msk			(0x3u << TMC_OTP_PROG_OTPBYTE_Pos)
+#define TMC_OTP_PROG_OTPMAGIC_Pos			8u
+#define TMC_OTP_PROG_OTPMAGIC_Msk			(0xFFu << TMC_OTP_PROG_OTPMAGIC_Pos)
+#define TMC_OTP_PROG_MASK					0x0000FF37u
+
+/* ################ OTP_READ 0x05 ################ */
+#define TMC_OTP_READ_OTP0_Pos				0u
+#define TMC_OTP_READ_OTP0_Msk				(0xFFu << TMC_OTP_READ_OTP0_Pos)
+#define TMC_OTP_READ_OTP1_Pos				8u
+#define TMC_OTP_READ_OTP1_Msk				(0xFFu << TMC_OTP_READ_OTP1_Pos)
+#define TMC_OTP_READ_OTP2_Pos				16u
+#define TMC_OTP_READ_OTP2_Msk				(0xFFu << TMC_OTP_READ_OTP2_Pos)
+#define TMC_OTP_READ_MASK					0x00FFFFFFu
+
+/* ################ IOIN 0x06 ################ */
+#define TMC_IOIN_ENN_Pos					0u
+#define TMC_IOIN_ENN_Msk					(0x1u << TMC_IOIN_ENN_Pos)
+#define TMC_IOIN_MS1_Pos					2u
+#define TMC_IOIN_MS1_Msk					(0x1u << TMC_IOIN_MS1_Pos)
+#define TMC_IOIN_MS2_Pos					3u
+#define TMC_IOIN_MS2_Msk					(0x1u << TMC_IOIN_MS2_Pos)
+#define TMC_IOIN_DIAG_Pos					4u
+#define TMC_IOIN_DIAG_Msk					(0x1u << TMC_IOIN_DIAG_Pos)
+#define TMC_IOIN_PDN_UART_Pos				6u
+#define TMC_IOIN_PDN_UART_Msk				(0x1u << TMC_IOIN_PDN_UART_Pos)
+#define TMC_IOIN_STEP_Pos					7u
+#define TMC_IOIN_STEP_Msk					(0x1u << TMC_IOIN_STEP_Pos)
+#define TMC_IOIN_SPREAD_EN_Pos				8u
+#define TMC_IOIN_SPREAD_EN_Msk				(0x1u << TMC_IOIN_SPREAD_EN_Pos)
+#define TMC_IOIN_DIR_Pos					9u
+#define TMC_IOIN_DIR_Msk					(0x1u << TMC_IOIN_DIR_Pos)
+#define TMC_IOIN_VERSION_Pos				24u
+#define TMC_IOIN_VERSION_Msk				(0xFFu << TMC_IOIN_VERSION_Pos)
+#define TMC_IOIN_MASK						0xFF0003FFu
+
+/* VERSION read from IOIN of every TMC2226 (and TMC2209) */
+#define TMC_IOIN_VERSION_TMC2226			0x21u
+
+/* ################ FACTORY_CONF 0x07 ################ */
+#define TMC_FACTORY_CONF_FCLKTRIM_Pos		0u
+#define TMC_FACTORY_CONF_FCLKTRIM_Msk		(0x1Fu << TMC_FACTORY_CONF_FCLKTRIM_Pos)
+#define TMC_FACTORY_CONF_OTTRIM_Pos			8u
+#define TMC_FACTORY_CONF_OTTRIM_Msk			(0x3u << TMC_FACTORY_CONF_OTTRIM_Pos)
+#define TMC_FACTORY_CONF_MASK				0x0000031Fu
+
+/* ################ IHOLD_IRUN 0x10 ################ */
+#define TMC_IHOLD_IRUN_IHOLD_Pos			0u
+#define TMC_IHOLD_IRUN_IHOLD_Msk			(0x1Fu << TMC_IHOLD_IRUN_IHOLD_Pos)
+#define TMC_IHOLD_IRUN_IRUN_Pos				8u
+#define TMC_IHOLD_IRUN_IRUN_Msk				(0x1Fu << TMC_IHOLD_IRUN_IRUN_Pos)
+#define TMC_IHOLD_IRUN_IHOLDDELAY_Pos		16u
+#define TMC_IHOLD_IRUN_IHOLDDELAY_Msk		(0xFu << TMC_IHOLD_IRUN_IHOLDDELAY_Pos)
+#define TMC_IHOLD_IRUN_MASK					0x000F1F1Fu
+
+/* ################ TPOWERDOWN 0x11 ################ */
+#define TMC_TPOWERDOWN_MASK					0x000000FFu
+
+/* ################ TSTEP 0x12 ################ */
+#define TMC_TSTEP_MASK						0x000FFFFFu
+
+/* ################ TPWMTHRS 0x13 ################ */
+#define TMC_TPWMTHRS_MASK					0x000FFFFFu
+
+/* ################ TCOOLTHRS 0x14 ################ */
+#define TMC_TCOOLTHRS_MASK					0x000FFFFFu
+
+/* ################ VACTUAL 0x22 ################ */
+#define TMC_VACTUAL_MASK					0x00FFFFFFu
+
+/* ################ SGTHRS 0x40 ################ */
+#define TMC_SGTHRS_MASK						0x000000FFu
+
+/* ################ SG_RESULT 0x41 ################ */
+#define TMC_SG_RESULT_MASK					0x000003FFu
+
+/* ################ COOLCONF 0x42 ################ */
+#define TMC_COOLCONF_SEMIN_Pos				0u
+#define TMC_COOLCONF_SEMIN_Msk				(0xFu << TMC_COOLCONF_SEMIN_Pos)
+#define TMC_COOLCONF_SEUP_Pos				5u
+#define TMC_COOLCONF_SEUP_Msk				(0x3u << TMC_COOLCONF_SEUP_Pos)
+#define TMC_COOLCONF_SEMAX_Pos				8u
+#define TMC_COOLCONF_SEMAX_Msk				(0xFu << TMC_COOLCONF_SEMAX_Pos)
+#define TMC_COOLCONF_SEDN_Pos				13u
+#define TMC_COOLCONF_SEDN_Msk				(0x3u << TMC_COOLCONF_SEDN_Pos)
+#define TMC_COOLCONF_SEIMIN_Pos				15u
+#define TMC_COOLCONF_SEIMIN_Msk				(0x1u << TMC_COOLCONF_SEIMIN_Pos)
+#define TMC_COOLCONF_MASK					0x0000EF6Fu
+
+/* ################ MSCNT 0x6A ################ */
+#define TMC_MSCNT_MASK						0x000003FFu
+
+/* ################ MSCURACT 0x6B ################ */
+#define TMC_MSCURACT_CUR_A_Pos				0u
+#define TMC_MSCURACT_CUR_A_Msk				(0x1FFu << TMC_MSCURACT_CUR_A_Pos)
+#define TMC_MSCURACT_CUR_B_Pos				16u
+#define TMC_MSCURACT_CUR_B_Msk				(0x1FFu << TMC_MSCURACT_CUR_B_Pos)
+#define TMC_MSCURACT_MASK					0x01FF01FFu
+
+/* ################ CHOPCONF 0x6C ################ */
+#define TMC_CHOPCONF_TOFF_Pos				0u
+#define TMC_CHOPCONF_TOFF_Msk				(0xFu << TMC_CHOPCONF_TOFF_Pos)
+#define TMC_CHOPCONF_HSTRT_Pos				4u
+#define TMC_CHOPCONF_HSTRT_Msk				(0x7u << TMC_CHOPCONF_HSTRT_Pos)
+#define TMC_CHOPCONF_HEND_Pos				7u
+#define TMC_CHOPCONF_HEND_Msk				(0xFu << TMC_CHOPCONF_HEND_Pos)
+#define TMC_CHOPCONF_TBL_Pos				15u
+#define TMC_CHOPCONF_TBL_Msk				(0x3u << TMC_CHOPCONF_TBL_Pos)
+#define TMC_CHOPCONF_VSENSE_Pos				17u
+#define TMC_CHOPCONF_VSENSE_Msk				(0x1u << TMC_CHOPCONF_VSENSE_Pos)
+#define TMC_CHOPCONF_MRES_Pos				24u
+#define TMC_CHOPCONF_MRES_Msk				(0xFu << TMC_CHOPCONF_MRES_Pos)
+#define TMC_CHOPCONF_INTPOL_Pos				28u
+#define TMC_CHOPCONF_INTPOL_Msk				(0x1u << TMC_CHOPCONF_INTPOL_Pos)
+#define TMC_CHOPCONF_DEDGE_Pos				29u
+#define TMC_CHOPCONF_DEDGE_Msk				(0x1u << TMC_CHOPCONF_DEDGE_Pos)
+#define TMC_CHOPCONF_DISS2G_Pos				30u
+#define TMC_CHOPCONF_DISS2G_Msk				(0x1u << TMC_CHOPCONF_DISS2G_Pos)
+#define TMC_CHOPCONF_DISS2VS_Pos			31u
+#define TMC_CHOPCONF_DISS2VS_Msk			(0x1u << TMC_CHOPCONF_DISS2VS_Pos)
+#define TMC_CHOPCONF_MASK					0xFF0387FFu
+
+/* ################ DRV_STATUS 0x6F ################ */
+#define TMC_DRV_STATUS_OTPW_Pos				0u
+#define TMC_DRV_STATUS_OTPW_Msk				(0x1u << TMC_DRV_STATUS_OTPW_Pos)
+#define TMC_DRV_STATUS_OT_Pos				1u
+#define TMC_DRV_STATUS_OT_Msk				(0x1u << TMC_DRV_STATUS_OT_Pos)
+#define TMC_DRV_STATUS_S2GA_Pos				2u
+#define TMC_DRV_STATUS_S2GA_Msk				(0x1u << TMC_DRV_STATUS_S2GA_Pos)
+#define TMC_DRV_STATUS_S2GB_Pos				3u
+#define TMC_DRV_STATUS_S2GB_Msk				(0x1u << TMC_DRV_STATUS_S2GB_Pos)
+#define TMC_DRV_STATUS_S2VSA_Pos			4u
+#define TMC_DRV_STATUS_S2VSA_Msk			(0x1u << TMC_DRV_STATUS_S2VSA_Pos)
+#define TMC_DRV_STATUS_S2VSB_Pos			5u
+#define TMC_DRV_STATUS_S2VSB_Msk			(0x1u << TMC_DRV_STATUS_S2VSB_Pos)
+#define TMC_DRV_STATUS_OLA_Pos				6u
+#define TMC_DRV_STATUS_OLA_Msk				(0x1u << TMC_DRV_STATUS_OLA_Pos)
+#define TMC_DRV_STATUS_OLB_Pos				7u
+#define TMC_DRV_STATUS_OLB_Msk				(0x1u << TMC_DRV_STATUS_OLB_Pos)
+#define TMC_DRV_STATUS_T120_Pos				8u
+#define TMC_DRV_STATUS_T120_Msk				(0x1u << TMC_DRV_STATUS_T120_Pos)
+#define TMC_DRV_STATUS_T143_Pos				9u
+#define TMC_DRV_STATUS_T143_Msk				(0x1u << TMC_DRV_STATUS_T143_Pos)
+#define TMC_DRV_STATUS_T150_Pos				10u
+#define TMC_DRV_STATUS_T150_Msk				(0x1u << TMC_DRV_STATUS_T150_Pos)
+#define TMC_DRV_STATUS_T157_Pos				11u
+#define TMC_DRV_STATUS_T157_Msk				(0x1u << TMC_DRV_STATUS_T157_Pos)
+#define TMC_DRV_STATUS_CS_ACTUAL_Pos		16u
+#define TMC_DRV_STATUS_CS_ACTUAL_Msk		(0x1Fu << TMC_DRV_STATUS_CS_ACTUAL_Pos)
+#define TMC_DRV_STATUS_STEALTH_Pos			30u
+#define TMC_DRV_STATUS_STEALTH_Msk			(0x1u << TMC_DRV_STATUS_STEALTH_Pos)
+#define TMC_DRV_STATUS_STST_Pos				31u
+#define TMC_DRV_STATUS_STST_Msk				(0x1u << TMC_DRV_STATUS_STST_Pos)
+#define TMC_DRV_STATUS_MASK					0xC01F0FFFu
+
+/* Flags that mean the bridge has shut down or is about to, any of them set needs attention */
+#define TMC_DRV_STATUS_FAULT_Msk			(TMC_DRV_STATUS_OT_Msk | TMC_DRV_STATUS_S2GA_Msk | \
+											 TMC_DRV_STATUS_S2GB_Msk | TMC_DRV_STATUS_S2VSA_Msk | \
+											 TMC_DRV_STATUS_S2VSB_Msk)
+
+/* ################ PWMCONF 0x70 ################ */
+#define TMC_PWMCONF_PWM_OFS_Pos				0u
+#define TMC_PWMCONF_PWM_OFS_Msk				(0xFFu << TMC_PWMCONF_PWM_OFS_Pos)
+#define TMC_PWMCONF_PWM_GRAD_Pos			8u
+#define TMC_PWMCONF_PWM_GRAD_Msk			(0xFFu << TMC_PWMCONF_PWM_GRAD_Pos)
+#define TMC_PWMCONF_PWM_FREQ_Pos			16u
+#define TMC_PWMCONF_PWM_FREQ_Msk			(0x3u << TMC_PWMCONF_PWM_FREQ_Pos)
+#define TMC_PWMCONF_PWM_AUTOSCALE_Pos		18u
+#define TMC_PWMCONF_PWM_AUTOSCALE_Msk		(0x1u << TMC_PWMCONF_PWM_AUTOSCALE_Pos)
+#define TMC_PWMCONF_PWM_AUTOGRAD_Pos		19u
+#define TMC_PWMCONF_PWM_AUTOGRAD_Msk		(0x1u << TMC_PWMCONF_PWM_AUTOGRAD_Pos)
+#define TMC_PWMCONF_FREEWHEEL_Pos			20u
+#define TMC_PWMCONF_FREEWHEEL_Msk			(0x3u << TMC_PWMCONF_FREEWHEEL_Pos)
+#define TMC_PWMCONF_PWM_REG_Pos				24u
+#define TMC_PWMCONF_PWM_REG_Msk				(0xFu << TMC_PWMCONF_PWM_REG_Pos)
+#define TMC_PWMCONF_PWM_LIM_Pos				28u
+#define TMC_PWMCONF_PWM_LIM_Msk				(0xFu << TMC_PWMCONF_PWM_LIM_Pos)
+#define TMC_PWMCONF_MASK					0xFF3FFFFFu
+
+/* ################ PWM_SCALE 0x71 ################ */
+#define TMC_PWM_SCALE_SUM_Pos				0u
+#define TMC_PWM_SCALE_SUM_Msk				(0xFFu << TMC_PWM_SCALE_SUM_Pos)
+#define TMC_PWM_SCALE_AUTO_Pos				16u
+#define TMC_PWM_SCALE_AUTO_Msk				(0x1FFu << TMC_PWM_SCALE_AUTO_Pos)
+#define TMC_PWM_SCALE_MASK					0x01FF00FFu
+
+/* ################ PWM_AUTO 0x72 ################ */
+#define TMC_PWM_AUTO_OFS_Pos				0u
+#define TMC_PWM_AUTO_OFS_Msk				(0xFFu << TMC_PWM_AUTO_OFS_Pos)
+#define TMC_PWM_AUTO_GRAD_Pos				16u
+#define TMC_PWM_AUTO_GRAD_Msk				(0xFFu << TMC_PWM_AUTO_GRAD_Pos)
+#define TMC_PWM_AUTO_MASK					0x00FF00FFu
+
+
+/* ################ Register table ################ */
+/*
+ * X(name, address, access, mask, reset) for every register, in datasheet order
+ *	access	R read only, W write only, RW both, RWC read and write 1 to clear
+ *	mask	<REGISTER>_MASK above
+ *	reset	value the register shadow starts with, power on value unless noted,
+ *			0 for read only registers. GCONF and NODECONF are always written by TMC_Init,
+ *			FACTORY_CONF and IHOLD depend on OTP
+ * Order of writable registers is the order of shadow slots and of TMC_flush writes
+ */
+#define TMC2226_REGISTERS(X) \
+	/* General configuration registers */ \
+	X(GCONF,		0x00u,	RW,		TMC_GCONF_MASK,			0x00000000u) \
+	X(GSTAT,		0x01u,	RWC,	TMC_GSTAT_MASK,			0x00000000u) \
+	X(IFCNT,		0x02u,	R,		TMC_IFCNT_MASK,			0x00000000u) \
+	X(NODECONF,		0x03u,	W,		TMC_NODECONF_MASK,		0x00000000u) \
+	X(OTP_PROG,		0x04u,	W,		TMC_OTP_PROG_MASK,		0x00000000u) \
+	X(OTP_READ,		0x05u,	R,		TMC_OTP_READ_MASK,		0x00000000u) \
+	X(IOIN,			0x06u,	R,		TMC_IOIN_MASK,			0x00000000u) \
+	X(FACTORY_CONF,	0x07u,	RW,		TMC_FACTORY_CONF_MASK,	0x00000000u) \
+	/* Velocity Dependent Control */ \
+	X(IHOLD_IRUN,	0x10u,	W,		TMC_IHOLD_IRUN_MASK,	0x00011F10u) /* IHOLDDELAY=1, IRUN=31, IHOLD=16 */ \
+	X(TPOWERDOWN,	0x11u,	W,		TMC_TPOWERDOWN_MASK,	0x00000014u) \
+	X(TSTEP,		0x12u,	R,		TMC_TSTEP_MASK,			0x00000000u) \
+	X(TPWMTHRS,		0x13u,	W,		TMC_TPWMTHRS_MASK,		0x00000000u) \
+	X(VACTUAL,		0x22u,	W,		TMC_VACTUAL_MASK,		0x00000000u) \
+	/* StallGuard Control */ \
+	X(TCOOLTHRS,	0x14u,	W,		TMC_TCOOLTHRS_MASK,		0x00000000u) \
+	X(SGTHRS,		0x40u,	W,		TMC_SGTHRS_MASK,		0x00000000u) \
+	X(SG_RESULT,	0x41u,	R,		TMC_SG_RESULT_MASK,		0x00000000u) \
+	X(COOLCONF,		0x42u,	W,		TMC_COOLCONF_MASK,		0x00000000u) \
+	/* Sequencer Registers */ \
+	X(MSCNT,		0x6Au,	R,		TMC_MSCNT_MASK,			0x00000000u) \
+	X(MSCURACT,		0x6Bu,	R,		TMC_MSCURACT_MASK,		0x00000000u) \
+	/* Chopper Control Registers */ \
+	X(CHOPCONF,		0x6Cu,	RW,		TMC_CHOPCONF_MASK,		0x10000053u) \
+	X(DRV_STATUS,	0x6Fu,	R,		TMC_DRV_STATUS_MASK,	0x00000000u) \
+	X(PWMCONF,		0x70u,	RW,		TMC_PWMCONF_MASK,		0xC10D0024u) \
+	X(PWM_SCALE,	0x71u,	R,		TMC_PWM_SCALE_MASK,		0x00000000u) \
+	X(PWM_AUTO,		0x72u,	R,		TMC_PWM_AUTO_MASK,		0x00000000u)
+
+/* Expand to their arguments only for registers that can be read, TMC_IF_READABLE_##access(...) */
+#define TMC_IF_READABLE_R(...)				__VA_ARGS__
+#define TMC_IF_READABLE_W(...)
+#define TMC_IF_READABLE_RW(...)				__VA_ARGS__
+#define TMC_IF_READABLE_RWC(...)			__VA_ARGS__
+
+/* Expand to their arguments only for registers that can be written, TMC_IF_WRITABLE_##access(...) */
+#define TMC_IF_WRITABLE_R(...)
+#define TMC_IF_WRITABLE_W(...)				__VA_ARGS__
+#define TMC_IF_WRITABLE_RW(...)				__VA_ARGS__
+#define TMC_IF_WRITABLE_RWC(...)			__VA_ARGS__
+
+/* Name of TMC2226_WriteRegisters member, write 1 to clear registers get WC_ */
+#define TMC_WRITE_NAME_W(name)				W_##name
+#define TMC_WRITE_NAME_RW(name)				W_##name
+#define TMC_WRITE_NAME_RWC(name)			WC_##name
+
+/* Access mode as bits, TMC_ACCESS_MODE_##access */
+#define TMC_ACCESS_READ						0x01u
+#define TMC_ACCESS_WRITE					0x02u
+#define TMC_ACCESS_MODE_R					TMC_ACCESS_READ
+#define TMC_ACCESS_MODE_W					TMC_ACCESS_WRITE
+#define TMC_ACCESS_MODE_RW					(TMC_ACCESS_READ | TMC_ACCESS_WRITE)
+#define TMC_ACCESS_MODE_RWC					(TMC_ACCESS_READ | TMC_ACCESS_WRITE)
+
+
+/* ################ Decoders ################ */
+/**
+ * \brief			Sign extends 9 bit field, used by MSCURACT and PWM_SCALE
+ * \note			Compiles to single SBFX instruction on Cortex-M3
+ */
+static inline int16_t TMC_sign_extend_9(uint32_t field)
+{
+	return (int16_t)((int32_t)(field << 23) >> 23);
+}
+
+/**
+ * \brief			Actual motor current scale from DRV_STATUS, 0..31 like IRUN
+ */
+static inline uint8_t TMC_drv_status_cs_actual(uint32_t drv_status)
+{
+	return TMC_FIELD_GET(drv_status, TMC_DRV_STATUS_CS_ACTUAL);
+}
+
+/**
+ * \brief			Returns nonzero when DRV_STATUS reports overtemperature or a short
+ */
+static inline uint32_t TMC_drv_status_fault(uint32_t drv_status)
+{
+	return drv_status & TMC_DRV_STATUS_FAULT_Msk;
+}
+
+/**
+ * \brief			Highest temperature threshold exceeded, in degrees Celsius
+ * \return			157, 150, 143 or 120, 0 below all of them
+ * \note			Threshold flags are cumulative, so only the highest one set matters
+ */
+static inline uint8_t TMC_drv_status_temperature(uint32_t drv_status)
+{
+	if (drv_status & TMC_DRV_STATUS_T157_Msk)
+	{
+		return 157;
+	}
+	if (drv_status & TMC_DRV_STATUS_T150_Msk)
+	{
+		return 150;
+	}
+	if (drv_status & TMC_DRV_STATUS_T143_Msk)
+	{
+		return 143;
+	}
+	return (drv_status & TMC_DRV_STATUS_T120_Msk) ? 120 : 0;
+}
+
+/**
+ * \brief			Silicon version from IOIN, TMC_IOIN_VERSION_TMC2226 on a healthy link
+ */
+static inline uint8_t TMC_ioin_version(uint32_t ioin)
+{
+	return TMC_FIELD_GET(ioin, TMC_IOIN_VERSION);
+}
+
+/**
+ * \brief			Current of coil A from MSCURACT, -255..255
+ */
+static inline int16_t TMC_mscuract_cur_a(uint32_t mscuract)
+{
+	return TMC_sign_extend_9(TMC_FIELD_GET(mscuract, TMC_MSCURACT_CUR_A));
+}
+
+/**
+ * \brief			Current of coil B from MSCURACT, -255..255
+ */
+static inline int16_t TMC_mscuract_cur_b(uint32_t mscuract)
+{
+	return TMC_sign_extend_9(TMC_FIELD_GET(mscuract, TMC_MSCURACT_CUR_B));
+}
+
+/**
+ * \brief			Actual PWM duty cycle of StealthChop from PWM_SCALE, 0..255
+ */
+static inline uint8_t TMC_pwm_scale_sum(uint32_t pwm_scale)
+{
+	return TMC_FIELD_GET(pwm_scale, TMC_PWM_SCALE_SUM);
+}
+
+/**
+ * \brief			Result of StealthChop automatic amplitude regulation from PWM_SCALE, -255..255
+ */
+static inline int16_t TMC_pwm_scale_auto(uint32_t pwm_scale)
+{
+	return TMC_sign_extend_9(TMC_FIELD_GET(pwm_scale, TMC_PWM_SCALE_AUTO));
+}
+
+/**
+ * \brief			PWM_OFS learned by automatic tuning, from PWM_AUTO
+ */
+static inline uint8_t TMC_pwm_auto_ofs(uint32_t pwm_auto)
+{
+	return TMC_FIELD_GET(pwm_auto, TMC_PWM_AUTO_OFS);
+}
+
+/**
+ * \brief			PWM_GRAD learned by automatic tuning, from PWM_AUTO
+ */
+static inline uint8_t TMC_pwm_auto_grad(uint32_t pwm_auto)
+{
+	return TMC_FIELD_GET(pwm_auto, TMC_PWM_AUTO_GRAD);
+}
+
+/**
+ * \brief			Microsteps per full step selected by MRES in CHOPCONF, 1..256
+ */
+static inline uint16_t TMC_chopconf_microsteps(uint32_t chopconf)
+{
+	uint32_t mres = TMC_FIELD_GET(chopconf, TMC_CHOPCONF_MRES);
+	return (mres > 8u) ? 1u : (uint16_t)(1u << (8u - mres));
+}
+
+#endif /* INC_TMC2226_REGISTERS_H_ */
@@ -0,0 +1,65 @@
+/*
+ * TMC2226_shell.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+
+#ifndef INC_TMC2226_SHELL_H_
+#define INC_TMC2226_SHELL_H_
+
+#include "main.h"
+#include "usart.h"
+#include "cmsis_os.h"
+#include "TMC2226.h"
+#include "shell.h"
+
+/* Bytes of the circular buffer USART2 receives into by DMA, has to be a power of 2 */
+#define TMC_SHELL_RX_SIZE			256u
+
+/* Nodes the commands can address, all nodes of every bus */
+#define TMC_SHELL_MAX_NODES			(TMC_BUS_MAX_COUNT * TMC_BUS_NODE_COUNT)
+
+/* Milliseconds capture waits for room in its stream ring before it gives up on a frame */
+#define TMC_SHELL_CAPTURE_RETRIES	50u
+
+/* Thread flag set for the shell thread when a line may have ended, above TMC_BUS_FLAG_* */
+#define TMC_SHELL_FLAG_RECEIVED		0x0100u
+
+/*
+ * Commands, every one answers with result lines followed by "ok" or "err ...".
+ * Node is TMC_node_id of a node added with TMC_shell_add_node (bus index * 4 + node
+ * address, so just the node address on the first bus), register is
+ * a name without prefix (DRV_STATUS) or an address, numbers are decimal or 0x hex.
+ * Commands arrive as plain text, answers leave through stdout, which is the binary stream,
+ * so they are text frames on the wire: stream_decode -i sends lines and prints the answers
+ *
+ *	nodes								ids, buses and addresses of the nodes commands can use
+ *	speed <node> <rpm>					VACTUAL velocity, up to 3 decimals, sign selects direction
+ *	move <node> <microsteps>			STEP/DIR move within motion limits of the node
+ *	stop <node>							VACTUAL 0 and STEP pulses stopped
+ *	rd <node> <register>				reads READ register from the driver
+ *	wr <node> <register> <value>		writes WRITE register through shadow and flush
+ *	tel [node]							latest telemetry snapshot of one or all nodes
+ *	rtos								CPU share, free stack and priority per task, heap, over the last window
+ *	capture [clear]						sends the bus capture ring as binary frames, stream_decode renders them
+ *	probe [reset]						cycle histograms of PROBE_* sections, only with PROBE_ENABLED
+ */
+
+
+/* ################ API ################ */
+void TMC_shell_init(UART_HandleTypeDef* huart);
+
+HAL_StatusTypeDef TMC_shell_add_node(TMC_HandleTypeDef* htmc);
+
+uint32_t TMC_shell_poll(void);
+
+uint32_t TMC_shell_wait(uint32_t timeout_ms);
+
+void TMC_shell_get_stats(ShellStats* stats);
+
+/* ################ Interrupt context ################ */
+void TMC_shell_RxEventCallback(UART_HandleTypeDef* huart, uint16_t size);
+void TMC_shell_ErrorCallback(UART_HandleTypeDef* huart);
+
+#endif /* INC_TMC2226_SHELL_H_ */
@@ -0,0 +1,94 @@
+/*
+ * TMC2226_step.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+
+#ifndef INC_TMC2226_STEP_H_
+#define INC_TMC2226_STEP_H_
+
+#include "main.h"
+#include "tim.h"
+
+/* How many step engines (pulse + counter timer pairs) can be registered at once */
+#define TMC_STEP_MAX_COUNT			1u
+
+/* Pulse timer channel wired to STEP pin */
+#define TMC_STEP_CHANNEL			TIM_CHANNEL_1
+
+/* Counter timer is 16 bit, longer moves are split into chunks of this many steps */
+#define TMC_STEP_CHUNK				65536u
+
+/**
+ * \brief			Called from interrupt context when the requested number of steps was produced
+ */
+typedef void (*TMC_StepDoneCallback)(void* context);
+
+/**
+ * \brief			Run of pulses at constant rate, timer values are computed up front
+ * 					so nothing but register writes happens in the interrupt
+ */
+typedef struct {
+	uint32_t steps;								/* Pulses in this segment, 0 segments are skipped */
+	uint16_t prescaler;							/* Pulse timer PSC */
+	uint16_t period;							/* Pulse timer ARR, pulse lasts ARR + 1 prescaled ticks */
+} TMC_StepSegment;
+
+/**
+ * \brief			Step pulse generator built from two timers
+ * \note			Pulse timer outputs PWM on STEP pin and its update event is routed as TRGO
+ * 					to the counter timer, which counts steps in hardware. CPU is involved only
+ * 					once per TMC_STEP_CHUNK steps and at the end of the move
+ */
+typedef struct {
+	TIM_HandleTypeDef* htim_pulse;				/* Timer producing STEP pulses (PWM mode 2) */
+	TIM_HandleTypeDef* htim_count;				/* Timer counting pulses, external clock from htim_pulse TRGO */
+	GPIO_TypeDef* dir_port;						/* DIR pin */
+	uint16_t dir_pin;
+	volatile uint8_t running;
+	int8_t direction;							/* +1 or -1 */
+	const TMC_StepSegment* segments;			/* Segments of the current move, played in order */
+	uint16_t segment_count;
+	volatile uint16_t segment_index;			/* Segment being played */
+	TMC_StepSegment single;						/* Storage for moves started with TMC_step_start */
+	volatile uint32_t remaining;				/* Steps of current segment not yet loaded into the counter timer */
+	volatile uint32_t chunk;					/* Steps loaded into the counter timer */
+	volatile int32_t position;					/* Position at the start of the current chunk, in microsteps */
+	TMC_StepDoneCallback done_callback;
+	void* done_context;
+} TMC_StepEngineTypeDef;
+
+
+/* ################ API ################ */
+TMC_StepEngineTypeDef* TMC_step_init(TIM_HandleTypeDef* htim_pulse, TIM_HandleTypeDef* htim_count,
+		GPIO_TypeDef* dir_port, uint16_t dir_pin);
+
+TMC_StepEngineTypeDef* TMC_step_get(TIM_HandleTypeDef* htim_pulse);
+
+HAL_StatusTypeDef TMC_step_start(TMC_StepEngineTypeDef* hstep, int32_t steps, uint32_t frequency_hz,
+		TMC_StepDoneCallback done_callback, void* done_context);
+
+HAL_StatusTypeDef TMC_step_start_segments(TMC_StepEngineTypeDef* hstep, int8_t direction,
+		const TMC_StepSegment* segments, uint16_t segment_count,
+		TMC_StepDoneCallback done_callback, void* done_context);
+
+void TMC_step_set_frequency(TMC_StepEngineTypeDef* hstep, uint32_t frequency_hz);
+
+void TMC_step_compute_segment(uint32_t frequency_hz, uint32_t steps, TMC_StepSegment* segment);
+
+void TMC_step_compute_timed_segment(uint32_t steps, uint64_t duration_us, uint32_t max_frequency_hz,
+		TMC_StepSegment* segment);
+
+void TMC_step_stop(TMC_StepEngineTypeDef* hstep);
+
+uint8_t TMC_step_busy(TMC_StepEngineTypeDef* hstep);
+
+int32_t TMC_step_get_position(TMC_StepEngineTypeDef* hstep);
+
+void TMC_step_set_position(TMC_StepEngineTypeDef* hstep, int32_t position);
+
+/* ################ Interrupt context ################ */
+void TMC_step_PeriodElapsedCallback(TIM_HandleTypeDef* htim);
+
+#endif /* INC_TMC2226_STEP_H_ */
@@ -0,0 +1,82 @@
+/*
+ * TMC2226_stream.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+
+#ifndef INC_TMC2226_STREAM_H_
+#define INC_TMC2226_STREAM_H_
+
+#include "main.h"
+#include "usart.h"
+#include "cmsis_os.h"
+#include "TMC2226_stream_protocol.h"
+
+/* Bytes of the ring shared by interrupts and tasks without own ring, has to be a power of 2 */
+#define TMC_STREAM_SHARED_RING_SIZE	256u
+
+/* Bytes of each task ring, has to be a power of 2 */
+#define TMC_STREAM_TASK_RING_SIZE	512u
+
+/* Tasks that get own ring on their first write, later ones fall back to the shared ring */
+#define TMC_STREAM_TASK_RINGS		4u
+
+/* Rings drained by DMA, channel number of a frame is index of its ring */
+#define TMC_STREAM_RING_COUNT		(TMC_STREAM_TASK_RINGS + 1u)
+
+/**
+ * \brief			Counters of the stream, frames are never waited for, only counted
+ */
+typedef struct {
+	uint32_t frames;							/* Frames put into the ring */
+	uint32_t dropped;							/* Frames that did not fit into the ring */
+	uint32_t bytes;								/* Encoded bytes put into the ring */
+	uint16_t peak_used;							/* Highest ring fill seen so far */
+} TMC_StreamStats;
+
+/**
+ * \brief			Byte ring of encoded frames, drained by DMA
+ * \note			Head moves only by whole frames, so DMA never sends a frame that is being written.
+ * 					Task ring has a single producer, its owner, which makes it lock free
+ */
+typedef struct {
+	uint8_t* buffer;
+	uint32_t mask;								/* Size - 1 */
+	volatile uint32_t head;						/* Free running position after the last whole frame */
+	volatile uint32_t tail;						/* Free running position of the first byte not sent yet */
+	volatile uint32_t owner;					/* osThreadId_t of the producer, 0 for free task ring */
+	uint8_t sequence;							/* Sequence number of the next frame */
+	TMC_StreamStats stats;
+} TMC_StreamRing;
+
+/**
+ * \brief			Framed output on a UART transmitted by DMA from several rings
+ * \note			DMA sends the longest contiguous part of one ring at a time and its
+ * 					completion interrupt picks the next ring round robin
+ */
+typedef struct {
+	UART_HandleTypeDef* huart;					/* UART with DMA TX channel linked */
+	TMC_StreamRing rings[TMC_STREAM_RING_COUNT];	/* Shared ring first, task rings after it */
+	volatile uint32_t dma_busy;					/* Claimed with exclusive access by whoever starts DMA */
+	TMC_StreamRing* dma_ring;					/* Ring DMA is sending from */
+	uint16_t dma_length;						/* Bytes handed to DMA */
+	uint16_t dma_released;						/* Part of them already returned to the ring at half transfer */
+	uint8_t cursor;								/* Ring looked at first when DMA gets free */
+} TMC_StreamTypeDef;
+
+
+/* ################ API ################ */
+void TMC_stream_init(UART_HandleTypeDef* huart);
+
+HAL_StatusTypeDef TMC_stream_write_frame(TMC_StreamFrameType type, const uint8_t* payload, uint8_t length);
+
+uint32_t TMC_stream_write_text(const uint8_t* text, uint32_t length);
+
+void TMC_stream_get_stats(TMC_StreamStats* stats);
+
+/* ################ Interrupt context ################ */
+void TMC_stream_TxHalfCpltCallback(UART_HandleTypeDef* huart);
+void TMC_stream_TxCpltCallback(UART_HandleTypeDef* huart);
+
+#endif /* INC_TMC2226_STREAM_H_ */
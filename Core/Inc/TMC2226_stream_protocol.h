@@ -0,0 +1,104 @@
+/*
+ * TMC2226_stream_protocol.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+
+#ifndef INC_TMC2226_STREAM_PROTOCOL_H_
+#define INC_TMC2226_STREAM_PROTOCOL_H_
+
+/*
+ * Wire format of the binary stream on USART2, shared with the host decoder in Tools,
+ * so nothing from HAL may be included here
+ *
+ * Frame before encoding:	channel << 5 | type (1) | sequence (1) | payload (0..TMC_STREAM_MAX_PAYLOAD) | CRC8 (1)
+ * On the wire:				COBS(frame) | 0x00
+ *
+ * CRC8 is polynomial 0x07 with initial value 0, MSB first, over the first byte, sequence and payload.
+ * Channel tells which ring the frame went through, 0 is the shared one, others belong to
+ * single tasks. Frames of different channels interleave on the wire, but within a channel
+ * sequence grows by one with every frame the firmware tried to send, so a gap seen by the
+ * decoder means frames were dropped on a full ring. Multi-byte fields are little endian.
+ */
+
+#include <stdint.h>
+
+/* Longest payload of a single frame */
+#define TMC_STREAM_MAX_PAYLOAD			64u
+
+/* Type, sequence and CRC around the payload */
+#define TMC_STREAM_FRAME_OVERHEAD		3u
+
+/* Longest frame on the wire: COBS adds one byte per started 254 bytes, plus the 0x00 delimiter */
+#define TMC_STREAM_MAX_ENCODED			(TMC_STREAM_MAX_PAYLOAD + TMC_STREAM_FRAME_OVERHEAD + \
+										 (TMC_STREAM_MAX_PAYLOAD + TMC_STREAM_FRAME_OVERHEAD) / 254u + 2u)
+
+/* First byte of a frame holds channel in the top bits and TMC_StreamFrameType in the rest */
+#define TMC_STREAM_CHANNEL_SHIFT		5u
+#define TMC_STREAM_TYPE_MASK			0x1Fu
+
+/**
+ * \brief			Kinds of frames, low bits of the first byte of every frame
+ */
+typedef enum {
+	TMC_STREAM_FRAME_TEXT = 0x01u,				/* Characters written to stdout, not terminated */
+	TMC_STREAM_FRAME_TELEMETRY = 0x02u,			/* One polling round of a node, see below */
+	TMC_STREAM_FRAME_CAPTURE = 0x03u			/* Records of the bus capture ring, see below */
+} TMC_StreamFrameType;
+
+/*
+ * TMC_STREAM_FRAME_TELEMETRY payload
+ *	0	node id, bus index * 4 + node address
+ *	1	bit per register below, set when it was read successfully in this round
+ *	2	kernel tick of the round in ms, 4 bytes
+ *	6	SG_RESULT, 4 bytes
+ *	10	TSTEP, 4 bytes
+ *	14	DRV_STATUS, 4 bytes
+ *	18	MSCNT, 4 bytes
+ */
+#define TMC_STREAM_TELEMETRY_NODE		0u
+#define TMC_STREAM_TELEMETRY_FRESH		1u
+#define TMC_STREAM_TELEMETRY_TIMESTAMP	2u
+#define TMC_STREAM_TELEMETRY_VALUES		6u
+#define TMC_STREAM_TELEMETRY_VALUE_COUNT	4u
+#define TMC_STREAM_TELEMETRY_LENGTH		(TMC_STREAM_TELEMETRY_VALUES + 4u * TMC_STREAM_TELEMETRY_VALUE_COUNT)
+
+/**
+ * \brief			What a capture record stands for
+ */
+typedef enum {
+	TMC_CAPTURE_TX = 0x01u,						/* Datagram sent, read request or write access */
+	TMC_CAPTURE_RX = 0x02u,						/* Reply received with matching CRC */
+	TMC_CAPTURE_RX_CRC = 0x03u,					/* Reply received with wrong CRC */
+	TMC_CAPTURE_TIMEOUT = 0x04u,				/* No whole reply or TX completion before the deadline */
+	TMC_CAPTURE_LINE_ERROR = 0x05u,				/* UART reported noise, framing or overrun error */
+	TMC_CAPTURE_BAUD = 0x06u					/* Bus switched to the rate of the record */
+} TMC_CaptureEvent;
+
+/*
+ * TMC_STREAM_FRAME_CAPTURE payload, records oldest first
+ *	0	core clock in MHz, cycle counter of the records runs at this rate
+ *	1	number of records in this frame
+ *	2	index of the first record counted from reset, 4 bytes, the others follow it
+ *	6	records, TMC_STREAM_CAPTURE_RECORD_LENGTH bytes each
+ *
+ * Record
+ *	0	cycle counter at the end of the datagram or event, 4 bytes, wraps every 2^32 cycles
+ *	4	data bytes of 8 byte datagram as one word, 4 bytes
+ *	8	bus rate in units of 100 baud, 2 bytes
+ *	10	TMC_CaptureEvent
+ *	11	bus index
+ *	12	node address
+ *	13	register byte, write bit included
+ *	14	datagram length, 0 for events without datagram
+ *	15	CRC byte of the datagram as it travelled
+ */
+#define TMC_STREAM_CAPTURE_CLOCK_MHZ	0u
+#define TMC_STREAM_CAPTURE_COUNT		1u
+#define TMC_STREAM_CAPTURE_INDEX		2u
+#define TMC_STREAM_CAPTURE_RECORDS		6u
+#define TMC_STREAM_CAPTURE_RECORD_LENGTH	16u
+#define TMC_STREAM_CAPTURE_PER_FRAME	((TMC_STREAM_MAX_PAYLOAD - TMC_STREAM_CAPTURE_RECORDS) / TMC_STREAM_CAPTURE_RECORD_LENGTH)
+
+#endif /* INC_TMC2226_STREAM_PROTOCOL_H_ */
@@ -0,0 +1,74 @@
+/*
+ * TMC2226_telemetry.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+
+#ifndef INC_TMC2226_TELEMETRY_H_
+#define INC_TMC2226_TELEMETRY_H_
+
+#include "main.h"
+#include "TMC2226.h"
+
+/* How many nodes the poller can follow, all nodes of every bus */
+#define TMC_TELEMETRY_MAX_NODES		(TMC_BUS_MAX_COUNT * TMC_BUS_NODE_COUNT)
+
+/* Time between two polling rounds over all registered nodes until TMC_telemetry_set_period */
+#define TMC_TELEMETRY_DEFAULT_PERIOD_MS	100u
+
+/**
+ * \brief			Registers read by the poller, index to TMC_TelemetrySnapshot samples
+ */
+typedef enum {
+	TMC_TELEMETRY_SG_RESULT = 0,
+	TMC_TELEMETRY_TSTEP,
+	TMC_TELEMETRY_DRV_STATUS,
+	TMC_TELEMETRY_MSCNT,
+	TMC_TELEMETRY_REGISTER_COUNT
+} TMC_TelemetryRegister;
+
+/**
+ * \brief			Single register value together with the moment it was read
+ */
+typedef struct {
+	uint32_t value;								/* Masked register value */
+	uint32_t timestamp_ms;						/* Kernel tick when the reply arrived, 0 if never read */
+} TMC_TelemetrySample;
+
+/**
+ * \brief			State of one node as last seen by the poller
+ * \note			Sample whose read failed keeps its previous value and timestamp,
+ * 					so its age tells how stale it is
+ */
+typedef struct {
+	uint8_t node_id;							/* TMC_node_id, node address on the first bus */
+	TMC_TelemetrySample samples[TMC_TELEMETRY_REGISTER_COUNT];
+	uint32_t rounds;							/* Polling rounds published so far */
+	uint32_t failed_reads;						/* Reads that ended with anything but TMC_BUS_OK */
+} TMC_TelemetrySnapshot;
+
+/**
+ * \brief			Snapshot double buffer of one node
+ * \note			Poller fills the buffer readers do not look at and then bumps sequence,
+ * 					which selects the published buffer with its lowest bit
+ */
+typedef struct {
+	TMC_HandleTypeDef* htmc;
+	TMC_TelemetrySnapshot buffer[2];
+	volatile uint32_t sequence;
+} TMC_TelemetryNode;
+
+
+/* ################ API ################ */
+HAL_StatusTypeDef TMC_telemetry_add(TMC_HandleTypeDef* htmc);
+
+void TMC_telemetry_set_period(uint32_t period_ms);
+
+uint8_t TMC_telemetry_read(TMC_HandleTypeDef* htmc, TMC_TelemetrySnapshot* snapshot);
+
+void TMC_telemetry_poll(void);
+
+void TMC_telemetry_run(void);
+
+#endif /* INC_TMC2226_TELEMETRY_H_ */
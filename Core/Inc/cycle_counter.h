@@ -0,0 +1,50 @@
+/*
+ * cycle_counter.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+
+#ifndef INC_CYCLE_COUNTER_H_
+#define INC_CYCLE_COUNTER_H_
+
+#include "main.h"
+
+/**
+ * \brief			Starts DWT cycle counter, safe to call more than once
+ */
+static inline void cycle_counter_init(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/**
+ * \brief			Returns core clock cycles counted so far, wraps every ~67 s at 64 MHz
+ */
+static inline uint32_t cycle_counter_get(void)
+{
+	return DWT->CYCCNT;
+}
+
+/**
+ * \brief			Converts number of core clock cycles to microseconds
+ */
+static inline uint32_t cycle_counter_to_us(uint32_t cycles)
+{
+	return cycles / (SystemCoreClock / 1000000u);
+}
+
+/**
+ * \brief			Busy waits given number of microseconds, meant for gaps shorter than one RTOS tick
+ */
+static inline void cycle_counter_delay_us(uint32_t us)
+{
+	uint32_t start = DWT->CYCCNT;
+	uint32_t cycles = us * (SystemCoreClock / 1000000u);
+	while ((DWT->CYCCNT - start) < cycles)
+	{
+	}
+}
+
+#endif /* INC_CYCLE_COUNTER_H_ */
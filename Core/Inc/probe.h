@@ -0,0 +1,68 @@
+/*
+ * probe.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+
+#ifndef INC_PROBE_H_
+#define INC_PROBE_H_
+
+#include "main.h"
+#include "cycle_counter.h"
+
+/* Set to 1 (e.g. -DPROBE_ENABLED=1) to measure probes, otherwise PROBE_BEGIN and PROBE_END are empty */
+#ifndef PROBE_ENABLED
+#define PROBE_ENABLED				0
+#endif
+
+/* Bucket b counts durations of 2^(b-1) up to 2^b - 1 cycles, bucket 0 counts zero length */
+#define PROBE_BUCKETS				33u
+
+/**
+ * \brief			Measured code sections, each has its own histogram
+ */
+typedef enum {
+	PROBE_TICK_IRQ = 0,							/* TIM1_UP_IRQHandler, HAL timebase */
+	PROBE_TIM_PERIOD,							/* HAL_TIM_PeriodElapsedCallback, step engine included */
+	PROBE_GPIO_EXTI,							/* HAL_GPIO_EXTI_Callback */
+	PROBE_BUS_IRQ,								/* USART1_IRQHandler, TMC bus byte and completion interrupts */
+	PROBE_BUS_TRANSFER,							/* Bus worker from start of a transfer until it completes */
+	PROBE_COUNT
+} ProbeId;
+
+/**
+ * \brief			Durations of one probe in core cycles
+ * \note			Written only by the context the probe sits in, readers get a snapshot
+ * 					that may be one sample behind
+ */
+typedef struct {
+	uint32_t count;
+	uint32_t max_cycles;
+	uint64_t total_cycles;						/* Divide by count to get the mean */
+	uint32_t buckets[PROBE_BUCKETS];
+} ProbeHistogram;
+
+#if PROBE_ENABLED
+/* Opens probe, the matching PROBE_END has to be in the same function */
+#define PROBE_BEGIN(id)				uint32_t probe_start_##id = cycle_counter_get()
+/* Closes probe and adds its duration to the histogram */
+#define PROBE_END(id)				probe_record((id), cycle_counter_get() - probe_start_##id)
+#else
+#define PROBE_BEGIN(id)
+#define PROBE_END(id)
+#endif
+
+
+/* ################ API ################ */
+void probe_init(void);
+
+void probe_record(ProbeId id, uint32_t cycles);
+
+void probe_get(ProbeId id, ProbeHistogram* histogram);
+
+const char* probe_name(ProbeId id);
+
+void probe_reset(void);
+
+#endif /* INC_PROBE_H_ */
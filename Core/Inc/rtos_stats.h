@@ -0,0 +1,66 @@
+/*
+ * rtos_stats.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+
+#ifndef INC_RTOS_STATS_H_
+#define INC_RTOS_STATS_H_
+
+#include "main.h"
+#include "FreeRTOS.h"
+
+/* Time between two samples, CPU share of a task is measured over this window */
+#define RTOS_STATS_PERIOD_MS		5000u
+
+/* Set to 0 to keep sampling for the rtos shell command without printing a report every period */
+#ifndef RTOS_STATS_REPORT_ENABLED
+#define RTOS_STATS_REPORT_ENABLED	1
+#endif
+
+/* Tasks a sample can hold: application tasks, bus workers, idle and timer service */
+#define RTOS_STATS_MAX_TASKS		12u
+
+/**
+ * \brief			One task as seen by the last sample
+ */
+typedef struct {
+	const char* name;
+	uint16_t cpu_permille;						/* Share of the run-time counter over the last window */
+	uint16_t stack_free_words;					/* Stack that was never touched since the task started */
+	uint8_t priority;
+	uint8_t number;								/* FreeRTOS task number, order of creation */
+} RtosTaskStats;
+
+/**
+ * \brief			Result of one sample, CPU shares of the tasks add up to ~1000
+ * \note			Time spent in interrupts is charged to the task they interrupted
+ */
+typedef struct {
+	uint32_t window_ms;
+	uint32_t heap_free;
+	uint32_t heap_minimum_free;					/* Lowest free heap since reset */
+	uint32_t samples;							/* Samples taken so far, 0 means the rest is not filled yet */
+	uint8_t task_count;
+	RtosTaskStats tasks[RTOS_STATS_MAX_TASKS];
+} RtosStatsSnapshot;
+
+
+/* ################ API ################ */
+void rtos_stats_timer_start(TIM_HandleTypeDef* htim);
+
+uint32_t rtos_stats_timer_get(void);
+
+void rtos_stats_sample(void);
+
+void rtos_stats_get(RtosStatsSnapshot* snapshot);
+
+void rtos_stats_print(const RtosStatsSnapshot* snapshot);
+
+void rtos_stats_run(void);
+
+/* ################ Interrupt context ################ */
+void rtos_stats_PeriodElapsedCallback(TIM_HandleTypeDef* htim);
+
+#endif /* INC_RTOS_STATS_H_ */
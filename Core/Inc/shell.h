@@ -0,0 +1,100 @@
+/*
+ * shell.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+
+#ifndef INC_SHELL_H_
+#define INC_SHELL_H_
+
+/*
+ * Line oriented command shell working straight on a circular receive buffer filled by DMA.
+ * Nothing from HAL may be included here, answers go through printf to whatever stdout is.
+ *
+ * Line ends with '\n' or '\r', words are separated by spaces or tabs. Lines are split in place,
+ * terminators are written into the receive buffer itself, only a line wrapping around the end
+ * of the buffer is copied once so that it becomes contiguous.
+ */
+
+#include <stdint.h>
+
+/* Words of a line including the command name, lines with more words are rejected */
+#define SHELL_MAX_ARGS				8u
+
+/* Longest line, longer lines are dropped whole */
+#define SHELL_MAX_LINE				80u
+
+/* Results of a command handler */
+#define SHELL_OK					0			/* Shell answers "ok" */
+#define SHELL_ERROR_USAGE			1			/* Shell answers "err usage: " with the command usage */
+#define SHELL_ERROR_REPORTED		2			/* Handler already printed its own "err ..." line */
+
+/**
+ * \brief			Command handler, argv[0] is the command name
+ * \return			SHELL_OK, SHELL_ERROR_USAGE or SHELL_ERROR_REPORTED
+ * \note			Handler may print any number of result lines, shell adds the final "ok" or "err"
+ * 					line, so a script knows the command is complete when it sees one
+ */
+typedef int (*ShellHandler)(int argc, char** argv);
+
+/**
+ * \brief			Entry of a command table
+ */
+typedef struct {
+	const char* name;
+	const char* usage;							/* Arguments, printed by help and after a failed command */
+	uint8_t min_args;							/* Arguments required after the name */
+	ShellHandler handler;
+} ShellCommand;
+
+/**
+ * \brief			Counters of the shell
+ */
+typedef struct {
+	uint32_t lines;								/* Lines that were not empty */
+	uint32_t failed;							/* Lines that were unknown, incomplete or failed in handler */
+	uint32_t dropped;							/* Lines longer than SHELL_MAX_LINE */
+	uint32_t overruns;							/* Times the receiver overwrote bytes not processed yet */
+} ShellStats;
+
+/**
+ * \brief			Shell reading from one circular receive buffer
+ * \note			Positions are free running byte counts, buffer index is position & mask.
+ * 					Only head is written from interrupt, the rest belongs to the processing thread
+ */
+typedef struct {
+	char* buffer;								/* Receive buffer, size has to be a power of 2 */
+	uint32_t mask;								/* Size - 1 */
+	volatile uint32_t head;						/* Position after the last byte received */
+	volatile uint8_t restarted;					/* Receiver was restarted at index 0, set from interrupt */
+	uint32_t dma_index;							/* Buffer index the receiver writes next, interrupt only */
+	uint32_t tail;								/* Position of the first byte of the current line */
+	uint32_t scan;								/* Position where search for line end continues */
+	uint8_t discarding;							/* Skipping rest of an overlong or broken line */
+	const ShellCommand* commands;
+	uint8_t command_count;
+	char scratch[SHELL_MAX_LINE + 1u];			/* Line that wraps around the end of the buffer */
+	ShellStats stats;
+} ShellTypeDef;
+
+
+/* ################ API ################ */
+void shell_init(ShellTypeDef* shell, char* buffer, uint32_t size, const ShellCommand* commands, uint8_t command_count);
+
+uint32_t shell_process(ShellTypeDef* shell);
+
+int shell_execute(ShellTypeDef* shell, char* line);
+
+uint8_t shell_parse_int(const char* text, int32_t* value);
+
+uint8_t shell_parse_uint(const char* text, uint32_t* value);
+
+uint8_t shell_parse_fixed(const char* text, uint8_t decimals, int32_t* value);
+
+/* ################ Interrupt context ################ */
+void shell_received(ShellTypeDef* shell, uint32_t index);
+
+void shell_restart(ShellTypeDef* shell);
+
+#endif /* INC_SHELL_H_ */
@@ -6,10 +6,88 @@
  */
 #include "TMC2226.h"
 
+#include <string.h>
 #include "main.h"
 #include "tim.h"
 #include "usart.h"
 #include "cmsis_os.h"
+#include "TMC2226_bus.h"
+
+
+/* Tables below are generated from TMC2226_REGISTERS */
+#define SHADOW_REGISTER(name, address, access, mask, reset) \
+	TMC_IF_WRITABLE_##access(TMC_WRITE_NAME_##access(name),)
+#define SHADOW_RESET_VALUE(name, address, access, mask, reset) \
+	TMC_IF_WRITABLE_##access(reset,)
+#define SHADOW_INDEX_BY_ADDRESS(name, address, access, mask, reset) \
+	TMC_IF_WRITABLE_##access([address] = SHADOW_##name + 1,)
+#define INVERTED_MASK_BY_ADDRESS(name, address, access, mask, reset) \
+	TMC_IF_READABLE_##access([address] = ~(uint32_t)(mask),)
+#define CHECK_REGISTER(name, address, access, mask, reset) \
+	_Static_assert((address) <= 0x7Fu, #name " address does not fit 7 bits"); \
+	_Static_assert(((reset) & ~(uint32_t)(mask)) == 0, #name " reset value has bits outside its mask");
+
+TMC2226_REGISTERS(CHECK_REGISTER)
+_Static_assert(SHADOW_COUNT <= 16, "dirty has one bit per shadow slot");
+
+/* WRITE register held in each shadow slot */
+static const TMC2226_WriteRegisters shadow_registers[SHADOW_COUNT] = {
+	TMC2226_REGISTERS(SHADOW_REGISTER)
+};
+
+/* Values every shadow slot starts with */
+static const uint32_t shadow_reset_values[SHADOW_COUNT] = {
+	TMC2226_REGISTERS(SHADOW_RESET_VALUE)
+};
+
+/* Shadow slot + 1 of every WRITE register address, 0 for addresses that can not be written */
+static const uint8_t shadow_index_by_address[128] = {
+	TMC2226_REGISTERS(SHADOW_INDEX_BY_ADDRESS)
+};
+
+/* Masks of READ registers by address, kept inverted so addresses missing here give 0xFF..F mask */
+static const uint32_t inverted_mask_by_address[128] = {
+	TMC2226_REGISTERS(INVERTED_MASK_BY_ADDRESS)
+};
+
+/* CRC8 with polynomial 0x07 for every possible value of (crc ^ byte), kept in flash */
+const uint8_t TMC2226_CRC_table[256] = {
+	0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+	0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+	0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+	0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+	0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+	0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+	0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+	0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+	0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+	0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+	0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+	0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+	0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+	0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+	0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+	0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3
+};
+
+#if TMC_TRACE_ENABLED
+/* Last finished read and write, default TMC_trace keeps them for the debugger watch window */
+TMC_TransferTypeDef tmc_trace_read;
+TMC_TransferTypeDef tmc_trace_write;
+#endif
+
+/* Slots that trigger an action when written instead of holding state */
+#define SHADOW_ONE_SHOT_MASK	((1u << SHADOW_GSTAT) | (1u << SHADOW_OTP_PROG))
+
+static void build_write_transfer(TMC_HandleTypeDef* htmc, TMC2226_WriteRegisters register_address,
+		uint32_t data, TMC_TransferTypeDef* transfer);
+static void mark_written(TMC_HandleTypeDef* htmc, TMC2226_ShadowIndex index);
+static uint8_t probe_link(TMC_HandleTypeDef* htmc);
+static TMC_BusStatus read_interface_counter(TMC_HandleTypeDef* htmc, uint8_t* counter);
+static TMC_BusStatus read_interface_counter_retried(TMC_HandleTypeDef* htmc, uint8_t* counter,
+		uint8_t* failed_checks);
+static TMC_BusStatus flush_group(TMC_HandleTypeDef* htmc, const TMC2226_ShadowIndex* group, uint8_t count,
+		uint8_t* counter);
 
 
 /* ################ API ################*/
@@ -19,24 +97,40 @@
  * 					It sets structure parameters and some registers in the device
  * \param[in]		htmc: handle for proper TMC structure instance
  * \param[in]		node_addr: node address based on MS1 and MS2 pins configuration
- * \param[in]		htim: handle for specific TIM interface
+ * \param[in]		htim: handle for specific TIM interface, TMC_step_init has to be called on it
+ * 					before, otherwise position moves are not available
  * \param[in]		huart: handle for specific UART interface
  * \param[in]		engine_steps_per_full_turn: specific engine characteristic typically 200
  */
 void TMC_Init(TMC_HandleTypeDef* htmc, TMC2226_NodeAddress node_addr, TIM_HandleTypeDef* htim,
 			UART_HandleTypeDef* huart, uint16_t engine_steps_per_full_turn)
 {
-	uint64_t sent_datagram = 0;
-
 	htmc->htim = htim;
 	htmc->huart = huart;
+	htmc->hbus = TMC_bus_get(huart);
+	if (htmc->hbus != NULL)
+	{
+		TMC_bus_attach(htmc->hbus, node_addr);
+	}
+	htmc->hstep = TMC_step_get(htim);
+	htmc->motion_limits.max_velocity = TMC_DEFAULT_MAX_VELOCITY;
+	htmc->motion_limits.acceleration = TMC_DEFAULT_ACCELERATION;
+	htmc->motion_limits.jerk = TMC_DEFAULT_JERK;
 	htmc->node_address = node_addr;
+	htmc->verify_writes = 0;
 	htmc->engine_steps_per_full_turn = engine_steps_per_full_turn;
 
-	// Internal clock used
-	htmc->clock_constant = 0.715;
 	// Microstep resolution as fullstep
 	htmc->microstep_resolution = uSteps_256;
+	// VACTUAL factor for the internal clock (TMC_CLOCK_CONSTANT_MILLI) and the resolution above
+	update_vactual_scale(htmc);
+
+	/*
+	 * Shadow starts with power on values, but the driver may have kept older values
+	 * over MCU reset, so registers configured here are always written
+	 */
+	memcpy(htmc->shadow, shadow_reset_values, sizeof(htmc->shadow));
+	htmc->dirty = (1u << SHADOW_NODECONF) | (1u << SHADOW_GCONF) | (1u << SHADOW_VACTUAL);
 
 	// Assume multi-node operation and set SENDDELAY in NODECONF to at least 2, that's from documentation
 	/*
@@ -44,8 +138,7 @@ void TMC_Init(TMC_HandleTypeDef* htmc, TMC2226_NodeAddress node_addr, TIM_Handle
 	 * so SENDDELAY for read access (time until reply is sent)
 	 * is set to at least 2: respond is delayed 3*8 bit times
 	 */
-	htmc->reg_NODECONF_val = (0x02<<8);
-	write_access(htmc, W_NODECONF, htmc->reg_NODECONF_val, &sent_datagram);
+	htmc->shadow[SHADOW_NODECONF] = (0x02<<8);
 
 	/*
 	 * GCONF register configuration:
@@ -60,8 +153,7 @@ void TMC_Init(TMC_HandleTypeDef* htmc, TMC2226_NodeAddress node_addr, TIM_Handle
 	 * 1 multistep_filt
 	 * 0 test_mode - never set to 1
 	 */
-	htmc->reg_GCONF_val = 0b0111100001;
-	write_access(htmc, W_GCONF, htmc->reg_GCONF_val, &sent_datagram);
+	htmc->shadow[SHADOW_GCONF] = 0b0111100001;
 
 	/*
 	 * CHOPCONF driver configuration (Reset default=0x10000053)
@@ -78,73 +170,446 @@ void TMC_Init(TMC_HandleTypeDef* htmc, TMC2226_NodeAddress node_addr, TIM_Handle
 	 * 30		= 0		diss2g
 	 * 31		= 0		diss2vs
 	 */
-//	htmc->reg_CHOPCONF_val = 0x10000053; // + (htmc->microstep_resolution << 24);
-//	write_access(htmc, W_CHOPCONF, htmc->reg_CHOPCONF_val, &sent_datagram);
+//	TMC_write_register(htmc, W_CHOPCONF, 0x10000053); // + (htmc->microstep_resolution << 24);
+
+	// VACTUAL stays at 0 so the motor stops if it was left spinning
+	TMC_flush(htmc);
 }
 
 /**
  * \brief			This runs stepper motor at desired speed
+ * \note			rpm_speed has always been applied as full turns per second, that scale is kept
+ * 					for existing callers. Single float multiply, the rest is TMC_set_speed_mrpm
  */
 void TMC_set_speed_by_UART(TMC_HandleTypeDef* htmc, float rpm_speed)
 {
-	uint64_t sent_datagram;
-	float FSC_x_USC = htmc->engine_steps_per_full_turn * (1 << (8 - htmc->microstep_resolution));
-	float vactual_speed = (rpm_speed * FSC_x_USC / htmc->clock_constant);
-	write_access(htmc, W_VACTUAL, (int32_t)vactual_speed, &sent_datagram);
+	float milli_rpm = rpm_speed * 60000.0f;
+	if (milli_rpm > 2000000000.0f)
+	{
+		milli_rpm = 2000000000.0f;
+	}
+	else if (milli_rpm < -2000000000.0f)
+	{
+		milli_rpm = -2000000000.0f;
+	}
+	TMC_set_speed_mrpm(htmc, (int32_t)milli_rpm);
 }
 
+/**
+ * \brief			This runs stepper motor at desired speed, integer only, never blocks
+ * \param[in]		htmc: handle for proper TMC structure instance
+ * \param[in]		milli_rpm: speed in thousandths of revolution per minute, sign selects direction
+ * \note			VACTUAL is posted only when the new value differs from the last one posted,
+ * 					speeds above VACTUAL range are clamped. Setpoints posted faster than the link
+ * 					can carry them are coalesced, only the latest one is sent
+ */
+void TMC_set_speed_mrpm(TMC_HandleTypeDef* htmc, int32_t milli_rpm)
+{
+	TMC_WRITE(htmc, VACTUAL, mrpm_to_vactual(htmc, milli_rpm));
+	if (htmc->dirty & (1u << SHADOW_VACTUAL))
+	{
+		TMC_POST(htmc, VACTUAL, htmc->shadow[SHADOW_VACTUAL]);
+	}
+}
 
-/* ################ Low level functions ################ */
 /**
- * \brief			LL function for obtaining registry value from TMC2226
- * \param[in]		htmc: something like "self" parameter
- * \param[in]		register_address: readable register address to read from
- * \param[out]		received_datagram: storing received datagram for debugging purposes
- * \param[out]		sent_datagram: storing sent datagram for debugging purposes
- * \return			32 bit registry value but with masked only bits that are pointed in documentation
- *					for example GCONF has only 10 first bits pointed out, so it is masked with 0x3FF
+ * \brief			Streams setpoint register to the node, latest value wins
+ * \param[in]		htmc: handle for proper TMC structure instance
+ * \param[in]		register_address: W_VACTUAL or W_IHOLD_IRUN
+ * \param[in]		value: new register value
+ * \return			TMC_BUS_PENDING when posted, TMC_BUS_ERROR for registers without mailbox
+ * \note			Returns right away, value not sent yet is replaced by the new one. Shadow is
+ * 					updated immediately and is not marked dirty, so TMC_flush does not send it again
  */
-uint32_t read_access(TMC_HandleTypeDef* htmc, TMC2226_ReadRegisters register_address,
-		uint64_t *received_datagram, uint32_t *sent_datagram)
+TMC_BusStatus TMC_post_register(TMC_HandleTypeDef* htmc, TMC2226_WriteRegisters register_address, uint32_t value)
 {
-	// Datagram creation, CRC calculation
-	uint8_t datagram[4];
-	datagram[0] = 0x05;
-	datagram[1] = htmc->node_address;
-	datagram[2] = register_address | TMC2226_READ;
-	datagram[3] = calculate_CRC(datagram, 4);
+	uint8_t slot;
+	switch (register_address)
+	{
+		case W_VACTUAL:
+			slot = TMC_MAILBOX_VACTUAL;
+			break;
+		case W_IHOLD_IRUN:
+			slot = TMC_MAILBOX_IHOLD_IRUN;
+			break;
+		default:
+			return TMC_BUS_ERROR;
+	}
+
+	TMC_TransferTypeDef transfer;
+	build_write_transfer(htmc, register_address, value, &transfer);
+	TMC2226_ShadowIndex index = get_shadow_index(register_address);
+	htmc->shadow[index] = value;
+	htmc->dirty &= ~(1u << index);
+	return TMC_bus_post(htmc->hbus, slot, transfer.tx_datagram, transfer.tx_length);
+}
+
+/**
+ * \brief			Rotates motor to given absolute angle using STEP/DIR pulses, returns immediately
+ * \param[in]		htmc: handle for proper TMC structure instance
+ * \param[in]		angle: target angle in degrees, 0 is the position where the engine was started
+ * \note			Angle is converted to microsteps with current microstep_resolution, whole turns
+ * 					made earlier are not unwound, so the motor takes the path through position 0
+ */
+void TMC_set_angle(TMC_HandleTypeDef* htmc, uint16_t angle)
+{
+	if (htmc->hstep == NULL)
+	{
+		return;
+	}
+	int32_t microsteps_per_turn = (int32_t)htmc->engine_steps_per_full_turn << (8 - htmc->microstep_resolution);
+	int32_t target = (int32_t)(((int64_t)angle * microsteps_per_turn) / 360);
+	TMC_move_steps(htmc, target - TMC_step_get_position(htmc->hstep));
+}
+
+/**
+ * \brief			Makes given number of microsteps within motion_limits, returns immediately
+ * \param[in]		htmc: handle for proper TMC structure instance
+ * \param[in]		steps: microsteps to make, sign selects direction
+ * \return			HAL_BUSY when previous move is still running, HAL_ERROR when there is no step engine
+ * 					or VACTUAL could not be zeroed
+ * \note			Driver ignores STEP input while VACTUAL is not 0, so VACTUAL is zeroed first.
+ * 					When that write fails VACTUAL stays dirty and no move is started
+ */
+HAL_StatusTypeDef TMC_move_steps(TMC_HandleTypeDef* htmc, int32_t steps)
+{
+	if (htmc->hstep == NULL)
+	{
+		return HAL_ERROR;
+	}
+	if (htmc->shadow[SHADOW_VACTUAL] != 0 || (htmc->dirty & (1u << SHADOW_VACTUAL)))
+	{
+		// Zero replaces any setpoint still waiting in the mailbox, blocking write then confirms it went out
+		TMC_POST(htmc, VACTUAL, 0);
+		write_access(htmc, W_VACTUAL, 0);
+		if (htmc->dirty & (1u << SHADOW_VACTUAL))
+		{
+			return HAL_ERROR;
+		}
+	}
+	return TMC_motion_move(htmc->hstep, steps, &htmc->motion_limits, NULL, NULL);
+}
 
-	// Sending the datagram
-	for (uint8_t i = 0; i < 4; i++)
+/**
+ * \brief			Sets whole WRITE register in the shadow, nothing is sent until TMC_flush
+ * \param[in]		htmc: handle for proper TMC structure instance
+ * \param[in]		register_address: register to be set
+ * \param[in]		value: new register value
+ * \note			Register is marked dirty only when the value changes. Addresses that are not
+ * 					WRITE registers are ignored
+ */
+void TMC_write_register(TMC_HandleTypeDef* htmc, TMC2226_WriteRegisters register_address, uint32_t value)
+{
+	TMC2226_ShadowIndex index = get_shadow_index(register_address);
+	assert_param(index != SHADOW_NONE);
+	if (index == SHADOW_NONE)
+	{
+		return;
+	}
+	if (htmc->shadow[index] != value || ((1u << index) & SHADOW_ONE_SHOT_MASK))
+	{
+		htmc->shadow[index] = value;
+		htmc->dirty |= (1u << index);
+	}
+}
+
+/**
+ * \brief			Changes selected bits of WRITE register in the shadow, nothing is sent until TMC_flush
+ * \param[in]		htmc: handle for proper TMC structure instance
+ * \param[in]		register_address: register to be modified
+ * \param[in]		mask: bits that are replaced
+ * \param[in]		value: new bits, already shifted to their position
+ * \note			Addresses that are not WRITE registers are ignored
+ */
+void TMC_modify_register(TMC_HandleTypeDef* htmc, TMC2226_WriteRegisters register_address,
+		uint32_t mask, uint32_t value)
+{
+	TMC2226_ShadowIndex index = get_shadow_index(register_address);
+	assert_param(index != SHADOW_NONE);
+	if (index == SHADOW_NONE)
 	{
-	    HAL_UART_Transmit(htmc->huart, &datagram[i], 1, HAL_MAX_DELAY);	// TODO Check if it's okay to use HAL_MAX_DELAY
+		return;
 	}
+	uint32_t current = htmc->shadow[index];
+	TMC_write_register(htmc, register_address, (current & ~mask) | (value & mask));
+}
+
+/**
+ * \brief			Returns shadow value of WRITE register
+ * \note			WRITE only registers can not be read back, this is the only way to know their value.
+ * 					0 for addresses that are not WRITE registers
+ */
+uint32_t TMC_get_shadow(TMC_HandleTypeDef* htmc, TMC2226_WriteRegisters register_address)
+{
+	TMC2226_ShadowIndex index = get_shadow_index(register_address);
+	assert_param(index != SHADOW_NONE);
+	return (index != SHADOW_NONE) ? htmc->shadow[index] : 0;
+}
 
-	// Flush one byte
-	uint8_t flush = 0;
-	HAL_UART_Receive(htmc->huart, &flush, 1, 1);	// TODO Check if it's okay to use 1 as Timeout
+/**
+ * \brief			Writes all dirty registers to the driver in one burst
+ * \param[in]		htmc: handle for proper TMC structure instance
+ * \return			TMC_BUS_OK when all dirty registers were sent, otherwise first failure
+ * \note			Writes are queued TMC_FLUSH_BATCH at a time so the worker sends them back to back.
+ * 					Registers that failed stay dirty and are retried on the next flush.
+ * 					With verify_writes set in the handle this is TMC_flush_verified
+ */
+TMC_BusStatus TMC_flush(TMC_HandleTypeDef* htmc)
+{
+	if (htmc->verify_writes)
+	{
+		return TMC_flush_verified(htmc);
+	}
 
-	// Receiving response
-	uint8_t response[8] = {0};
-	HAL_UART_Receive(htmc->huart, response, 8, HAL_MAX_DELAY);	// TODO Check if it's okay to use 1000 as Timeout
+	TMC_TransferTypeDef batch[TMC_FLUSH_BATCH];
+	TMC2226_ShadowIndex batch_index[TMC_FLUSH_BATCH];
+	TMC_BusStatus result = TMC_BUS_OK;
+	uint8_t index = 0;
 
-	// Storing received datagram for later use
-	for (uint8_t i = 0; i < 8; i++)
+	while (index < SHADOW_COUNT)
 	{
-		*received_datagram = (*received_datagram << 8) | response[i];
+		uint8_t queued = 0;
+		for (; index < SHADOW_COUNT && queued < TMC_FLUSH_BATCH; index++)
+		{
+			if (htmc->dirty & (1u << index))
+			{
+				build_write_transfer(htmc, shadow_registers[index], htmc->shadow[index], &batch[queued]);
+				TMC_bus_submit(htmc->hbus, &batch[queued]);
+				batch_index[queued++] = index;
+			}
+		}
+
+		for (uint8_t i = 0; i < queued; i++)
+		{
+			TMC_bus_await(&batch[i]);
+			TMC_TRACE(&batch[i]);
+			if (batch[i].status == TMC_BUS_OK)
+			{
+				mark_written(htmc, batch_index[i]);
+			}
+			else if (result == TMC_BUS_OK)
+			{
+				result = batch[i].status;
+			}
+		}
 	}
+	return result;
+}
+
+/**
+ * \brief			Writes all dirty registers and confirms with IFCNT that the driver accepted them
+ * \param[in]		htmc: handle for proper TMC structure instance
+ * \return			TMC_BUS_OK when every dirty register landed, TMC_BUS_ERROR when retries of a group
+ * 					ran out, otherwise status of the failed IFCNT read
+ * \note			Writes go out in groups of up to TMC_FLUSH_BATCH followed by one IFCNT read. Driver
+ * 					counts only writes with correct CRC, a group whose count did not advance by its
+ * 					size is bisected, see flush_group. One shot registers (GSTAT, OTP_PROG) go in a
+ * 					group of their own, so once their count checks out they are never sent again.
+ * 					Nothing else may write to this node meanwhile (e.g. VACTUAL mailbox), that
+ * 					would advance IFCNT too
+ */
+TMC_BusStatus TMC_flush_verified(TMC_HandleTypeDef* htmc)
+{
+	TMC2226_ShadowIndex group[TMC_FLUSH_BATCH];
+	uint8_t failed_checks = 0;
+	uint8_t counter;
 
-	// Storing back the datagram we created earlier for debugging purposes
-	for (uint8_t i = 0; i < 4; i++)
+	TMC_BusStatus status = read_interface_counter_retried(htmc, &counter, &failed_checks);
+	while (status == TMC_BUS_OK && htmc->dirty != 0)
 	{
-		*sent_datagram = (*sent_datagram << 8) | datagram[i];
+		uint8_t count = 0;
+		for (uint8_t index = 0; index < SHADOW_COUNT && count < TMC_FLUSH_BATCH; index++)
+		{
+			if (!(htmc->dirty & (1u << index)))
+			{
+				continue;
+			}
+			uint8_t one_shot = ((1u << index) & SHADOW_ONE_SHOT_MASK) != 0;
+			if (one_shot && count != 0)
+			{
+				break;
+			}
+			group[count++] = index;
+			if (one_shot)
+			{
+				break;
+			}
+		}
+		status = flush_group(htmc, group, count, &counter);
 	}
+	return status;
+}
 
-	// Check CRC correctness
-	uint8_t response_based_CRC = calculate_CRC(response, 8);
-	if (response_based_CRC == response[7])
+/**
+ * \brief			Sets MRES in CHOPCONF shadow, takes effect after TMC_flush
+ * \note			Requires mstep_reg_select in GCONF which TMC_Init sets
+ */
+void TMC_set_microstep_resolution(TMC_HandleTypeDef* htmc, TMC2226_MRES_steps resolution)
+{
+	htmc->microstep_resolution = resolution;
+	update_vactual_scale(htmc);
+	TMC_MODIFY(htmc, CHOPCONF, TMC_CHOPCONF_MRES_Msk, TMC_FIELD_SET(TMC_CHOPCONF_MRES, resolution));
+}
+
+/**
+ * \brief			Sets TOFF in CHOPCONF shadow, 0 disables the driver, takes effect after TMC_flush
+ */
+void TMC_set_toff(TMC_HandleTypeDef* htmc, uint8_t toff)
+{
+	TMC_MODIFY(htmc, CHOPCONF, TMC_CHOPCONF_TOFF_Msk, TMC_FIELD_SET(TMC_CHOPCONF_TOFF, toff));
+}
+
+/**
+ * \brief			Sets motor currents in IHOLD_IRUN shadow, takes effect after TMC_flush
+ * \param[in]		ihold: standstill current 0..31
+ * \param[in]		irun: run current 0..31
+ * \param[in]		iholddelay: number of clock cycles for motor power down after standstill 0..15
+ */
+void TMC_set_current(TMC_HandleTypeDef* htmc, uint8_t ihold, uint8_t irun, uint8_t iholddelay)
+{
+	TMC_WRITE(htmc, IHOLD_IRUN, TMC_FIELD_SET(TMC_IHOLD_IRUN_IHOLDDELAY, iholddelay)
+			| TMC_FIELD_SET(TMC_IHOLD_IRUN_IRUN, irun) | TMC_FIELD_SET(TMC_IHOLD_IRUN_IHOLD, ihold));
+}
+
+/**
+ * \brief			Sets shaft bit in GCONF shadow (inverse motor direction), takes effect after TMC_flush
+ */
+void TMC_set_shaft(TMC_HandleTypeDef* htmc, uint8_t inverse)
+{
+	TMC_MODIFY(htmc, GCONF, TMC_GCONF_SHAFT_Msk, inverse ? TMC_GCONF_SHAFT_Msk : 0);
+}
+
+/**
+ * \brief			Starts reading register and returns without waiting for the reply
+ * \param[in]		htmc: handle for proper TMC structure instance
+ * \param[in]		register_address: readable register address to read from
+ * \param[out]		future: storage for the request, has to stay valid until TMC_read_await returns
+ * \return			TMC_BUS_PENDING when queued, TMC_BUS_BUSY when bus queue is full
+ * \note			Several reads may be outstanding at once, the bus serves them in order
+ */
+TMC_BusStatus TMC_read_async(TMC_HandleTypeDef* htmc, TMC2226_ReadRegisters register_address,
+		TMC_ReadFuture* future)
+{
+	future->register_address = register_address;
+	future->value = 0;
+
+	build_read_datagram(htmc, register_address, future->transfer.tx_datagram);
+	future->transfer.tx_length = 4;
+	future->transfer.rx_length = 8;
+	future->transfer.timeout = read_timeout_ms(htmc);
+	future->transfer.priority = TMC_BUS_PRIORITY_LOW;
+
+	return TMC_bus_submit(htmc->hbus, &future->transfer);
+}
+
+/**
+ * \brief			Checks without blocking whether the reply already arrived
+ * \param[in]		future: read started with TMC_read_async
+ * \return			1 when TMC_read_await will return immediately, 0 otherwise
+ */
+uint8_t TMC_read_ready(TMC_ReadFuture* future)
+{
+	return future->transfer.status != TMC_BUS_PENDING;
+}
+
+/**
+ * \brief			Sleeps until reply for given read arrives or its deadline passes
+ * \param[in,out]	future: read started with TMC_read_async, value is filled on success
+ * \return			TMC_BUS_OK, TMC_BUS_TIMEOUT, TMC_BUS_CRC_ERROR or TMC_BUS_ERROR
+ */
+TMC_BusStatus TMC_read_await(TMC_ReadFuture* future)
+{
+	TMC_BusStatus status = TMC_bus_await(&future->transfer);
+	TMC_TRACE(&future->transfer);
+	if (status != TMC_BUS_OK)
 	{
-		return apply_mask_and_convert(get_mask_for_given_register(register_address), *received_datagram);
+		return status;
+	}
+
+	// Bus receiver checked sync, address and CRC while the reply was arriving
+	future->value = apply_mask_and_convert(get_mask_for_given_register(future->register_address),
+			future->transfer.rx_datagram);
+	return TMC_BUS_OK;
+}
+
+/**
+ * \brief			Waits for several outstanding reads
+ * \param[in,out]	futures: array of reads started with TMC_read_async
+ * \param[in]		count: number of elements in futures
+ * \return			TMC_BUS_OK when all reads succeeded, otherwise status of the first failed one
+ * \note			Each future gets its own status and value, so partial results can still be used
+ */
+TMC_BusStatus TMC_read_await_all(TMC_ReadFuture* futures, uint8_t count)
+{
+	TMC_BusStatus result = TMC_BUS_OK;
+	for (uint8_t i = 0; i < count; i++)
+	{
+		TMC_BusStatus status = TMC_read_await(&futures[i]);
+		if (result == TMC_BUS_OK)
+		{
+			result = status;
+		}
+	}
+	return result;
+}
+
+/**
+ * \brief			Moves the bus to the fastest baud rate this node still answers reliably at
+ * \param[in]		htmc: node used for probing
+ * \return			Baud rate the bus was left at, 0 when the node does not answer even at the lowest one
+ * \note			Every rate of TMC_BUS_BAUD_RATES is confirmed with TMC_LINK_PROBE_WRITES writes
+ * 					whose arrival is checked with IFCNT readback, climbing stops at the first
+ * 					rate that fails. Rate is shared by all nodes on the bus, so probe with the
+ * 					node that has the worst wiring. Bus worker still falls back on its own
+ * 					when errors show up later
+ */
+uint32_t TMC_link_bringup(TMC_HandleTypeDef* htmc)
+{
+	static const uint32_t baud_rates[] = TMC_BUS_BAUD_RATES;
+	uint32_t reliable = 0;
+
+	for (uint8_t i = 0; i < sizeof(baud_rates) / sizeof(baud_rates[0]); i++)
+	{
+		if (TMC_bus_set_baud_rate(htmc->hbus, baud_rates[i]) != TMC_BUS_OK || !probe_link(htmc))
+		{
+			break;
+		}
+		reliable = baud_rates[i];
+	}
+
+	TMC_bus_set_baud_rate(htmc->hbus, (reliable != 0) ? reliable : baud_rates[0]);
+	return reliable;
+}
+
+/**
+ * \brief			Returns number of the node unique across all buses
+ * \return			Bus index times TMC_BUS_NODE_COUNT plus node address, equal to node address
+ * 					on the first bus
+ */
+uint8_t TMC_node_id(TMC_HandleTypeDef* htmc)
+{
+	return (uint8_t)(TMC_bus_index(htmc->hbus) * TMC_BUS_NODE_COUNT + htmc->node_address);
+}
+
+
+/* ################ Low level functions ################ */
+/**
+ * \brief			LL function for obtaining registry value from TMC2226
+ * \param[in]		htmc: something like "self" parameter
+ * \param[in]		register_address: readable register address to read from
+ * \return			32 bit registry value but with masked only bits that are pointed in documentation
+ *					for example GCONF has only 10 first bits pointed out, so it is masked with 0x3FF.
+ *					0 when the read failed, TMC_read_async with TMC_read_await tell why
+ * \note			Datagrams live only in the future on the stack, with TMC_TRACE_ENABLED
+ * 					they are handed to TMC_trace
+ */
+uint32_t read_access(TMC_HandleTypeDef* htmc, TMC2226_ReadRegisters register_address)
+{
+	TMC_ReadFuture future;
+	if (TMC_read_async(htmc, register_address, &future) == TMC_BUS_PENDING
+			&& TMC_read_await(&future) == TMC_BUS_OK)
+	{
+		return future.value;
 	}
 	return 0;
 }
@@ -154,33 +619,73 @@ uint32_t read_access(TMC_HandleTypeDef* htmc, TMC2226_ReadRegisters register_add
  * \param[in]		htmc: something like "self"
  * \param[in]		register_address: chooses register to write
  * \param[in]		data: data to be set in the register
- * \param[out]		sent_datagram: storing sent datagram for debugging purposes
+ * \note			Register stays dirty when the write failed, TMC_flush retries it. Addresses
+ * 					that are not WRITE registers are not sent
  */
-void write_access(TMC_HandleTypeDef* htmc, TMC2226_WriteRegisters register_address,
-		uint32_t data, uint64_t *sent_datagram)
+void write_access(TMC_HandleTypeDef* htmc, TMC2226_WriteRegisters register_address, uint32_t data)
 {
+	TMC2226_ShadowIndex index = get_shadow_index(register_address);
+	assert_param(index != SHADOW_NONE);
+	if (index == SHADOW_NONE)
+	{
+		return;
+	}
+
 	// Datagram creation, CRC calculation
-	uint8_t datagram[8];
-	datagram[0] = TMC2226_SYNC;
-	datagram[1] = htmc->node_address;
-	datagram[2] = register_address | 0x80;
-	datagram[3] = (data >> 24) & 0xFF;
-	datagram[4] = (data >> 16) & 0xFF;
-	datagram[5] = (data >> 8 ) & 0xFF;
-	datagram[6] = (data      ) & 0xFF;
-	datagram[7] = calculate_CRC(datagram, 8);
+	TMC_TransferTypeDef transfer;
+	build_write_transfer(htmc, register_address, data, &transfer);
 
-	// Sending the datagram
-	for (uint8_t i = 0; i < 8; i++)
+	// Sending the datagram, calling thread sleeps until UART interrupt reports completion
+	htmc->shadow[index] = data;
+	if (TMC_bus_submit(htmc->hbus, &transfer) == TMC_BUS_PENDING)
+	{
+		TMC_bus_await(&transfer);
+	}
+	TMC_TRACE(&transfer);
+	if (transfer.status == TMC_BUS_OK)
+	{
+		mark_written(htmc, index);
+	}
+	else
 	{
-	    HAL_UART_Transmit(htmc->huart, &datagram[i], 1, HAL_MAX_DELAY);	// TODO Check if it is okay to use HAL_MAX_DELAY
+		htmc->dirty |= (1u << index);
 	}
+}
 
-	// Storing back the datagram we created earlier for debugging purposes
-	for (uint8_t i = 0; i < 8; i++)
+#if TMC_TRACE_ENABLED
+/**
+ * \brief			Receives every awaited read and write once it finished, failed ones included
+ * \param[in]		transfer: request in tx_datagram with node address in its second byte,
+ * 					reply of a read in rx_datagram, final status
+ * \note			Runs in the thread that awaited the transfer. Weak, the default only keeps
+ * 					the last read and write for the debugger, override it to log them.
+ * 					Mailbox posts are never awaited, so setpoints do not show up here
+ */
+__weak void TMC_trace(const TMC_TransferTypeDef* transfer)
+{
+	if (transfer->rx_length > 0)
 	{
-		*sent_datagram = (*sent_datagram << 8) | datagram[i];
+		tmc_trace_read = *transfer;
 	}
+	else
+	{
+		tmc_trace_write = *transfer;
+	}
+}
+#endif
+
+/**
+ * \brief			Assembles read request datagram, CRC included
+ * \param[in]		htmc: node the request is addressed to
+ * \param[in]		register_address: readable register address to read from
+ * \param[out]		datagram: 4 bytes of read request
+ */
+void build_read_datagram(TMC_HandleTypeDef* htmc, TMC2226_ReadRegisters register_address, uint8_t* datagram)
+{
+	datagram[0] = TMC2226_SYNC;
+	datagram[1] = htmc->node_address;
+	datagram[2] = register_address | TMC2226_READ;
+	datagram[3] = calculate_CRC(datagram, 4);
 }
 
 /**
@@ -191,62 +696,253 @@ void write_access(TMC_HandleTypeDef* htmc, TMC2226_WriteRegisters register_addre
  */
 uint8_t calculate_CRC(uint8_t* datagram, uint8_t datagram_length)
 {
-	uint8_t currentByte;
 	uint8_t crc = 0;
 	for (uint8_t i = 0; i < (datagram_length-1); i++)
-	{ // Execute for all bytes of a message
-		currentByte = datagram[i]; // Retrieve a byte to be sent from Array
-		for (uint8_t j = 0; j < 8; j++)
-		{
-			if ((crc >> 7) ^ (currentByte&0x01)) // update CRC based result of XOR operation
-			{
-				crc = (crc << 1) ^ 0x07;
-			}
-			else
-			{
-				crc = (crc << 1);
-			}
-		currentByte = currentByte >> 1;
-		} // for CRC bit
-	} // for message byte
+	{ // Execute for all bytes of a message except the CRC slot
+		crc = update_CRC(crc, datagram[i]);
+	}
 	return crc;
 }
 
 /**
- * \brief			Function holds and returns mask accordingly to provided address
- * \param[in]		register_address: register whom mask should be returned
- * \return		 	Byte mask for certain register
- * \note			By default it returns 0xFF..F mask so none of bytes masked are omitted
+ * \brief			Calculates deadline for a single read access
+ * \param[in]		htmc: node whose NODECONF value is used
+ * \return			Time in milliseconds from sending the request until the whole reply is expected
+ * \note			Covers 4 byte request, SENDDELAY from NODECONF and 8 byte reply.
+ * 					SENDDELAY values 0,1 mean 8 bit times, 2,3 mean 3*8 bit times and so on
  */
-uint32_t get_mask_for_given_register(TMC2226_ReadRegisters register_address)
+uint32_t read_timeout_ms(TMC_HandleTypeDef* htmc)
 {
-	switch (register_address)
+	uint8_t senddelay = TMC_FIELD_GET(htmc->shadow[SHADOW_NODECONF], TMC_NODECONF_SENDDELAY);
+	uint16_t bit_times = 4 * 10 + (senddelay | 0x01) * 8 + 8 * 10;
+	return TMC_bus_wire_time_ms(htmc->hbus, bit_times) + TMC_BUS_TIMEOUT_MARGIN_MS;
+}
+
+/**
+ * \brief			Caches VACTUAL per milli-rpm factor, has to be called whenever microstep_resolution
+ * 					or engine_steps_per_full_turn changes
+ * \note			VACTUAL = milli_rpm * microsteps_per_turn / (60000 * 0.715), constant part folded
+ * 					into single fixed point factor so speed updates need one 32x32 multiply and a
+ * 					shift. Factor gets as many fraction bits as fit 32 bits, so its rounding error
+ * 					stays below 2^-31 for full steps of a 1 step motor as well as for 65535 steps
+ * 					at 1/256, where a fixed Q24 would lose ~50 LSB or overflow
+ */
+void update_vactual_scale(TMC_HandleTypeDef* htmc)
+{
+	uint64_t microsteps_per_turn = (uint64_t)htmc->engine_steps_per_full_turn << (8 - htmc->microstep_resolution);
+	uint32_t divisor = 60u * TMC_CLOCK_CONSTANT_MILLI;
+	if (microsteps_per_turn == 0)
 	{
-		case R_GCONF:
-			return 0b1111111111;		// TODO: Finish this dude
-		case R_GSTAT:
-			return 0b111;
-		case R_IFCNT:
-			return 0b11111111;
-		case R_OTP_READ:
-			return 0xFFFFFF;
-		case R_IOIN:
-			return 0xFF0003FF;
-		case R_FACTORY_CONF:
-			return 0b1100011111;
-		default:
-			return 0xFFFFFFFF;
+		microsteps_per_turn = 1;
 	}
+
+	// At most 2^24 microsteps per turn, so shifted value stays within 64 bits up to q = 39
+	uint8_t q = 0;
+	while (q < 39 && ((microsteps_per_turn << (q + 1)) + divisor / 2) / divisor <= UINT32_MAX)
+	{
+		q++;
+	}
+	htmc->vactual_scale = ((microsteps_per_turn << q) + divisor / 2) / divisor;
+	htmc->vactual_scale_q = q;
+}
+
+/**
+ * \brief			Converts speed into VACTUAL value using cached factor
+ * \param[in]		htmc: handle with up to date vactual_scale
+ * \param[in]		milli_rpm: speed in thousandths of revolution per minute
+ * \return			VACTUAL rounded toward zero and clamped to its 24 bit signed range
+ */
+int32_t mrpm_to_vactual(TMC_HandleTypeDef* htmc, int32_t milli_rpm)
+{
+	uint32_t magnitude = (milli_rpm < 0) ? -(uint32_t)milli_rpm : (uint32_t)milli_rpm;
+	uint64_t vactual = ((uint64_t)magnitude * htmc->vactual_scale) >> htmc->vactual_scale_q;
+	if (vactual > TMC_VACTUAL_MAX)
+	{
+		vactual = TMC_VACTUAL_MAX;
+	}
+	return (milli_rpm < 0) ? -(int32_t)vactual : (int32_t)vactual;
+}
+
+/**
+ * \brief			Finds shadow slot of given WRITE register
+ * \param[in]		register_address: WRITE register address
+ * \return			Index to TMC_HandleTypeDef shadow array, SHADOW_NONE when the address is not
+ * 					a WRITE register
+ * \note			Single table load, see shadow_index_by_address
+ */
+TMC2226_ShadowIndex get_shadow_index(TMC2226_WriteRegisters register_address)
+{
+	uint8_t slot = ((uint32_t)register_address <= 0x7Fu) ? shadow_index_by_address[register_address] : 0;
+	return (slot != 0) ? (TMC2226_ShadowIndex)(slot - 1) : SHADOW_NONE;
+}
+
+/**
+ * \brief			Returns mask of given register from the register table
+ * \param[in]		register_address: register whom mask should be returned
+ * \return		 	Mask of all bits the datasheet defines for certain register
+ * \note			Reserved bits read as 0 anyway, masking keeps garbage out of the decoders
+ * 					in TMC2226_registers.h. Unknown address gets 0xFF..F mask so nothing is lost.
+ * 					Where the register is known at build time TMC_<name>_MASK is the constant
+ */
+uint32_t get_mask_for_given_register(TMC2226_ReadRegisters register_address)
+{
+	return ~inverted_mask_by_address[register_address & 0x7Fu];
 }
 
 /**
- * \brief			Applies mask, shifts bits and returns registry value
+ * \brief			Applies mask and returns registry value
  * \param[in]		mask: mask to be applied
- * \param[in]		received_datagram: datagram from witch data is being extracted
+ * \param[in]		reply: 8 byte read reply, data sits big endian in bytes 3..6
  * \return			Register value
  */
-uint32_t apply_mask_and_convert(uint32_t mask, uint64_t received_datagram)
+uint32_t apply_mask_and_convert(uint32_t mask, const uint8_t* reply)
+{
+	uint32_t data = ((uint32_t)reply[3] << 24) | ((uint32_t)reply[4] << 16) | ((uint32_t)reply[5] << 8) | reply[6];
+	return data & mask;
+}
+
+/* ################ Private functions ################ */
+/* Returns 1 when every probe write advanced IFCNT by exactly one */
+static uint8_t probe_link(TMC_HandleTypeDef* htmc)
+{
+	uint8_t counter;
+	if (read_interface_counter(htmc, &counter) != TMC_BUS_OK)
+	{
+		return 0;
+	}
+
+	for (uint8_t i = 0; i < TMC_LINK_PROBE_WRITES; i++)
+	{
+		// GCONF rewritten with its own value, driver state does not change
+		uint8_t expected = counter + 1;
+		write_access(htmc, W_GCONF, htmc->shadow[SHADOW_GCONF]);
+		if (read_interface_counter(htmc, &counter) != TMC_BUS_OK || counter != expected)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Counter is left alone when the read fails */
+static TMC_BusStatus read_interface_counter(TMC_HandleTypeDef* htmc, uint8_t* counter)
+{
+	TMC_ReadFuture future;
+	TMC_BusStatus status = TMC_read_async(htmc, R_IFCNT, &future);
+	if (status == TMC_BUS_PENDING)
+	{
+		status = TMC_read_await(&future);
+	}
+	if (status == TMC_BUS_OK)
+	{
+		*counter = future.value;
+	}
+	return status;
+}
+
+/* Failed read says nothing about the writes before it, the counter is read again within the retry budget */
+static TMC_BusStatus read_interface_counter_retried(TMC_HandleTypeDef* htmc, uint8_t* counter,
+		uint8_t* failed_checks)
+{
+	TMC_BusStatus status = read_interface_counter(htmc, counter);
+	while (status != TMC_BUS_OK && ++(*failed_checks) <= TMC_VERIFY_RETRIES)
+	{
+		status = read_interface_counter(htmc, counter);
+	}
+	return status;
+}
+
+/*
+ * Sends group of shadow slots and checks IFCNT advanced by its size. Group that comes up short
+ * is split, each half is sent and checked on its own and marked written once its count is right,
+ * down to single registers. Part whose count did not move at all is missing as a whole and is
+ * sent again unsplit. Every group gets its own TMC_VERIFY_RETRIES failed checks
+ */
+static TMC_BusStatus flush_group(TMC_HandleTypeDef* htmc, const TMC2226_ShadowIndex* group, uint8_t count,
+		uint8_t* counter)
+{
+	TMC_TransferTypeDef batch[TMC_FLUSH_BATCH];
+	uint8_t starts[TMC_FLUSH_BATCH];			/* Parts still to be confirmed, the last one goes next */
+	uint8_t sizes[TMC_FLUSH_BATCH];
+	uint8_t parts = 1;
+	uint8_t failed_checks = 0;
+
+	starts[0] = 0;
+	sizes[0] = count;
+	while (parts != 0)
+	{
+		uint8_t start = starts[parts - 1];
+		uint8_t size = sizes[parts - 1];
+		for (uint8_t i = 0; i < size; i++)
+		{
+			TMC2226_ShadowIndex index = group[start + i];
+			build_write_transfer(htmc, shadow_registers[index], htmc->shadow[index], &batch[i]);
+			TMC_bus_submit(htmc->hbus, &batch[i]);
+		}
+		for (uint8_t i = 0; i < size; i++)
+		{
+			TMC_bus_await(&batch[i]);
+			TMC_TRACE(&batch[i]);
+		}
+
+		uint8_t previous = *counter;
+		TMC_BusStatus status = read_interface_counter_retried(htmc, counter, &failed_checks);
+		if (status != TMC_BUS_OK)
+		{
+			return status;
+		}
+		uint8_t landed = *counter - previous;
+		if (landed == size)
+		{
+			for (uint8_t i = 0; i < size; i++)
+			{
+				mark_written(htmc, group[start + i]);
+			}
+			parts--;
+			continue;
+		}
+		if (++failed_checks > TMC_VERIFY_RETRIES)
+		{
+			return TMC_BUS_ERROR;
+		}
+		if (size > 1 && landed != 0)
+		{
+			// Part is replaced by its halves, the first half goes next
+			starts[parts - 1] = start + size / 2;
+			sizes[parts - 1] = size - size / 2;
+			starts[parts] = start;
+			sizes[parts] = size / 2;
+			parts++;
+		}
+	}
+	return TMC_BUS_OK;
+}
+
+static void build_write_transfer(TMC_HandleTypeDef* htmc, TMC2226_WriteRegisters register_address,
+		uint32_t data, TMC_TransferTypeDef* transfer)
 {
-	return (uint32_t)((received_datagram >> 8) & mask);
+	uint8_t* datagram = transfer->tx_datagram;
+	datagram[0] = TMC2226_SYNC;
+	datagram[1] = htmc->node_address;
+	datagram[2] = register_address | TMC2226_WRITE;
+	datagram[3] = (data >> 24) & 0xFF;
+	datagram[4] = (data >> 16) & 0xFF;
+	datagram[5] = (data >> 8 ) & 0xFF;
+	datagram[6] = (data      ) & 0xFF;
+	datagram[7] = calculate_CRC(datagram, 8);
+	transfer->tx_length = 8;
+	transfer->rx_length = 0;
+	transfer->timeout = TMC_bus_wire_time_ms(htmc->hbus, 8 * 10) + TMC_BUS_TIMEOUT_MARGIN_MS;
+
+	// Setpoints overtake configuration writes and status reads of other nodes
+	transfer->priority = (register_address == W_VACTUAL) ? TMC_BUS_PRIORITY_HIGH : TMC_BUS_PRIORITY_NORMAL;
 }
 
+static void mark_written(TMC_HandleTypeDef* htmc, TMC2226_ShadowIndex index)
+{
+	htmc->dirty &= ~(1u << index);
+	if ((1u << index) & SHADOW_ONE_SHOT_MASK)
+	{
+		htmc->shadow[index] = 0;
+	}
+}
@@ -0,0 +1,139 @@
+/*
+ * TMC2226_axes.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+#include "TMC2226_axes.h"
+
+#include <string.h>
+#include "main.h"
+#include "TMC2226.h"
+
+
+/* ################ API ################*/
+
+/**
+ * \brief			Prepares empty machine over given buses
+ * \param[in]		huarts: single wire UARTs, each configured by its MX_USARTx_UART_Init
+ * \param[in]		bus_count: 1 up to TMC_BUS_MAX_COUNT
+ * \return			HAL_ERROR when bus_count is out of range or a bus can not be registered
+ * \note			Registers the buses in given order, so their TMC_bus_index follows it as long
+ * 					as no other bus was registered before
+ */
+HAL_StatusTypeDef TMC_axes_init(TMC_AxesTypeDef* haxes, UART_HandleTypeDef* const* huarts, uint8_t bus_count)
+{
+	memset(haxes, 0, sizeof(TMC_AxesTypeDef));
+	if (bus_count == 0 || bus_count > TMC_BUS_MAX_COUNT)
+	{
+		return HAL_ERROR;
+	}
+	for (uint8_t bus = 0; bus < bus_count; bus++)
+	{
+		if (TMC_bus_get(huarts[bus]) == NULL)
+		{
+			return HAL_ERROR;
+		}
+		haxes->huarts[bus] = huarts[bus];
+	}
+	haxes->bus_count = bus_count;
+	return HAL_OK;
+}
+
+/**
+ * \brief			Initializes next axis on the bus that has the fewest axes so far
+ * \param[in]		htmc: node to be initialized with TMC_Init, has to stay valid
+ * \param[in]		htim: STEP/DIR timer of the axis, see TMC_Init
+ * \param[in]		engine_steps_per_full_turn: specific engine characteristic typically 200
+ * \return			HAL_ERROR when every bus already has TMC_BUS_NODE_COUNT axes
+ * \note			Axes are dealt round robin: axis n goes to bus n % bus_count with node address
+ * 					n / bus_count, so MS1/MS2 have to be strapped that way. Neighbouring axes,
+ * 					which usually move together, end up on different buses
+ */
+HAL_StatusTypeDef TMC_axes_add(TMC_AxesTypeDef* haxes, TMC_HandleTypeDef* htmc, TIM_HandleTypeDef* htim,
+		uint16_t engine_steps_per_full_turn)
+{
+	uint8_t least = 0;
+	for (uint8_t bus = 1; bus < haxes->bus_count; bus++)
+	{
+		if (haxes->axes_on_bus[bus] < haxes->axes_on_bus[least])
+		{
+			least = bus;
+		}
+	}
+	if (haxes->bus_count == 0 || haxes->axes_on_bus[least] >= TMC_BUS_NODE_COUNT)
+	{
+		return HAL_ERROR;
+	}
+
+	TMC2226_NodeAddress node_address = (TMC2226_NodeAddress)haxes->axes_on_bus[least];
+	TMC_Init(htmc, node_address, htim, haxes->huarts[least], engine_steps_per_full_turn);
+	haxes->axes_on_bus[least]++;
+	haxes->axes[haxes->axis_count++] = htmc;
+	return HAL_OK;
+}
+
+/**
+ * \brief			Runs TMC_link_bringup on every bus with its first axis
+ * \return			Lowest rate the buses settled at, 0 when a bus does not answer at all
+ * \note			Buses are brought up one after another, every one ends at its own rate
+ */
+uint32_t TMC_axes_link_bringup(TMC_AxesTypeDef* haxes)
+{
+	uint32_t lowest = 0;
+	for (uint8_t bus = 0; bus < haxes->bus_count && bus < haxes->axis_count; bus++)
+	{
+		// Axis n sits on bus n as long as every bus has at least one axis
+		uint32_t reliable = TMC_link_bringup(haxes->axes[bus]);
+		if (bus == 0 || reliable < lowest)
+		{
+			lowest = reliable;
+		}
+	}
+	return lowest;
+}
+
+/**
+ * \brief			Posts speed of every axis, never blocks
+ * \param[in]		milli_rpm: one speed per axis in the order of TMC_axes_add
+ * \note			Setpoints land in the mailboxes of their buses, workers of all buses start
+ * 					sending them at once, see TMC_set_speed_mrpm
+ */
+void TMC_axes_set_speed_mrpm(TMC_AxesTypeDef* haxes, const int32_t* milli_rpm)
+{
+	for (uint8_t axis = 0; axis < haxes->axis_count; axis++)
+	{
+		TMC_set_speed_mrpm(haxes->axes[axis], milli_rpm[axis]);
+	}
+}
+
+/**
+ * \brief			Reads one register of every axis, buses work in parallel
+ * \param[out]		values: one masked value per axis in the order of TMC_axes_add,
+ * 					entries of failed reads are left untouched
+ * \return			TMC_BUS_OK or status of the first read that failed
+ * \note			All reads are queued before the first await, so the whole batch takes
+ * 					about as long as the reads of the bus with the most axes
+ */
+TMC_BusStatus TMC_axes_read(TMC_AxesTypeDef* haxes, TMC2226_ReadRegisters register_address, uint32_t* values)
+{
+	for (uint8_t axis = 0; axis < haxes->axis_count; axis++)
+	{
+		TMC_read_async(haxes->axes[axis], register_address, &haxes->reads[axis]);
+	}
+
+	TMC_BusStatus result = TMC_BUS_OK;
+	for (uint8_t axis = 0; axis < haxes->axis_count; axis++)
+	{
+		TMC_BusStatus status = TMC_read_await(&haxes->reads[axis]);
+		if (status == TMC_BUS_OK)
+		{
+			values[axis] = haxes->reads[axis].value;
+		}
+		else if (result == TMC_BUS_OK)
+		{
+			result = status;
+		}
+	}
+	return result;
+}
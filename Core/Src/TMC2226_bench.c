@@ -0,0 +1,173 @@
+/*
+ * TMC2226_bench.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+#include "TMC2226_bench.h"
+
+#include <stdio.h>
+#include "main.h"
+#include "FreeRTOS.h"
+#include "cycle_counter.h"
+
+typedef void (*BenchPath)(TMC_HandleTypeDef* htmc, uint32_t iterations);
+
+typedef struct {
+	const char* name;
+	BenchPath path;
+} BenchEntry;
+
+/* Keeps results alive, otherwise the compiler may drop calls whose value is unused */
+static volatile uint32_t bench_sink;
+
+static void bench_baseline(TMC_HandleTypeDef* htmc, uint32_t iterations);
+static void bench_calculate_crc(TMC_HandleTypeDef* htmc, uint32_t iterations);
+static void bench_build_read_datagram(TMC_HandleTypeDef* htmc, uint32_t iterations);
+static void bench_get_mask(TMC_HandleTypeDef* htmc, uint32_t iterations);
+static void bench_apply_mask(TMC_HandleTypeDef* htmc, uint32_t iterations);
+static void bench_set_speed(TMC_HandleTypeDef* htmc, uint32_t iterations);
+static void bench_read_access(TMC_HandleTypeDef* htmc, uint32_t iterations);
+
+static const BenchEntry bench_entries[TMC_BENCH_COUNT] = {
+	{ "baseline", bench_baseline },
+	{ "calculate_CRC", bench_calculate_crc },
+	{ "build_read_datagram", bench_build_read_datagram },
+	{ "get_mask_for_register", bench_get_mask },
+	{ "apply_mask_and_convert", bench_apply_mask },
+	{ "TMC_set_speed_by_UART", bench_set_speed },
+	{ "read_access", bench_read_access }
+};
+
+/* Read registers visited in turn, so the mask lookup does not always hit the same case */
+static const TMC2226_ReadRegisters bench_registers[] = {
+	R_GCONF, R_GSTAT, R_IFCNT, R_OTP_READ, R_IOIN, R_FACTORY_CONF, R_TSTEP, R_SG_RESULT,
+	R_MSCNT, R_MSCURACT, R_CHOPCONF, R_DRV_STATUS, R_PWMCONF, R_PWM_SCALE, R_PWM_AUTO
+};
+
+#define BENCH_REGISTER_COUNT		(sizeof(bench_registers) / sizeof(bench_registers[0]))
+
+
+/* ################ API ################*/
+
+/**
+ * \brief			Measures hot paths of the driver one after another
+ * \param[in]		htmc: initialized node, read_access and speed posts really go to it
+ * \param[in]		iterations: calls per path, keep total below 2^32 cycles (~67 s at 64 MHz)
+ * \param[out]		results: TMC_BENCH_COUNT entries
+ * \return			Number of results filled
+ * \note			Blocks for as long as the reads take on the bus, motor is left at speed 0.
+ * 					Heap check compares free RTOS heap before and after each path, so only
+ * 					allocations that stay taken show up
+ */
+uint8_t TMC_bench_run(TMC_HandleTypeDef* htmc, uint32_t iterations, TMC_BenchResult* results)
+{
+	cycle_counter_init();
+	for (uint8_t i = 0; i < TMC_BENCH_COUNT; i++)
+	{
+		size_t free_heap = xPortGetFreeHeapSize();
+		uint32_t start = cycle_counter_get();
+		bench_entries[i].path(htmc, iterations);
+		results[i].cycles = cycle_counter_get() - start;
+		results[i].heap_taken = (uint32_t)(free_heap - xPortGetFreeHeapSize());
+		results[i].name = bench_entries[i].name;
+		results[i].iterations = iterations;
+	}
+	TMC_set_speed_mrpm(htmc, 0);
+	return TMC_BENCH_COUNT;
+}
+
+/**
+ * \brief			Returns time of a single call in tenths of nanosecond
+ */
+uint32_t TMC_bench_ns_x10(const TMC_BenchResult* result)
+{
+	uint64_t ns_x10 = (uint64_t)result->cycles * 10000u / (SystemCoreClock / 1000000u);
+	return (uint32_t)(ns_x10 / result->iterations);
+}
+
+/**
+ * \brief			Prints one line per result: name, ns/op, cycles/op and allocation status
+ */
+void TMC_bench_print(const TMC_BenchResult* results, uint8_t count)
+{
+	for (uint8_t i = 0; i < count; i++)
+	{
+		uint32_t ns_x10 = TMC_bench_ns_x10(&results[i]);
+		uint32_t cycles_x10 = (uint32_t)((uint64_t)results[i].cycles * 10u / results[i].iterations);
+		printf("%-24s %7lu.%lu ns/op %7lu.%lu cycles/op  %s\n", results[i].name,
+				(unsigned long)(ns_x10 / 10u), (unsigned long)(ns_x10 % 10u),
+				(unsigned long)(cycles_x10 / 10u), (unsigned long)(cycles_x10 % 10u),
+				(results[i].heap_taken != 0) ? "allocates" : "no-alloc");
+	}
+}
+
+
+/* ################ Private functions ################ */
+/* Loop and sink alone, what every other path pays on top of its own cost */
+static void bench_baseline(TMC_HandleTypeDef* htmc, uint32_t iterations)
+{
+	(void)htmc;
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		bench_sink = i;
+	}
+}
+
+static void bench_calculate_crc(TMC_HandleTypeDef* htmc, uint32_t iterations)
+{
+	(void)htmc;
+	uint8_t datagram[8] = { TMC2226_SYNC, 0x00, W_GCONF | TMC2226_WRITE, 0x00, 0x00, 0x01, 0xE1, 0x00 };
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		datagram[6] = (uint8_t)i;
+		bench_sink = calculate_CRC(datagram, 8);
+	}
+}
+
+static void bench_build_read_datagram(TMC_HandleTypeDef* htmc, uint32_t iterations)
+{
+	uint8_t datagram[4];
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		build_read_datagram(htmc, bench_registers[i % BENCH_REGISTER_COUNT], datagram);
+		bench_sink = datagram[3];
+	}
+}
+
+static void bench_get_mask(TMC_HandleTypeDef* htmc, uint32_t iterations)
+{
+	(void)htmc;
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		bench_sink = get_mask_for_given_register(bench_registers[i % BENCH_REGISTER_COUNT]);
+	}
+}
+
+static void bench_apply_mask(TMC_HandleTypeDef* htmc, uint32_t iterations)
+{
+	(void)htmc;
+	uint8_t reply[8] = { TMC2226_SYNC, 0xFF, R_DRV_STATUS, 0x80, 0x00, 0x00, 0x1F, 0x00 };
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		reply[6] = (uint8_t)i;
+		bench_sink = apply_mask_and_convert(TMC_DRV_STATUS_MASK, reply);
+	}
+}
+
+/* Speed alternates, so every call converts and posts instead of hitting the unchanged value check */
+static void bench_set_speed(TMC_HandleTypeDef* htmc, uint32_t iterations)
+{
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		TMC_set_speed_by_UART(htmc, (i & 1u) ? 1.5f : -1.5f);
+	}
+}
+
+static void bench_read_access(TMC_HandleTypeDef* htmc, uint32_t iterations)
+{
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		bench_sink = read_access(htmc, R_IFCNT);
+	}
+}
@@ -0,0 +1,672 @@
+/*
+ * TMC2226_bus.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+#include "TMC2226_bus.h"
+
+#include <string.h>
+#include "main.h"
+#include "usart.h"
+#include "cmsis_os.h"
+#include "cycle_counter.h"
+#include "probe.h"
+#include "TMC2226.h"
+#include "TMC2226_capture.h"
+
+
+static TMC_BusTypeDef tmc_buses[TMC_BUS_MAX_COUNT];
+
+static const uint32_t tmc_bus_baud_rates[] = TMC_BUS_BAUD_RATES;
+
+static const osThreadAttr_t tmc_bus_worker_attributes = {
+  .name = "tmc_bus",
+  .stack_size = 128 * 4,
+  .priority = (osPriority_t) osPriorityAboveNormal,
+};
+
+static void bus_worker(void *argument);
+static TMC_TransferTypeDef* next_transfer(TMC_BusTypeDef* hbus);
+static TMC_TransferTypeDef* next_queued(TMC_BusTypeDef* hbus);
+static TMC_TransferTypeDef* next_mailbox(TMC_BusTypeDef* hbus);
+static TMC_BusStatus run_transfer(TMC_BusTypeDef* hbus, TMC_TransferTypeDef* transfer);
+static void wait_interframe_gap(TMC_BusTypeDef* hbus);
+static TMC_BusStatus apply_baud_rate(TMC_BusTypeDef* hbus, uint32_t baud_rate);
+static void count_error(TMC_BusTypeDef* hbus, uint8_t node_address, TMC_BusStatus status);
+static void fall_back_if_unreliable(TMC_BusTypeDef* hbus);
+static void recover_if_clean(TMC_BusTypeDef* hbus);
+static void update_node_stats(TMC_BusTypeDef* hbus, TMC_TransferTypeDef* transfer, TMC_BusStatus status);
+static TMC_BusTypeDef* find_bus(UART_HandleTypeDef* huart);
+static void complete_from_isr(TMC_BusTypeDef* hbus, TMC_BusStatus status);
+static TMC_BusStatus receive_byte(TMC_BusTypeDef* hbus, uint8_t byte);
+static void capture_transfer(TMC_BusTypeDef* hbus, TMC_TransferTypeDef* transfer, TMC_CaptureEvent event,
+		const uint8_t* datagram, uint8_t length);
+
+
+/* ################ API ################*/
+
+/**
+ * \brief			Returns bus instance bound to given UART, registers it on first use
+ * \param[in]		huart: handle for single wire UART interface
+ * \return			Bus instance or NULL if all TMC_BUS_MAX_COUNT slots are taken
+ * \note			First call for given UART creates the transfer queues and the worker thread
+ * 					which from now on is the only one touching the UART
+ */
+TMC_BusTypeDef* TMC_bus_get(UART_HandleTypeDef* huart)
+{
+	TMC_BusTypeDef* hbus = find_bus(huart);
+	if (hbus != NULL)
+	{
+		return hbus;
+	}
+
+	for (uint8_t i = 0; i < TMC_BUS_MAX_COUNT; i++)
+	{
+		if (tmc_buses[i].huart == NULL)
+		{
+			hbus = &tmc_buses[i];
+			memset(hbus, 0, sizeof(TMC_BusTypeDef));
+			for (uint8_t priority = 0; priority < TMC_BUS_PRIORITY_COUNT; priority++)
+			{
+				hbus->queue[priority] = osMessageQueueNew(TMC_BUS_QUEUE_LENGTH, sizeof(TMC_TransferTypeDef*), NULL);
+			}
+			cycle_counter_init();
+			hbus->huart = huart;
+			hbus->baud_rate_limit = huart->Init.BaudRate;
+			hbus->worker = osThreadNew(bus_worker, hbus, &tmc_bus_worker_attributes);
+			return hbus;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * \brief			Returns position of the bus in registration order, 0 for the first TMC_bus_get
+ * \note			Stays the same for the lifetime of the bus, so it can tell nodes of
+ * 					different buses apart where they share a node address
+ */
+uint8_t TMC_bus_index(TMC_BusTypeDef* hbus)
+{
+	return (uint8_t)(hbus - tmc_buses);
+}
+
+/**
+ * \brief			Tells the bus a node with given address is expected on it
+ * \param[in]		hbus: bus the node is wired to
+ * \param[in]		node_address: node address 0..3
+ * \note			Timeouts of the only node of a bus can not come from another node being absent,
+ * 					so they may drive the fallback, see TMC_BUS_FALLBACK_ERRORS
+ */
+void TMC_bus_attach(TMC_BusTypeDef* hbus, uint8_t node_address)
+{
+	int32_t lock = osKernelLock();
+	hbus->node_mask |= (1u << (node_address % TMC_BUS_NODE_COUNT));
+	osKernelRestoreLock(lock);
+}
+
+/**
+ * \brief			Queues transfer for the bus worker and returns immediately
+ * \param[in]		hbus: bus to be used
+ * \param[in,out]	transfer: filled datagram, its status is TMC_BUS_PENDING until the worker finishes it
+ * \return			TMC_BUS_PENDING when queued, TMC_BUS_BUSY when the queue is full
+ * \note			Calling thread becomes the owner and gets TMC_BUS_FLAG_DONE on completion.
+ * 					Transfers of higher priority overtake queued ones of lower priority,
+ * 					within one priority they are served in submission order
+ */
+TMC_BusStatus TMC_bus_submit(TMC_BusTypeDef* hbus, TMC_TransferTypeDef* transfer)
+{
+	transfer->owner = osThreadGetId();
+	transfer->status = TMC_BUS_PENDING;
+	transfer->submit_cycles = cycle_counter_get();
+	if (osMessageQueuePut(hbus->queue[transfer->priority], &transfer, 0, 0) != osOK)
+	{
+		transfer->status = TMC_BUS_BUSY;
+		return TMC_BUS_BUSY;
+	}
+	osThreadFlagsSet(hbus->worker, TMC_BUS_FLAG_QUEUED);
+	return TMC_BUS_PENDING;
+}
+
+/**
+ * \brief			Sleeps until submitted transfer completes
+ * \param[in]		transfer: previously submitted transfer
+ * \return			Final status of the transfer
+ * \note			Never blocks forever, the worker enforces the deadline of every transfer
+ */
+TMC_BusStatus TMC_bus_await(TMC_TransferTypeDef* transfer)
+{
+	while (transfer->status == TMC_BUS_PENDING)
+	{
+		// Flag is shared by all transfers of this thread, so re-check status after each wake up
+		osThreadFlagsWait(TMC_BUS_FLAG_DONE, osFlagsWaitAny, osWaitForever);
+	}
+	return transfer->status;
+}
+
+/**
+ * \brief			Posts write datagram into node mailbox, replacing value that was not sent yet
+ * \param[in]		hbus: bus to be used
+ * \param[in]		slot: mailbox of the node, one per streamed register, below TMC_BUS_MAILBOX_SLOTS
+ * \param[in]		tx_datagram: whole write datagram, node address is taken from it
+ * \param[in]		tx_length: length of datagram
+ * \return			TMC_BUS_PENDING, posting never blocks and never fails
+ * \note			Meant for setpoints posted faster than the link can carry them. Worker sends
+ * 					only the latest value, so delay is bounded by about one datagram time.
+ * 					Nobody is notified about completion, failures show up in node statistics
+ */
+TMC_BusStatus TMC_bus_post(TMC_BusTypeDef* hbus, uint8_t slot, const uint8_t* tx_datagram, uint8_t tx_length)
+{
+	uint8_t node = tx_datagram[1] % TMC_BUS_NODE_COUNT;
+	TMC_BusMailbox* mailbox = &hbus->mailbox[node][slot % TMC_BUS_MAILBOX_SLOTS];
+
+	// Worker copies the datagram out with scheduler locked as well, so it never sees half of it
+	int32_t lock = osKernelLock();
+	if (mailbox->full)
+	{
+		hbus->node_stats[node].superseded++;
+	}
+	memcpy(mailbox->datagram, tx_datagram, tx_length);
+	mailbox->length = tx_length;
+	mailbox->post_cycles = cycle_counter_get();
+	mailbox->full = 1;
+	osKernelRestoreLock(lock);
+
+	osThreadFlagsSet(hbus->worker, TMC_BUS_FLAG_QUEUED);
+	return TMC_BUS_PENDING;
+}
+
+/**
+ * \brief			Switches the bus to another baud rate
+ * \param[in]		hbus: bus to be reconfigured
+ * \param[in]		baud_rate: new rate, nodes follow it on their own
+ * \return			TMC_BUS_OK when UART was reconfigured
+ * \note			Change is queued like any other transfer, so transfers submitted earlier
+ * 					by this thread still go out at the old rate
+ */
+TMC_BusStatus TMC_bus_set_baud_rate(TMC_BusTypeDef* hbus, uint32_t baud_rate)
+{
+	TMC_TransferTypeDef transfer;
+	transfer.priority = TMC_BUS_PRIORITY_NORMAL;
+	transfer.tx_length = 0;
+	transfer.rx_length = 0;
+	transfer.baud_rate = baud_rate;
+
+	if (TMC_bus_submit(hbus, &transfer) != TMC_BUS_PENDING)
+	{
+		return transfer.status;
+	}
+	return TMC_bus_await(&transfer);
+}
+
+/**
+ * \brief			Returns baud rate the bus currently runs at
+ */
+uint32_t TMC_bus_get_baud_rate(TMC_BusTypeDef* hbus)
+{
+	return hbus->huart->Init.BaudRate;
+}
+
+/**
+ * \brief			Copies statistics of a single node
+ * \param[in]		hbus: bus the node is attached to
+ * \param[in]		node_address: node address 0..3
+ * \param[out]		stats: copy of the node statistics
+ * \note			Worker may update statistics while they are copied, values are for diagnostics only
+ */
+void TMC_bus_get_node_stats(TMC_BusTypeDef* hbus, uint8_t node_address, TMC_BusNodeStats* stats)
+{
+	*stats = hbus->node_stats[node_address % TMC_BUS_NODE_COUNT];
+}
+
+/**
+ * \brief			Clears statistics of all nodes on the bus
+ */
+void TMC_bus_reset_stats(TMC_BusTypeDef* hbus)
+{
+	memset(hbus->node_stats, 0, sizeof(hbus->node_stats));
+}
+
+/**
+ * \brief			Calculates time needed to put given number of bit times on the wire
+ * \param[in]		hbus: bus whose baud rate is used
+ * \param[in]		bit_times: number of bit times, each byte takes 10 of them (start + 8 data + stop)
+ * \return			Time in milliseconds rounded up
+ */
+uint32_t TMC_bus_wire_time_ms(TMC_BusTypeDef* hbus, uint16_t bit_times)
+{
+	uint32_t baud_rate = hbus->huart->Init.BaudRate;
+	return ((uint32_t)bit_times * 1000u + baud_rate - 1u) / baud_rate;
+}
+
+
+/* ################ Interrupt context ################ */
+/**
+ * \brief			Has to be called from HAL_UART_TxCpltCallback
+ * \note			Fires with the last stop bit on the line. Node starts replying SENDDELAY
+ * 					(at least 8 bit times) later, enough to turn the receiver on and arm it
+ */
+void TMC_bus_TxCpltCallback(UART_HandleTypeDef* huart)
+{
+	TMC_BusTypeDef* hbus = find_bus(huart);
+	if (hbus == NULL || hbus->current == NULL)
+	{
+		return;
+	}
+	capture_transfer(hbus, hbus->current, TMC_CAPTURE_TX, hbus->current->tx_datagram, hbus->current->tx_length);
+	if (hbus->current->rx_length == 0)
+	{
+		complete_from_isr(hbus, TMC_BUS_OK);
+		return;
+	}
+
+	SET_BIT(huart->Instance->CR1, USART_CR1_RE);
+	__HAL_UART_CLEAR_OREFLAG(huart);
+	if (HAL_UART_Receive_IT(huart, &hbus->rx_byte, 1) != HAL_OK)
+	{
+		complete_from_isr(hbus, TMC_BUS_ERROR);
+	}
+}
+
+/**
+ * \brief			Has to be called from HAL_UART_RxCpltCallback
+ * \note			Runs for every received byte, worker is woken up only once the whole reply
+ * 					is in or its CRC failed
+ */
+void TMC_bus_RxCpltCallback(UART_HandleTypeDef* huart)
+{
+	TMC_BusTypeDef* hbus = find_bus(huart);
+	if (hbus == NULL || hbus->current == NULL || hbus->current->rx_length == 0)
+	{
+		return;
+	}
+
+	TMC_BusStatus status = receive_byte(hbus, hbus->rx_byte);
+	if (status == TMC_BUS_PENDING)
+	{
+		if (HAL_UART_Receive_IT(huart, &hbus->rx_byte, 1) == HAL_OK)
+		{
+			return;
+		}
+		status = TMC_BUS_ERROR;
+	}
+
+	if (status == TMC_BUS_ERROR)
+	{
+		capture_transfer(hbus, hbus->current, TMC_CAPTURE_LINE_ERROR, NULL, 0);
+	}
+	else
+	{
+		capture_transfer(hbus, hbus->current, (status == TMC_BUS_OK) ? TMC_CAPTURE_RX : TMC_CAPTURE_RX_CRC,
+				hbus->rx_buffer, hbus->current->rx_length);
+	}
+	complete_from_isr(hbus, status);
+}
+
+/**
+ * \brief			Has to be called from HAL_UART_ErrorCallback
+ */
+void TMC_bus_ErrorCallback(UART_HandleTypeDef* huart)
+{
+	TMC_BusTypeDef* hbus = find_bus(huart);
+	if (hbus != NULL && hbus->current != NULL)
+	{
+		HAL_UART_Abort(huart);
+		capture_transfer(hbus, hbus->current, TMC_CAPTURE_LINE_ERROR, NULL, 0);
+		complete_from_isr(hbus, TMC_BUS_ERROR);
+	}
+}
+
+
+/* ################ Private functions ################ */
+static void bus_worker(void *argument)
+{
+	TMC_BusTypeDef* hbus = (TMC_BusTypeDef*)argument;
+
+	while (1)
+	{
+		TMC_TransferTypeDef* transfer = next_transfer(hbus);
+		if (transfer == NULL)
+		{
+			osThreadFlagsWait(TMC_BUS_FLAG_QUEUED, osFlagsWaitAny, osWaitForever);
+			continue;
+		}
+		if (transfer->tx_length == 0)
+		{
+			TMC_BusStatus status = apply_baud_rate(hbus, transfer->baud_rate);
+			hbus->baud_rate_limit = transfer->baud_rate;
+			hbus->recovery_backoff = 0;
+			hbus->recovered = 0;
+			osThreadId_t owner = transfer->owner;
+			transfer->status = status;
+			osThreadFlagsSet(owner, TMC_BUS_FLAG_DONE);
+			continue;
+		}
+
+		PROBE_BEGIN(PROBE_BUS_TRANSFER);
+		TMC_BusStatus status = run_transfer(hbus, transfer);
+		PROBE_END(PROBE_BUS_TRANSFER);
+		update_node_stats(hbus, transfer, status);
+
+		uint8_t node_address = transfer->tx_datagram[1] % TMC_BUS_NODE_COUNT;
+		uint32_t baud_rate = hbus->huart->Init.BaudRate;
+		if (status == TMC_BUS_OK && transfer->rx_length > 0
+				&& (hbus->reply_rates[node_address] == 0 || baud_rate < hbus->reply_rates[node_address]))
+		{
+			hbus->reply_rates[node_address] = baud_rate;
+		}
+		count_error(hbus, node_address, status);
+		fall_back_if_unreliable(hbus);
+		recover_if_clean(hbus);
+
+		// Owner may re-submit the transfer as soon as it sees the status, so notify it last
+		osThreadId_t owner = transfer->owner;
+		transfer->status = status;
+		if (owner != NULL)
+		{
+			osThreadFlagsSet(owner, TMC_BUS_FLAG_DONE);
+		}
+	}
+}
+
+static TMC_TransferTypeDef* next_transfer(TMC_BusTypeDef* hbus)
+{
+	// Setpoints go first, but queued transfers get every other turn so a fast poster can not starve them
+	TMC_TransferTypeDef* transfer;
+	hbus->mailbox_turn ^= 1;
+	if (hbus->mailbox_turn)
+	{
+		transfer = next_mailbox(hbus);
+		return (transfer != NULL) ? transfer : next_queued(hbus);
+	}
+	transfer = next_queued(hbus);
+	return (transfer != NULL) ? transfer : next_mailbox(hbus);
+}
+
+static TMC_TransferTypeDef* next_queued(TMC_BusTypeDef* hbus)
+{
+	TMC_TransferTypeDef* transfer;
+	for (uint8_t priority = 0; priority < TMC_BUS_PRIORITY_COUNT; priority++)
+	{
+		if (osMessageQueueGet(hbus->queue[priority], &transfer, NULL, 0) == osOK)
+		{
+			return transfer;
+		}
+	}
+	return NULL;
+}
+
+static TMC_TransferTypeDef* next_mailbox(TMC_BusTypeDef* hbus)
+{
+	TMC_TransferTypeDef* transfer = &hbus->mailbox_transfer;
+	for (uint8_t i = 0; i < TMC_BUS_NODE_COUNT * TMC_BUS_MAILBOX_SLOTS; i++)
+	{
+		hbus->mailbox_cursor = (hbus->mailbox_cursor + 1) % (TMC_BUS_NODE_COUNT * TMC_BUS_MAILBOX_SLOTS);
+		TMC_BusMailbox* mailbox = &hbus->mailbox[hbus->mailbox_cursor / TMC_BUS_MAILBOX_SLOTS]
+				[hbus->mailbox_cursor % TMC_BUS_MAILBOX_SLOTS];
+		if (!mailbox->full)
+		{
+			continue;
+		}
+
+		int32_t lock = osKernelLock();
+		memcpy(transfer->tx_datagram, mailbox->datagram, mailbox->length);
+		transfer->tx_length = mailbox->length;
+		transfer->submit_cycles = mailbox->post_cycles;
+		mailbox->full = 0;
+		osKernelRestoreLock(lock);
+
+		transfer->rx_length = 0;
+		transfer->priority = TMC_BUS_PRIORITY_HIGH;
+		transfer->timeout = TMC_bus_wire_time_ms(hbus, 10u * transfer->tx_length) + TMC_BUS_TIMEOUT_MARGIN_MS;
+		transfer->owner = NULL;
+		transfer->status = TMC_BUS_PENDING;
+		return transfer;
+	}
+	return NULL;
+}
+
+static TMC_BusStatus run_transfer(TMC_BusTypeDef* hbus, TMC_TransferTypeDef* transfer)
+{
+	hbus->status = TMC_BUS_PENDING;
+	osThreadFlagsClear(TMC_BUS_FLAG_UART);
+	hbus->rx_index = 0;
+	hbus->current = transfer;
+
+	// Single wire line echoes every byte we send, receiver stays off until TxCplt so it only sees the reply
+	CLEAR_BIT(hbus->huart->Instance->CR1, USART_CR1_RE);
+	wait_interframe_gap(hbus);
+	if (HAL_UART_Transmit_IT(hbus->huart, transfer->tx_datagram, transfer->tx_length) != HAL_OK)
+	{
+		HAL_UART_Abort(hbus->huart);
+		hbus->current = NULL;
+		hbus->frame_end_cycles = cycle_counter_get();
+		return TMC_BUS_ERROR;
+	}
+
+	uint32_t flags = osThreadFlagsWait(TMC_BUS_FLAG_UART, osFlagsWaitAny, transfer->timeout);
+	hbus->current = NULL;
+	hbus->frame_end_cycles = cycle_counter_get();
+	if (flags & osFlagsError)
+	{
+		// Node did not answer, release the peripheral for the next transfer
+		HAL_UART_Abort(hbus->huart);
+		capture_transfer(hbus, transfer, TMC_CAPTURE_TIMEOUT, NULL, 0);
+		return TMC_BUS_TIMEOUT;
+	}
+
+	if (hbus->status == TMC_BUS_OK && transfer->rx_length > 0)
+	{
+		memcpy(transfer->rx_datagram, hbus->rx_buffer, transfer->rx_length);
+	}
+	return hbus->status;
+}
+
+/*
+ * Line has to stay idle for TMC_BUS_INTERFRAME_GAP_BITS after the previous frame. Time the worker
+ * spent completing the last transfer and picking this one counts, so usually nothing is left.
+ * Short rest is busy waited, at low rates the rest is slept away a tick at a time
+ */
+static void wait_interframe_gap(TMC_BusTypeDef* hbus)
+{
+	uint32_t gap_us = (TMC_BUS_INTERFRAME_GAP_BITS * 1000000u) / hbus->huart->Init.BaudRate;
+	uint32_t elapsed_us = cycle_counter_to_us(cycle_counter_get() - hbus->frame_end_cycles);
+	while (elapsed_us < gap_us && gap_us - elapsed_us > TMC_BUS_GAP_SPIN_MAX_US)
+	{
+		osDelay(1);
+		elapsed_us = cycle_counter_to_us(cycle_counter_get() - hbus->frame_end_cycles);
+	}
+	if (elapsed_us < gap_us)
+	{
+		cycle_counter_delay_us(gap_us - elapsed_us);
+	}
+}
+
+static TMC_BusStatus apply_baud_rate(TMC_BusTypeDef* hbus, uint32_t baud_rate)
+{
+	hbus->huart->Init.BaudRate = baud_rate;
+	hbus->error_streak = 0;
+	hbus->timeout_nodes = 0;
+	hbus->clean_streak = 0;
+	TMC_capture_record(TMC_CAPTURE_BAUD, TMC_bus_index(hbus), 0, 0, NULL, 0, baud_rate);
+	return (HAL_HalfDuplex_Init(hbus->huart) == HAL_OK) ? TMC_BUS_OK : TMC_BUS_ERROR;
+}
+
+/*
+ * Called by the worker after every transfer, nobody else touches the streaks.
+ * Timeout of a single node looks the same as a node that is not there, so timeouts count only
+ * once another node timed out too since the last success. Exception is a node known to be there,
+ * one that replied at a lower rate, while it is alone on the bus or the rate was just recovered
+ */
+static void count_error(TMC_BusTypeDef* hbus, uint8_t node_address, TMC_BusStatus status)
+{
+	uint8_t alone = (hbus->node_mask & (hbus->node_mask - 1)) == 0;
+	uint32_t reply_rate = hbus->reply_rates[node_address];
+	switch (status)
+	{
+		case TMC_BUS_OK:
+			hbus->error_streak = 0;
+			hbus->timeout_nodes = 0;
+			hbus->clean_streak++;
+			return;
+		case TMC_BUS_TIMEOUT:
+			hbus->timeout_nodes |= (1u << node_address);
+			if ((hbus->timeout_nodes & (hbus->timeout_nodes - 1)) == 0
+					&& !((alone || hbus->recovered) && reply_rate != 0 && reply_rate < hbus->huart->Init.BaudRate))
+			{
+				return;
+			}
+			break;
+		default:
+			break;
+	}
+	hbus->clean_streak = 0;
+	if (hbus->error_streak < UINT8_MAX)
+	{
+		hbus->error_streak++;
+	}
+}
+
+/* Called by the worker between transfers, the only moment UART may be reconfigured */
+static void fall_back_if_unreliable(TMC_BusTypeDef* hbus)
+{
+	if (hbus->error_streak < TMC_BUS_FALLBACK_ERRORS)
+	{
+		return;
+	}
+
+	// Highest rate below the current one, rates are sorted in ascending order
+	uint32_t current = hbus->huart->Init.BaudRate;
+	uint32_t lower = current;
+	for (uint8_t i = 0; i < sizeof(tmc_bus_baud_rates) / sizeof(tmc_bus_baud_rates[0]); i++)
+	{
+		if (tmc_bus_baud_rates[i] < current)
+		{
+			lower = tmc_bus_baud_rates[i];
+		}
+	}
+	if (lower != current)
+	{
+		hbus->fallbacks++;
+		// Rate reached by recovery failed again, wait longer before the next attempt
+		if (hbus->recovered && hbus->recovery_backoff < TMC_BUS_RECOVERY_BACKOFF_MAX)
+		{
+			hbus->recovery_backoff++;
+		}
+	}
+	hbus->recovered = 0;
+	apply_baud_rate(hbus, lower);
+}
+
+/* Called by the worker between transfers, steps back up once the fallback rate stayed clean */
+static void recover_if_clean(TMC_BusTypeDef* hbus)
+{
+	uint32_t current = hbus->huart->Init.BaudRate;
+	if (hbus->clean_streak < (TMC_BUS_RECOVERY_TRANSFERS << hbus->recovery_backoff))
+	{
+		return;
+	}
+	if (hbus->recovered)
+	{
+		// Recovered rate proved itself, next fallback starts with the short wait again
+		hbus->recovered = 0;
+		hbus->recovery_backoff = 0;
+	}
+	if (current >= hbus->baud_rate_limit)
+	{
+		hbus->clean_streak = 0;
+		return;
+	}
+
+	// Lowest rate above the current one, rates are sorted in ascending order
+	uint32_t higher = current;
+	for (uint8_t i = sizeof(tmc_bus_baud_rates) / sizeof(tmc_bus_baud_rates[0]); i > 0; i--)
+	{
+		if (tmc_bus_baud_rates[i - 1] > current && tmc_bus_baud_rates[i - 1] <= hbus->baud_rate_limit)
+		{
+			higher = tmc_bus_baud_rates[i - 1];
+		}
+	}
+	if (higher == current)
+	{
+		hbus->clean_streak = 0;
+		return;
+	}
+	hbus->recoveries++;
+	hbus->recovered = 1;
+	apply_baud_rate(hbus, higher);
+}
+
+static void update_node_stats(TMC_BusTypeDef* hbus, TMC_TransferTypeDef* transfer, TMC_BusStatus status)
+{
+	TMC_BusNodeStats* stats = &hbus->node_stats[transfer->tx_datagram[1] % TMC_BUS_NODE_COUNT];
+	uint32_t latency_us = cycle_counter_to_us(cycle_counter_get() - transfer->submit_cycles);
+
+	stats->transfers++;
+	if (status != TMC_BUS_OK)
+	{
+		stats->failures++;
+	}
+	stats->last_latency_us = latency_us;
+	stats->total_latency_us += latency_us;
+	if (latency_us > stats->max_latency_us)
+	{
+		stats->max_latency_us = latency_us;
+	}
+}
+
+static TMC_BusTypeDef* find_bus(UART_HandleTypeDef* huart)
+{
+	for (uint8_t i = 0; i < TMC_BUS_MAX_COUNT; i++)
+	{
+		if (tmc_buses[i].huart == huart)
+		{
+			return &tmc_buses[i];
+		}
+	}
+	return NULL;
+}
+
+static void complete_from_isr(TMC_BusTypeDef* hbus, TMC_BusStatus status)
+{
+	hbus->status = status;
+	osThreadFlagsSet(hbus->worker, TMC_BUS_FLAG_UART);
+}
+
+/* Frame synchroniser fed from RxCplt, returns TMC_BUS_PENDING until the reply is complete */
+static TMC_BusStatus receive_byte(TMC_BusTypeDef* hbus, uint8_t byte)
+{
+	uint8_t index = hbus->rx_index;
+	if (index == 1 && byte != TMC_BUS_REPLY_ADDRESS)
+	{
+		// Sync was line noise, this byte may still start the reply
+		index = 0;
+	}
+	if (index == 0)
+	{
+		hbus->rx_crc = 0;
+		if (byte != TMC_BUS_REPLY_SYNC)
+		{
+			hbus->rx_index = 0;
+			return TMC_BUS_PENDING;
+		}
+	}
+
+	hbus->rx_buffer[index] = byte;
+	if (index + 1u == hbus->current->rx_length)
+	{
+		hbus->rx_index = 0;
+		return (byte == hbus->rx_crc) ? TMC_BUS_OK : TMC_BUS_CRC_ERROR;
+	}
+	hbus->rx_crc = update_CRC(hbus->rx_crc, byte);
+	hbus->rx_index = index + 1u;
+	return TMC_BUS_PENDING;
+}
+
+/* Node and register of every record come from the request, a reply carries the master address */
+static void capture_transfer(TMC_BusTypeDef* hbus, TMC_TransferTypeDef* transfer, TMC_CaptureEvent event,
+		const uint8_t* datagram, uint8_t length)
+{
+	TMC_capture_record(event, TMC_bus_index(hbus), transfer->tx_datagram[1], transfer->tx_datagram[2],
+			datagram, length, hbus->huart->Init.BaudRate);
+}
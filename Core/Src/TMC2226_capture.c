@@ -0,0 +1,160 @@
+/*
+ * TMC2226_capture.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+#include "TMC2226_capture.h"
+
+#include "main.h"
+#include "cycle_counter.h"
+
+
+static TMC_CaptureRecord capture_ring[TMC_CAPTURE_RECORDS];
+/* Free running index of the next record, ring position is its low bits */
+static volatile uint32_t capture_next;
+/* Index of the first record kept by TMC_capture_clear */
+static volatile uint32_t capture_start;
+static volatile uint32_t capture_missed;
+static volatile uint8_t capture_frozen;
+
+static void put_u32(uint8_t* buffer, uint32_t value);
+
+
+/* ################ API ################*/
+
+/**
+ * \brief			Appends one record, overwrites the oldest one when the ring is full
+ * \param[in]		event: what happened on the bus
+ * \param[in]		bus: TMC_bus_index of the bus
+ * \param[in]		node: node address the datagram went to or came from
+ * \param[in]		register_byte: third byte of the request, write bit included
+ * \param[in]		datagram: bytes as they travelled, may be NULL when length is 0
+ * \param[in]		length: datagram length, data is taken from 8 byte datagrams only
+ * \param[in]		baud_rate: rate the bus runs at
+ * \note			Constant time, called from the bus interrupts and the bus worker. Only the
+ * 					copy into the ring runs masked
+ */
+void TMC_capture_record(TMC_CaptureEvent event, uint8_t bus, uint8_t node, uint8_t register_byte,
+		const uint8_t* datagram, uint8_t length, uint32_t baud_rate)
+{
+	uint32_t cycles = cycle_counter_get();
+	uint32_t data = 0;
+	if (length == 8)
+	{
+		data = ((uint32_t)datagram[3] << 24) | ((uint32_t)datagram[4] << 16) | ((uint32_t)datagram[5] << 8) | datagram[6];
+	}
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	if (capture_frozen)
+	{
+		capture_missed++;
+	}
+	else
+	{
+		TMC_CaptureRecord* record = &capture_ring[capture_next & (TMC_CAPTURE_RECORDS - 1u)];
+		capture_next++;
+		record->cycles = cycles;
+		record->data = data;
+		record->baud_rate_100 = (uint16_t)(baud_rate / 100u);
+		record->event = event;
+		record->bus = bus;
+		record->node = node;
+		record->register_byte = register_byte;
+		record->length = length;
+		record->crc = (length != 0) ? datagram[length - 1] : 0;
+	}
+	__set_PRIMASK(primask);
+}
+
+/**
+ * \brief			Stops (1) or resumes (0) recording, records of a frozen ring are only counted
+ * \note			Ring has to be frozen while TMC_capture_encode reads it
+ */
+void TMC_capture_freeze(uint8_t frozen)
+{
+	capture_frozen = frozen;
+}
+
+/**
+ * \brief			Returns index of the oldest record still in the ring
+ */
+uint32_t TMC_capture_oldest(void)
+{
+	uint32_t next = capture_next;
+	uint32_t oldest = (next > TMC_CAPTURE_RECORDS) ? next - TMC_CAPTURE_RECORDS : 0;
+	return (capture_start > oldest) ? capture_start : oldest;
+}
+
+/**
+ * \brief			Fills payload of one TMC_STREAM_FRAME_CAPTURE frame
+ * \param[in,out]	index: first record to take, moved past the records taken. Records
+ * 					already overwritten are skipped
+ * \param[out]		payload: at least TMC_STREAM_MAX_PAYLOAD bytes
+ * \return			Payload length, 0 when there is no record at or after index
+ */
+uint8_t TMC_capture_encode(uint32_t* index, uint8_t* payload)
+{
+	uint32_t oldest = TMC_capture_oldest();
+	if (*index < oldest)
+	{
+		*index = oldest;
+	}
+	uint32_t available = capture_next - *index;
+	uint8_t count = (available < TMC_STREAM_CAPTURE_PER_FRAME) ? (uint8_t)available : TMC_STREAM_CAPTURE_PER_FRAME;
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	payload[TMC_STREAM_CAPTURE_CLOCK_MHZ] = (uint8_t)(SystemCoreClock / 1000000u);
+	payload[TMC_STREAM_CAPTURE_COUNT] = count;
+	put_u32(&payload[TMC_STREAM_CAPTURE_INDEX], *index);
+	for (uint8_t i = 0; i < count; i++)
+	{
+		const TMC_CaptureRecord* record = &capture_ring[(*index + i) & (TMC_CAPTURE_RECORDS - 1u)];
+		uint8_t* out = &payload[TMC_STREAM_CAPTURE_RECORDS + i * TMC_STREAM_CAPTURE_RECORD_LENGTH];
+		put_u32(&out[0], record->cycles);
+		put_u32(&out[4], record->data);
+		out[8] = (uint8_t)record->baud_rate_100;
+		out[9] = (uint8_t)(record->baud_rate_100 >> 8);
+		out[10] = record->event;
+		out[11] = record->bus;
+		out[12] = record->node;
+		out[13] = record->register_byte;
+		out[14] = record->length;
+		out[15] = record->crc;
+	}
+	*index += count;
+	return TMC_STREAM_CAPTURE_RECORDS + count * TMC_STREAM_CAPTURE_RECORD_LENGTH;
+}
+
+/**
+ * \brief			Forgets records taken so far, indexes keep counting from reset
+ */
+void TMC_capture_clear(void)
+{
+	capture_start = capture_next;
+	capture_missed = 0;
+}
+
+/**
+ * \brief			Copies counters of the capture ring
+ */
+void TMC_capture_get_stats(TMC_CaptureStats* stats)
+{
+	stats->recorded = capture_next;
+	stats->missed = capture_missed;
+}
+
+
+/* ################ Private functions ################ */
+/* Little endian, as every multi-byte field of the stream */
+static void put_u32(uint8_t* buffer, uint32_t value)
+{
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		buffer[i] = (uint8_t)(value >> (8 * i));
+	}
+}
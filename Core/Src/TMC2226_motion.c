@@ -0,0 +1,298 @@
+/*
+ * TMC2226_motion.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+#include "TMC2226_motion.h"
+
+#include "main.h"
+#include "TMC2226_step.h"
+
+
+#define US_PER_S	1000000ull
+/* Ramp velocities carry this many fraction bits, slow ramps would lose up to a step/s per slice otherwise */
+#define VELOCITY_FRACTION_BITS	8
+
+/**
+ * \brief			Shape of the acceleration ramp up to given velocity, all times in us
+ * \note			Deceleration ramp is the same shape played backwards. Both trapezoidal and
+ * 					S-curve ramps are symmetric in velocity, so ramp distance is velocity * time / 2.
+ * 					Times are 64 bit, a ramp at a few microsteps/s^2 lasts longer than 2^32 us
+ */
+typedef struct {
+	uint32_t velocity;							/* Velocity at the end of the ramp */
+	uint64_t duration_us;
+	uint64_t jerk_time_us;						/* Time spent changing acceleration at each end, 0 for trapezoid */
+	uint32_t acceleration;						/* Highest acceleration reached */
+	uint32_t jerk;
+} RampShape;
+
+/* Movement storage used by TMC_motion_move, one per step engine */
+static TMC_MotionProfile motion_profiles[TMC_STEP_MAX_COUNT];
+static TMC_StepEngineTypeDef* motion_profile_owners[TMC_STEP_MAX_COUNT];
+
+static void ramp_shape(uint32_t velocity, const TMC_MotionLimits* limits, RampShape* shape);
+static uint64_t ramp_distance(uint32_t velocity, const TMC_MotionLimits* limits);
+static uint64_t ramp_velocity(const RampShape* shape, uint64_t time_us);
+static uint64_t rate_times_us(uint64_t rate, uint64_t time_us);
+static void append_segment(TMC_MotionProfile* profile, uint32_t velocity, uint32_t steps);
+static uint32_t isqrt64(uint64_t value);
+
+
+/* ################ API ################*/
+
+/**
+ * \brief			Plans move of given length within given limits
+ * \param[out]		profile: segment table of the move
+ * \param[in]		distance: microsteps to make, sign selects direction
+ * \param[in]		limits: kinematic limits, only max_velocity is used when acceleration is 0
+ * \note			Integer only, runs in thread context. Short moves that can not reach
+ * 					max_velocity get the highest peak velocity whose ramps still fit
+ */
+void TMC_motion_plan(TMC_MotionProfile* profile, int32_t distance, const TMC_MotionLimits* limits)
+{
+	uint32_t total = (distance < 0) ? -(uint32_t)distance : (uint32_t)distance;
+	uint32_t max_velocity = (limits->max_velocity != 0) ? limits->max_velocity : 1;
+
+	profile->direction = (distance < 0) ? -1 : 1;
+	profile->distance = total;
+	profile->segment_count = 0;
+	profile->peak_velocity = max_velocity;
+	profile->ramp_time_us = 0;
+
+	if (limits->acceleration == 0 || total == 0)
+	{
+		append_segment(profile, max_velocity, total);
+		return;
+	}
+
+	// Both ramps have to fit into the distance, ramp distance grows with velocity so bisect it
+	uint32_t peak_velocity = max_velocity;
+	if (2 * ramp_distance(max_velocity, limits) > total)
+	{
+		uint32_t low = 1;
+		uint32_t high = max_velocity;
+		while (low < high)
+		{
+			uint32_t middle = low + (high - low + 1) / 2;
+			if (2 * ramp_distance(middle, limits) <= total)
+			{
+				low = middle;
+			}
+			else
+			{
+				high = middle - 1;
+			}
+		}
+		peak_velocity = low;
+	}
+
+	RampShape shape;
+	ramp_shape(peak_velocity, limits, &shape);
+	profile->peak_velocity = peak_velocity;
+	profile->ramp_time_us = shape.duration_us;
+
+	/*
+	 * Acceleration ramp is cut into equal time slices, distance is integrated with the velocity
+	 * from the middle of each slice and a slice gets the whole steps the rounded distance grew by.
+	 * Steps of a slice are spread over its time rather than played at that velocity, and
+	 * slices without a whole step hand their time over to the next one, so the ramp lasts
+	 * as long as planned even when slices carry a single step at a few Hz
+	 */
+	uint64_t slice_us = shape.duration_us / TMC_MOTION_RAMP_SEGMENTS;
+	if (slice_us == 0)
+	{
+		slice_us = 1;
+	}
+	uint64_t travelled = 0;						/* Ramp distance so far, in fractions of a step */
+	uint64_t carry = 0;							/* Remainder of travelled, in fraction * us */
+	uint64_t pending_us = 0;
+	uint32_t ramp_steps = 0;
+	for (uint16_t i = 0; i < TMC_MOTION_RAMP_SEGMENTS; i++)
+	{
+		uint64_t velocity = ramp_velocity(&shape, slice_us * i + slice_us / 2);
+		// Whole seconds of the slice apart, so velocity * slice_us does not overflow for long ramps
+		carry += velocity * (slice_us % US_PER_S);
+		travelled += velocity * (slice_us / US_PER_S) + carry / US_PER_S;
+		carry %= US_PER_S;
+		uint64_t whole_steps = ((travelled + (1u << (VELOCITY_FRACTION_BITS - 1))) >> VELOCITY_FRACTION_BITS) - ramp_steps;
+		uint32_t steps = (2 * (ramp_steps + whole_steps) > total) ? total / 2 - ramp_steps : (uint32_t)whole_steps;
+		ramp_steps += steps;
+		pending_us += slice_us;
+		TMC_step_compute_timed_segment(steps, pending_us, peak_velocity,
+				&profile->segments[profile->segment_count++]);
+		if (steps != 0)
+		{
+			pending_us = 0;
+		}
+	}
+
+	append_segment(profile, peak_velocity, total - 2 * ramp_steps);
+
+	// Deceleration mirrors acceleration, so the move ends at the same rate it started
+	for (uint16_t i = TMC_MOTION_RAMP_SEGMENTS; i > 0; i--)
+	{
+		profile->segments[profile->segment_count++] = profile->segments[i - 1];
+	}
+}
+
+/**
+ * \brief			Starts playing planned move, returns immediately
+ * \return			HAL_BUSY when the engine is still running previous move
+ */
+HAL_StatusTypeDef TMC_motion_start(TMC_StepEngineTypeDef* hstep, const TMC_MotionProfile* profile,
+		TMC_StepDoneCallback done_callback, void* done_context)
+{
+	return TMC_step_start_segments(hstep, profile->direction, profile->segments, profile->segment_count,
+			done_callback, done_context);
+}
+
+/**
+ * \brief			Plans and starts move using profile storage owned by this module
+ * \param[in]		hstep: step engine
+ * \param[in]		distance: microsteps to make, sign selects direction
+ * \param[in]		limits: kinematic limits of the move
+ * \return			HAL_BUSY when the engine is still running previous move, its table is not touched then
+ */
+HAL_StatusTypeDef TMC_motion_move(TMC_StepEngineTypeDef* hstep, int32_t distance, const TMC_MotionLimits* limits,
+		TMC_StepDoneCallback done_callback, void* done_context)
+{
+	if (TMC_step_busy(hstep))
+	{
+		return HAL_BUSY;
+	}
+
+	TMC_MotionProfile* profile = NULL;
+	for (uint8_t i = 0; profile == NULL && i < TMC_STEP_MAX_COUNT; i++)
+	{
+		if (motion_profile_owners[i] == hstep || motion_profile_owners[i] == NULL)
+		{
+			motion_profile_owners[i] = hstep;
+			profile = &motion_profiles[i];
+		}
+	}
+	if (profile == NULL)
+	{
+		return HAL_ERROR;
+	}
+
+	TMC_motion_plan(profile, distance, limits);
+	return TMC_motion_start(hstep, profile, done_callback, done_context);
+}
+
+
+/* ################ Private functions ################ */
+static void ramp_shape(uint32_t velocity, const TMC_MotionLimits* limits, RampShape* shape)
+{
+	uint32_t acceleration = limits->acceleration;
+	uint32_t jerk = limits->jerk;
+
+	shape->velocity = velocity;
+	shape->jerk = jerk;
+	if (jerk == 0)
+	{
+		shape->acceleration = acceleration;
+		shape->jerk_time_us = 0;
+		shape->duration_us = (uint64_t)velocity * US_PER_S / acceleration;
+	}
+	else if ((uint64_t)velocity * jerk >= (uint64_t)acceleration * acceleration)
+	{
+		// Acceleration limit is reached and held until the velocity is close enough
+		shape->acceleration = acceleration;
+		shape->jerk_time_us = (uint64_t)acceleration * US_PER_S / jerk;
+		shape->duration_us = (uint64_t)velocity * US_PER_S / acceleration + shape->jerk_time_us;
+	}
+	else
+	{
+		// Velocity is reached before acceleration limit, ramp has no constant acceleration part.
+		// Jerk phase lasts sqrt(velocity / jerk), taken in microseconds so slow ramps do not
+		// lose the fraction of the peak acceleration and end in a velocity step
+		uint64_t ratio = (uint64_t)velocity * US_PER_S / jerk;
+		if (ratio <= UINT64_MAX / US_PER_S)
+		{
+			shape->jerk_time_us = isqrt64(ratio * US_PER_S);
+		}
+		else
+		{
+			shape->jerk_time_us = (uint64_t)isqrt64(ratio) * 1000;
+		}
+		shape->acceleration = rate_times_us(jerk, shape->jerk_time_us);
+		if (shape->acceleration == 0)
+		{
+			shape->acceleration = 1;
+		}
+		shape->duration_us = 2 * shape->jerk_time_us;
+	}
+}
+
+static uint64_t ramp_distance(uint32_t velocity, const TMC_MotionLimits* limits)
+{
+	RampShape shape;
+	ramp_shape(velocity, limits, &shape);
+	return rate_times_us(velocity, shape.duration_us) / 2;
+}
+
+/* Velocity at given time of the ramp, with VELOCITY_FRACTION_BITS fraction bits */
+static uint64_t ramp_velocity(const RampShape* shape, uint64_t time_us)
+{
+	uint64_t velocity = (uint64_t)shape->velocity << VELOCITY_FRACTION_BITS;
+	uint64_t acceleration = (uint64_t)shape->acceleration << VELOCITY_FRACTION_BITS;
+	uint64_t jerk = (uint64_t)shape->jerk << VELOCITY_FRACTION_BITS;
+
+	if (time_us >= shape->duration_us)
+	{
+		return velocity;
+	}
+	if (shape->jerk_time_us == 0)
+	{
+		return rate_times_us(acceleration, time_us);
+	}
+	if (time_us < shape->jerk_time_us)
+	{
+		return rate_times_us(rate_times_us(jerk, time_us), time_us) / 2;
+	}
+	if (time_us < shape->duration_us - shape->jerk_time_us)
+	{
+		uint64_t jerk_velocity = rate_times_us(acceleration, shape->jerk_time_us) / 2;
+		return jerk_velocity + rate_times_us(acceleration, time_us - shape->jerk_time_us);
+	}
+	uint64_t left_us = shape->duration_us - time_us;
+	uint64_t missing = rate_times_us(rate_times_us(jerk, left_us), left_us) / 2;
+	return (missing < velocity) ? velocity - missing : 0;
+}
+
+/* rate * time_us / 1 s rounded down, without the 64 bit overflow of multiplying first */
+static uint64_t rate_times_us(uint64_t rate, uint64_t time_us)
+{
+	return rate * (time_us / US_PER_S) + rate * (time_us % US_PER_S) / US_PER_S;
+}
+
+static void append_segment(TMC_MotionProfile* profile, uint32_t velocity, uint32_t steps)
+{
+	TMC_step_compute_segment(velocity, steps, &profile->segments[profile->segment_count++]);
+}
+
+static uint32_t isqrt64(uint64_t value)
+{
+	uint64_t root = 0;
+	uint64_t bit = 1ull << 62;
+	while (bit > value)
+	{
+		bit >>= 2;
+	}
+	while (bit != 0)
+	{
+		if (value >= root + bit)
+		{
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+		{
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return root;
+}
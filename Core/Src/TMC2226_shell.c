@@ -0,0 +1,524 @@
+/*
+ * TMC2226_shell.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+#include "TMC2226_shell.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "usart.h"
+#include "cmsis_os.h"
+#include "TMC2226.h"
+#include "TMC2226_telemetry.h"
+#include "TMC2226_stream.h"
+#include "TMC2226_capture.h"
+#include "probe.h"
+#include "rtos_stats.h"
+
+
+/**
+ * \brief			Register name accepted by rd and wr
+ */
+typedef struct {
+	const char* name;
+	uint8_t address;
+} RegisterName;
+
+/* Name tables generated from TMC2226_REGISTERS */
+#define READ_REGISTER_NAME(name, address, access, mask, reset) \
+	TMC_IF_READABLE_##access({ #name, R_##name },)
+#define WRITE_REGISTER_NAME(name, address, access, mask, reset) \
+	TMC_IF_WRITABLE_##access({ #name, TMC_WRITE_NAME_##access(name) },)
+
+static const RegisterName read_register_names[] = {
+	TMC2226_REGISTERS(READ_REGISTER_NAME)
+};
+
+static const RegisterName write_register_names[] = {
+	TMC2226_REGISTERS(WRITE_REGISTER_NAME)
+};
+
+/* Name of each TMC_TelemetryRegister */
+static const char* const telemetry_names[TMC_TELEMETRY_REGISTER_COUNT] = {
+	"SG_RESULT", "TSTEP", "DRV_STATUS", "MSCNT"
+};
+
+static int command_nodes(int argc, char** argv);
+static int command_speed(int argc, char** argv);
+static int command_move(int argc, char** argv);
+static int command_stop(int argc, char** argv);
+static int command_rd(int argc, char** argv);
+static int command_wr(int argc, char** argv);
+static int command_tel(int argc, char** argv);
+static int command_stats(int argc, char** argv);
+static int command_rtos(int argc, char** argv);
+static int command_capture(int argc, char** argv);
+#if PROBE_ENABLED
+static int command_probe(int argc, char** argv);
+#endif
+
+static const ShellCommand shell_commands[] = {
+	{ "nodes", "", 0, command_nodes },
+	{ "speed", "<node> <rpm>", 2, command_speed },
+	{ "move", "<node> <microsteps>", 2, command_move },
+	{ "stop", "<node>", 1, command_stop },
+	{ "rd", "<node> <register>", 2, command_rd },
+	{ "wr", "<node> <register> <value>", 3, command_wr },
+	{ "tel", "[node]", 0, command_tel },
+	{ "stats", "", 0, command_stats },
+	{ "rtos", "", 0, command_rtos },
+	{ "capture", "[clear]", 0, command_capture },
+#if PROBE_ENABLED
+	{ "probe", "[reset]", 0, command_probe }
+#endif
+};
+
+static ShellTypeDef tmc_shell;
+static char shell_rx_buffer[TMC_SHELL_RX_SIZE];
+static UART_HandleTypeDef* shell_huart;
+static osThreadId_t shell_thread;
+static TMC_HandleTypeDef* shell_nodes[TMC_SHELL_MAX_NODES];
+static uint8_t shell_node_count;
+
+static void start_reception(void);
+static TMC_HandleTypeDef* parse_node(const char* text);
+static const RegisterName* parse_register(const RegisterName* names, uint8_t count, const char* text);
+static void print_telemetry(TMC_HandleTypeDef* htmc);
+
+
+/* ################ API ################*/
+
+/**
+ * \brief			Starts receiving commands on given UART
+ * \param[in]		huart: UART with circular DMA RX channel linked and its global interrupt enabled
+ * \note			Calling thread becomes the shell thread, commands run only inside its
+ * 					TMC_shell_poll or TMC_shell_wait, so they never race with its own use of the nodes
+ */
+void TMC_shell_init(UART_HandleTypeDef* huart)
+{
+	shell_init(&tmc_shell, shell_rx_buffer, TMC_SHELL_RX_SIZE,
+			shell_commands, sizeof(shell_commands) / sizeof(shell_commands[0]));
+	shell_thread = osThreadGetId();
+	shell_huart = huart;
+	start_reception();
+}
+
+/**
+ * \brief			Makes node available to the commands under its node address
+ * \param[in]		htmc: node initialised with TMC_Init, used only from the shell thread
+ * \return			HAL_ERROR when all TMC_SHELL_MAX_NODES slots are taken, HAL_OK otherwise
+ */
+HAL_StatusTypeDef TMC_shell_add_node(TMC_HandleTypeDef* htmc)
+{
+	for (uint8_t i = 0; i < shell_node_count; i++)
+	{
+		if (shell_nodes[i] == htmc)
+		{
+			return HAL_OK;
+		}
+	}
+	if (shell_node_count >= TMC_SHELL_MAX_NODES)
+	{
+		return HAL_ERROR;
+	}
+	shell_nodes[shell_node_count++] = htmc;
+	return HAL_OK;
+}
+
+/**
+ * \brief			Executes commands received so far, never waits for more
+ * \return			Number of commands executed
+ * \note			Has to be called from the thread that called TMC_shell_init
+ */
+uint32_t TMC_shell_poll(void)
+{
+	if (shell_huart == NULL)
+	{
+		return 0;
+	}
+	return shell_process(&tmc_shell);
+}
+
+/**
+ * \brief			Sleeps until a line may have arrived or timeout passed, then executes commands
+ * \return			Number of commands executed
+ * \note			Drop-in replacement of osDelay in the loop of the shell thread, commands are
+ * 					answered as soon as their line ends instead of at the next loop turn
+ */
+uint32_t TMC_shell_wait(uint32_t timeout_ms)
+{
+	osThreadFlagsWait(TMC_SHELL_FLAG_RECEIVED, osFlagsWaitAny, timeout_ms);
+	return TMC_shell_poll();
+}
+
+/**
+ * \brief			Copies counters of the shell
+ */
+void TMC_shell_get_stats(ShellStats* stats)
+{
+	*stats = tmc_shell.stats;
+}
+
+/* ################ Interrupt context ################ */
+
+/**
+ * \brief			Accounts received bytes, call from HAL_UARTEx_RxEventCallback
+ * \note			HAL reports half transfer, full transfer and idle line, so a line is
+ * 					picked up as soon as the sender pauses after it
+ */
+void TMC_shell_RxEventCallback(UART_HandleTypeDef* huart, uint16_t size)
+{
+	if (huart != shell_huart)
+	{
+		return;
+	}
+	shell_received(&tmc_shell, size);
+	osThreadFlagsSet(shell_thread, TMC_SHELL_FLAG_RECEIVED);
+}
+
+/**
+ * \brief			Restarts reception stopped by a line error, call from HAL_UART_ErrorCallback
+ * \note			HAL aborts DMA reception on overrun, noise or framing error. Line being
+ * 					received at that moment is dropped
+ */
+void TMC_shell_ErrorCallback(UART_HandleTypeDef* huart)
+{
+	if (huart != shell_huart || huart->RxState != HAL_UART_STATE_READY)
+	{
+		return;
+	}
+	shell_restart(&tmc_shell);
+	start_reception();
+	osThreadFlagsSet(shell_thread, TMC_SHELL_FLAG_RECEIVED);
+}
+
+/* ################ Commands ################ */
+static int command_nodes(int argc, char** argv)
+{
+	(void)argc;
+	(void)argv;
+	for (uint8_t i = 0; i < shell_node_count; i++)
+	{
+		printf("node %u bus %u address %u baud %lu\n", TMC_node_id(shell_nodes[i]),
+				TMC_bus_index(shell_nodes[i]->hbus), shell_nodes[i]->node_address,
+				(unsigned long)TMC_bus_get_baud_rate(shell_nodes[i]->hbus));
+	}
+	return SHELL_OK;
+}
+
+static int command_speed(int argc, char** argv)
+{
+	(void)argc;
+	TMC_HandleTypeDef* htmc = parse_node(argv[1]);
+	int32_t milli_rpm;
+	if (htmc == NULL)
+	{
+		return SHELL_ERROR_REPORTED;
+	}
+	if (!shell_parse_fixed(argv[2], 3, &milli_rpm))
+	{
+		return SHELL_ERROR_USAGE;
+	}
+	TMC_set_speed_mrpm(htmc, milli_rpm);
+	return SHELL_OK;
+}
+
+static int command_move(int argc, char** argv)
+{
+	(void)argc;
+	TMC_HandleTypeDef* htmc = parse_node(argv[1]);
+	int32_t steps;
+	if (htmc == NULL)
+	{
+		return SHELL_ERROR_REPORTED;
+	}
+	if (!shell_parse_int(argv[2], &steps))
+	{
+		return SHELL_ERROR_USAGE;
+	}
+	switch (TMC_move_steps(htmc, steps))
+	{
+		case HAL_OK:
+			return SHELL_OK;
+		case HAL_BUSY:
+			printf("err move in progress\n");
+			return SHELL_ERROR_REPORTED;
+		default:
+			printf((htmc->hstep == NULL) ? "err no step engine\n" : "err VACTUAL not cleared\n");
+			return SHELL_ERROR_REPORTED;
+	}
+}
+
+static int command_stop(int argc, char** argv)
+{
+	(void)argc;
+	TMC_HandleTypeDef* htmc = parse_node(argv[1]);
+	if (htmc == NULL)
+	{
+		return SHELL_ERROR_REPORTED;
+	}
+	TMC_set_speed_mrpm(htmc, 0);
+	if (htmc->hstep != NULL)
+	{
+		TMC_step_stop(htmc->hstep);
+	}
+	return SHELL_OK;
+}
+
+static int command_rd(int argc, char** argv)
+{
+	(void)argc;
+	TMC_HandleTypeDef* htmc = parse_node(argv[1]);
+	if (htmc == NULL)
+	{
+		return SHELL_ERROR_REPORTED;
+	}
+	const RegisterName* reg = parse_register(read_register_names,
+			sizeof(read_register_names) / sizeof(read_register_names[0]), argv[2]);
+	if (reg == NULL)
+	{
+		return SHELL_ERROR_REPORTED;
+	}
+
+	TMC_ReadFuture future;
+	TMC_BusStatus status = TMC_read_async(htmc, (TMC2226_ReadRegisters)reg->address, &future);
+	if (status == TMC_BUS_PENDING)
+	{
+		status = TMC_read_await(&future);
+	}
+	if (status != TMC_BUS_OK)
+	{
+		printf("err bus status %u\n", status);
+		return SHELL_ERROR_REPORTED;
+	}
+	printf("%s 0x%08lX\n", reg->name, (unsigned long)future.value);
+	return SHELL_OK;
+}
+
+static int command_wr(int argc, char** argv)
+{
+	(void)argc;
+	TMC_HandleTypeDef* htmc = parse_node(argv[1]);
+	uint32_t value;
+	if (htmc == NULL)
+	{
+		return SHELL_ERROR_REPORTED;
+	}
+	const RegisterName* reg = parse_register(write_register_names,
+			sizeof(write_register_names) / sizeof(write_register_names[0]), argv[2]);
+	if (reg == NULL)
+	{
+		return SHELL_ERROR_REPORTED;
+	}
+	if (!shell_parse_uint(argv[3], &value))
+	{
+		return SHELL_ERROR_USAGE;
+	}
+
+	TMC_write_register(htmc, (TMC2226_WriteRegisters)reg->address, value);
+	TMC_BusStatus status = TMC_flush(htmc);
+	if (status != TMC_BUS_OK)
+	{
+		printf("err bus status %u\n", status);
+		return SHELL_ERROR_REPORTED;
+	}
+	return SHELL_OK;
+}
+
+static int command_tel(int argc, char** argv)
+{
+	if (argc > 1)
+	{
+		TMC_HandleTypeDef* htmc = parse_node(argv[1]);
+		if (htmc == NULL)
+		{
+			return SHELL_ERROR_REPORTED;
+		}
+		print_telemetry(htmc);
+		return SHELL_OK;
+	}
+	for (uint8_t i = 0; i < shell_node_count; i++)
+	{
+		print_telemetry(shell_nodes[i]);
+	}
+	return SHELL_OK;
+}
+
+static int command_stats(int argc, char** argv)
+{
+	(void)argc;
+	(void)argv;
+	TMC_StreamStats stream;
+	TMC_stream_get_stats(&stream);
+	printf("shell lines %lu failed %lu dropped %lu overruns %lu\n",
+			(unsigned long)tmc_shell.stats.lines, (unsigned long)tmc_shell.stats.failed,
+			(unsigned long)tmc_shell.stats.dropped, (unsigned long)tmc_shell.stats.overruns);
+	printf("stream frames %lu dropped %lu bytes %lu peak %u\n",
+			(unsigned long)stream.frames, (unsigned long)stream.dropped,
+			(unsigned long)stream.bytes, stream.peak_used);
+	return SHELL_OK;
+}
+
+/* Last sample of the RTOS statistics, taken every RTOS_STATS_PERIOD_MS by defaultTask */
+static int command_rtos(int argc, char** argv)
+{
+	(void)argc;
+	(void)argv;
+	RtosStatsSnapshot snapshot;
+	rtos_stats_get(&snapshot);
+	if (snapshot.samples == 0)
+	{
+		printf("err no sample yet\n");
+		return SHELL_ERROR_REPORTED;
+	}
+	rtos_stats_print(&snapshot);
+	return SHELL_OK;
+}
+
+/* Bus capture as TMC_STREAM_FRAME_CAPTURE frames, rendered by stream_decode on the host */
+static int command_capture(int argc, char** argv)
+{
+	if (argc > 1)
+	{
+		if (strcmp(argv[1], "clear") != 0)
+		{
+			return SHELL_ERROR_USAGE;
+		}
+		TMC_capture_clear();
+		return SHELL_OK;
+	}
+
+	// Frozen ring stays consistent while it is sent, bus traffic meanwhile is only counted as missed
+	TMC_capture_freeze(1);
+	uint32_t index = TMC_capture_oldest();
+	uint32_t sent = 0;
+	uint8_t payload[TMC_STREAM_MAX_PAYLOAD];
+	uint8_t length;
+	HAL_StatusTypeDef status = HAL_OK;
+	while (status == HAL_OK && (length = TMC_capture_encode(&index, payload)) != 0)
+	{
+		// Whole capture is bigger than the task ring, wait for DMA to drain it
+		for (uint8_t retry = 0; (status = TMC_stream_write_frame(TMC_STREAM_FRAME_CAPTURE, payload, length)) == HAL_BUSY
+				&& retry < TMC_SHELL_CAPTURE_RETRIES; retry++)
+		{
+			osDelay(1);
+		}
+		if (status == HAL_OK)
+		{
+			sent += payload[TMC_STREAM_CAPTURE_COUNT];
+		}
+	}
+	TMC_capture_freeze(0);
+
+	TMC_CaptureStats stats;
+	TMC_capture_get_stats(&stats);
+	if (status != HAL_OK)
+	{
+		printf("err stream stalled after %lu records\n", (unsigned long)sent);
+		return SHELL_ERROR_REPORTED;
+	}
+	printf("capture %lu records, %lu since reset, %lu missed\n", (unsigned long)sent,
+			(unsigned long)stats.recorded, (unsigned long)stats.missed);
+	return SHELL_OK;
+}
+
+#if PROBE_ENABLED
+/* One line per probe, then non-empty log2 buckets: "< 2^b n" counts durations below 2^b cycles */
+static int command_probe(int argc, char** argv)
+{
+	if (argc > 1)
+	{
+		if (strcmp(argv[1], "reset") != 0)
+		{
+			return SHELL_ERROR_USAGE;
+		}
+		probe_reset();
+		return SHELL_OK;
+	}
+	for (uint8_t id = 0; id < PROBE_COUNT; id++)
+	{
+		ProbeHistogram histogram;
+		probe_get(id, &histogram);
+		uint32_t mean = (histogram.count != 0) ? (uint32_t)(histogram.total_cycles / histogram.count) : 0;
+		printf("%-12s count %lu mean %lu max %lu cycles, max %lu us\n", probe_name(id),
+				(unsigned long)histogram.count, (unsigned long)mean, (unsigned long)histogram.max_cycles,
+				(unsigned long)cycle_counter_to_us(histogram.max_cycles));
+		for (uint8_t bucket = 0; bucket < PROBE_BUCKETS; bucket++)
+		{
+			if (histogram.buckets[bucket] != 0)
+			{
+				printf("  < 2^%-2u %lu\n", bucket, (unsigned long)histogram.buckets[bucket]);
+			}
+		}
+	}
+	return SHELL_OK;
+}
+#endif
+
+/* ################ Private functions ################ */
+static void start_reception(void)
+{
+	// HAL reports half transfer, full transfer and idle line, all through HAL_UARTEx_RxEventCallback
+	HAL_UARTEx_ReceiveToIdle_DMA(shell_huart, (uint8_t*)shell_rx_buffer, TMC_SHELL_RX_SIZE);
+}
+
+/* Finds node by its TMC_node_id, prints the reason when there is none */
+static TMC_HandleTypeDef* parse_node(const char* text)
+{
+	uint32_t id;
+	if (shell_parse_uint(text, &id))
+	{
+		for (uint8_t i = 0; i < shell_node_count; i++)
+		{
+			if (TMC_node_id(shell_nodes[i]) == id)
+			{
+				return shell_nodes[i];
+			}
+		}
+	}
+	printf("err no node %s\n", text);
+	return NULL;
+}
+
+/* Finds register by name or address among given ones, prints the reason when there is none */
+static const RegisterName* parse_register(const RegisterName* names, uint8_t count, const char* text)
+{
+	uint32_t address;
+	uint8_t numeric = shell_parse_uint(text, &address);
+	for (uint8_t i = 0; i < count; i++)
+	{
+		if (numeric ? (names[i].address == address) : (strcmp(names[i].name, text) == 0))
+		{
+			return &names[i];
+		}
+	}
+	printf("err no such register %s\n", text);
+	return NULL;
+}
+
+static void print_telemetry(TMC_HandleTypeDef* htmc)
+{
+	TMC_TelemetrySnapshot snapshot;
+	if (!TMC_telemetry_read(htmc, &snapshot))
+	{
+		printf("node %u not polled\n", TMC_node_id(htmc));
+		return;
+	}
+
+	uint32_t now = osKernelGetTickCount();
+	printf("node %u rounds %lu failed %lu\n", snapshot.node_id,
+			(unsigned long)snapshot.rounds, (unsigned long)snapshot.failed_reads);
+	for (uint8_t i = 0; i < TMC_TELEMETRY_REGISTER_COUNT; i++)
+	{
+		if (snapshot.samples[i].timestamp_ms == 0)
+		{
+			printf("  %-10s never read\n", telemetry_names[i]);
+			continue;
+		}
+		printf("  %-10s 0x%08lX %lu ms ago\n", telemetry_names[i], (unsigned long)snapshot.samples[i].value,
+				(unsigned long)(now - snapshot.samples[i].timestamp_ms));
+	}
+}
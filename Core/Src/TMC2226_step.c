@@ -0,0 +1,357 @@
+/*
+ * TMC2226_step.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+#include "TMC2226_step.h"
+
+#include <string.h>
+#include "main.h"
+#include "tim.h"
+
+
+static TMC_StepEngineTypeDef step_engines[TMC_STEP_MAX_COUNT];
+
+static uint32_t timer_clock_hz(void);
+static void segment_from_ticks(uint64_t ticks, uint32_t steps, TMC_StepSegment* segment);
+static uint32_t next_chunk(TMC_StepEngineTypeDef* hstep);
+static void load_segment(TMC_StepEngineTypeDef* hstep, const TMC_StepSegment* segment);
+
+
+/* ################ API ################*/
+
+/**
+ * \brief			Registers step engine built from given timers
+ * \param[in]		htim_pulse: timer with PWM on TMC_STEP_CHANNEL connected to STEP pin,
+ * 					TRGO has to be set to update event and auto-reload preload enabled
+ * \param[in]		htim_count: timer in external clock mode 1 triggered by htim_pulse TRGO,
+ * 					its update interrupt has to be enabled in NVIC
+ * \param[in]		dir_port: GPIO port of DIR pin
+ * \param[in]		dir_pin: DIR pin
+ * \return			Registered engine or NULL if all TMC_STEP_MAX_COUNT slots are taken
+ * \note			Both timers have to be clocked from APB1 (TIM2..TIM4 on STM32F103)
+ */
+TMC_StepEngineTypeDef* TMC_step_init(TIM_HandleTypeDef* htim_pulse, TIM_HandleTypeDef* htim_count,
+		GPIO_TypeDef* dir_port, uint16_t dir_pin)
+{
+	TMC_StepEngineTypeDef* hstep = TMC_step_get(htim_pulse);
+	for (uint8_t i = 0; hstep == NULL && i < TMC_STEP_MAX_COUNT; i++)
+	{
+		if (step_engines[i].htim_pulse == NULL)
+		{
+			hstep = &step_engines[i];
+		}
+	}
+	if (hstep == NULL)
+	{
+		return NULL;
+	}
+
+	memset(hstep, 0, sizeof(TMC_StepEngineTypeDef));
+	hstep->htim_count = htim_count;
+	hstep->dir_port = dir_port;
+	hstep->dir_pin = dir_pin;
+	hstep->direction = 1;
+	hstep->htim_pulse = htim_pulse;
+	return hstep;
+}
+
+/**
+ * \brief			Returns step engine registered for given pulse timer
+ * \return			Engine or NULL when TMC_step_init was not called for this timer
+ */
+TMC_StepEngineTypeDef* TMC_step_get(TIM_HandleTypeDef* htim_pulse)
+{
+	for (uint8_t i = 0; i < TMC_STEP_MAX_COUNT; i++)
+	{
+		if (step_engines[i].htim_pulse == htim_pulse && htim_pulse != NULL)
+		{
+			return &step_engines[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * \brief			Starts producing given number of step pulses at constant rate, returns immediately
+ * \param[in]		hstep: step engine
+ * \param[in]		steps: number of microsteps, sign selects DIR pin level
+ * \param[in]		frequency_hz: step rate
+ * \param[in]		done_callback: called from interrupt when the last pulse was produced, may be NULL
+ * \param[in]		done_context: passed to done_callback
+ * \return			HAL_BUSY when a move is already running, HAL_OK otherwise
+ * \note			Driver follows STEP input only when VACTUAL is 0
+ */
+HAL_StatusTypeDef TMC_step_start(TMC_StepEngineTypeDef* hstep, int32_t steps, uint32_t frequency_hz,
+		TMC_StepDoneCallback done_callback, void* done_context)
+{
+	if (hstep->running)
+	{
+		return HAL_BUSY;
+	}
+	TMC_step_compute_segment(frequency_hz, (steps > 0) ? (uint32_t)steps : -(uint32_t)steps, &hstep->single);
+	return TMC_step_start_segments(hstep, (steps > 0) ? 1 : -1, &hstep->single, 1, done_callback, done_context);
+}
+
+/**
+ * \brief			Plays table of constant rate segments one after another, returns immediately
+ * \param[in]		hstep: step engine
+ * \param[in]		direction: +1 or -1, selects DIR pin level
+ * \param[in]		segments: table prepared with TMC_step_compute_segment, has to stay valid until
+ * 					the move ends
+ * \param[in]		segment_count: number of entries in segments
+ * \param[in]		done_callback: called from interrupt when the last pulse was produced, may be NULL
+ * \param[in]		done_context: passed to done_callback
+ * \return			HAL_BUSY when a move is already running, HAL_OK otherwise
+ * \note			Rate of the next segment is loaded when the counter timer reports the end of
+ * 					the previous one, the pulse timer is already in the first period of the next
+ * 					segment then, so every segment starts with one pulse at the previous rate
+ */
+HAL_StatusTypeDef TMC_step_start_segments(TMC_StepEngineTypeDef* hstep, int8_t direction,
+		const TMC_StepSegment* segments, uint16_t segment_count,
+		TMC_StepDoneCallback done_callback, void* done_context)
+{
+	if (hstep->running)
+	{
+		return HAL_BUSY;
+	}
+
+	uint16_t first = 0;
+	while (first < segment_count && segments[first].steps == 0)
+	{
+		first++;
+	}
+	if (first == segment_count)
+	{
+		return HAL_OK;
+	}
+
+	hstep->direction = (direction < 0) ? -1 : 1;
+	hstep->segments = segments;
+	hstep->segment_count = segment_count;
+	hstep->segment_index = first;
+	hstep->remaining = segments[first].steps;
+	hstep->done_callback = done_callback;
+	hstep->done_context = done_context;
+	HAL_GPIO_WritePin(hstep->dir_port, hstep->dir_pin, (direction < 0) ? GPIO_PIN_RESET : GPIO_PIN_SET);
+
+	// Load prescaler and period right away, this update event reaches the counter timer while it is still stopped
+	load_segment(hstep, &segments[first]);
+	hstep->htim_pulse->Instance->EGR = TIM_EGR_UG;
+
+	hstep->chunk = next_chunk(hstep);
+	__HAL_TIM_SET_COUNTER(hstep->htim_count, 0);
+	__HAL_TIM_SET_AUTORELOAD(hstep->htim_count, hstep->chunk - 1);
+	__HAL_TIM_CLEAR_FLAG(hstep->htim_count, TIM_FLAG_UPDATE);
+
+	hstep->running = 1;
+	HAL_TIM_Base_Start_IT(hstep->htim_count);
+	HAL_TIM_PWM_Start(hstep->htim_pulse, TMC_STEP_CHANNEL);
+	return HAL_OK;
+}
+
+/**
+ * \brief			Changes step rate, may be called while the engine is running
+ * \param[in]		hstep: step engine
+ * \param[in]		frequency_hz: new step rate
+ * \note			Prescaler, period and compare are preloaded, so the new rate starts with the next
+ * 					pulse and no pulse is cut short. 50% duty cycle is kept. Next segment of
+ * 					a segment table overrides this rate
+ */
+void TMC_step_set_frequency(TMC_StepEngineTypeDef* hstep, uint32_t frequency_hz)
+{
+	TMC_StepSegment segment;
+	TMC_step_compute_segment(frequency_hz, 0, &segment);
+	load_segment(hstep, &segment);
+}
+
+/**
+ * \brief			Converts step rate into pulse timer prescaler and period
+ * \param[in]		frequency_hz: step rate, clamped to 1 Hz .. half of timer clock
+ * \param[in]		steps: pulses in the segment
+ * \param[out]		segment: filled segment
+ * \note			Uses integer division only, still it is meant for thread context, so the
+ * 					interrupt just copies the results into timer registers. Period is rounded
+ * 					up, so the rate never exceeds frequency_hz
+ */
+void TMC_step_compute_segment(uint32_t frequency_hz, uint32_t steps, TMC_StepSegment* segment)
+{
+	uint32_t clock = timer_clock_hz();
+	if (frequency_hz == 0)
+	{
+		frequency_hz = 1;
+	}
+	segment_from_ticks(((uint64_t)clock + frequency_hz - 1) / frequency_hz, steps, segment);
+}
+
+/**
+ * \brief			Converts time given steps should take into pulse timer prescaler and period
+ * \param[in]		steps: pulses in the segment, 0 gives an empty segment
+ * \param[in]		duration_us: time the pulses should take together
+ * \param[in]		max_frequency_hz: rate the segment must not exceed, it takes longer then
+ * \param[out]		segment: filled segment
+ * \note			Rate is not limited to whole Hz, so slow segments of a ramp keep their time.
+ * 					Period goes down to 2 timer ticks and up to 2^32 ticks (~67 s at 64 MHz)
+ */
+void TMC_step_compute_timed_segment(uint32_t steps, uint64_t duration_us, uint32_t max_frequency_hz,
+		TMC_StepSegment* segment)
+{
+	uint32_t clock = timer_clock_hz();
+	if (steps == 0 || max_frequency_hz == 0)
+	{
+		segment_from_ticks(clock, 0, segment);
+		return;
+	}
+	uint64_t ticks = duration_us * (clock / 1000000u) / steps;
+	uint64_t min_ticks = ((uint64_t)clock + max_frequency_hz - 1) / max_frequency_hz;
+	segment_from_ticks((ticks < min_ticks) ? min_ticks : ticks, steps, segment);
+}
+
+/**
+ * \brief			Stops the move immediately, done_callback is not called
+ */
+void TMC_step_stop(TMC_StepEngineTypeDef* hstep)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	if (hstep->running)
+	{
+		HAL_TIM_PWM_Stop(hstep->htim_pulse, TMC_STEP_CHANNEL);
+		HAL_TIM_Base_Stop_IT(hstep->htim_count);
+		hstep->position += hstep->direction * (int32_t)__HAL_TIM_GET_COUNTER(hstep->htim_count);
+		hstep->remaining = 0;
+		hstep->running = 0;
+	}
+	__set_PRIMASK(primask);
+}
+
+/**
+ * \brief			Returns 1 while step pulses are being produced
+ */
+uint8_t TMC_step_busy(TMC_StepEngineTypeDef* hstep)
+{
+	return hstep->running;
+}
+
+/**
+ * \brief			Returns current position in microsteps, pulses already produced are included
+ */
+int32_t TMC_step_get_position(TMC_StepEngineTypeDef* hstep)
+{
+	int32_t position;
+	uint32_t counted;
+	do
+	{
+		// Retry if chunk interrupt moved position while counter was read
+		position = hstep->position;
+		counted = hstep->running ? __HAL_TIM_GET_COUNTER(hstep->htim_count) : 0;
+	} while (position != hstep->position);
+	return position + hstep->direction * (int32_t)counted;
+}
+
+/**
+ * \brief			Sets current position in microsteps, ignored while the engine is running
+ */
+void TMC_step_set_position(TMC_StepEngineTypeDef* hstep, int32_t position)
+{
+	if (!hstep->running)
+	{
+		hstep->position = position;
+	}
+}
+
+
+/* ################ Interrupt context ################ */
+/**
+ * \brief			Has to be called from HAL_TIM_PeriodElapsedCallback
+ * \note			Counter timer update means a whole chunk of pulses was produced. After the last
+ * 					chunk the pulse timer is in the low half of the next period, so it has to be
+ * 					stopped within half of the step period
+ */
+void TMC_step_PeriodElapsedCallback(TIM_HandleTypeDef* htim)
+{
+	TMC_StepEngineTypeDef* hstep = NULL;
+	for (uint8_t i = 0; i < TMC_STEP_MAX_COUNT; i++)
+	{
+		if (step_engines[i].htim_count == htim)
+		{
+			hstep = &step_engines[i];
+		}
+	}
+	if (hstep == NULL || !hstep->running)
+	{
+		return;
+	}
+
+	hstep->position += hstep->direction * (int32_t)hstep->chunk;
+	while (hstep->remaining == 0 && hstep->segment_index + 1 < hstep->segment_count)
+	{
+		const TMC_StepSegment* segment = &hstep->segments[++hstep->segment_index];
+		hstep->remaining = segment->steps;
+		if (segment->steps != 0)
+		{
+			load_segment(hstep, segment);
+		}
+	}
+	if (hstep->remaining > 0)
+	{
+		hstep->chunk = next_chunk(hstep);
+		__HAL_TIM_SET_AUTORELOAD(hstep->htim_count, hstep->chunk - 1);
+		return;
+	}
+
+	HAL_TIM_PWM_Stop(hstep->htim_pulse, TMC_STEP_CHANNEL);
+	HAL_TIM_Base_Stop_IT(hstep->htim_count);
+	hstep->running = 0;
+	if (hstep->done_callback != NULL)
+	{
+		hstep->done_callback(hstep->done_context);
+	}
+}
+
+
+/* ################ Private functions ################ */
+static uint32_t timer_clock_hz(void)
+{
+	// APB1 timers run at twice the bus clock whenever APB1 prescaler is not 1
+	uint32_t clock = HAL_RCC_GetPCLK1Freq();
+	if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1)
+	{
+		clock *= 2;
+	}
+	return clock;
+}
+
+/* Smallest prescaler that still lets the period fit into 16 bits gives the best resolution */
+static void segment_from_ticks(uint64_t ticks, uint32_t steps, TMC_StepSegment* segment)
+{
+	// Two ticks are the shortest pulse with both levels, 2^32 the longest PSC and ARR can count
+	if (ticks < 2)
+	{
+		ticks = 2;
+	}
+	if (ticks > 65536ull * 65536ull)
+	{
+		ticks = 65536ull * 65536ull;
+	}
+	uint32_t prescaler = (ticks - 1) / 65536u;
+	segment->prescaler = prescaler;
+	segment->period = (ticks + prescaler) / (prescaler + 1) - 1;
+	segment->steps = steps;
+}
+
+static uint32_t next_chunk(TMC_StepEngineTypeDef* hstep)
+{
+	uint32_t chunk = (hstep->remaining > TMC_STEP_CHUNK) ? TMC_STEP_CHUNK : hstep->remaining;
+	hstep->remaining -= chunk;
+	return chunk;
+}
+
+static void load_segment(TMC_StepEngineTypeDef* hstep, const TMC_StepSegment* segment)
+{
+	// All three registers are preloaded, they take effect together at the next update event
+	__HAL_TIM_SET_PRESCALER(hstep->htim_pulse, segment->prescaler);
+	__HAL_TIM_SET_AUTORELOAD(hstep->htim_pulse, segment->period);
+	__HAL_TIM_SET_COMPARE(hstep->htim_pulse, TMC_STEP_CHANNEL, (segment->period + 1u) / 2u);
+}
@@ -0,0 +1,380 @@
+/*
+ * TMC2226_stream.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+#include "TMC2226_stream.h"
+
+#include <string.h>
+#include "main.h"
+#include "usart.h"
+#include "cmsis_os.h"
+#include "TMC2226.h"
+
+
+/* Upper bound of encoded frame length for given payload, checked before a frame is written */
+#define ENCODED_LENGTH(length)		((uint32_t)(length) + TMC_STREAM_FRAME_OVERHEAD + 2u)
+
+/**
+ * \brief			COBS encoder writing straight into a ring
+ * \note			Code byte of a block is written when the block ends, so the encoder
+ * 					keeps its position and fills it in later
+ */
+typedef struct {
+	uint8_t* buffer;
+	uint32_t mask;
+	uint32_t position;
+	uint32_t code_position;
+	uint8_t code;
+	uint8_t crc;
+} FrameEncoder;
+
+static TMC_StreamTypeDef tmc_stream;
+static uint8_t shared_ring_buffer[TMC_STREAM_SHARED_RING_SIZE];
+static uint8_t task_ring_buffers[TMC_STREAM_TASK_RINGS][TMC_STREAM_TASK_RING_SIZE];
+
+static TMC_StreamRing* own_ring(TMC_StreamTypeDef* hstream);
+static HAL_StatusTypeDef write_own_ring(TMC_StreamTypeDef* hstream, TMC_StreamRing* ring, uint8_t first,
+		const uint8_t* payload, uint8_t length);
+static HAL_StatusTypeDef write_shared_ring(TMC_StreamTypeDef* hstream, uint8_t type,
+		const uint8_t* payload, uint8_t length);
+static void count_frame(TMC_StreamRing* ring, uint32_t used, uint32_t encoded_length);
+static uint32_t encode_frame(uint8_t* buffer, uint32_t mask, uint32_t position, uint8_t first, uint8_t sequence,
+		const uint8_t* payload, uint8_t length);
+static void encoder_put(FrameEncoder* encoder, uint8_t byte);
+static uint8_t try_claim(volatile uint32_t* word, uint32_t expected, uint32_t value);
+static void kick_dma(TMC_StreamTypeDef* hstream);
+static uint8_t start_next(TMC_StreamTypeDef* hstream);
+
+
+/* ################ API ################*/
+
+/**
+ * \brief			Starts the stream on given UART, nothing is sent before this call
+ * \param[in]		huart: UART with DMA TX channel linked and its global interrupt enabled
+ */
+void TMC_stream_init(UART_HandleTypeDef* huart)
+{
+	memset(&tmc_stream, 0, sizeof(tmc_stream));
+	tmc_stream.rings[0].buffer = shared_ring_buffer;
+	tmc_stream.rings[0].mask = TMC_STREAM_SHARED_RING_SIZE - 1u;
+	for (uint8_t i = 0; i < TMC_STREAM_TASK_RINGS; i++)
+	{
+		tmc_stream.rings[i + 1].buffer = task_ring_buffers[i];
+		tmc_stream.rings[i + 1].mask = TMC_STREAM_TASK_RING_SIZE - 1u;
+	}
+	tmc_stream.huart = huart;
+}
+
+/**
+ * \brief			Queues single frame for transmission, never blocks
+ * \param[in]		type: kind of the frame
+ * \param[in]		payload: frame content
+ * \param[in]		length: payload length, at most TMC_STREAM_MAX_PAYLOAD
+ * \return			HAL_OK when queued, HAL_BUSY when the ring is full and the frame was dropped,
+ * 					HAL_ERROR when the stream is not started or payload is too long
+ * \note			Task writes into its own ring without masking interrupts. Interrupts and tasks
+ * 					that found no free ring share one ring, there only the copy runs masked
+ */
+HAL_StatusTypeDef TMC_stream_write_frame(TMC_StreamFrameType type, const uint8_t* payload, uint8_t length)
+{
+	TMC_StreamTypeDef* hstream = &tmc_stream;
+	if (hstream->huart == NULL || length > TMC_STREAM_MAX_PAYLOAD)
+	{
+		return HAL_ERROR;
+	}
+
+	TMC_StreamRing* ring = own_ring(hstream);
+	if (ring == NULL)
+	{
+		return write_shared_ring(hstream, type, payload, length);
+	}
+	uint8_t channel = ring - hstream->rings;
+	return write_own_ring(hstream, ring, (channel << TMC_STREAM_CHANNEL_SHIFT) | type, payload, length);
+}
+
+/**
+ * \brief			Sends characters as text frames, backend of _write for stdout
+ * \param[in]		text: characters, not terminated
+ * \param[in]		length: number of characters
+ * \return			Number of characters queued, the rest was dropped and counted
+ * \note			Newlib keeps stdout buffer per task and flushes it at end of line,
+ * 					so a line is normally a single frame and lines of tasks never mix
+ */
+uint32_t TMC_stream_write_text(const uint8_t* text, uint32_t length)
+{
+	uint32_t written = 0;
+	while (written < length)
+	{
+		uint32_t chunk = length - written;
+		if (chunk > TMC_STREAM_MAX_PAYLOAD)
+		{
+			chunk = TMC_STREAM_MAX_PAYLOAD;
+		}
+		if (TMC_stream_write_frame(TMC_STREAM_FRAME_TEXT, &text[written], chunk) != HAL_OK)
+		{
+			break;
+		}
+		written += chunk;
+	}
+	return written;
+}
+
+/**
+ * \brief			Sums counters of all rings
+ * \note			peak_used is the highest fill of any single ring
+ */
+void TMC_stream_get_stats(TMC_StreamStats* stats)
+{
+	memset(stats, 0, sizeof(TMC_StreamStats));
+	for (uint8_t i = 0; i < TMC_STREAM_RING_COUNT; i++)
+	{
+		const TMC_StreamStats* ring_stats = &tmc_stream.rings[i].stats;
+		stats->frames += ring_stats->frames;
+		stats->dropped += ring_stats->dropped;
+		stats->bytes += ring_stats->bytes;
+		if (ring_stats->peak_used > stats->peak_used)
+		{
+			stats->peak_used = ring_stats->peak_used;
+		}
+	}
+}
+
+/* ################ Interrupt context ################ */
+/**
+ * \brief			Has to be called from HAL_UART_TxHalfCpltCallback, ignores other UARTs
+ * \note			First half of the DMA block already left memory, so it is returned to the ring
+ * 					right away and producers get the space half a block earlier
+ */
+void TMC_stream_TxHalfCpltCallback(UART_HandleTypeDef* huart)
+{
+	TMC_StreamTypeDef* hstream = &tmc_stream;
+	if (hstream->huart != huart || huart == NULL || hstream->dma_ring == NULL)
+	{
+		return;
+	}
+	hstream->dma_released = hstream->dma_length / 2u;
+	hstream->dma_ring->tail += hstream->dma_released;
+}
+
+/**
+ * \brief			Has to be called from HAL_UART_TxCpltCallback, ignores other UARTs
+ */
+void TMC_stream_TxCpltCallback(UART_HandleTypeDef* huart)
+{
+	TMC_StreamTypeDef* hstream = &tmc_stream;
+	if (hstream->huart != huart || huart == NULL || hstream->dma_ring == NULL)
+	{
+		return;
+	}
+	hstream->dma_ring->tail += hstream->dma_length - hstream->dma_released;
+	hstream->dma_ring = NULL;
+
+	if (!start_next(hstream))
+	{
+		hstream->dma_busy = 0;
+		__DMB();
+		// Producer that published between the scan and the release found DMA busy, look once more
+		kick_dma(hstream);
+	}
+}
+
+/* ################ Private functions ################ */
+/* Ring owned by calling task, claims a free one on the first call, NULL in interrupt or when none is left */
+static TMC_StreamRing* own_ring(TMC_StreamTypeDef* hstream)
+{
+	uint32_t self = (uint32_t)(uintptr_t)osThreadGetId();
+	if (__get_IPSR() != 0 || self == 0)
+	{
+		return NULL;
+	}
+	for (uint8_t i = 1; i < TMC_STREAM_RING_COUNT; i++)
+	{
+		if (hstream->rings[i].owner == self)
+		{
+			return &hstream->rings[i];
+		}
+	}
+	for (uint8_t i = 1; i < TMC_STREAM_RING_COUNT; i++)
+	{
+		if (try_claim(&hstream->rings[i].owner, 0, self))
+		{
+			return &hstream->rings[i];
+		}
+	}
+	return NULL;
+}
+
+/* Lock free, only the owner moves head and only the DMA interrupts move tail */
+static HAL_StatusTypeDef write_own_ring(TMC_StreamTypeDef* hstream, TMC_StreamRing* ring, uint8_t first,
+		const uint8_t* payload, uint8_t length)
+{
+	uint8_t sequence = ring->sequence++;
+	uint32_t head = ring->head;
+	uint32_t used = head - ring->tail;
+	if (ring->mask + 1u - used < ENCODED_LENGTH(length))
+	{
+		ring->stats.dropped++;
+		return HAL_BUSY;
+	}
+
+	uint32_t encoded_length = encode_frame(ring->buffer, ring->mask, head, first, sequence, payload, length);
+	// Frame has to be in memory before DMA may see it
+	__DMB();
+	ring->head = head + encoded_length;
+	count_frame(ring, used, encoded_length);
+	kick_dma(hstream);
+	return HAL_OK;
+}
+
+/* Several producers, frame is encoded on the stack and only copied with interrupts masked */
+static HAL_StatusTypeDef write_shared_ring(TMC_StreamTypeDef* hstream, uint8_t type,
+		const uint8_t* payload, uint8_t length)
+{
+	TMC_StreamRing* ring = &hstream->rings[0];
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	uint8_t sequence = ring->sequence++;
+	__set_PRIMASK(primask);
+
+	uint8_t encoded[TMC_STREAM_MAX_ENCODED];
+	uint32_t encoded_length = encode_frame(encoded, 0xFFFFFFFFu, 0, type, sequence, payload, length);
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	uint32_t used = ring->head - ring->tail;
+	if (ring->mask + 1u - used < encoded_length)
+	{
+		ring->stats.dropped++;
+		__set_PRIMASK(primask);
+		return HAL_BUSY;
+	}
+	uint32_t position = ring->head & ring->mask;
+	uint32_t first = ring->mask + 1u - position;
+	if (first > encoded_length)
+	{
+		first = encoded_length;
+	}
+	memcpy(&ring->buffer[position], encoded, first);
+	memcpy(ring->buffer, &encoded[first], encoded_length - first);
+	ring->head += encoded_length;
+	count_frame(ring, used, encoded_length);
+	__set_PRIMASK(primask);
+
+	kick_dma(hstream);
+	return HAL_OK;
+}
+
+static void count_frame(TMC_StreamRing* ring, uint32_t used, uint32_t encoded_length)
+{
+	ring->stats.frames++;
+	ring->stats.bytes += encoded_length;
+	if (used + encoded_length > ring->stats.peak_used)
+	{
+		ring->stats.peak_used = used + encoded_length;
+	}
+}
+
+/* COBS encodes first byte, sequence, payload and CRC at given position, adds delimiter, returns encoded length */
+static uint32_t encode_frame(uint8_t* buffer, uint32_t mask, uint32_t position, uint8_t first, uint8_t sequence,
+		const uint8_t* payload, uint8_t length)
+{
+	FrameEncoder encoder = {
+		.buffer = buffer,
+		.mask = mask,
+		.position = position + 1u,
+		.code_position = position,
+		.code = 1,
+		.crc = 0
+	};
+
+	encoder_put(&encoder, first);
+	encoder_put(&encoder, sequence);
+	for (uint8_t i = 0; i < length; i++)
+	{
+		encoder_put(&encoder, payload[i]);
+	}
+	encoder_put(&encoder, encoder.crc);
+
+	buffer[encoder.code_position & mask] = encoder.code;
+	buffer[encoder.position++ & mask] = 0x00;
+	return encoder.position - position;
+}
+
+/* Every zero is replaced by distance to the next one, so 0x00 only appears as delimiter */
+static void encoder_put(FrameEncoder* encoder, uint8_t byte)
+{
+	encoder->crc = TMC2226_CRC_table[encoder->crc ^ byte];
+	if (byte != 0)
+	{
+		encoder->buffer[encoder->position++ & encoder->mask] = byte;
+		encoder->code++;
+	}
+	if (byte == 0 || encoder->code == 0xFF)
+	{
+		encoder->buffer[encoder->code_position & encoder->mask] = encoder->code;
+		encoder->code_position = encoder->position++;
+		encoder->code = 1;
+	}
+}
+
+/* Atomically replaces expected with value, returns 0 when word held something else */
+static uint8_t try_claim(volatile uint32_t* word, uint32_t expected, uint32_t value)
+{
+	do
+	{
+		if (__LDREXW(word) != expected)
+		{
+			__CLREX();
+			return 0;
+		}
+	} while (__STREXW(value, word) != 0);
+	__DMB();
+	return 1;
+}
+
+/* Starts DMA unless it already runs, its completion picks up what was just published */
+static void kick_dma(TMC_StreamTypeDef* hstream)
+{
+	if (try_claim(&hstream->dma_busy, 0, 1) && !start_next(hstream))
+	{
+		hstream->dma_busy = 0;
+	}
+}
+
+/* Hands contiguous part of the next non empty ring to DMA, called with dma_busy claimed */
+static uint8_t start_next(TMC_StreamTypeDef* hstream)
+{
+	for (uint8_t i = 0; i < TMC_STREAM_RING_COUNT; i++)
+	{
+		uint8_t index = (hstream->cursor + i) % TMC_STREAM_RING_COUNT;
+		TMC_StreamRing* ring = &hstream->rings[index];
+		uint32_t pending = ring->head - ring->tail;
+		if (pending == 0)
+		{
+			continue;
+		}
+
+		uint32_t position = ring->tail & ring->mask;
+		uint32_t length = pending;
+		if (length > ring->mask + 1u - position)
+		{
+			length = ring->mask + 1u - position;
+		}
+		// Ring wrap may cut a frame, its rest has to follow before another ring gets a turn
+		hstream->cursor = (length < pending) ? index : (index + 1) % TMC_STREAM_RING_COUNT;
+		hstream->dma_ring = ring;
+		hstream->dma_length = length;
+		hstream->dma_released = 0;
+		if (HAL_UART_Transmit_DMA(hstream->huart, &ring->buffer[position], length) != HAL_OK)
+		{
+			// Retried by the next write
+			hstream->dma_ring = NULL;
+			return 0;
+		}
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,238 @@
+/*
+ * TMC2226_telemetry.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+#include "TMC2226_telemetry.h"
+
+#include <string.h>
+#include "main.h"
+#include "cmsis_os.h"
+#include "TMC2226.h"
+#include "TMC2226_stream.h"
+
+
+/* Register read for each TMC_TelemetryRegister */
+static const TMC2226_ReadRegisters telemetry_registers[TMC_TELEMETRY_REGISTER_COUNT] = {
+	R_SG_RESULT, R_TSTEP, R_DRV_STATUS, R_MSCNT
+};
+
+static TMC_TelemetryNode telemetry_nodes[TMC_TELEMETRY_MAX_NODES];
+static volatile uint8_t telemetry_node_count;
+static volatile uint32_t telemetry_period_ms = TMC_TELEMETRY_DEFAULT_PERIOD_MS;
+
+/* Only the poller thread reads, so the in-flight requests do not have to live on its stack.
+ * One set per bus, nodes of different buses are polled at the same time */
+static TMC_ReadFuture telemetry_reads[TMC_BUS_MAX_COUNT][TMC_TELEMETRY_REGISTER_COUNT];
+
+static TMC_TelemetryNode* find_node(TMC_HandleTypeDef* htmc);
+static void submit_reads(TMC_TelemetryNode* node, TMC_ReadFuture* reads, TMC_BusStatus* status);
+static void publish_reads(TMC_TelemetryNode* node, TMC_ReadFuture* reads, TMC_BusStatus* status);
+static void stream_snapshot(const TMC_TelemetrySnapshot* snapshot, uint8_t fresh, uint32_t timestamp_ms);
+
+
+/* ################ API ################*/
+
+/**
+ * \brief			Adds node to the polling rounds
+ * \param[in]		htmc: node initialised with TMC_Init, has to stay valid as long as the poller runs
+ * \return			HAL_ERROR when all TMC_TELEMETRY_MAX_NODES slots are taken, HAL_OK otherwise
+ * \note			May be called while the poller is running, node shows up in its next round
+ */
+HAL_StatusTypeDef TMC_telemetry_add(TMC_HandleTypeDef* htmc)
+{
+	if (find_node(htmc) != NULL)
+	{
+		return HAL_OK;
+	}
+	uint8_t count = telemetry_node_count;
+	if (count >= TMC_TELEMETRY_MAX_NODES)
+	{
+		return HAL_ERROR;
+	}
+
+	TMC_TelemetryNode* node = &telemetry_nodes[count];
+	memset(node, 0, sizeof(TMC_TelemetryNode));
+	node->buffer[0].node_id = TMC_node_id(htmc);
+	node->buffer[1].node_id = TMC_node_id(htmc);
+	node->htmc = htmc;
+
+	// Slot has to be complete before the poller can see it
+	__DMB();
+	telemetry_node_count = count + 1;
+	return HAL_OK;
+}
+
+/**
+ * \brief			Sets time between two polling rounds over all registered nodes
+ * \note			Round that takes longer than the period is followed by the next one right away
+ */
+void TMC_telemetry_set_period(uint32_t period_ms)
+{
+	telemetry_period_ms = period_ms;
+}
+
+/**
+ * \brief			Copies the latest published state of a node, never blocks
+ * \param[in]		htmc: node registered with TMC_telemetry_add
+ * \param[out]		snapshot: filled with consistent copy of the node state
+ * \return			1 when snapshot was filled, 0 when the node is not registered or not polled yet
+ * \note			Poller writes only the unpublished buffer, so a reader of higher priority
+ * 					never waits for it. Reader of lower priority retries whenever a round was
+ * 					published while it was copying, the round after that rewrites its buffer
+ */
+uint8_t TMC_telemetry_read(TMC_HandleTypeDef* htmc, TMC_TelemetrySnapshot* snapshot)
+{
+	TMC_TelemetryNode* node = find_node(htmc);
+	if (node == NULL)
+	{
+		return 0;
+	}
+
+	uint32_t sequence;
+	do
+	{
+		sequence = node->sequence;
+		__DMB();
+		*snapshot = node->buffer[sequence & 1u];
+		__DMB();
+	} while (node->sequence != sequence);
+	return sequence != 0;
+}
+
+/**
+ * \brief			Runs one polling round over all registered nodes
+ * \note			Reads of one node are queued together and overlap on the bus at low priority,
+ * 					so setpoints and configuration writes of other tasks overtake them. Round goes
+ * 					in waves of one node per bus, every bus worker has its own node to poll, so
+ * 					a round over N buses takes about as long as the round of the busiest one
+ */
+void TMC_telemetry_poll(void)
+{
+	uint8_t count = telemetry_node_count;
+	TMC_TelemetryNode* wave[TMC_BUS_MAX_COUNT];
+	TMC_BusStatus status[TMC_BUS_MAX_COUNT][TMC_TELEMETRY_REGISTER_COUNT];
+	uint32_t polled = 0;
+	while (polled != (1u << count) - 1u)
+	{
+		memset(wave, 0, sizeof(wave));
+		for (uint8_t i = 0; i < count; i++)
+		{
+			uint8_t bus = TMC_bus_index(telemetry_nodes[i].htmc->hbus);
+			if (!(polled & (1u << i)) && wave[bus] == NULL)
+			{
+				wave[bus] = &telemetry_nodes[i];
+				polled |= 1u << i;
+				submit_reads(wave[bus], telemetry_reads[bus], status[bus]);
+			}
+		}
+		for (uint8_t bus = 0; bus < TMC_BUS_MAX_COUNT; bus++)
+		{
+			if (wave[bus] != NULL)
+			{
+				publish_reads(wave[bus], telemetry_reads[bus], status[bus]);
+			}
+		}
+	}
+}
+
+/**
+ * \brief			Polls registered nodes forever at the configured period, meant as a task body
+ */
+void TMC_telemetry_run(void)
+{
+	uint32_t wake_up = osKernelGetTickCount();
+	while (1)
+	{
+		TMC_telemetry_poll();
+
+		wake_up += telemetry_period_ms;
+		uint32_t now = osKernelGetTickCount();
+		if ((int32_t)(wake_up - now) > 0)
+		{
+			osDelayUntil(wake_up);
+		}
+		else
+		{
+			// Round overran the period, do not try to catch up with a burst of rounds
+			wake_up = now;
+		}
+	}
+}
+
+/* ################ Private functions ################ */
+static TMC_TelemetryNode* find_node(TMC_HandleTypeDef* htmc)
+{
+	uint8_t count = telemetry_node_count;
+	for (uint8_t i = 0; i < count; i++)
+	{
+		if (telemetry_nodes[i].htmc == htmc)
+		{
+			return &telemetry_nodes[i];
+		}
+	}
+	return NULL;
+}
+
+static void submit_reads(TMC_TelemetryNode* node, TMC_ReadFuture* reads, TMC_BusStatus* status)
+{
+	for (uint8_t i = 0; i < TMC_TELEMETRY_REGISTER_COUNT; i++)
+	{
+		status[i] = TMC_read_async(node->htmc, telemetry_registers[i], &reads[i]);
+	}
+}
+
+/* Waits for reads of submit_reads and publishes them as the next snapshot of the node */
+static void publish_reads(TMC_TelemetryNode* node, TMC_ReadFuture* reads, TMC_BusStatus* status)
+{
+	uint8_t fresh = 0;
+	// Unpublished buffer starts as a copy of the published one, failed reads keep old samples
+	uint32_t sequence = node->sequence;
+	TMC_TelemetrySnapshot* next = &node->buffer[(sequence + 1u) & 1u];
+	*next = node->buffer[sequence & 1u];
+
+	for (uint8_t i = 0; i < TMC_TELEMETRY_REGISTER_COUNT; i++)
+	{
+		if (status[i] == TMC_BUS_PENDING)
+		{
+			status[i] = TMC_read_await(&reads[i]);
+		}
+		if (status[i] == TMC_BUS_OK)
+		{
+			next->samples[i].value = reads[i].value;
+			next->samples[i].timestamp_ms = osKernelGetTickCount();
+			fresh |= 1u << i;
+		}
+		else
+		{
+			next->failed_reads++;
+		}
+	}
+	next->rounds++;
+
+	__DMB();
+	node->sequence = sequence + 1u;
+
+	stream_snapshot(next, fresh, osKernelGetTickCount());
+}
+
+/* Sends the round as TMC_STREAM_FRAME_TELEMETRY, dropped silently when the stream is full */
+static void stream_snapshot(const TMC_TelemetrySnapshot* snapshot, uint8_t fresh, uint32_t timestamp_ms)
+{
+	uint8_t payload[TMC_STREAM_TELEMETRY_LENGTH];
+	payload[TMC_STREAM_TELEMETRY_NODE] = snapshot->node_id;
+	payload[TMC_STREAM_TELEMETRY_FRESH] = fresh;
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		payload[TMC_STREAM_TELEMETRY_TIMESTAMP + i] = (uint8_t)(timestamp_ms >> (8 * i));
+	}
+	for (uint8_t r = 0; r < TMC_TELEMETRY_REGISTER_COUNT; r++)
+	{
+		for (uint8_t i = 0; i < 4; i++)
+		{
+			payload[TMC_STREAM_TELEMETRY_VALUES + 4 * r + i] = (uint8_t)(snapshot->samples[r].value >> (8 * i));
+		}
+	}
+	TMC_stream_write_frame(TMC_STREAM_FRAME_TELEMETRY, payload, sizeof(payload));
+}
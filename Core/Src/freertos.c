@@ -25,6 +25,8 @@
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "tim.h"
+#include "rtos_stats.h"
 
 /* USER CODE END Includes */
 
@@ -51,14 +53,14 @@
 osThreadId_t defaultTaskHandle;
 const osThreadAttr_t defaultTask_attributes = {
   .name = "defaultTask",
-  .stack_size = 128 * 4,
+  .stack_size = 256 * 4,
   .priority = (osPriority_t) osPriorityNormal,
 };
 /* Definitions for task_stepper_mo */
 osThreadId_t task_stepper_moHandle;
 const osThreadAttr_t task_stepper_mo_attributes = {
   .name = "task_stepper_mo",
-  .stack_size = 128 * 4,
+  .stack_size = 256 * 4,
   .priority = (osPriority_t) osPriorityLow,
 };
 /* Definitions for task_serial_pri */
@@ -80,6 +82,23 @@ extern void start_task_serial_print(void *argument);
 
 void MX_FREERTOS_Init(void); /* (MISRA C 2004 rule 8.1) */
 
+/* Hook prototypes */
+void configureTimerForRunTimeStats(void);
+unsigned long getRunTimeCounterValue(void);
+
+/* USER CODE BEGIN 1 */
+/* Functions needed when configGENERATE_RUN_TIME_STATS is on */
+void configureTimerForRunTimeStats(void)
+{
+  rtos_stats_timer_start(&htim4);
+}
+
+unsigned long getRunTimeCounterValue(void)
+{
+  return rtos_stats_timer_get();
+}
+/* USER CODE END 1 */
+
 /**
   * @brief  FreeRTOS initialization
   * @param  None
@@ -136,11 +155,8 @@ void MX_FREERTOS_Init(void) {
 void StartDefaultTask(void *argument)
 {
   /* USER CODE BEGIN StartDefaultTask */
-  /* Infinite loop */
-  for(;;)
-  {
-    osDelay(1);
-  }
+  /* CPU shares, stack high-water marks and heap of all tasks, printed every RTOS_STATS_PERIOD_MS */
+  rtos_stats_run();
   /* USER CODE END StartDefaultTask */
 }
 
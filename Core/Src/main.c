@@ -19,12 +19,19 @@
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
 #include "cmsis_os.h"
+#include "dma.h"
 #include "tim.h"
 #include "usart.h"
 #include "gpio.h"
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "TMC2226_bus.h"
+#include "TMC2226_step.h"
+#include "TMC2226_stream.h"
+#include "TMC2226_shell.h"
+#include "probe.h"
+#include "rtos_stats.h"
 
 /* USER CODE END Includes */
 
@@ -46,9 +53,7 @@
 /* Private variables ---------------------------------------------------------*/
 
 /* USER CODE BEGIN PV */
-uint8_t triggered = 0;
 uint8_t command_triggered = 0;
-//uint16_t trigger_counter = 0;
 
 /* USER CODE END PV */
 
@@ -56,15 +61,16 @@ uint8_t command_triggered = 0;
 void SystemClock_Config(void);
 void MX_FREERTOS_Init(void);
 /* USER CODE BEGIN PFP */
-int __io_putchar(int ch)
+/*
+ * stdout backend, replaces weak one from syscalls.c that went character by character.
+ * Lines go out as text frames of the binary stream, Tools/stream_decode prints them.
+ * Never blocks, what does not fit into the ring is dropped and counted in TMC_stream_get_stats
+ */
+int _write(int file, char *ptr, int len)
 {
-    if (ch == '\n') {
-        uint8_t ch2 = '\r';
-        HAL_UART_Transmit(&huart2, &ch2, 1, HAL_MAX_DELAY);
-    }
-
-    HAL_UART_Transmit(&huart2, (uint8_t*)&ch, 1, HAL_MAX_DELAY);
-    return 1;
+	(void)file;
+	TMC_stream_write_text((const uint8_t*)ptr, len);
+	return len;
 }
 /* USER CODE END PFP */
 
@@ -101,10 +107,17 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_USART2_UART_Init();
   MX_USART1_UART_Init();
+  MX_USART3_UART_Init();
   MX_TIM2_Init();
+  MX_TIM3_Init();
+  MX_TIM4_Init();
   /* USER CODE BEGIN 2 */
+  TMC_stream_init(&huart2);
+  // Interrupt probes read the cycle counter, start it before the scheduler enables them all
+  probe_init();
 
   /* USER CODE END 2 */
 
@@ -172,14 +185,41 @@ void SystemClock_Config(void)
 
 void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
 {
+	PROBE_BEGIN(PROBE_GPIO_EXTI);
 	if (GPIO_Pin == B1_Pin && command_triggered == 0)
 	{
-		HAL_TIM_Base_Start_IT(&htim2);
 		command_triggered = 1;
 		HAL_GPIO_TogglePin(LD2_GPIO_Port, LD2_Pin);
 	}
+	PROBE_END(PROBE_GPIO_EXTI);
+}
+
+void HAL_UART_TxHalfCpltCallback(UART_HandleTypeDef *huart)
+{
+	TMC_stream_TxHalfCpltCallback(huart);
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	TMC_bus_TxCpltCallback(huart);
+	TMC_stream_TxCpltCallback(huart);
+}
+
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+	TMC_bus_RxCpltCallback(huart);
 }
 
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+	TMC_shell_RxEventCallback(huart, Size);
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+	TMC_bus_ErrorCallback(huart);
+	TMC_shell_ErrorCallback(huart);
+}
 
 /* USER CODE END 4 */
 
@@ -194,20 +234,15 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
 void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
 {
   /* USER CODE BEGIN Callback 0 */
-
+  PROBE_BEGIN(PROBE_TIM_PERIOD);
   /* USER CODE END Callback 0 */
   if (htim->Instance == TIM1) {
     HAL_IncTick();
   }
   /* USER CODE BEGIN Callback 1 */
-  if (htim == &htim2 && HAL_GPIO_ReadPin(B1_GPIO_Port, B1_Pin) && triggered == 1)
-  {
-	  HAL_GPIO_TogglePin(LD2_GPIO_Port, LD2_Pin);
-	  command_triggered = 1;
-//	  trigger_counter++;
-	  HAL_TIM_Base_Stop_IT(&htim2);
-	  triggered = 0;
-  }
+  TMC_step_PeriodElapsedCallback(htim);
+  rtos_stats_PeriodElapsedCallback(htim);
+  PROBE_END(PROBE_TIM_PERIOD);
   /* USER CODE END Callback 1 */
 }
 
@@ -0,0 +1,81 @@
+/*
+ * probe.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+#include "probe.h"
+
+#include <string.h>
+#include "main.h"
+#include "cycle_counter.h"
+
+
+static ProbeHistogram probe_histograms[PROBE_COUNT];
+
+/* Name of each ProbeId as shown by the shell */
+static const char* const probe_names[PROBE_COUNT] = {
+	"tick_irq", "tim_period", "gpio_exti", "bus_irq", "bus_transfer"
+};
+
+
+/* ################ API ################*/
+
+/**
+ * \brief			Starts cycle counter the probes read, has to run before the first PROBE_BEGIN
+ */
+void probe_init(void)
+{
+	cycle_counter_init();
+}
+
+/**
+ * \brief			Adds one duration to the histogram of given probe
+ * \param[in]		id: probe the duration belongs to
+ * \param[in]		cycles: duration in core cycles
+ * \note			Called by PROBE_END from any context. No locking, every probe sits in a
+ * 					single context (one ISR or one thread) that can not preempt itself
+ */
+void probe_record(ProbeId id, uint32_t cycles)
+{
+	ProbeHistogram* histogram = &probe_histograms[id];
+	// Bucket is the bit length of the duration, CLZ makes it a single instruction
+	uint32_t bucket = (cycles != 0) ? 32u - __CLZ(cycles) : 0;
+	histogram->buckets[bucket]++;
+	histogram->count++;
+	histogram->total_cycles += cycles;
+	if (cycles > histogram->max_cycles)
+	{
+		histogram->max_cycles = cycles;
+	}
+}
+
+/**
+ * \brief			Copies histogram of given probe, consistent even if the probe fires meanwhile
+ */
+void probe_get(ProbeId id, ProbeHistogram* histogram)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	*histogram = probe_histograms[id];
+	__set_PRIMASK(primask);
+}
+
+/**
+ * \brief			Returns short name of given probe
+ */
+const char* probe_name(ProbeId id)
+{
+	return (id < PROBE_COUNT) ? probe_names[id] : "?";
+}
+
+/**
+ * \brief			Clears all histograms, e.g. before a measurement of a particular scenario
+ */
+void probe_reset(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	memset(probe_histograms, 0, sizeof(probe_histograms));
+	__set_PRIMASK(primask);
+}
@@ -0,0 +1,209 @@
+/*
+ * rtos_stats.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+#include "rtos_stats.h"
+
+#include <stdio.h>
+#include "main.h"
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+
+static TIM_HandleTypeDef* stats_htim;
+/* Upper half of the run-time counter, TIM4 counts the lower 16 bits */
+static volatile uint32_t timer_overflows;
+
+/* Scratch of rtos_stats_sample, too big for the stack of the sampling task */
+static TaskStatus_t task_status[RTOS_STATS_MAX_TASKS];
+/* Run-time counters seen by the previous sample, matched to tasks by task number */
+static uint32_t previous_runtime[RTOS_STATS_MAX_TASKS];
+static UBaseType_t previous_number[RTOS_STATS_MAX_TASKS];
+static uint8_t previous_count;
+static uint32_t previous_total;
+static uint32_t previous_tick;
+
+static RtosStatsSnapshot stats_snapshot;
+
+static uint32_t previous_runtime_of(UBaseType_t number);
+static void sort_by_number(RtosTaskStats* tasks, uint8_t count);
+
+
+/* ################ API ################*/
+
+/**
+ * \brief			Starts run-time counter of FreeRTOS, portCONFIGURE_TIMER_FOR_RUN_TIME_STATS
+ * \param[in]		htim: free running 16-bit timer with its update interrupt enabled,
+ * 					TIM4 prescaled to 100 kHz gives 10 us resolution and wraps after ~11.9 h
+ * \note			Called by the kernel when the scheduler starts. Resolution is 100x the tick,
+ * 					enough to see tasks that run for a fraction of a tick
+ */
+void rtos_stats_timer_start(TIM_HandleTypeDef* htim)
+{
+	stats_htim = htim;
+	timer_overflows = 0;
+	HAL_TIM_Base_Start_IT(htim);
+}
+
+/**
+ * \brief			Returns run-time counter, portGET_RUN_TIME_COUNTER_VALUE
+ * \note			Called by the kernel on every context switch. Overflow interrupt that is
+ * 					pending but not handled yet is counted here, CNT read before the flag
+ * 					tells whether the overflow happened before or after it
+ */
+uint32_t rtos_stats_timer_get(void)
+{
+	if (stats_htim == NULL)
+	{
+		return 0;
+	}
+	TIM_TypeDef* timer = stats_htim->Instance;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	uint32_t high = timer_overflows;
+	uint32_t low = timer->CNT;
+	if ((timer->SR & TIM_SR_UIF) && low < 0x8000u)
+	{
+		high++;
+	}
+	__set_PRIMASK(primask);
+	return (high << 16) | low;
+}
+
+/**
+ * \brief			Takes CPU shares since the previous sample, stack high-water marks and heap
+ * \note			Walks the stack of every task looking for untouched words, keep it out of
+ * 					tight loops. Tasks above RTOS_STATS_MAX_TASKS make the sample fail, the
+ * 					previous snapshot stays published then
+ */
+void rtos_stats_sample(void)
+{
+	uint32_t total;
+	UBaseType_t count = uxTaskGetSystemState(task_status, RTOS_STATS_MAX_TASKS, &total);
+	if (count == 0)
+	{
+		return;
+	}
+	uint32_t tick = osKernelGetTickCount();
+	uint32_t window = total - previous_total;
+
+	RtosStatsSnapshot sample;
+	sample.window_ms = tick - previous_tick;
+	sample.heap_free = xPortGetFreeHeapSize();
+	sample.heap_minimum_free = xPortGetMinimumEverFreeHeapSize();
+	sample.task_count = (uint8_t)count;
+	for (UBaseType_t i = 0; i < count; i++)
+	{
+		RtosTaskStats* task = &sample.tasks[i];
+		uint32_t runtime = task_status[i].ulRunTimeCounter - previous_runtime_of(task_status[i].xTaskNumber);
+		task->name = task_status[i].pcTaskName;
+		task->cpu_permille = (window != 0) ? (uint16_t)((uint64_t)runtime * 1000u / window) : 0;
+		task->stack_free_words = task_status[i].usStackHighWaterMark;
+		task->priority = (uint8_t)task_status[i].uxCurrentPriority;
+		task->number = (uint8_t)task_status[i].xTaskNumber;
+	}
+	// Kernel lists tasks by state, creation order keeps lines of consecutive reports aligned
+	sort_by_number(sample.tasks, sample.task_count);
+
+	for (UBaseType_t i = 0; i < count; i++)
+	{
+		previous_runtime[i] = task_status[i].ulRunTimeCounter;
+		previous_number[i] = task_status[i].xTaskNumber;
+	}
+	previous_count = (uint8_t)count;
+	previous_total = total;
+	previous_tick = tick;
+
+	int32_t lock = osKernelLock();
+	sample.samples = stats_snapshot.samples + 1;
+	stats_snapshot = sample;
+	osKernelRestoreLock(lock);
+}
+
+/**
+ * \brief			Copies result of the last sample
+ */
+void rtos_stats_get(RtosStatsSnapshot* snapshot)
+{
+	int32_t lock = osKernelLock();
+	*snapshot = stats_snapshot;
+	osKernelRestoreLock(lock);
+}
+
+/**
+ * \brief			Prints heap line and one line per task: name, CPU %, priority, free stack words
+ */
+void rtos_stats_print(const RtosStatsSnapshot* snapshot)
+{
+	printf("rtos %lu ms heap free %lu min %lu\n", (unsigned long)snapshot->window_ms,
+			(unsigned long)snapshot->heap_free, (unsigned long)snapshot->heap_minimum_free);
+	for (uint8_t i = 0; i < snapshot->task_count; i++)
+	{
+		const RtosTaskStats* task = &snapshot->tasks[i];
+		printf("  %-16s %3u.%u%% prio %2u stack free %4u w\n", task->name,
+				task->cpu_permille / 10u, task->cpu_permille % 10u, task->priority, task->stack_free_words);
+	}
+}
+
+/**
+ * \brief			Samples every RTOS_STATS_PERIOD_MS and reports when RTOS_STATS_REPORT_ENABLED
+ * \note			Never returns, body of defaultTask
+ */
+void rtos_stats_run(void)
+{
+	uint32_t wake_up = osKernelGetTickCount();
+	while (1)
+	{
+		wake_up += RTOS_STATS_PERIOD_MS;
+		osDelayUntil(wake_up);
+		rtos_stats_sample();
+#if RTOS_STATS_REPORT_ENABLED
+		// Only this task writes the snapshot, no copy needed
+		rtos_stats_print(&stats_snapshot);
+#endif
+	}
+}
+
+
+/* ################ Interrupt context ################ */
+void rtos_stats_PeriodElapsedCallback(TIM_HandleTypeDef* htim)
+{
+	if (stats_htim != NULL && htim->Instance == stats_htim->Instance)
+	{
+		timer_overflows++;
+	}
+}
+
+
+/* ################ Private functions ################ */
+/* Counter of a task created after the previous sample starts at 0 */
+static uint32_t previous_runtime_of(UBaseType_t number)
+{
+	for (uint8_t i = 0; i < previous_count; i++)
+	{
+		if (previous_number[i] == number)
+		{
+			return previous_runtime[i];
+		}
+	}
+	return 0;
+}
+
+/* Insertion sort, a dozen entries at most */
+static void sort_by_number(RtosTaskStats* tasks, uint8_t count)
+{
+	for (uint8_t i = 1; i < count; i++)
+	{
+		RtosTaskStats task = tasks[i];
+		uint8_t j = i;
+		while (j > 0 && tasks[j - 1].number > task.number)
+		{
+			tasks[j] = tasks[j - 1];
+			j--;
+		}
+		tasks[j] = task;
+	}
+}
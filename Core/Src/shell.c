@@ -0,0 +1,366 @@
+/*
+ * shell.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ */
+#include "shell.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+static void resync(ShellTypeDef* shell, uint32_t position);
+static void execute_range(ShellTypeDef* shell, uint32_t start, uint32_t end);
+static const ShellCommand* find_command(ShellTypeDef* shell, const char* name);
+static void print_help(ShellTypeDef* shell);
+
+
+/* ################ API ################*/
+
+/**
+ * \brief			Prepares shell for a receive buffer that is about to be filled from index 0
+ * \param[in]		buffer: circular receive buffer, size has to be a power of 2 above SHELL_MAX_LINE
+ * \param[in]		commands: table searched by command name, has to stay valid
+ */
+void shell_init(ShellTypeDef* shell, char* buffer, uint32_t size, const ShellCommand* commands, uint8_t command_count)
+{
+	memset(shell, 0, sizeof(ShellTypeDef));
+	shell->buffer = buffer;
+	shell->mask = size - 1u;
+	shell->commands = commands;
+	shell->command_count = command_count;
+}
+
+/**
+ * \brief			Executes every complete line received so far
+ * \return			Number of lines executed
+ * \note			Call from the thread that owns whatever the commands act on. Bytes of an
+ * 					unfinished line stay in the buffer and are looked at again on the next call
+ */
+uint32_t shell_process(ShellTypeDef* shell)
+{
+	uint32_t executed = 0;
+	uint32_t size = shell->mask + 1u;
+	uint32_t head = shell->head;
+	__sync_synchronize();
+	if (shell->restarted)
+	{
+		// Receiver started over at index 0, whatever was in the buffer is not a continuation
+		shell->restarted = 0;
+		__sync_synchronize();
+		head = shell->head;
+		resync(shell, head);
+		shell->stats.overruns++;
+	}
+
+	while (shell->scan != head)
+	{
+		if (head - shell->tail > size)
+		{
+			// Receiver lapped the line being assembled, nothing of it can be trusted
+			resync(shell, head);
+			shell->stats.overruns++;
+			break;
+		}
+
+		uint32_t end = shell->scan++;
+		char c = shell->buffer[end & shell->mask];
+		if (c != '\n' && c != '\r')
+		{
+			if (!shell->discarding && shell->scan - shell->tail > SHELL_MAX_LINE)
+			{
+				shell->discarding = 1;
+				shell->stats.dropped++;
+				printf("err line too long\n");
+			}
+			continue;
+		}
+
+		if (!shell->discarding && end != shell->tail)
+		{
+			execute_range(shell, shell->tail, end);
+			executed++;
+		}
+		shell->discarding = 0;
+		shell->tail = shell->scan;
+	}
+	return executed;
+}
+
+/**
+ * \brief			Splits line into words in place and runs the command it names
+ * \param[in]		line: zero terminated, separators are overwritten with zeros
+ * \return			Handler result, SHELL_OK for empty line
+ */
+int shell_execute(ShellTypeDef* shell, char* line)
+{
+	char* argv[SHELL_MAX_ARGS];
+	int argc = 0;
+	char* p = line;
+	while (1)
+	{
+		while (*p == ' ' || *p == '\t')
+		{
+			p++;
+		}
+		if (*p == '\0')
+		{
+			break;
+		}
+		if (argc == SHELL_MAX_ARGS)
+		{
+			shell->stats.lines++;
+			shell->stats.failed++;
+			printf("err too many words\n");
+			return SHELL_ERROR_REPORTED;
+		}
+		argv[argc++] = p;
+		while (*p != '\0' && *p != ' ' && *p != '\t')
+		{
+			p++;
+		}
+		if (*p != '\0')
+		{
+			*p++ = '\0';
+		}
+	}
+	if (argc == 0)
+	{
+		return SHELL_OK;
+	}
+
+	shell->stats.lines++;
+	if (strcmp(argv[0], "help") == 0)
+	{
+		print_help(shell);
+		printf("ok\n");
+		return SHELL_OK;
+	}
+
+	const ShellCommand* command = find_command(shell, argv[0]);
+	if (command == NULL)
+	{
+		shell->stats.failed++;
+		printf("err unknown command %s\n", argv[0]);
+		return SHELL_ERROR_REPORTED;
+	}
+
+	int result = (argc - 1 < command->min_args) ? SHELL_ERROR_USAGE : command->handler(argc, argv);
+	switch (result)
+	{
+		case SHELL_OK:
+			printf("ok\n");
+			break;
+		case SHELL_ERROR_USAGE:
+			shell->stats.failed++;
+			printf("err usage: %s %s\n", command->name, command->usage);
+			break;
+		default:
+			shell->stats.failed++;
+			break;
+	}
+	return result;
+}
+
+/**
+ * \brief			Parses signed decimal or 0x prefixed hexadecimal 32 bit number
+ * \return			1 when the whole text is a number in range, 0 otherwise
+ */
+uint8_t shell_parse_int(const char* text, int32_t* value)
+{
+	uint8_t negative = (*text == '-');
+	uint32_t magnitude;
+	if (!shell_parse_uint(negative ? text + 1 : text, &magnitude))
+	{
+		return 0;
+	}
+	if (magnitude > (negative ? 0x80000000u : 0x7FFFFFFFu))
+	{
+		return 0;
+	}
+	*value = negative ? (int32_t)(0u - magnitude) : (int32_t)magnitude;
+	return 1;
+}
+
+/**
+ * \brief			Parses unsigned decimal or 0x prefixed hexadecimal 32 bit number
+ * \return			1 when the whole text is a number in range, 0 otherwise
+ */
+uint8_t shell_parse_uint(const char* text, uint32_t* value)
+{
+	uint32_t base = 10;
+	if (text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+	{
+		base = 16;
+		text += 2;
+	}
+	if (*text == '\0')
+	{
+		return 0;
+	}
+
+	uint32_t result = 0;
+	for (; *text != '\0'; text++)
+	{
+		uint32_t digit;
+		if (*text >= '0' && *text <= '9')
+		{
+			digit = (uint32_t)(*text - '0');
+		}
+		else if (base == 16 && (*text | 0x20) >= 'a' && (*text | 0x20) <= 'f')
+		{
+			digit = (uint32_t)((*text | 0x20) - 'a' + 10);
+		}
+		else
+		{
+			return 0;
+		}
+		if (result > (0xFFFFFFFFu - digit) / base)
+		{
+			return 0;
+		}
+		result = result * base + digit;
+	}
+	*value = result;
+	return 1;
+}
+
+/**
+ * \brief			Parses signed decimal fraction into integer scaled by 10^decimals, no floats involved
+ * \param[in]		decimals: fraction digits kept, "1.5" with 3 decimals gives 1500
+ * \return			1 when the whole text is a number in range with at most that many fraction digits
+ */
+uint8_t shell_parse_fixed(const char* text, uint8_t decimals, int32_t* value)
+{
+	uint8_t negative = (*text == '-');
+	if (negative)
+	{
+		text++;
+	}
+
+	int64_t result = 0;
+	uint8_t digits = 0;
+	int8_t fraction = -1;
+	for (; *text != '\0'; text++)
+	{
+		if (*text == '.' && fraction < 0)
+		{
+			fraction = 0;
+			continue;
+		}
+		if (*text < '0' || *text > '9' || fraction == (int8_t)decimals)
+		{
+			return 0;
+		}
+		result = result * 10 + (*text - '0');
+		digits++;
+		if (fraction >= 0)
+		{
+			fraction++;
+		}
+		if (result > 0x80000000LL)
+		{
+			return 0;
+		}
+	}
+	if (digits == 0)
+	{
+		return 0;
+	}
+
+	for (int8_t i = (fraction < 0) ? 0 : fraction; i < (int8_t)decimals; i++)
+	{
+		result *= 10;
+	}
+	if (negative)
+	{
+		result = -result;
+	}
+	if (result > 0x7FFFFFFFLL || result < -0x80000000LL)
+	{
+		return 0;
+	}
+	*value = (int32_t)result;
+	return 1;
+}
+
+/* ################ Interrupt context ################ */
+
+/**
+ * \brief			Accounts bytes written by the receiver
+ * \param[in]		index: buffer index the receiver is going to write next, buffer size at wrap
+ * \note			Receiver has to report at least twice per lap, DMA half and full transfer
+ * 					events do that, otherwise a whole lap can not be told from no data
+ */
+void shell_received(ShellTypeDef* shell, uint32_t index)
+{
+	uint32_t last = shell->dma_index;
+	uint32_t count = (index >= last) ? index - last : shell->mask + 1u - last + index;
+	shell->dma_index = index & shell->mask;
+	shell->head += count;
+}
+
+/**
+ * \brief			Tells shell that the receiver was started again from index 0
+ * \note			Head moves to the next lap so positions keep matching buffer indexes,
+ * 					the partial line is thrown away by the next shell_process
+ */
+void shell_restart(ShellTypeDef* shell)
+{
+	shell->restarted = 1;
+	__sync_synchronize();
+	shell->dma_index = 0;
+	shell->head = (shell->head + shell->mask) & ~shell->mask;
+}
+
+/* ################ Private functions ################ */
+static void resync(ShellTypeDef* shell, uint32_t position)
+{
+	shell->tail = position;
+	shell->scan = position;
+	shell->discarding = 1;
+}
+
+/* Runs line from start up to the terminator at end, in place unless it wraps around the buffer */
+static void execute_range(ShellTypeDef* shell, uint32_t start, uint32_t end)
+{
+	uint32_t first = start & shell->mask;
+	uint32_t last = end & shell->mask;
+	char* line;
+	if (first < last)
+	{
+		line = &shell->buffer[first];
+		shell->buffer[last] = '\0';
+	}
+	else
+	{
+		uint32_t part = shell->mask + 1u - first;
+		memcpy(shell->scratch, &shell->buffer[first], part);
+		memcpy(&shell->scratch[part], shell->buffer, last);
+		shell->scratch[part + last] = '\0';
+		line = shell->scratch;
+	}
+	shell_execute(shell, line);
+}
+
+static const ShellCommand* find_command(ShellTypeDef* shell, const char* name)
+{
+	for (uint8_t i = 0; i < shell->command_count; i++)
+	{
+		if (strcmp(shell->commands[i].name, name) == 0)
+		{
+			return &shell->commands[i];
+		}
+	}
+	return NULL;
+}
+
+static void print_help(ShellTypeDef* shell)
+{
+	for (uint8_t i = 0; i < shell->command_count; i++)
+	{
+		const ShellCommand* command = &shell->commands[i];
+		printf("%s%s%s\n", command->name, (command->usage[0] != '\0') ? " " : "", command->usage);
+	}
+}
@@ -9,13 +9,16 @@
 #include "usart.h"
 #include "gpio.h"
 #include "cmsis_os.h"
+#include "TMC2226_telemetry.h"
 
 
+/**
+ * \brief			Telemetry engine, polls every node added with TMC_telemetry_add
+ * \note			Other tasks get the results from TMC_telemetry_read without touching the UART
+ */
 void start_task_serial_print(void *argument)
 {
-	while (1)
-	{
-		osDelay(1000);
-	}
+	TMC_telemetry_set_period(TMC_TELEMETRY_DEFAULT_PERIOD_MS);
+	TMC_telemetry_run();
 }
 
@@ -8,22 +8,38 @@
 #include "tim.h"
 #include "usart.h"
 #include "TMC2226.h"
+#include "TMC2226_step.h"
+#include "TMC2226_telemetry.h"
+#include "TMC2226_shell.h"
+#include "TMC2226_bench.h"
+#include "task_stepper_motors.h"
 #include "cmsis_os.h"
 #include  <stdio.h>
 
 extern uint8_t command_triggered;
 
-uint64_t recieved_data = 0;
-uint32_t sent_read = 0;
-
-uint64_t sent_write = 0;
 uint32_t data = 0;
 
 void start_task_stepper_motors(void *argument)
 {
 	/* ## EXAMPLE OF API USE ## */
 	TMC_HandleTypeDef htmc1;
+	TIM_STEPPER_Init();
 	TMC_Init(&htmc1, TMC2226_ADDR_0, &htim2, &huart1, 200);
+	// Link starts at 9600 baud from MX_USART1_UART_Init, climb as high as the wiring allows
+	TMC_link_bringup(&htmc1);
+	// From now on configuration flushes are confirmed by IFCNT readback
+	htmc1.verify_writes = 1;
+	// Status registers are polled in background from now on
+	TMC_telemetry_add(&htmc1);
+	// Commands from USART2 run in this task, between the button actions below
+	TMC_shell_init(&huart2);
+	TMC_shell_add_node(&htmc1);
+#if TMC_BENCH_ENABLED
+	// Cost of the driver hot paths in core cycles, compare with the numbers of the previous release
+	TMC_BenchResult bench_results[TMC_BENCH_COUNT];
+	TMC_bench_print(bench_results, TMC_bench_run(&htmc1, TMC_BENCH_ITERATIONS, bench_results));
+#endif
 
 	uint8_t trigger_counter = 0;
 	while (1)
@@ -35,31 +51,51 @@ void start_task_stepper_motors(void *argument)
 			switch (trigger_counter)
 			{
 				case 1:
-					data = read_access(&htmc1, R_GCONF, &recieved_data, &sent_read);
+					data = TMC_READ(&htmc1, GCONF);
 					break;
 				case 2:
-					data = read_access(&htmc1, R_SG_RESULT, &recieved_data, &sent_read);
+				{
+					// Reads overlap on the bus, task is free until it awaits them
+					TMC_ReadFuture status_reads[3];
+					TMC_read_async(&htmc1, R_SG_RESULT, &status_reads[0]);
+					TMC_read_async(&htmc1, R_TSTEP, &status_reads[1]);
+					TMC_read_async(&htmc1, R_DRV_STATUS, &status_reads[2]);
+					TMC_read_await_all(status_reads, 3);
+					data = status_reads[0].value;
 					break;
+				}
 				case 3:
 					TMC_set_speed_by_UART(&htmc1, -10.0f);
 					break;
 				case 4:
 					TMC_set_speed_by_UART(&htmc1, 0.0f);
 					break;
+				case 5:
+					// Quarter turn made by STEP pulses from TIM2, counted by TIM3
+					TMC_set_angle(&htmc1, 90);
+					break;
 				default:
 					trigger_counter = 0;
 					break;
 			}
 			printf("Current trigger_counter = %d", trigger_counter);
 		}
-		osDelay(10);
+		TMC_shell_wait(10);
 	}
 }
 
 
+/**
+ * \brief			Registers STEP/DIR engine: TIM2 CH1 (PA0) produces pulses, TIM3 counts them
+ */
+void TIM_STEPPER_Init(void)
+{
+	TMC_step_init(&htim2, &htim3, DIR_GPIO_Port, DIR_Pin);
+}
+
 /*
  * UART has to be configured in Single Wire (Half-Duplex) Mode
- * 		Baud Rate 		9600 Bits/s
+ * 		Baud Rate 		9600 Bits/s at start, TMC_link_bringup raises it later
  * 		Word Length		8 Bits (including parity)
  * 		Parity			None
  * 		Stop Bits		1
@@ -67,12 +103,7 @@ void start_task_stepper_motors(void *argument)
  */
 
 /*
- * TIM has to output PWM 50% duty cycle with varying Frequency,
- * also it has to be able to count pulses or pulse certain number of times
- *
- * Funkcja przyjmuje czestotliwosc i ilosc krokow
- * nastepnie ustawia timer z przerwaniami
- * uruchamia go
- * 	A w przerwaniach toggluje sie stepa
- * dopóki timer nie doliczy do zera
+ * TIM2 outputs PWM 50% duty cycle with varying frequency on STEP pin,
+ * its update event clocks TIM3 which counts pulses in hardware,
+ * so the CPU is interrupted only at the end of the move (or every 65536 steps)
  */
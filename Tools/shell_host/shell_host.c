@@ -0,0 +1,207 @@
+/*
+ * shell_host.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ *
+ * Linux stand-in for the board behind USART2, see shell.h and TMC2226_shell.h. Unmodified
+ * TMC2226_shell.c runs against simulated nodes of tmc_sim.h, its replies leave through
+ * TMC2226_stream.c as text frames of the binary stream, the same bytes the board sends
+ *
+ * Build:	gcc -O2 -pthread -I../tmc_sim -I../../Core/Inc -o shell_host shell_host.c \
+ * 			../tmc_sim/tmc_sim.c ../tmc_sim/sim_hal.c ../tmc_sim/sim_os.c ../../Core/Src/shell.c \
+ * 			../../Core/Src/TMC2226_shell.c ../../Core/Src/TMC2226_stream.c ../../Core/Src/TMC2226_telemetry.c \
+ * 			../../Core/Src/TMC2226.c ../../Core/Src/TMC2226_bus.c ../../Core/Src/TMC2226_step.c \
+ * 			../../Core/Src/TMC2226_motion.c ../../Core/Src/TMC2226_capture.c
+ * Pty:		./shell_host [-n nodes]			prints the pseudo terminal, talk to it with stream_decode -i
+ * Pipe:	./shell_host -c 7 - < script.txt | ../stream_decode/stream_decode -
+ *
+ * Commands are plain lines like on the board, replies are decoded by stream_decode only.
+ * Bytes go through the circular buffer of TMC_shell_init with the same half, full and idle
+ * events DMA reception produces, -c limits bytes per event so lines wrap around the buffer.
+ * -n puts nodes 0..n-1 on huart1, all of them polled by telemetry, node 0 has the step engine.
+ * rtos answers "err no sample yet", FreeRTOS task lists do not exist here
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "TMC2226.h"
+#include "TMC2226_shell.h"
+#include "TMC2226_stream.h"
+#include "TMC2226_telemetry.h"
+#include "rtos_stats.h"
+#include "tmc_sim.h"
+/* Last, its CR1..CR3 macros would rename USART_TypeDef fields */
+#include <termios.h>
+
+static TMC_SimNode sim_nodes[TMC_SIM_LINE_NODES];
+static TMC_HandleTypeDef handles[TMC_SIM_LINE_NODES];
+
+/* stdout backend, same as _write of main.c */
+static ssize_t stdout_write(void* cookie, const char* data, size_t length)
+{
+	(void)cookie;
+	TMC_stream_write_text((const uint8_t*)data, (uint32_t)length);
+	return (ssize_t)length;
+}
+
+/* rtos_stats.c walks FreeRTOS task lists, the simulation has none, so there is never a sample */
+void rtos_stats_get(RtosStatsSnapshot* snapshot)
+{
+	memset(snapshot, 0, sizeof(RtosStatsSnapshot));
+}
+
+void rtos_stats_print(const RtosStatsSnapshot* snapshot)
+{
+	(void)snapshot;
+}
+
+/* Callbacks as main.c routes them */
+void HAL_UART_TxHalfCpltCallback(UART_HandleTypeDef* huart)
+{
+	TMC_stream_TxHalfCpltCallback(huart);
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart)
+{
+	TMC_bus_TxCpltCallback(huart);
+	TMC_stream_TxCpltCallback(huart);
+}
+
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart)
+{
+	TMC_bus_RxCpltCallback(huart);
+}
+
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef* huart, uint16_t size)
+{
+	TMC_shell_RxEventCallback(huart, size);
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart)
+{
+	TMC_bus_ErrorCallback(huart);
+	TMC_shell_ErrorCallback(huart);
+}
+
+static void telemetry_thread(void* argument)
+{
+	(void)argument;
+	TMC_telemetry_run();
+}
+
+static int open_pty(void)
+{
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+	{
+		perror("posix_openpt");
+		return -1;
+	}
+	const char* name = ptsname(master);
+	// Slave stays open here so the master does not see hang up between two clients
+	int slave = open(name, O_RDWR | O_NOCTTY);
+	struct termios tty;
+	if (slave < 0 || tcgetattr(slave, &tty) != 0)
+	{
+		perror(name);
+		return -1;
+	}
+	cfmakeraw(&tty);
+	tcsetattr(slave, TCSANOW, &tty);
+	fprintf(stderr, "shell on %s\n", name);
+	return master;
+}
+
+int main(int argc, char** argv)
+{
+	size_t chunk = TMC_SHELL_RX_SIZE;
+	unsigned long node_count = 1;
+	int option;
+	while ((option = getopt(argc, argv, "c:n:")) != -1)
+	{
+		unsigned long value = (optarg != NULL) ? strtoul(optarg, NULL, 10) : 0;
+		if (option == 'c' && value != 0)
+		{
+			chunk = value;
+		}
+		else if (option == 'n' && value != 0 && value <= TMC_SIM_LINE_NODES)
+		{
+			node_count = value;
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [-c bytes per event] [-n nodes] [-]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	int in = STDIN_FILENO;
+	int out = STDOUT_FILENO;
+	if (optind == argc || strcmp(argv[optind], "-") != 0)
+	{
+		in = out = open_pty();
+		if (in < 0)
+		{
+			return 1;
+		}
+	}
+	tmc_sim_console_attach(&huart2, out);
+	TMC_stream_init(&huart2);
+	stdout = fopencookie(NULL, "w", (cookie_io_functions_t){ .write = stdout_write });
+	setvbuf(stdout, NULL, _IOLBF, TMC_STREAM_MAX_PAYLOAD);
+
+	// Wire time is real, slack keeps host scheduling jitter from failing transfers like in tmc_sim_run
+	tmc_sim_os_set_timeouts(1.0, 50);
+	TMC_step_init(&htim2, &htim3, GPIOA, GPIO_PIN_5);
+	for (uint8_t i = 0; i < node_count; i++)
+	{
+		tmc_sim_node_init(&sim_nodes[i], i);
+		tmc_sim_line_attach(&huart1, &sim_nodes[i]);
+		TMC_Init(&handles[i], i, (i == 0) ? &htim2 : NULL, &huart1, 200);
+		TMC_telemetry_add(&handles[i]);
+	}
+	osThreadNew(telemetry_thread, NULL, NULL);
+
+	// This thread is the shell thread, it executes every line as soon as its bytes arrived
+	TMC_shell_init(&huart2);
+	for (uint8_t i = 0; i < node_count; i++)
+	{
+		TMC_shell_add_node(&handles[i]);
+	}
+
+	uint8_t data[512];
+	ssize_t received;
+	while ((received = read(in, data, sizeof(data))) != 0)
+	{
+		if (received < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			perror("read");
+			return 1;
+		}
+		for (size_t offset = 0; offset < (size_t)received; offset += chunk)
+		{
+			size_t count = ((size_t)received - offset < chunk) ? (size_t)received - offset : chunk;
+			tmc_sim_console_receive(&huart2, &data[offset], (uint16_t)count);
+			TMC_shell_poll();
+		}
+	}
+
+	fflush(stdout);
+	tmc_sim_console_drain(&huart2);
+	ShellStats stats;
+	TMC_shell_get_stats(&stats);
+	fprintf(stderr, "%u lines, %u failed, %u dropped, %u overruns\n",
+			stats.lines, stats.failed, stats.dropped, stats.overruns);
+	return 0;
+}
@@ -0,0 +1,632 @@
+/*
+ * stream_decode.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ *
+ * Linux decoder of the binary stream sent on USART2, see TMC2226_stream_protocol.h
+ *
+ * Build:	gcc -O2 -I../../Core/Inc -o stream_decode stream_decode.c
+ * Live:	./stream_decode -b 460800 -w capture_log.bin /dev/ttyACM0
+ * Shell:	./stream_decode -i /dev/ttyACM0
+ * Replay:	./stream_decode capture_log.bin
+ * Bus:		./stream_decode -p bus.pcap capture_log.bin
+ * Pipe:	../shell_host/shell_host - < script.txt | ./stream_decode -
+ *
+ * Capture holds raw bytes exactly as received, so it replays through the same decoder.
+ * -i sends lines typed on stdin to the tty as they are, the shell of TMC2226_shell.h takes
+ * commands as plain text and answers in text frames, which come out here like any other frame.
+ *
+ * Records of the bus capture ring (shell command capture) are printed one per line and summed
+ * up at the end: latency of every read register from the end of the request to the end of the
+ * reply, and share of time every bus spent carrying datagrams. Records sent again by a later
+ * dump are recognised by their index and skipped. Cycle counter wraps every ~67 s at 64 MHz,
+ * records further apart than that are placed too close together.
+ *
+ * -p writes the records as pcap with link type USER0 (147), every packet is event, bus, node,
+ * register byte followed by the datagram as it travelled, timestamps start at the first record.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "TMC2226_stream_protocol.h"
+#include "TMC2226_registers.h"
+
+static uint8_t crc_table[256];
+
+static struct {
+	unsigned long frames;
+	unsigned long crc_errors;
+	unsigned long malformed;
+	unsigned long lost;
+	int have_sequence[1u << (8u - TMC_STREAM_CHANNEL_SHIFT)];
+	uint8_t next_sequence[1u << (8u - TMC_STREAM_CHANNEL_SHIFT)];
+} totals;
+
+/* Latency of replies to one read register */
+typedef struct {
+	unsigned long reads;
+	unsigned long failures;						/* Wrong CRC, timeout or line error instead of reply */
+	unsigned long writes;
+	double total_us;
+	double min_us;
+	double max_us;
+} RegisterStats;
+
+/* Read request waiting for its reply and wire time of one bus */
+typedef struct {
+	int request_pending;
+	uint8_t request_register;
+	uint64_t request_cycles;
+	double wire_us;
+	uint64_t first_cycles;
+	uint64_t last_cycles;
+	int seen;
+} BusState;
+
+#define CAPTURE_MAX_BUSES		8
+#define LINKTYPE_USER0			147u
+
+static struct {
+	unsigned long records;
+	unsigned long overwritten;					/* Records overwritten in the ring before they were dumped */
+	int have_index;
+	uint32_t next_index;
+	int have_cycles;
+	uint32_t last_cycles;
+	uint64_t cycles;							/* Cycle counter extended beyond 32 bits */
+	uint64_t first_cycles;
+	uint8_t clock_mhz;
+	RegisterStats registers[128];
+	BusState buses[CAPTURE_MAX_BUSES];
+	FILE* pcap;
+} capture_log;
+
+static void build_crc_table(void)
+{
+	for (int i = 0; i < 256; i++)
+	{
+		uint8_t crc = (uint8_t)i;
+		for (int bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+		}
+		crc_table[i] = crc;
+	}
+}
+
+static speed_t baud_constant(unsigned long baud)
+{
+	switch (baud)
+	{
+		case 9600: return B9600;
+		case 19200: return B19200;
+		case 57600: return B57600;
+		case 115200: return B115200;
+		case 230400: return B230400;
+		case 460800: return B460800;
+		case 921600: return B921600;
+		default: return 0;
+	}
+}
+
+static int configure_tty(int fd, unsigned long baud)
+{
+	struct termios tty;
+	speed_t speed = baud_constant(baud);
+	if (speed == 0)
+	{
+		fprintf(stderr, "unsupported baud rate %lu\n", baud);
+		return -1;
+	}
+	if (tcgetattr(fd, &tty) != 0)
+	{
+		perror("tcgetattr");
+		return -1;
+	}
+	cfmakeraw(&tty);
+	cfsetispeed(&tty, speed);
+	cfsetospeed(&tty, speed);
+	tty.c_cc[VMIN] = 1;
+	tty.c_cc[VTIME] = 0;
+	if (tcsetattr(fd, TCSANOW, &tty) != 0)
+	{
+		perror("tcsetattr");
+		return -1;
+	}
+	return 0;
+}
+
+/* Reverses COBS in place, returns decoded length or -1 when the frame is malformed */
+static int cobs_decode(uint8_t* data, int length)
+{
+	int in = 0;
+	int out = 0;
+	while (in < length)
+	{
+		uint8_t code = data[in++];
+		if (code == 0 || in + code - 1 > length)
+		{
+			return -1;
+		}
+		for (int i = 1; i < code; i++)
+		{
+			data[out++] = data[in++];
+		}
+		if (code != 0xFF && in < length)
+		{
+			data[out++] = 0;
+		}
+	}
+	return out;
+}
+
+static uint32_t get_u32(const uint8_t* p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void print_telemetry(const uint8_t* payload, int length)
+{
+	if (length != TMC_STREAM_TELEMETRY_LENGTH)
+	{
+		totals.malformed++;
+		return;
+	}
+	const uint8_t* values = &payload[TMC_STREAM_TELEMETRY_VALUES];
+	uint32_t drv_status = get_u32(&values[8]);
+	printf("%10u ms node %u fresh %X  sg %4u  tstep %7u  mscnt %4u  cs %2u%s%s%s%s%s\n",
+			get_u32(&payload[TMC_STREAM_TELEMETRY_TIMESTAMP]),
+			payload[TMC_STREAM_TELEMETRY_NODE], payload[TMC_STREAM_TELEMETRY_FRESH],
+			get_u32(&values[0]), get_u32(&values[4]), get_u32(&values[12]),
+			TMC_drv_status_cs_actual(drv_status),
+			(drv_status & TMC_DRV_STATUS_STST_Msk) ? " stst" : "",
+			(drv_status & TMC_DRV_STATUS_STEALTH_Msk) ? " stealth" : "",
+			(drv_status & TMC_DRV_STATUS_OTPW_Msk) ? " otpw" : "",
+			TMC_drv_status_fault(drv_status) ? " FAULT" : "",
+			(drv_status & (TMC_DRV_STATUS_OLA_Msk | TMC_DRV_STATUS_OLB_Msk)) ? " open-load" : "");
+}
+
+static const char* capture_event_name(uint8_t event)
+{
+	switch (event)
+	{
+		case TMC_CAPTURE_TX: return "tx";
+		case TMC_CAPTURE_RX: return "rx";
+		case TMC_CAPTURE_RX_CRC: return "rx-crc";
+		case TMC_CAPTURE_TIMEOUT: return "timeout";
+		case TMC_CAPTURE_LINE_ERROR: return "error";
+		case TMC_CAPTURE_BAUD: return "baud";
+		default: return "?";
+	}
+}
+
+static void put_le(uint8_t* p, uint32_t value)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		p[i] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+static void write_pcap_header(FILE* pcap)
+{
+	uint8_t header[24] = { 0 };
+	put_le(&header[0], 0xA1B2C3D4u);
+	header[4] = 2;								/* Version 2.4 */
+	header[6] = 4;
+	put_le(&header[16], 64u);					/* Snap length */
+	put_le(&header[20], LINKTYPE_USER0);
+	fwrite(header, 1, sizeof(header), pcap);
+}
+
+/* Datagram as it travelled: sync, node or master address, register, data and CRC */
+static void write_pcap_record(const uint8_t* record, double seconds)
+{
+	uint8_t packet[4 + 8];
+	int length = 0;
+	uint8_t datagram_length = record[14];
+	uint32_t data = get_u32(&record[4]);
+	packet[length++] = record[10];
+	packet[length++] = record[11];
+	packet[length++] = record[12];
+	packet[length++] = record[13];
+	if (datagram_length == 4 || datagram_length == 8)
+	{
+		int reply = (record[10] == TMC_CAPTURE_RX || record[10] == TMC_CAPTURE_RX_CRC);
+		packet[length++] = 0x05;
+		packet[length++] = reply ? 0xFF : record[12];
+		packet[length++] = record[13];
+		if (datagram_length == 8)
+		{
+			for (int i = 3; i >= 0; i--)
+			{
+				packet[length++] = (uint8_t)(data >> (8 * i));
+			}
+		}
+		packet[length++] = record[15];
+	}
+
+	uint8_t header[16];
+	put_le(&header[0], (uint32_t)seconds);
+	put_le(&header[4], (uint32_t)((seconds - (uint32_t)seconds) * 1e6));
+	put_le(&header[8], (uint32_t)length);
+	put_le(&header[12], (uint32_t)length);
+	fwrite(header, 1, sizeof(header), capture_log.pcap);
+	fwrite(packet, 1, length, capture_log.pcap);
+}
+
+static void account_capture_record(const uint8_t* record, uint64_t cycles)
+{
+	uint8_t event = record[10];
+	uint8_t length = record[14];
+	uint32_t baud_rate = ((uint32_t)record[8] | ((uint32_t)record[9] << 8)) * 100u;
+	uint8_t register_address = record[13] & 0x7F;
+	BusState* bus = &capture_log.buses[record[11] % CAPTURE_MAX_BUSES];
+	RegisterStats* stats = &capture_log.registers[register_address];
+
+	if (!bus->seen)
+	{
+		bus->first_cycles = cycles;
+		bus->seen = 1;
+	}
+	bus->last_cycles = cycles;
+	if (length != 0 && baud_rate != 0)
+	{
+		bus->wire_us += 10.0 * length * 1e6 / baud_rate;
+	}
+
+	switch (event)
+	{
+		case TMC_CAPTURE_TX:
+			if (record[13] & 0x80)
+			{
+				stats->writes++;
+				bus->request_pending = 0;
+			}
+			else
+			{
+				bus->request_pending = 1;
+				bus->request_register = register_address;
+				bus->request_cycles = cycles;
+			}
+			break;
+		case TMC_CAPTURE_RX:
+			if (bus->request_pending && bus->request_register == register_address)
+			{
+				double latency_us = (double)(cycles - bus->request_cycles) / capture_log.clock_mhz;
+				if (stats->reads == 0 || latency_us < stats->min_us)
+				{
+					stats->min_us = latency_us;
+				}
+				if (latency_us > stats->max_us)
+				{
+					stats->max_us = latency_us;
+				}
+				stats->total_us += latency_us;
+				stats->reads++;
+			}
+			bus->request_pending = 0;
+			break;
+		case TMC_CAPTURE_RX_CRC:
+		case TMC_CAPTURE_TIMEOUT:
+		case TMC_CAPTURE_LINE_ERROR:
+			if (bus->request_pending && bus->request_register == register_address)
+			{
+				stats->failures++;
+			}
+			bus->request_pending = 0;
+			break;
+		default:
+			break;
+	}
+}
+
+static void print_capture(const uint8_t* payload, int length)
+{
+	if (length < (int)TMC_STREAM_CAPTURE_RECORDS || payload[TMC_STREAM_CAPTURE_CLOCK_MHZ] == 0
+			|| length != (int)(TMC_STREAM_CAPTURE_RECORDS
+					+ payload[TMC_STREAM_CAPTURE_COUNT] * TMC_STREAM_CAPTURE_RECORD_LENGTH))
+	{
+		totals.malformed++;
+		return;
+	}
+	capture_log.clock_mhz = payload[TMC_STREAM_CAPTURE_CLOCK_MHZ];
+	uint32_t index = get_u32(&payload[TMC_STREAM_CAPTURE_INDEX]);
+	for (int i = 0; i < payload[TMC_STREAM_CAPTURE_COUNT]; i++, index++)
+	{
+		const uint8_t* record = &payload[TMC_STREAM_CAPTURE_RECORDS + i * TMC_STREAM_CAPTURE_RECORD_LENGTH];
+		if (capture_log.have_index && (int32_t)(index - capture_log.next_index) < 0)
+		{
+			continue;
+		}
+		if (capture_log.have_index && index != capture_log.next_index)
+		{
+			capture_log.overwritten += index - capture_log.next_index;
+			printf("-- %u capture record(s) overwritten before the dump\n", index - capture_log.next_index);
+		}
+		capture_log.have_index = 1;
+		capture_log.next_index = index + 1;
+		capture_log.records++;
+
+		uint32_t cycles = get_u32(&record[0]);
+		if (!capture_log.have_cycles)
+		{
+			capture_log.first_cycles = cycles;
+			capture_log.cycles = cycles;
+			capture_log.have_cycles = 1;
+		}
+		else
+		{
+			capture_log.cycles += (uint32_t)(cycles - capture_log.last_cycles);
+		}
+		capture_log.last_cycles = cycles;
+		double seconds = (double)(capture_log.cycles - capture_log.first_cycles) / (capture_log.clock_mhz * 1e6);
+
+		uint32_t baud_rate = ((uint32_t)record[8] | ((uint32_t)record[9] << 8)) * 100u;
+		if (record[10] == TMC_CAPTURE_BAUD)
+		{
+			printf("%12.6f s  #%-6u bus %u  baud %u\n", seconds, index, record[11], baud_rate);
+		}
+		else
+		{
+			printf("%12.6f s  #%-6u bus %u  node %u  %-7s reg 0x%02X %c", seconds, index, record[11], record[12],
+					capture_event_name(record[10]), record[13] & 0x7F, (record[13] & 0x80) ? 'w' : 'r');
+			if (record[14] == 8)
+			{
+				printf("  data 0x%08X", get_u32(&record[4]));
+			}
+			if (record[14] != 0)
+			{
+				printf("  crc 0x%02X  %u B", record[15], record[14]);
+			}
+			printf("\n");
+		}
+		account_capture_record(record, capture_log.cycles);
+		if (capture_log.pcap != NULL)
+		{
+			write_pcap_record(record, seconds);
+		}
+	}
+}
+
+static void print_capture_summary(void)
+{
+	if (capture_log.records == 0)
+	{
+		return;
+	}
+	printf("-- capture %lu records, %lu overwritten before dump\n", capture_log.records, capture_log.overwritten);
+	printf("-- register   reads  failed  mean us   min us   max us  writes\n");
+	for (int r = 0; r < 128; r++)
+	{
+		const RegisterStats* stats = &capture_log.registers[r];
+		if (stats->reads == 0 && stats->failures == 0 && stats->writes == 0)
+		{
+			continue;
+		}
+		printf("-- 0x%02X     %7lu %7lu %8.1f %8.1f %8.1f %7lu\n", r, stats->reads, stats->failures,
+				stats->reads ? stats->total_us / stats->reads : 0.0, stats->min_us, stats->max_us, stats->writes);
+	}
+	for (int b = 0; b < CAPTURE_MAX_BUSES; b++)
+	{
+		const BusState* bus = &capture_log.buses[b];
+		if (!bus->seen)
+		{
+			continue;
+		}
+		double span_us = (double)(bus->last_cycles - bus->first_cycles) / capture_log.clock_mhz;
+		printf("-- bus %d  %.1f ms captured, %.1f ms on the wire, %.1f%% utilised\n", b, span_us / 1000.0,
+				bus->wire_us / 1000.0, (span_us > 0.0) ? 100.0 * bus->wire_us / span_us : 0.0);
+	}
+}
+
+static void handle_frame(uint8_t* data, int length)
+{
+	length = cobs_decode(data, length);
+	if (length < (int)TMC_STREAM_FRAME_OVERHEAD)
+	{
+		totals.malformed++;
+		return;
+	}
+
+	uint8_t crc = 0;
+	for (int i = 0; i < length - 1; i++)
+	{
+		crc = crc_table[crc ^ data[i]];
+	}
+	if (crc != data[length - 1])
+	{
+		totals.crc_errors++;
+		return;
+	}
+
+	// Sequence counts frames of one channel, channels interleave freely
+	uint8_t channel = data[0] >> TMC_STREAM_CHANNEL_SHIFT;
+	uint8_t sequence = data[1];
+	if (totals.have_sequence[channel] && sequence != totals.next_sequence[channel])
+	{
+		uint8_t gap = (uint8_t)(sequence - totals.next_sequence[channel]);
+		totals.lost += gap;
+		printf("-- %u frame(s) lost on channel %u\n", gap, channel);
+	}
+	totals.have_sequence[channel] = 1;
+	totals.next_sequence[channel] = sequence + 1;
+	totals.frames++;
+
+	const uint8_t* payload = &data[2];
+	int payload_length = length - TMC_STREAM_FRAME_OVERHEAD;
+	switch (data[0] & TMC_STREAM_TYPE_MASK)
+	{
+		case TMC_STREAM_FRAME_TEXT:
+			fwrite(payload, 1, payload_length, stdout);
+			break;
+		case TMC_STREAM_FRAME_TELEMETRY:
+			print_telemetry(payload, payload_length);
+			break;
+		case TMC_STREAM_FRAME_CAPTURE:
+			print_capture(payload, payload_length);
+			break;
+		default:
+			printf("-- unknown frame type 0x%02X, %d bytes\n", data[0], payload_length);
+			break;
+	}
+}
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "usage: %s [-b baud] [-w capture] [-p pcap] [-i] <tty, capture file or - for stdin>\n", name);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned long baud = 460800;
+	const char* capture_path = NULL;
+	const char* pcap_path = NULL;
+	int interactive = 0;
+	int option;
+	while ((option = getopt(argc, argv, "b:w:p:i")) != -1)
+	{
+		switch (option)
+		{
+			case 'b':
+				baud = strtoul(optarg, NULL, 10);
+				break;
+			case 'w':
+				capture_path = optarg;
+				break;
+			case 'p':
+				pcap_path = optarg;
+				break;
+			case 'i':
+				interactive = 1;
+				break;
+			default:
+				usage(argv[0]);
+				return 2;
+		}
+	}
+	if (optind != argc - 1)
+	{
+		usage(argv[0]);
+		return 2;
+	}
+
+	int fd = STDIN_FILENO;
+	if (strcmp(argv[optind], "-") == 0)
+	{
+		interactive = 0;
+	}
+	else if ((fd = open(argv[optind], (interactive ? O_RDWR : O_RDONLY) | O_NOCTTY)) < 0)
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+	if (isatty(fd) && configure_tty(fd, baud) != 0)
+	{
+		return 1;
+	}
+	FILE* capture = NULL;
+	if (capture_path != NULL && (capture = fopen(capture_path, "wb")) == NULL)
+	{
+		perror(capture_path);
+		return 1;
+	}
+	if (pcap_path != NULL)
+	{
+		if ((capture_log.pcap = fopen(pcap_path, "wb")) == NULL)
+		{
+			perror(pcap_path);
+			return 1;
+		}
+		write_pcap_header(capture_log.pcap);
+	}
+	build_crc_table();
+
+	// Bytes before the first delimiter may be the tail of a frame, they fail CRC and are skipped
+	uint8_t frame[TMC_STREAM_MAX_ENCODED];
+	int frame_length = 0;
+	int overflow = 0;
+	uint8_t chunk[4096];
+	ssize_t received;
+	struct pollfd sources[2] = { { .fd = fd, .events = POLLIN }, { .fd = STDIN_FILENO, .events = POLLIN } };
+	while (1)
+	{
+		if (interactive && poll(sources, 2, -1) > 0 && sources[1].revents != 0)
+		{
+			// Typed line goes to the shell, replies arrive as frames of the stream
+			received = read(STDIN_FILENO, chunk, sizeof(chunk));
+			if (received <= 0 || write(fd, chunk, received) != received)
+			{
+				interactive = 0;
+			}
+			if (!(sources[0].revents & (POLLIN | POLLHUP)))
+			{
+				continue;
+			}
+		}
+		if ((received = read(fd, chunk, sizeof(chunk))) == 0)
+		{
+			break;
+		}
+		if (received < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			perror("read");
+			break;
+		}
+		if (capture != NULL)
+		{
+			fwrite(chunk, 1, received, capture);
+		}
+		for (ssize_t i = 0; i < received; i++)
+		{
+			if (chunk[i] == 0x00)
+			{
+				if (overflow)
+				{
+					totals.malformed++;
+				}
+				else if (frame_length != 0)
+				{
+					handle_frame(frame, frame_length);
+				}
+				frame_length = 0;
+				overflow = 0;
+			}
+			else if (frame_length < (int)sizeof(frame))
+			{
+				frame[frame_length++] = chunk[i];
+			}
+			else
+			{
+				overflow = 1;
+			}
+		}
+		fflush(stdout);
+	}
+
+	if (capture != NULL)
+	{
+		fclose(capture);
+	}
+	if (capture_log.pcap != NULL)
+	{
+		fclose(capture_log.pcap);
+	}
+	close(fd);
+	print_capture_summary();
+	fprintf(stderr, "%lu frames, %lu lost, %lu CRC errors, %lu malformed\n",
+			totals.frames, totals.lost, totals.crc_errors, totals.malformed);
+	return 0;
+}
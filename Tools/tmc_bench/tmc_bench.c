@@ -0,0 +1,359 @@
+/*
+ * tmc_bench.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ *
+ * Host build of the TMC2226_bench.h suite, against the stub HAL and simulated node of Tools/tmc_sim
+ *
+ * Build:	gcc -O2 -pthread -I../tmc_sim -I../../Core/Inc -o tmc_bench tmc_bench.c \
+ * 			../tmc_sim/tmc_sim.c ../tmc_sim/sim_hal.c ../tmc_sim/sim_os.c ../../Core/Src/TMC2226_bench.c \
+ * 			../../Core/Src/TMC2226.c ../../Core/Src/TMC2226_bus.c ../../Core/Src/TMC2226_step.c \
+ * 			../../Core/Src/TMC2226_motion.c ../../Core/Src/TMC2226_capture.c
+ * Run:		./tmc_bench [-n iterations] [-r repeats] [-c baseline.txt] [-t percent] > current.txt
+ *
+ * Simulated line has no wire time, read_access shows the software path alone. Suite runs
+ * -r times (default 5) and the fastest run of every path is kept, which filters most of
+ * the host scheduling noise. Output of a release kept as baseline, -c compares against it
+ * and exits with 1 when a path got more than -t percent (default 20) and at least 1 ns
+ * slower, or when any path allocates. Target runs the same suite with TMC_BENCH_ENABLED=1
+ * and prints core cycles on USART2
+ *
+ * Host only checks follow the suite, each against the implementation the driver replaced:
+ * calculate_CRC against the bitwise loop over random 4 and 8 byte datagrams, with cycles/byte
+ * of both, and mrpm_to_vactual against the float formula for every MRES over the whole
+ * int32 milli-rpm range, clamped speeds and a motor whose factor would overflow Q24 included,
+ * with ns/call of both. Difference above VACTUAL_TOLERANCE LSB or any CRC difference makes
+ * the exit status 1
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "TMC2226.h"
+#include "TMC2226_bench.h"
+#include "cycle_counter.h"
+#include "tmc_sim.h"
+
+/* Random datagrams of each length checked against the reference CRC */
+#define CRC_CHECK_DATAGRAMS		1000000u
+
+/* Largest allowed difference between integer and float VACTUAL, float keeps only 24 bits */
+#define VACTUAL_TOLERANCE		2
+
+/* Full steps per turn of the motors swept, the last one would overflow Q24 at 1/256 */
+static const uint16_t vactual_check_motors[] = { 200, 400, 65535 };
+
+static TMC_HandleTypeDef htmc;
+static TMC_SimNode node;
+/* Keeps results of the reference implementations alive */
+static volatile uint32_t check_sink;
+
+/* CRC8 as the driver computed it before the lookup table, bit by bit LSB first, datasheet code */
+static uint8_t reference_crc(const uint8_t* datagram, uint8_t datagram_length)
+{
+	uint8_t crc = 0;
+	for (uint8_t i = 0; i < (datagram_length - 1); i++)
+	{
+		uint8_t current_byte = datagram[i];
+		for (uint8_t j = 0; j < 8; j++)
+		{
+			if ((crc >> 7) ^ (current_byte & 0x01))
+			{
+				crc = (crc << 1) ^ 0x07;
+			}
+			else
+			{
+				crc = (crc << 1);
+			}
+			current_byte = current_byte >> 1;
+		}
+	}
+	return crc;
+}
+
+/* Cycles per CRC byte of both implementations, datagram changes every call so nothing is hoisted */
+static void time_crc(uint32_t iterations)
+{
+	uint8_t datagram[8] = { TMC2226_SYNC, 0x00, W_GCONF | TMC2226_WRITE, 0x00, 0x00, 0x01, 0xE1, 0x00 };
+	uint32_t bytes = iterations * (sizeof(datagram) - 1);
+
+	uint32_t start = cycle_counter_get();
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		datagram[6] = (uint8_t)i;
+		check_sink = reference_crc(datagram, sizeof(datagram));
+	}
+	uint32_t bitwise = cycle_counter_get() - start;
+
+	start = cycle_counter_get();
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		datagram[6] = (uint8_t)i;
+		check_sink = calculate_CRC(datagram, sizeof(datagram));
+	}
+	uint32_t table = cycle_counter_get() - start;
+
+	printf("%-24s %9.2f cycles/byte\n", "crc_bitwise", (double)bitwise / bytes);
+	printf("%-24s %9.2f cycles/byte\n", "crc_table", (double)table / bytes);
+}
+
+/*
+ * VACTUAL as TMC_set_speed_by_UART computed it before the fixed point factor, 0.715 microsteps/s per LSB,
+ * clamped to 24 bit signed range the way the integer path does it
+ */
+static int32_t reference_vactual(uint16_t steps_per_turn, TMC2226_MRES_steps resolution, int32_t milli_rpm)
+{
+	float rpm_speed = milli_rpm / 60000.0f;
+	float FSC_x_USC = steps_per_turn * (1 << (8 - resolution));
+	float vactual_speed = (rpm_speed * FSC_x_USC / 0.715f);
+	if (vactual_speed > TMC_VACTUAL_MAX)
+	{
+		return TMC_VACTUAL_MAX;
+	}
+	if (vactual_speed < -TMC_VACTUAL_MAX)
+	{
+		return -TMC_VACTUAL_MAX;
+	}
+	return (int32_t)vactual_speed;
+}
+
+/* ns per conversion of both versions, full sweep of speeds of one motor */
+static void time_vactual(uint32_t iterations)
+{
+	TMC_HandleTypeDef handle = { .engine_steps_per_full_turn = 200, .microstep_resolution = uSteps_16 };
+	update_vactual_scale(&handle);
+
+	uint32_t start = cycle_counter_get();
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		check_sink = reference_vactual(200, uSteps_16, (int32_t)(i * 977u) - 5000000);
+	}
+	uint32_t float_cycles = cycle_counter_get() - start;
+
+	start = cycle_counter_get();
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		check_sink = mrpm_to_vactual(&handle, (int32_t)(i * 977u) - 5000000);
+	}
+	uint32_t integer_cycles = cycle_counter_get() - start;
+
+	double ns_per_cycle = 1e9 / SystemCoreClock;
+	printf("%-24s %9.2f ns/call\n", "vactual_float", ns_per_cycle * float_cycles / iterations);
+	printf("%-24s %9.2f ns/call\n", "vactual_fixed", ns_per_cycle * integer_cycles / iterations);
+}
+
+/*
+ * Returns number of speeds where mrpm_to_vactual is more than VACTUAL_TOLERANCE off the float
+ * formula. Speed step grows with magnitude, so small speeds are dense and the sweep still
+ * reaches both ends of int32 where every MRES is clamped
+ */
+static uint32_t check_vactual(void)
+{
+	uint32_t mismatches = 0;
+	uint32_t checked = 0;
+	uint32_t clamped = 0;
+	int32_t worst = 0;
+	for (uint8_t m = 0; m < sizeof(vactual_check_motors) / sizeof(vactual_check_motors[0]); m++)
+	{
+		for (uint8_t resolution = uSteps_256; resolution <= fullStep; resolution++)
+		{
+			TMC_HandleTypeDef handle = {
+				.engine_steps_per_full_turn = vactual_check_motors[m],
+				.microstep_resolution = (TMC2226_MRES_steps)resolution
+			};
+			update_vactual_scale(&handle);
+			uint64_t magnitude = 0;
+			while (magnitude <= INT32_MAX)
+			{
+				for (int8_t sign = 1; sign >= -1; sign -= 2)
+				{
+					int32_t milli_rpm = sign * (int32_t)magnitude;
+					int32_t expected = reference_vactual(handle.engine_steps_per_full_turn, handle.microstep_resolution,
+							milli_rpm);
+					int32_t vactual = mrpm_to_vactual(&handle, milli_rpm);
+					int32_t difference = (vactual > expected) ? vactual - expected : expected - vactual;
+					checked++;
+					clamped += (expected == TMC_VACTUAL_MAX || expected == -TMC_VACTUAL_MAX);
+					if (difference > worst)
+					{
+						worst = difference;
+					}
+					if (difference > VACTUAL_TOLERANCE && mismatches++ < 5)
+					{
+						fprintf(stderr, "vactual of %u steps/turn MRES %u at %ld mrpm is %ld, float %ld\n",
+								handle.engine_steps_per_full_turn, resolution, (long)milli_rpm, (long)vactual,
+								(long)expected);
+					}
+				}
+				magnitude += 1 + magnitude / 4096;
+			}
+			// Sweep steps over the very ends of the range, every MRES is clamped there
+			checked += 2;
+			if (mrpm_to_vactual(&handle, INT32_MAX) != TMC_VACTUAL_MAX
+					|| mrpm_to_vactual(&handle, INT32_MIN + 1) != -TMC_VACTUAL_MAX)
+			{
+				fprintf(stderr, "vactual of %u steps/turn MRES %u is not clamped at the ends of int32\n",
+						handle.engine_steps_per_full_turn, resolution);
+				mismatches++;
+			}
+		}
+	}
+	printf("%-24s %9u speeds, %u clamped, worst %ld LSB, %u mismatches\n", "vactual_equivalence", checked,
+			clamped, (long)worst, mismatches);
+	return mismatches;
+}
+
+/* Returns number of random datagrams whose CRC differs from the bitwise reference */
+static uint32_t check_crc(void)
+{
+	uint32_t mismatches = 0;
+	uint8_t datagram[8];
+	srand(1);
+	for (uint32_t i = 0; i < 2 * CRC_CHECK_DATAGRAMS; i++)
+	{
+		uint8_t length = (i & 1u) ? 8 : 4;
+		for (uint8_t j = 0; j < length; j++)
+		{
+			datagram[j] = (uint8_t)rand();
+		}
+		uint8_t expected = reference_crc(datagram, length);
+		uint8_t crc = calculate_CRC(datagram, length);
+		if (crc != expected)
+		{
+			if (mismatches++ < 5)
+			{
+				fprintf(stderr, "crc of %u byte datagram %02X %02X %02X ... is 0x%02X, reference 0x%02X\n",
+						length, datagram[0], datagram[1], datagram[2], crc, expected);
+			}
+		}
+	}
+	printf("%-24s %9u datagrams, %u mismatches\n", "crc_equivalence", 2 * CRC_CHECK_DATAGRAMS, mismatches);
+	return mismatches;
+}
+
+/* Looks name up in baseline file, same format as the output, returns 0 when it is not there */
+static uint8_t baseline_ns(FILE* baseline, const char* name, double* ns)
+{
+	char line[160];
+	char baseline_name[64];
+	rewind(baseline);
+	while (fgets(line, sizeof(line), baseline) != NULL)
+	{
+		if (sscanf(line, "%63s %lf", baseline_name, ns) == 2 && strcmp(baseline_name, name) == 0)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t iterations = 10000;
+	uint32_t repeats = 5;
+	const char* baseline_path = NULL;
+	double tolerance = 20.0;
+	int option;
+	while ((option = getopt(argc, argv, "n:r:c:t:")) != -1)
+	{
+		switch (option)
+		{
+			case 'n':
+				iterations = strtoul(optarg, NULL, 0);
+				break;
+			case 'r':
+				repeats = strtoul(optarg, NULL, 0);
+				break;
+			case 'c':
+				baseline_path = optarg;
+				break;
+			case 't':
+				tolerance = strtod(optarg, NULL);
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-n iterations] [-r repeats] [-c baseline.txt] [-t percent]\n", argv[0]);
+				return 2;
+		}
+	}
+	if (iterations == 0 || repeats == 0)
+	{
+		fprintf(stderr, "iterations and repeats have to be above 0\n");
+		return 2;
+	}
+
+	tmc_sim_node_init(&node, TMC2226_ADDR_0);
+	tmc_sim_line_set_time_scale(0.0);
+	tmc_sim_line_attach(&huart1, &node);
+	TMC_Init(&htmc, TMC2226_ADDR_0, &htim2, &huart1, 200);
+
+	TMC_BenchResult results[TMC_BENCH_COUNT];
+	TMC_BenchResult run[TMC_BENCH_COUNT];
+	uint8_t count = TMC_bench_run(&htmc, iterations, results);
+	for (uint32_t r = 1; r < repeats; r++)
+	{
+		TMC_bench_run(&htmc, iterations, run);
+		for (uint8_t i = 0; i < count; i++)
+		{
+			results[i].heap_taken += run[i].heap_taken;
+			if (run[i].cycles < results[i].cycles)
+			{
+				results[i].cycles = run[i].cycles;
+			}
+		}
+	}
+	TMC_bench_print(results, count);
+
+	int status = 0;
+	time_crc(iterations);
+	if (check_crc() != 0)
+	{
+		status = 1;
+	}
+	time_vactual(iterations);
+	if (check_vactual() != 0)
+	{
+		status = 1;
+	}
+	for (uint8_t i = 0; i < count; i++)
+	{
+		if (results[i].heap_taken != 0)
+		{
+			fprintf(stderr, "%s allocates %u bytes\n", results[i].name, results[i].heap_taken);
+			status = 1;
+		}
+	}
+	if (baseline_path == NULL)
+	{
+		return status;
+	}
+
+	FILE* baseline = fopen(baseline_path, "r");
+	if (baseline == NULL)
+	{
+		perror(baseline_path);
+		return 2;
+	}
+	for (uint8_t i = 0; i < count; i++)
+	{
+		double before;
+		double now = TMC_bench_ns_x10(&results[i]) / 10.0;
+		if (!baseline_ns(baseline, results[i].name, &before))
+		{
+			fprintf(stderr, "%-24s not in baseline\n", results[i].name);
+			continue;
+		}
+		double change = (before > 0.0) ? 100.0 * (now - before) / before : 0.0;
+		uint8_t regressed = (change > tolerance) && (now - before >= 1.0);
+		fprintf(stderr, "%-24s %9.1f -> %9.1f ns/op %+6.1f%%%s\n", results[i].name, before, now, change,
+				regressed ? "  REGRESSION" : "");
+		if (regressed)
+		{
+			status = 1;
+		}
+	}
+	fclose(baseline);
+	return status;
+}
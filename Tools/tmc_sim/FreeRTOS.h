@@ -0,0 +1,22 @@
+/*
+ * FreeRTOS.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ *
+ * Host stand-in for the heap queries of FreeRTOS, sim_os.c charges every thread and queue
+ * it creates to a notional heap of the target size so allocation checks work on host too
+ */
+
+#ifndef TMC_SIM_FREERTOS_H_
+#define TMC_SIM_FREERTOS_H_
+
+#include <stddef.h>
+
+/* Same as configTOTAL_HEAP_SIZE of the firmware */
+#define SIM_TOTAL_HEAP_SIZE			((size_t)6144)
+
+size_t xPortGetFreeHeapSize(void);
+size_t xPortGetMinimumEverFreeHeapSize(void);
+
+#endif /* TMC_SIM_FREERTOS_H_ */
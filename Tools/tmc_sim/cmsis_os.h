@@ -0,0 +1,76 @@
+/*
+ * cmsis_os.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ *
+ * Host stand-in for the CMSIS-RTOS2 calls used by the TMC2226 driver, built on POSIX threads
+ * in sim_os.c. Threads run truly parallel instead of by priority, which is harsher on the
+ * driver than FreeRTOS on a single core. Kernel lock is a process wide recursive mutex.
+ * One tick is one millisecond like configTICK_RATE_HZ on the target
+ */
+
+#ifndef TMC_SIM_CMSIS_OS_H_
+#define TMC_SIM_CMSIS_OS_H_
+
+#include <stdint.h>
+
+typedef void* osThreadId_t;
+typedef void* osMessageQueueId_t;
+typedef void (*osThreadFunc_t)(void* argument);
+
+typedef enum {
+	osOK = 0,
+	osError = -1,
+	osErrorTimeout = -2,
+	osErrorResource = -3,
+	osErrorParameter = -4
+} osStatus_t;
+
+typedef enum {
+	osPriorityNone = 0,
+	osPriorityIdle = 1,
+	osPriorityLow = 8,
+	osPriorityBelowNormal = 16,
+	osPriorityNormal = 24,
+	osPriorityAboveNormal = 32,
+	osPriorityHigh = 40,
+	osPriorityRealtime = 48
+} osPriority_t;
+
+typedef struct {
+	const char* name;
+	uint32_t attr_bits;
+	void* cb_mem;
+	uint32_t cb_size;
+	void* stack_mem;
+	uint32_t stack_size;
+	osPriority_t priority;
+} osThreadAttr_t;
+
+#define osWaitForever				0xFFFFFFFFu
+#define osFlagsWaitAny				0x00000000u
+#define osFlagsWaitAll				0x00000001u
+#define osFlagsNoClear				0x00000002u
+#define osFlagsError				0x80000000u
+#define osFlagsErrorTimeout			0xFFFFFFFEu
+
+osThreadId_t osThreadNew(osThreadFunc_t func, void* argument, const osThreadAttr_t* attr);
+osThreadId_t osThreadGetId(void);
+
+uint32_t osThreadFlagsSet(osThreadId_t thread_id, uint32_t flags);
+uint32_t osThreadFlagsClear(uint32_t flags);
+uint32_t osThreadFlagsWait(uint32_t flags, uint32_t options, uint32_t timeout);
+
+osMessageQueueId_t osMessageQueueNew(uint32_t msg_count, uint32_t msg_size, const void* attr);
+osStatus_t osMessageQueuePut(osMessageQueueId_t mq_id, const void* msg_ptr, uint8_t msg_prio, uint32_t timeout);
+osStatus_t osMessageQueueGet(osMessageQueueId_t mq_id, void* msg_ptr, uint8_t* msg_prio, uint32_t timeout);
+
+int32_t osKernelLock(void);
+int32_t osKernelRestoreLock(int32_t lock);
+uint32_t osKernelGetTickCount(void);
+
+osStatus_t osDelay(uint32_t ticks);
+osStatus_t osDelayUntil(uint32_t ticks);
+
+#endif /* TMC_SIM_CMSIS_OS_H_ */
@@ -0,0 +1,696 @@
+/*
+ * sim_hal.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ *
+ * Mock HAL behind stm32f1xx_hal.h. Each UART gets a line thread standing in for the
+ * peripheral and the wire: it waits the wire time of every transmitted datagram, echoes it
+ * to the receiver like the single wire line does, hands it to the attached nodes and
+ * appends their reply after SENDDELAY. Bytes reach the armed receive buffer only while
+ * USART_CR1_RE is set. HAL callbacks run on the line thread with
+ * the interrupt lock held, so __disable_irq sections of the driver exclude them as on target.
+ * Console UART has a thread of its own that writes whatever DMA sends to a file descriptor
+ */
+#define _GNU_SOURCE
+#include "stm32f1xx_hal.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "usart.h"
+#include "tim.h"
+#include "TMC2226_bus.h"
+#include "tmc_sim.h"
+
+/**
+ * \brief			Peripheral and wire of one UART
+ */
+typedef struct {
+	UART_HandleTypeDef* huart;
+	TMC_SimNode* nodes[TMC_SIM_LINE_NODES];
+	uint8_t node_count;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint8_t tx_datagram[TMC_BUS_MAX_DATAGRAM];
+	uint16_t tx_length;
+	uint8_t tx_pending;							/* Transmit_IT started a datagram the thread did not take yet */
+	uint32_t generation;						/* Bumped by Abort, drops whatever is on the wire */
+} SimLine;
+
+/**
+ * \brief			Peripheral of the UART the shell and the stream use, DMA in both directions
+ */
+typedef struct {
+	UART_HandleTypeDef* huart;
+	int fd;										/* Gets every byte sent by DMA */
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint16_t rx_index;							/* Position circular reception writes next */
+} SimConsole;
+
+/* Any non-zero exception number means handler mode, USART1_IRQn + 16 */
+#define SIM_UART_EXCEPTION			53u
+
+static SimLine sim_lines[TMC_SIM_MAX_LINES];
+static SimConsole sim_console = { .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+static pthread_mutex_t sim_lines_lock = PTHREAD_MUTEX_INITIALIZER;
+static double sim_time_scale = 1.0;
+static TMC_SimLineMonitor sim_monitor = NULL;
+
+/* Interrupt lock, held by the line thread while callbacks run and by masked sections of the driver */
+static pthread_mutex_t irq_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread uint32_t primask;
+static __thread uint32_t ipsr;
+
+/* Exclusive monitor of __LDREXW and __STREXW */
+static __thread volatile uint32_t* exclusive_address;
+static __thread uint32_t exclusive_value;
+
+/* Register blocks the CMSIS device pointers point to */
+static USART_TypeDef usart1_regs, usart2_regs, usart3_regs;
+static TIM_TypeDef tim2_regs, tim3_regs;
+static GPIO_TypeDef gpioa_regs, gpiob_regs, gpioc_regs;
+static RCC_TypeDef rcc_regs = { .CFGR = RCC_CFGR_PPRE1_DIV2 };
+static CoreDebug_Type core_debug_regs;
+
+USART_TypeDef* const USART1 = &usart1_regs;
+USART_TypeDef* const USART2 = &usart2_regs;
+USART_TypeDef* const USART3 = &usart3_regs;
+TIM_TypeDef* const TIM2 = &tim2_regs;
+TIM_TypeDef* const TIM3 = &tim3_regs;
+GPIO_TypeDef* const GPIOA = &gpioa_regs;
+GPIO_TypeDef* const GPIOB = &gpiob_regs;
+GPIO_TypeDef* const GPIOC = &gpioc_regs;
+RCC_TypeDef* const RCC = &rcc_regs;
+CoreDebug_Type* const CoreDebug = &core_debug_regs;
+uint32_t SystemCoreClock = 64000000u;
+
+/* Handles usart.c and tim.c would define, with the rates the ioc configures */
+UART_HandleTypeDef huart1 = { .Instance = &usart1_regs, .Init.BaudRate = 115200u,
+		.gState = HAL_UART_STATE_READY, .RxState = HAL_UART_STATE_READY };
+UART_HandleTypeDef huart2 = { .Instance = &usart2_regs, .Init.BaudRate = 115200u,
+		.gState = HAL_UART_STATE_READY, .RxState = HAL_UART_STATE_READY };
+UART_HandleTypeDef huart3 = { .Instance = &usart3_regs, .Init.BaudRate = 115200u,
+		.gState = HAL_UART_STATE_READY, .RxState = HAL_UART_STATE_READY };
+TIM_HandleTypeDef htim2 = { .Instance = &tim2_regs };
+TIM_HandleTypeDef htim3 = { .Instance = &tim3_regs };
+
+static SimLine* get_line(UART_HandleTypeDef* huart);
+static void* line_thread(void* argument);
+static void wait_bits(uint32_t bit_times, uint32_t baud_rate);
+static void deliver(SimLine* line, uint32_t generation, const uint8_t* data, uint16_t length);
+static void* console_thread(void* argument);
+static void write_all(int fd, const uint8_t* data, uint16_t length);
+
+
+/* ################ Line ################*/
+
+/**
+ * \brief			Connects node to the single wire line of given UART
+ * \note			Up to TMC_SIM_LINE_NODES nodes, each answers only to its own address
+ */
+void tmc_sim_line_attach(UART_HandleTypeDef* huart, TMC_SimNode* node)
+{
+	SimLine* line = get_line(huart);
+	pthread_mutex_lock(&line->lock);
+	if (line->node_count < TMC_SIM_LINE_NODES)
+	{
+		line->nodes[line->node_count++] = node;
+	}
+	pthread_mutex_unlock(&line->lock);
+}
+
+/**
+ * \brief			Stretches (above 1) or shrinks every wire time, 0 leaves only software overhead
+ */
+void tmc_sim_line_set_time_scale(double scale)
+{
+	sim_time_scale = scale;
+}
+
+
+/* ################ Console ################*/
+
+/**
+ * \brief			Makes given UART the console, bytes it sends by DMA are written to fd
+ * \note			Only one console, later calls are ignored
+ */
+void tmc_sim_console_attach(UART_HandleTypeDef* huart, int fd)
+{
+	if (sim_console.huart != NULL)
+	{
+		return;
+	}
+	sim_console.huart = huart;
+	sim_console.fd = fd;
+	pthread_create(&sim_console.thread, NULL, console_thread, &sim_console);
+	pthread_detach(sim_console.thread);
+}
+
+/**
+ * \brief			Puts bytes into the circular buffer armed by HAL_UARTEx_ReceiveToIdle_DMA
+ * \note			Reports half and full buffer on the way and idle line after the last byte,
+ * 					like DMA and IDLE interrupt do. Bytes are lost while reception is not armed
+ */
+void tmc_sim_console_receive(UART_HandleTypeDef* huart, const uint8_t* data, uint16_t length)
+{
+	SimConsole* console = &sim_console;
+	if (huart != console->huart)
+	{
+		return;
+	}
+	__disable_irq();
+	ipsr = SIM_UART_EXCEPTION;
+	for (uint16_t i = 0; i < length && huart->RxState == HAL_UART_STATE_BUSY_RX; i++)
+	{
+		huart->pRxBuffPtr[console->rx_index++] = data[i];
+		if (console->rx_index == huart->RxXferSize / 2u)
+		{
+			HAL_UARTEx_RxEventCallback(huart, console->rx_index);
+		}
+		else if (console->rx_index == huart->RxXferSize)
+		{
+			HAL_UARTEx_RxEventCallback(huart, console->rx_index);
+			console->rx_index = 0;
+		}
+	}
+	if (huart->RxState == HAL_UART_STATE_BUSY_RX)
+	{
+		HAL_UARTEx_RxEventCallback(huart, console->rx_index);
+	}
+	ipsr = 0;
+	__enable_irq();
+}
+
+/**
+ * \brief			Waits until the console sent everything DMA was given
+ * \note			Completion callback starts the next block before it releases the interrupt
+ * 					lock, so the transmitter seen idle under the lock has nothing left to send
+ */
+void tmc_sim_console_drain(UART_HandleTypeDef* huart)
+{
+	while (1)
+	{
+		__disable_irq();
+		uint8_t idle = (huart->gState == HAL_UART_STATE_READY);
+		__enable_irq();
+		if (idle)
+		{
+			return;
+		}
+		struct timespec delay = { .tv_sec = 0, .tv_nsec = 1000000 };
+		nanosleep(&delay, NULL);
+	}
+}
+
+
+/* ################ HAL ################*/
+
+HAL_StatusTypeDef HAL_HalfDuplex_Init(UART_HandleTypeDef* huart)
+{
+	HAL_UART_Abort(huart);
+	SET_BIT(huart->Instance->CR1, USART_CR1_RE | USART_CR1_TE);
+	return (huart->Init.BaudRate != 0) ? HAL_OK : HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef* huart)
+{
+	return HAL_HalfDuplex_Init(huart);
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef* huart, const uint8_t* data, uint16_t size)
+{
+	SimLine* line = get_line(huart);
+	if (size == 0 || size > TMC_BUS_MAX_DATAGRAM)
+	{
+		return HAL_ERROR;
+	}
+
+	pthread_mutex_lock(&line->lock);
+	if (huart->gState != HAL_UART_STATE_READY)
+	{
+		pthread_mutex_unlock(&line->lock);
+		return HAL_BUSY;
+	}
+	huart->gState = HAL_UART_STATE_BUSY_TX;
+	huart->pTxBuffPtr = data;
+	huart->TxXferSize = size;
+	memcpy(line->tx_datagram, data, size);
+	line->tx_length = size;
+	line->tx_pending = 1;
+	pthread_cond_signal(&line->cond);
+	pthread_mutex_unlock(&line->lock);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef* huart, uint8_t* data, uint16_t size)
+{
+	SimLine* line = get_line(huart);
+	pthread_mutex_lock(&line->lock);
+	if (huart->RxState != HAL_UART_STATE_READY)
+	{
+		pthread_mutex_unlock(&line->lock);
+		return HAL_BUSY;
+	}
+	huart->RxState = HAL_UART_STATE_BUSY_RX;
+	huart->pRxBuffPtr = data;
+	huart->RxXferSize = size;
+	huart->RxXferCount = size;
+	pthread_mutex_unlock(&line->lock);
+	return HAL_OK;
+}
+
+/**
+ * \brief			Stops both directions, datagram still on the wire and reply to it are lost
+ */
+HAL_StatusTypeDef HAL_UART_Abort(UART_HandleTypeDef* huart)
+{
+	SimLine* line = get_line(huart);
+	// May be called from ErrorCallback, where interrupts are already masked
+	uint32_t masked = __get_PRIMASK();
+	__disable_irq();
+	pthread_mutex_lock(&line->lock);
+	huart->gState = HAL_UART_STATE_READY;
+	huart->RxState = HAL_UART_STATE_READY;
+	huart->RxXferCount = 0;
+	line->tx_pending = 0;
+	line->generation++;
+	pthread_mutex_unlock(&line->lock);
+	__set_PRIMASK(masked);
+	return HAL_OK;
+}
+
+/**
+ * \brief			Hands block to the console thread, which calls half and full completion
+ */
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef* huart, const uint8_t* data, uint16_t size)
+{
+	SimConsole* console = &sim_console;
+	if (huart != console->huart || size == 0)
+	{
+		return HAL_ERROR;
+	}
+
+	pthread_mutex_lock(&console->lock);
+	if (huart->gState != HAL_UART_STATE_READY)
+	{
+		pthread_mutex_unlock(&console->lock);
+		return HAL_BUSY;
+	}
+	huart->gState = HAL_UART_STATE_BUSY_TX;
+	huart->pTxBuffPtr = data;
+	huart->TxXferSize = size;
+	pthread_cond_signal(&console->cond);
+	pthread_mutex_unlock(&console->lock);
+	return HAL_OK;
+}
+
+/**
+ * \brief			Arms circular reception of the console, fed by tmc_sim_console_receive
+ */
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef* huart, uint8_t* data, uint16_t size)
+{
+	SimConsole* console = &sim_console;
+	if (huart != console->huart || size == 0)
+	{
+		return HAL_ERROR;
+	}
+
+	uint32_t masked = __get_PRIMASK();
+	__disable_irq();
+	HAL_StatusTypeDef status = HAL_BUSY;
+	if (huart->RxState == HAL_UART_STATE_READY)
+	{
+		huart->RxState = HAL_UART_STATE_BUSY_RX;
+		huart->pRxBuffPtr = data;
+		huart->RxXferSize = size;
+		console->rx_index = 0;
+		status = HAL_OK;
+	}
+	__set_PRIMASK(masked);
+	return status;
+}
+
+/* Weak like in HAL, tools with more users of the callbacks override them the way main.c does */
+__weak void HAL_UART_TxHalfCpltCallback(UART_HandleTypeDef* huart)
+{
+	(void)huart;
+}
+
+__weak void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart)
+{
+	TMC_bus_TxCpltCallback(huart);
+}
+
+__weak void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart)
+{
+	TMC_bus_RxCpltCallback(huart);
+}
+
+__weak void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef* huart, uint16_t size)
+{
+	(void)huart;
+	(void)size;
+}
+
+__weak void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart)
+{
+	TMC_bus_ErrorCallback(huart);
+}
+
+/* Timers and GPIO only keep the state, nothing steps in the simulation */
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef* htim, uint32_t channel)
+{
+	(void)channel;
+	htim->Instance->CR1 |= 0x01u;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef* htim, uint32_t channel)
+{
+	(void)channel;
+	htim->Instance->CR1 &= ~0x01u;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef* htim)
+{
+	htim->Instance->CR1 |= 0x01u;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef* htim)
+{
+	htim->Instance->CR1 &= ~0x01u;
+	return HAL_OK;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* port, uint16_t pin, GPIO_PinState state)
+{
+	port->ODR = (state == GPIO_PIN_SET) ? (port->ODR | pin) : (port->ODR & ~(uint32_t)pin);
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void)
+{
+	return SystemCoreClock / 2u;
+}
+
+uint32_t HAL_GetTick(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)((uint64_t)now.tv_sec * 1000u + (uint64_t)now.tv_nsec / 1000000u);
+}
+
+/* ################ CMSIS core ################*/
+void __disable_irq(void)
+{
+	if (!primask)
+	{
+		pthread_mutex_lock(&irq_lock);
+		primask = 1;
+	}
+}
+
+void __enable_irq(void)
+{
+	if (primask)
+	{
+		primask = 0;
+		pthread_mutex_unlock(&irq_lock);
+	}
+}
+
+uint32_t __get_PRIMASK(void)
+{
+	return primask;
+}
+
+/* Non-zero on the threads standing in for peripherals while they run callbacks */
+uint32_t __get_IPSR(void)
+{
+	return ipsr;
+}
+
+/**
+ * \brief			Exclusive load and store as compare and swap against the loaded value
+ * \note			Store after an ABA change succeeds where the target would fail and retry,
+ * 					harmless for the claim loops of the firmware
+ */
+uint32_t __LDREXW(volatile uint32_t* address)
+{
+	exclusive_address = address;
+	exclusive_value = *address;
+	return exclusive_value;
+}
+
+uint32_t __STREXW(uint32_t value, volatile uint32_t* address)
+{
+	uint8_t stored = (exclusive_address == address)
+			&& __sync_bool_compare_and_swap(address, exclusive_value, value);
+	exclusive_address = NULL;
+	return stored ? 0u : 1u;
+}
+
+void __CLREX(void)
+{
+	exclusive_address = NULL;
+}
+
+void __set_PRIMASK(uint32_t value)
+{
+	if (value)
+	{
+		__disable_irq();
+	}
+	else
+	{
+		__enable_irq();
+	}
+}
+
+/**
+ * \brief			Installs monitor of master datagrams of all lines, NULL removes it
+ * \note			Runs in the line thread before the datagram reaches the receiver
+ */
+void tmc_sim_line_set_monitor(TMC_SimLineMonitor monitor)
+{
+	sim_monitor = monitor;
+}
+
+
+/**
+ * \brief			Returns DWT with CYCCNT refreshed from the monotonic clock
+ * \note			Copy per thread, so concurrent readers never race on it
+ */
+DWT_Type* sim_dwt(void)
+{
+	static __thread DWT_Type dwt;
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	uint64_t ns = (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+	dwt.CYCCNT = (uint32_t)(ns * (SystemCoreClock / 1000000u) / 1000u);
+	return &dwt;
+}
+
+
+/* ################ Private functions ################ */
+/* Finds line of given UART, creates it and its thread on first use */
+static SimLine* get_line(UART_HandleTypeDef* huart)
+{
+	pthread_mutex_lock(&sim_lines_lock);
+	SimLine* line = NULL;
+	for (uint8_t i = 0; i < TMC_SIM_MAX_LINES && line == NULL; i++)
+	{
+		if (sim_lines[i].huart == huart)
+		{
+			line = &sim_lines[i];
+		}
+		else if (sim_lines[i].huart == NULL)
+		{
+			line = &sim_lines[i];
+			line->huart = huart;
+			pthread_mutex_init(&line->lock, NULL);
+			pthread_cond_init(&line->cond, NULL);
+			pthread_create(&line->thread, NULL, line_thread, line);
+			pthread_detach(line->thread);
+		}
+	}
+	pthread_mutex_unlock(&sim_lines_lock);
+	return line;
+}
+
+/* Peripheral and wire, one datagram and its reply at a time like the half duplex line itself */
+static void* line_thread(void* argument)
+{
+	SimLine* line = (SimLine*)argument;
+	UART_HandleTypeDef* huart = line->huart;
+	uint8_t datagram[TMC_BUS_MAX_DATAGRAM];
+	ipsr = SIM_UART_EXCEPTION;
+
+	while (1)
+	{
+		pthread_mutex_lock(&line->lock);
+		while (!line->tx_pending)
+		{
+			pthread_cond_wait(&line->cond, &line->lock);
+		}
+		uint16_t length = line->tx_length;
+		uint32_t generation = line->generation;
+		uint32_t baud_rate = huart->Init.BaudRate;
+		memcpy(datagram, line->tx_datagram, length);
+		line->tx_pending = 0;
+		pthread_mutex_unlock(&line->lock);
+
+		// Start, 8 data and stop bit per byte, echo arrives together with the last stop bit
+		wait_bits(10u * length, baud_rate);
+		uint8_t reply[TMC_SIM_MAX_REPLY];
+		uint8_t reply_length = 0;
+		uint32_t delay_bits = 0;
+		__disable_irq();
+		pthread_mutex_lock(&line->lock);
+		uint8_t sent = (line->generation == generation);
+		uint8_t jammed = 0;
+		for (uint8_t i = 0; i < line->node_count; i++)
+		{
+			jammed |= line->nodes[i]->jam_line;
+		}
+		if (sent)
+		{
+			// Every node latches the datagram at the same stop bit, at most the addressed one answers
+			for (uint8_t i = 0; i < line->node_count && reply_length == 0 && !jammed; i++)
+			{
+				reply_length = tmc_sim_node_receive(line->nodes[i], datagram, length, baud_rate, reply, &delay_bits);
+			}
+			huart->gState = HAL_UART_STATE_READY;
+		}
+		pthread_mutex_unlock(&line->lock);
+		TMC_SimLineMonitor monitor = sim_monitor;
+		if (sent && monitor != NULL)
+		{
+			monitor(huart, datagram, (uint8_t)length);
+		}
+		if (sent && jammed)
+		{
+			HAL_UART_ErrorCallback(huart);
+		}
+		else if (sent)
+		{
+			deliver(line, generation, datagram, length);
+			HAL_UART_TxCpltCallback(huart);
+		}
+		__enable_irq();
+		if (reply_length == 0)
+		{
+			continue;
+		}
+
+		wait_bits(delay_bits + 10u * reply_length, baud_rate);
+		__disable_irq();
+		deliver(line, generation, reply, reply_length);
+		__enable_irq();
+	}
+	return NULL;
+}
+
+static void wait_bits(uint32_t bit_times, uint32_t baud_rate)
+{
+	if (sim_time_scale <= 0.0 || baud_rate == 0)
+	{
+		return;
+	}
+	uint64_t ns = (uint64_t)((double)bit_times * 1e9 * sim_time_scale / baud_rate);
+	struct timespec delay = { .tv_sec = ns / 1000000000u, .tv_nsec = ns % 1000000000u };
+	while (nanosleep(&delay, &delay) != 0 && errno == EINTR)
+	{
+	}
+}
+
+/**
+ * \brief			Hands bytes to the receiver one by one like RXNE does, has to be called with
+ * 					interrupts masked and line unlocked, RxCplt may re-arm or abort reception
+ * \note			Bytes arriving while the receiver is off, not armed or after Abort are lost
+ */
+static void deliver(SimLine* line, uint32_t generation, const uint8_t* data, uint16_t length)
+{
+	UART_HandleTypeDef* huart = line->huart;
+	for (uint16_t i = 0; i < length; i++)
+	{
+		uint8_t received = 0;
+		pthread_mutex_lock(&line->lock);
+		if (line->generation == generation && (huart->Instance->CR1 & USART_CR1_RE)
+				&& huart->RxState == HAL_UART_STATE_BUSY_RX)
+		{
+			huart->pRxBuffPtr[huart->RxXferSize - huart->RxXferCount] = data[i];
+			if (--huart->RxXferCount == 0)
+			{
+				huart->RxState = HAL_UART_STATE_READY;
+				received = 1;
+			}
+		}
+		pthread_mutex_unlock(&line->lock);
+		if (received)
+		{
+			HAL_UART_RxCpltCallback(huart);
+		}
+	}
+}
+
+/* DMA and wire of the console, half transfer is reported once the first half left memory */
+static void* console_thread(void* argument)
+{
+	SimConsole* console = (SimConsole*)argument;
+	UART_HandleTypeDef* huart = console->huart;
+	ipsr = SIM_UART_EXCEPTION;
+
+	while (1)
+	{
+		pthread_mutex_lock(&console->lock);
+		while (huart->gState != HAL_UART_STATE_BUSY_TX)
+		{
+			pthread_cond_wait(&console->cond, &console->lock);
+		}
+		const uint8_t* data = huart->pTxBuffPtr;
+		uint16_t size = huart->TxXferSize;
+		pthread_mutex_unlock(&console->lock);
+
+		uint16_t half = size / 2u;
+		write_all(console->fd, data, half);
+		__disable_irq();
+		HAL_UART_TxHalfCpltCallback(huart);
+		__enable_irq();
+		write_all(console->fd, &data[half], size - half);
+
+		__disable_irq();
+		pthread_mutex_lock(&console->lock);
+		huart->gState = HAL_UART_STATE_READY;
+		pthread_mutex_unlock(&console->lock);
+		HAL_UART_TxCpltCallback(huart);
+		__enable_irq();
+	}
+	return NULL;
+}
+
+/* Reader gone away loses the bytes, like a board sending to an unplugged cable */
+static void write_all(int fd, const uint8_t* data, uint16_t length)
+{
+	while (length != 0)
+	{
+		ssize_t written = write(fd, data, length);
+		if (written < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (written <= 0)
+		{
+			return;
+		}
+		data += written;
+		length -= (uint16_t)written;
+	}
+}
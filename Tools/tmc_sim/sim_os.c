@@ -0,0 +1,372 @@
+/*
+ * sim_os.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ *
+ * CMSIS-RTOS2 subset of cmsis_os.h on POSIX threads. Every thread record carries its own
+ * mutex and condition for thread flags, queues block on their own pair the same way
+ */
+#define _GNU_SOURCE
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "tmc_sim.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Returned by osThreadFlagsWait with zero timeout when no flag is set */
+#define osFlagsErrorResource		0xFFFFFFFDu
+
+typedef struct {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint32_t flags;
+	osThreadFunc_t func;
+	void* argument;
+} SimThread;
+
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint8_t* buffer;
+	uint32_t msg_count;
+	uint32_t msg_size;
+	uint32_t head;
+	uint32_t count;
+} SimQueue;
+
+static __thread SimThread* self;
+static __thread int32_t kernel_lock_depth;
+static pthread_mutex_t kernel_lock;
+static pthread_once_t kernel_lock_once = PTHREAD_ONCE_INIT;
+static size_t heap_free = SIM_TOTAL_HEAP_SIZE;
+static size_t heap_minimum = SIM_TOTAL_HEAP_SIZE;
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+static double timeout_scale = 1.0;
+static uint32_t timeout_slack_ms;
+
+static SimThread* thread_new(void);
+static void* thread_entry(void* argument);
+static void deadline_after(struct timespec* deadline, uint32_t timeout_ms);
+static void init_kernel_lock(void);
+static void charge_heap(size_t size);
+
+
+/* ################ API ################*/
+
+osThreadId_t osThreadNew(osThreadFunc_t func, void* argument, const osThreadAttr_t* attr)
+{
+	(void)attr;
+	SimThread* thread = thread_new();
+	thread->func = func;
+	thread->argument = argument;
+	if (pthread_create(&thread->thread, NULL, thread_entry, thread) != 0)
+	{
+		free(thread);
+		return NULL;
+	}
+	pthread_detach(thread->thread);
+	return thread;
+}
+
+/**
+ * \brief			Returns record of the calling thread
+ * \note			Threads not started by osThreadNew (main) get their record on first call
+ */
+osThreadId_t osThreadGetId(void)
+{
+	if (self == NULL)
+	{
+		self = thread_new();
+		self->thread = pthread_self();
+	}
+	return self;
+}
+
+uint32_t osThreadFlagsSet(osThreadId_t thread_id, uint32_t flags)
+{
+	SimThread* thread = (SimThread*)thread_id;
+	if (thread == NULL)
+	{
+		return osFlagsError;
+	}
+	pthread_mutex_lock(&thread->lock);
+	thread->flags |= flags;
+	uint32_t result = thread->flags;
+	pthread_cond_broadcast(&thread->cond);
+	pthread_mutex_unlock(&thread->lock);
+	return result;
+}
+
+uint32_t osThreadFlagsClear(uint32_t flags)
+{
+	SimThread* thread = (SimThread*)osThreadGetId();
+	pthread_mutex_lock(&thread->lock);
+	uint32_t result = thread->flags;
+	thread->flags &= ~flags;
+	pthread_mutex_unlock(&thread->lock);
+	return result;
+}
+
+/**
+ * \brief			Sleeps until any (or all) of given flags is set, clears them unless osFlagsNoClear
+ * \return			Flags set before clearing, osFlagsErrorTimeout or osFlagsErrorResource
+ */
+uint32_t osThreadFlagsWait(uint32_t flags, uint32_t options, uint32_t timeout)
+{
+	SimThread* thread = (SimThread*)osThreadGetId();
+	struct timespec deadline;
+	deadline_after(&deadline, timeout);
+
+	pthread_mutex_lock(&thread->lock);
+	while (1)
+	{
+		uint32_t set = thread->flags & flags;
+		if ((options & osFlagsWaitAll) ? (set == flags) : (set != 0))
+		{
+			uint32_t result = thread->flags;
+			if (!(options & osFlagsNoClear))
+			{
+				thread->flags &= ~flags;
+			}
+			pthread_mutex_unlock(&thread->lock);
+			return result;
+		}
+		if (timeout == 0)
+		{
+			pthread_mutex_unlock(&thread->lock);
+			return osFlagsErrorResource;
+		}
+		if (timeout == osWaitForever)
+		{
+			pthread_cond_wait(&thread->cond, &thread->lock);
+		}
+		else if (pthread_cond_timedwait(&thread->cond, &thread->lock, &deadline) == ETIMEDOUT)
+		{
+			pthread_mutex_unlock(&thread->lock);
+			return osFlagsErrorTimeout;
+		}
+	}
+}
+
+osMessageQueueId_t osMessageQueueNew(uint32_t msg_count, uint32_t msg_size, const void* attr)
+{
+	(void)attr;
+	SimQueue* queue = calloc(1, sizeof(SimQueue));
+	charge_heap(sizeof(SimQueue) + msg_count * msg_size);
+	queue->buffer = calloc(msg_count, msg_size);
+	queue->msg_count = msg_count;
+	queue->msg_size = msg_size;
+	pthread_mutex_init(&queue->lock, NULL);
+	pthread_cond_init(&queue->cond, NULL);
+	return queue;
+}
+
+/**
+ * \brief			Appends message, waits up to timeout ticks for free space
+ * \note			Priority is ignored, the driver keeps one queue per priority instead
+ */
+osStatus_t osMessageQueuePut(osMessageQueueId_t mq_id, const void* msg_ptr, uint8_t msg_prio, uint32_t timeout)
+{
+	(void)msg_prio;
+	SimQueue* queue = (SimQueue*)mq_id;
+	struct timespec deadline;
+	deadline_after(&deadline, timeout);
+
+	pthread_mutex_lock(&queue->lock);
+	while (queue->count == queue->msg_count)
+	{
+		if (timeout == 0)
+		{
+			pthread_mutex_unlock(&queue->lock);
+			return osErrorResource;
+		}
+		if (timeout == osWaitForever)
+		{
+			pthread_cond_wait(&queue->cond, &queue->lock);
+		}
+		else if (pthread_cond_timedwait(&queue->cond, &queue->lock, &deadline) == ETIMEDOUT)
+		{
+			pthread_mutex_unlock(&queue->lock);
+			return osErrorTimeout;
+		}
+	}
+	uint32_t tail = (queue->head + queue->count) % queue->msg_count;
+	memcpy(&queue->buffer[tail * queue->msg_size], msg_ptr, queue->msg_size);
+	queue->count++;
+	pthread_cond_broadcast(&queue->cond);
+	pthread_mutex_unlock(&queue->lock);
+	return osOK;
+}
+
+osStatus_t osMessageQueueGet(osMessageQueueId_t mq_id, void* msg_ptr, uint8_t* msg_prio, uint32_t timeout)
+{
+	SimQueue* queue = (SimQueue*)mq_id;
+	struct timespec deadline;
+	deadline_after(&deadline, timeout);
+
+	pthread_mutex_lock(&queue->lock);
+	while (queue->count == 0)
+	{
+		if (timeout == 0)
+		{
+			pthread_mutex_unlock(&queue->lock);
+			return osErrorResource;
+		}
+		if (timeout == osWaitForever)
+		{
+			pthread_cond_wait(&queue->cond, &queue->lock);
+		}
+		else if (pthread_cond_timedwait(&queue->cond, &queue->lock, &deadline) == ETIMEDOUT)
+		{
+			pthread_mutex_unlock(&queue->lock);
+			return osErrorTimeout;
+		}
+	}
+	memcpy(msg_ptr, &queue->buffer[queue->head * queue->msg_size], queue->msg_size);
+	queue->head = (queue->head + 1) % queue->msg_count;
+	queue->count--;
+	if (msg_prio != NULL)
+	{
+		*msg_prio = 0;
+	}
+	pthread_cond_broadcast(&queue->cond);
+	pthread_mutex_unlock(&queue->lock);
+	return osOK;
+}
+
+/**
+ * \brief			Excludes every other thread that locks the kernel, returns previous lock state
+ * \note			Threads keep running in parallel, only sections guarded by the lock are serialized
+ */
+int32_t osKernelLock(void)
+{
+	pthread_once(&kernel_lock_once, init_kernel_lock);
+	pthread_mutex_lock(&kernel_lock);
+	return (kernel_lock_depth++ > 0) ? 1 : 0;
+}
+
+/**
+ * \brief			Undoes the osKernelLock call that returned given lock state
+ */
+int32_t osKernelRestoreLock(int32_t lock)
+{
+	kernel_lock_depth--;
+	pthread_mutex_unlock(&kernel_lock);
+	return lock;
+}
+
+uint32_t osKernelGetTickCount(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)((uint64_t)now.tv_sec * 1000u + (uint64_t)now.tv_nsec / 1000000u);
+}
+
+/**
+ * \brief			Free bytes of the notional RTOS heap, thread records and queues are charged to it
+ * \note			Host sizes differ from FreeRTOS control blocks, only changes are meaningful
+ */
+size_t xPortGetFreeHeapSize(void)
+{
+	pthread_mutex_lock(&heap_lock);
+	size_t free_bytes = heap_free;
+	pthread_mutex_unlock(&heap_lock);
+	return free_bytes;
+}
+
+size_t xPortGetMinimumEverFreeHeapSize(void)
+{
+	pthread_mutex_lock(&heap_lock);
+	size_t minimum = heap_minimum;
+	pthread_mutex_unlock(&heap_lock);
+	return minimum;
+}
+
+osStatus_t osDelay(uint32_t ticks)
+{
+	struct timespec delay = { .tv_sec = ticks / 1000u, .tv_nsec = (long)(ticks % 1000u) * 1000000L };
+	while (nanosleep(&delay, &delay) != 0 && errno == EINTR)
+	{
+	}
+	return osOK;
+}
+
+osStatus_t osDelayUntil(uint32_t ticks)
+{
+	int32_t remaining = (int32_t)(ticks - osKernelGetTickCount());
+	return (remaining > 0) ? osDelay((uint32_t)remaining) : osOK;
+}
+
+/**
+ * \brief			Stretches every finite timeout to timeout * scale + slack_ms
+ * \note			Driver timeouts are wire time plus TMC_BUS_TIMEOUT_MARGIN_MS. A host thread may
+ * 					be scheduled out for longer than that, and wire time slowed down with
+ * 					tmc_sim_line_set_time_scale is not in the driver's estimate at all
+ */
+void tmc_sim_os_set_timeouts(double scale, uint32_t slack_ms)
+{
+	timeout_scale = (scale > 1.0) ? scale : 1.0;
+	timeout_slack_ms = slack_ms;
+}
+
+
+/* ################ Private functions ################ */
+static SimThread* thread_new(void)
+{
+	SimThread* thread = calloc(1, sizeof(SimThread));
+	charge_heap(sizeof(SimThread));
+	pthread_mutex_init(&thread->lock, NULL);
+	pthread_cond_init(&thread->cond, NULL);
+	return thread;
+}
+
+static void* thread_entry(void* argument)
+{
+	self = (SimThread*)argument;
+	self->func(self->argument);
+	return NULL;
+}
+
+/* Condition variables use CLOCK_REALTIME deadlines by default */
+static void deadline_after(struct timespec* deadline, uint32_t timeout_ms)
+{
+	clock_gettime(CLOCK_REALTIME, deadline);
+	if (timeout_ms == 0 || timeout_ms == osWaitForever)
+	{
+		return;
+	}
+	timeout_ms = (uint32_t)(timeout_ms * timeout_scale) + timeout_slack_ms;
+	deadline->tv_sec += timeout_ms / 1000u;
+	deadline->tv_nsec += (long)(timeout_ms % 1000u) * 1000000L;
+	if (deadline->tv_nsec >= 1000000000L)
+	{
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000L;
+	}
+}
+
+static void init_kernel_lock(void)
+{
+	pthread_mutexattr_t attributes;
+	pthread_mutexattr_init(&attributes);
+	pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&kernel_lock, &attributes);
+}
+
+/* Nothing is ever freed, like RTOS objects of the firmware created once at start */
+static void charge_heap(size_t size)
+{
+	pthread_mutex_lock(&heap_lock);
+	heap_free = (size < heap_free) ? heap_free - size : 0;
+	if (heap_free < heap_minimum)
+	{
+		heap_minimum = heap_free;
+	}
+	pthread_mutex_unlock(&heap_lock);
+}
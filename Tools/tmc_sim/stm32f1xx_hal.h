@@ -0,0 +1,216 @@
+/*
+ * stm32f1xx_hal.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ *
+ * Host stand-in for the parts of STM32F1 HAL and CMSIS core used by the TMC2226 driver.
+ * Found before the real one through the include path, so Core sources build unmodified.
+ * UART is backed by the simulated single wire line of tmc_sim.h, or by the console of tmc_sim.h
+ * for DMA transfers, timers and GPIO only keep register values, interrupt masking is a process
+ * wide lock, see sim_hal.c. UART callbacks are weak as in HAL, the defaults serve the bus layer
+ */
+
+#ifndef TMC_SIM_STM32F1XX_HAL_H_
+#define TMC_SIM_STM32F1XX_HAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+	HAL_OK = 0x00u,
+	HAL_ERROR = 0x01u,
+	HAL_BUSY = 0x02u,
+	HAL_TIMEOUT = 0x03u
+} HAL_StatusTypeDef;
+
+#define HAL_MAX_DELAY				0xFFFFFFFFu
+
+/* Like stm32f1xx_hal_conf.h without USE_FULL_ASSERT, callers still have to handle bad arguments */
+#define assert_param(expr)			((void)0U)
+
+/* ################ Peripherals ################ */
+typedef struct {
+	volatile uint32_t SR, DR, BRR, CR1, CR2, CR3, GTPR;
+} USART_TypeDef;
+
+typedef struct {
+	volatile uint32_t CR1, CR2, SMCR, DIER, SR, EGR, CCMR1, CCMR2, CCER, CNT, PSC, ARR, RCR, CCR1, CCR2, CCR3, CCR4;
+} TIM_TypeDef;
+
+typedef struct {
+	volatile uint32_t CRL, CRH, IDR, ODR, BSRR, BRR, LCKR;
+} GPIO_TypeDef;
+
+typedef struct {
+	volatile uint32_t CR, CFGR;
+} RCC_TypeDef;
+
+typedef struct {
+	volatile uint32_t CTRL, CYCCNT;
+} DWT_Type;
+
+typedef struct {
+	volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+extern USART_TypeDef* const USART1;
+extern USART_TypeDef* const USART2;
+extern USART_TypeDef* const USART3;
+extern TIM_TypeDef* const TIM2;
+extern TIM_TypeDef* const TIM3;
+extern GPIO_TypeDef* const GPIOA;
+extern GPIO_TypeDef* const GPIOB;
+extern GPIO_TypeDef* const GPIOC;
+extern RCC_TypeDef* const RCC;
+extern CoreDebug_Type* const CoreDebug;
+extern uint32_t SystemCoreClock;
+
+/* Cycle counter follows the host monotonic clock scaled to SystemCoreClock */
+DWT_Type* sim_dwt(void);
+#define DWT							(sim_dwt())
+
+#define CoreDebug_DEMCR_TRCENA_Msk	(1u << 24)
+#define DWT_CTRL_CYCCNTENA_Msk		(1u << 0)
+#define RCC_CFGR_PPRE1				(0x7u << 8)
+#define RCC_CFGR_PPRE1_DIV1			(0x0u << 8)
+#define RCC_CFGR_PPRE1_DIV2			(0x4u << 8)
+#define TIM_EGR_UG					(1u << 0)
+#define TIM_FLAG_UPDATE				(1u << 0)
+#define USART_CR1_RE				(1u << 2)
+#define USART_CR1_TE				(1u << 3)
+
+#define SET_BIT(reg, bit)			((reg) |= (bit))
+#define CLEAR_BIT(reg, bit)			((reg) &= ~(bit))
+
+#define GPIO_PIN_0					0x0001u
+#define GPIO_PIN_1					0x0002u
+#define GPIO_PIN_2					0x0004u
+#define GPIO_PIN_3					0x0008u
+#define GPIO_PIN_5					0x0020u
+#define GPIO_PIN_6					0x0040u
+#define GPIO_PIN_13					0x2000u
+#define GPIO_PIN_14					0x4000u
+#define EXTI15_10_IRQn				40
+
+typedef enum {
+	GPIO_PIN_RESET = 0,
+	GPIO_PIN_SET
+} GPIO_PinState;
+
+/* ################ Handles ################ */
+typedef struct {
+	uint32_t BaudRate;
+	uint32_t WordLength;
+	uint32_t StopBits;
+	uint32_t Parity;
+	uint32_t Mode;
+	uint32_t HwFlowCtl;
+	uint32_t OverSampling;
+} UART_InitTypeDef;
+
+#define HAL_UART_STATE_READY		0x20u
+#define HAL_UART_STATE_BUSY_TX		0x21u
+#define HAL_UART_STATE_BUSY_RX		0x22u
+
+typedef struct {
+	USART_TypeDef* Instance;
+	UART_InitTypeDef Init;
+	const uint8_t* pTxBuffPtr;
+	uint16_t TxXferSize;
+	uint8_t* pRxBuffPtr;
+	uint16_t RxXferSize;
+	volatile uint16_t RxXferCount;				/* Bytes still expected, as in HAL */
+	void* hdmatx;
+	void* hdmarx;
+	volatile uint32_t gState;
+	volatile uint32_t RxState;
+	volatile uint32_t ErrorCode;
+} UART_HandleTypeDef;
+
+typedef struct {
+	uint32_t Prescaler;
+	uint32_t CounterMode;
+	uint32_t Period;
+	uint32_t ClockDivision;
+	uint32_t RepetitionCounter;
+	uint32_t AutoReloadPreload;
+} TIM_Base_InitTypeDef;
+
+typedef struct {
+	TIM_TypeDef* Instance;
+	TIM_Base_InitTypeDef Init;
+} TIM_HandleTypeDef;
+
+#define TIM_CHANNEL_1				0x00u
+#define TIM_CHANNEL_2				0x04u
+
+#define __HAL_TIM_SET_COUNTER(h, v)		((h)->Instance->CNT = (v))
+#define __HAL_TIM_GET_COUNTER(h)		((h)->Instance->CNT)
+#define __HAL_TIM_SET_AUTORELOAD(h, v)	((h)->Instance->ARR = (v))
+#define __HAL_TIM_GET_AUTORELOAD(h)		((h)->Instance->ARR)
+#define __HAL_TIM_SET_PRESCALER(h, v)	((h)->Instance->PSC = (v))
+#define __HAL_TIM_SET_COMPARE(h, c, v)	((h)->Instance->CCR1 = (v))
+#define __HAL_TIM_CLEAR_FLAG(h, f)		((h)->Instance->SR = ~(f))
+#define __HAL_UART_CLEAR_OREFLAG(h)		((void)(h))
+
+/* ################ HAL ################ */
+HAL_StatusTypeDef HAL_HalfDuplex_Init(UART_HandleTypeDef* huart);
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef* huart);
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef* huart, const uint8_t* data, uint16_t size);
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef* huart, uint8_t* data, uint16_t size);
+HAL_StatusTypeDef HAL_UART_Abort(UART_HandleTypeDef* huart);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef* huart, const uint8_t* data, uint16_t size);
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef* huart, uint8_t* data, uint16_t size);
+
+void HAL_UART_TxHalfCpltCallback(UART_HandleTypeDef* huart);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart);
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart);
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef* huart, uint16_t size);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart);
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef* htim, uint32_t channel);
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef* htim, uint32_t channel);
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef* htim);
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* port, uint16_t pin, GPIO_PinState state);
+uint32_t HAL_RCC_GetPCLK1Freq(void);
+uint32_t HAL_GetTick(void);
+
+/* ################ CMSIS core ################ */
+#define __weak						__attribute__((weak))
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+uint32_t __get_IPSR(void);
+uint32_t __LDREXW(volatile uint32_t* address);
+uint32_t __STREXW(uint32_t value, volatile uint32_t* address);
+void __CLREX(void);
+
+/* Single instruction on the target, swaps of ever larger groups here */
+static inline uint32_t __RBIT(uint32_t value)
+{
+	value = ((value >> 1) & 0x55555555u) | ((value & 0x55555555u) << 1);
+	value = ((value >> 2) & 0x33333333u) | ((value & 0x33333333u) << 2);
+	value = ((value >> 4) & 0x0F0F0F0Fu) | ((value & 0x0F0F0F0Fu) << 4);
+	return __builtin_bswap32(value);
+}
+
+static inline uint32_t __CLZ(uint32_t value)
+{
+	return (value != 0) ? (uint32_t)__builtin_clz(value) : 32u;
+}
+
+static inline void __DMB(void)
+{
+	__sync_synchronize();
+}
+
+static inline void __DSB(void)
+{
+	__sync_synchronize();
+}
+
+#endif /* TMC_SIM_STM32F1XX_HAL_H_ */
@@ -0,0 +1,266 @@
+/*
+ * tmc_sim.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ *
+ * Register level model of one TMC2226 node, written from the datasheet rather than from
+ * TMC2226.c so driver mistakes are not copied into it (CRC is the bitwise reference one)
+ */
+#include "tmc_sim.h"
+
+#include <string.h>
+#include "TMC2226_registers.h"
+
+/* Access of a register */
+#define R							0x01u		/* Readable */
+#define W							0x02u		/* Writable */
+#define C							0x04u		/* Write 1 to clear */
+
+typedef struct {
+	uint8_t address;
+	uint8_t access;
+	uint32_t reset_value;
+	uint32_t mask;								/* Bits a read returns */
+} SimRegister;
+
+/* Every register of the datasheet, the rest of the address space reads 0 and ignores writes */
+static const SimRegister sim_registers[] = {
+	{ 0x00, R | W, 0x00000101u, TMC_GCONF_MASK },		/* GCONF, pdn_disable=0 and multistep_filt=1 */
+	{ 0x01, R | C, 0x00000001u, TMC_GSTAT_MASK },		/* GSTAT, reset flag set after power on */
+	{ 0x02, R,     0x00000000u, TMC_IFCNT_MASK },		/* IFCNT */
+	{ 0x03, W,     0x00000000u, 0x00000F00u },			/* NODECONF */
+	{ 0x04, W,     0x00000000u, 0x00000000u },			/* OTP_PROG */
+	{ 0x05, R,     0x0000000Fu, TMC_OTP_READ_MASK },	/* OTP_READ */
+	{ 0x06, R,     0x21000040u, TMC_IOIN_MASK },		/* IOIN, VERSION 0x21 and PDN_UART high */
+	{ 0x07, R | W, 0x0000000Fu, TMC_FACTORY_CONF_MASK },	/* FACTORY_CONF */
+	{ 0x10, W,     0x00011F10u, 0x000F1F1Fu },			/* IHOLD_IRUN */
+	{ 0x11, W,     0x00000014u, 0x000000FFu },			/* TPOWERDOWN */
+	{ 0x12, R,     0x000FFFFFu, TMC_TSTEP_MASK },		/* TSTEP */
+	{ 0x13, W,     0x00000000u, 0x000FFFFFu },			/* TPWMTHRS */
+	{ 0x14, W,     0x00000000u, 0x000FFFFFu },			/* TCOOLTHRS */
+	{ 0x22, W,     0x00000000u, 0x00FFFFFFu },			/* VACTUAL */
+	{ 0x40, W,     0x00000000u, 0x000000FFu },			/* SGTHRS */
+	{ 0x41, R,     0x00000000u, TMC_SG_RESULT_MASK },	/* SG_RESULT */
+	{ 0x42, W,     0x00000000u, 0x0000EF6Fu },			/* COOLCONF */
+	{ 0x6A, R,     0x00000000u, TMC_MSCNT_MASK },		/* MSCNT */
+	{ 0x6B, R,     0x000000F7u, TMC_MSCURACT_MASK },	/* MSCURACT */
+	{ 0x6C, R | W, 0x10000053u, TMC_CHOPCONF_MASK },	/* CHOPCONF */
+	{ 0x6F, R,     0x00000000u, TMC_DRV_STATUS_MASK },	/* DRV_STATUS */
+	{ 0x70, R | W, 0xC10D0024u, TMC_PWMCONF_MASK },		/* PWMCONF */
+	{ 0x71, R,     0x00000000u, TMC_PWM_SCALE_MASK },	/* PWM_SCALE */
+	{ 0x72, R,     0x00000000u, TMC_PWM_AUTO_MASK }		/* PWM_AUTO */
+};
+
+#define SIM_REGISTER_COUNT			(sizeof(sim_registers) / sizeof(sim_registers[0]))
+
+/* Register addresses the model derives values for */
+#define SIM_GSTAT					0x01u
+#define SIM_IFCNT					0x02u
+#define SIM_NODECONF				0x03u
+#define SIM_IOIN					0x06u
+#define SIM_IHOLD_IRUN				0x10u
+#define SIM_TSTEP					0x12u
+#define SIM_VACTUAL					0x22u
+#define SIM_DRV_STATUS				0x6Fu
+
+static const SimRegister* find_register(uint8_t register_address);
+static uint32_t tstep_for(int32_t vactual);
+
+
+/* ################ API ################*/
+
+/**
+ * \brief			Puts node into its power on state
+ * \param[in,out]	node: node to be reset, fault injection is switched off
+ * \param[in]		address: node address 0..3
+ */
+void tmc_sim_node_init(TMC_SimNode* node, uint8_t address)
+{
+	memset(node, 0, sizeof(TMC_SimNode));
+	node->address = address;
+	for (uint8_t i = 0; i < SIM_REGISTER_COUNT; i++)
+	{
+		node->registers[sim_registers[i].address] = sim_registers[i].reset_value;
+	}
+}
+
+/**
+ * \brief			Feeds one datagram seen on the line to the node
+ * \param[in,out]	node: receiving node
+ * \param[in]		datagram: whole datagram as it travelled over the wire
+ * \param[in]		length: 4 for read request, 8 for write access
+ * \param[in]		baud_rate: rate the datagram was sent at
+ * \param[out]		reply: up to TMC_SIM_MAX_REPLY bytes, filled only when a reply is due
+ * \param[out]		delay_bits: bit times between end of the request and start of the reply
+ * \return			Length of the reply, 0 when the node stays quiet
+ * \note			Like the chip, anything not addressed to the node, with wrong sync or CRC
+ * 					is dropped without reply. Writes to read only registers are dropped too and
+ * 					do not advance IFCNT
+ */
+uint8_t tmc_sim_node_receive(TMC_SimNode* node, const uint8_t* datagram, uint8_t length,
+		uint32_t baud_rate, uint8_t* reply, uint32_t* delay_bits)
+{
+	if (node->silent || (length != 4 && length != 8) || (datagram[0] & 0x0F) != 0x05
+			|| datagram[1] != node->address)
+	{
+		return 0;
+	}
+	if (node->max_baud_rate != 0 && baud_rate > node->max_baud_rate)
+	{
+		node->ignored++;
+		return 0;
+	}
+	if (tmc_sim_crc(datagram, length - 1) != datagram[length - 1])
+	{
+		node->crc_errors++;
+		return 0;
+	}
+
+	uint8_t register_address = datagram[2] & 0x7F;
+	const SimRegister* reg = find_register(register_address);
+	if (length == 8)
+	{
+		if (!(datagram[2] & 0x80) || reg == NULL || !(reg->access & (W | C)))
+		{
+			node->ignored++;
+			return 0;
+		}
+		if (node->lose_write_every != 0 && ((node->writes + node->lost + 1u) % node->lose_write_every) == 0)
+		{
+			node->lost++;
+			return 0;
+		}
+		uint32_t data = ((uint32_t)datagram[3] << 24) | ((uint32_t)datagram[4] << 16)
+				| ((uint32_t)datagram[5] << 8) | datagram[6];
+		if (reg->access & C)
+		{
+			node->registers[register_address] &= ~data;
+		}
+		else
+		{
+			node->registers[register_address] = data;
+		}
+		node->interface_counter++;
+		node->writes++;
+		return 0;
+	}
+
+	if (datagram[2] & 0x80)
+	{
+		node->ignored++;
+		return 0;
+	}
+	uint32_t data = tmc_sim_node_read(node, register_address);
+	uint8_t noise = 0;
+	if (node->noise_every != 0 && ((node->reads + 1u) % node->noise_every) == 0)
+	{
+		// Glitch the receiver has to skip, then sync that is not followed by master address
+		reply[noise++] = 0x5A;
+		reply[noise++] = 0x05;
+		node->noisy++;
+	}
+	reply += noise;
+	reply[0] = 0x05;
+	reply[1] = 0xFF;							/* Master address */
+	reply[2] = register_address;
+	reply[3] = (data >> 24) & 0xFF;
+	reply[4] = (data >> 16) & 0xFF;
+	reply[5] = (data >> 8) & 0xFF;
+	reply[6] = data & 0xFF;
+	reply[7] = tmc_sim_crc(reply, 7);
+	node->reads++;
+	if (node->corrupt_every != 0 && (node->reads % node->corrupt_every) == 0)
+	{
+		reply[7] ^= 0x01;
+		node->corrupted++;
+	}
+
+	// SENDDELAY 0,1 wait 8 bit times, 2,3 wait 3*8, up to 15 with 15*8
+	uint32_t senddelay = TMC_FIELD_GET(node->registers[SIM_NODECONF], TMC_NODECONF_SENDDELAY);
+	*delay_bits = (2u * (senddelay / 2u) + 1u) * 8u;
+	return 8u + noise;
+}
+
+/**
+ * \brief			Returns value a read access of given register would reply with
+ * \note			Write only registers and unused addresses read as 0
+ */
+uint32_t tmc_sim_node_read(TMC_SimNode* node, uint8_t register_address)
+{
+	const SimRegister* reg = find_register(register_address);
+	if (reg == NULL || !(reg->access & R))
+	{
+		return 0;
+	}
+
+	uint32_t value = node->registers[register_address];
+	int32_t vactual = ((int32_t)(node->registers[SIM_VACTUAL] << 8)) >> 8;
+	uint32_t ihold_irun = node->registers[SIM_IHOLD_IRUN];
+	switch (register_address)
+	{
+		case SIM_IFCNT:
+			value = node->interface_counter;
+			break;
+		case SIM_IOIN:
+			value |= (node->address & 0x01u) ? TMC_IOIN_MS1_Msk : 0;
+			value |= (node->address & 0x02u) ? TMC_IOIN_MS2_Msk : 0;
+			break;
+		case SIM_TSTEP:
+			value = tstep_for(vactual);
+			break;
+		case SIM_DRV_STATUS:
+			value = TMC_FIELD_SET(TMC_DRV_STATUS_CS_ACTUAL, (vactual != 0)
+					? TMC_FIELD_GET(ihold_irun, TMC_IHOLD_IRUN_IRUN)
+					: TMC_FIELD_GET(ihold_irun, TMC_IHOLD_IRUN_IHOLD));
+			value |= (vactual == 0) ? TMC_DRV_STATUS_STST_Msk : 0;
+			break;
+		default:
+			break;
+	}
+	return value & reg->mask;
+}
+
+/**
+ * \brief			Datasheet CRC8 of given bytes, fed LSB first into polynomial x^8 + x^2 + x + 1
+ */
+uint8_t tmc_sim_crc(const uint8_t* data, uint8_t length)
+{
+	uint8_t crc = 0;
+	for (uint8_t i = 0; i < length; i++)
+	{
+		uint8_t byte = data[i];
+		for (uint8_t bit = 0; bit < 8; bit++)
+		{
+			crc = ((crc >> 7) ^ (byte & 0x01)) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+			byte >>= 1;
+		}
+	}
+	return crc;
+}
+
+
+/* ################ Private functions ################ */
+static const SimRegister* find_register(uint8_t register_address)
+{
+	for (uint8_t i = 0; i < SIM_REGISTER_COUNT; i++)
+	{
+		if (sim_registers[i].address == register_address)
+		{
+			return &sim_registers[i];
+		}
+	}
+	return NULL;
+}
+
+/* Time between microsteps in internal clock periods, one VACTUAL LSB is fCLK / 2^24 microsteps/s */
+static uint32_t tstep_for(int32_t vactual)
+{
+	uint32_t magnitude = (vactual < 0) ? -(uint32_t)vactual : (uint32_t)vactual;
+	if (magnitude == 0)
+	{
+		return TMC_TSTEP_MASK;
+	}
+	uint32_t tstep = (1u << 24) / magnitude;
+	return (tstep > TMC_TSTEP_MASK) ? TMC_TSTEP_MASK : tstep;
+}
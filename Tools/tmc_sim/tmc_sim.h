@@ -0,0 +1,91 @@
+/*
+ * tmc_sim.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ *
+ * Host model of TMC2226 nodes on a single wire UART line, lets TMC2226.c and the bus layer
+ * run on Linux without a board. Node part (tmc_sim.c) only turns datagrams into replies,
+ * line part (sim_hal.c) puts them on the simulated wire behind the mock HAL UART.
+ * Console part (sim_hal.c) stands in for USART2 with its DMA, host tools feed it and read it
+ */
+
+#ifndef TMC_SIM_H_
+#define TMC_SIM_H_
+
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+
+/* Register addresses are 7 bit */
+#define TMC_SIM_REGISTER_COUNT		128u
+
+/* Nodes one line can carry, ADDR_0..ADDR_3 */
+#define TMC_SIM_LINE_NODES			4u
+
+/* Lines that can exist at once, one per UART */
+#define TMC_SIM_MAX_LINES			4u
+
+/* Longest reply a node puts on the line, 8 byte datagram preceded by injected noise */
+#define TMC_SIM_MAX_REPLY			10u
+
+/**
+ * \brief			Simulated TMC2226, fields may be changed between transfers to set up a scenario
+ * \note			Registers hold what was written, readable values are derived from them when
+ * 					read (IFCNT, TSTEP, DRV_STATUS, IOIN). Counters are updated by the line thread
+ */
+typedef struct {
+	uint8_t address;							/* Node address set by MS1 and MS2 */
+	uint32_t registers[TMC_SIM_REGISTER_COUNT];
+	uint8_t interface_counter;					/* IFCNT, counts accepted writes */
+
+	/* Fault injection */
+	uint32_t corrupt_every;						/* Every n-th reply goes out with wrong CRC, 0 never */
+	uint32_t noise_every;						/* Every n-th reply is preceded by junk and a false sync byte, 0 never */
+	uint32_t lose_write_every;					/* Every n-th write is dropped as if its CRC was wrong, 0 never */
+	uint8_t silent;								/* Node ignores everything, like a cut wire */
+	uint8_t jam_line;							/* Node holds the line, every datagram ends in a framing error */
+	uint32_t max_baud_rate;						/* Datagrams above this rate are not understood, 0 no limit */
+
+	/* Counters */
+	uint32_t reads;
+	uint32_t writes;
+	uint32_t crc_errors;						/* Datagrams dropped for wrong CRC */
+	uint32_t ignored;							/* Datagrams for other nodes, read only targets, rate too high */
+	uint32_t corrupted;							/* Replies sent with wrong CRC on purpose */
+	uint32_t noisy;								/* Replies preceded by noise on purpose */
+	uint32_t lost;								/* Writes dropped on purpose */
+} TMC_SimNode;
+
+
+/* Called by the line thread with every datagram the master put on the wire, replies excluded */
+typedef void (*TMC_SimLineMonitor)(UART_HandleTypeDef* huart, const uint8_t* datagram, uint8_t length);
+
+
+/* ################ Node ################ */
+void tmc_sim_node_init(TMC_SimNode* node, uint8_t address);
+
+uint8_t tmc_sim_node_receive(TMC_SimNode* node, const uint8_t* datagram, uint8_t length,
+		uint32_t baud_rate, uint8_t* reply, uint32_t* delay_bits);
+
+uint32_t tmc_sim_node_read(TMC_SimNode* node, uint8_t register_address);
+
+uint8_t tmc_sim_crc(const uint8_t* data, uint8_t length);
+
+/* ################ Line ################ */
+void tmc_sim_line_attach(UART_HandleTypeDef* huart, TMC_SimNode* node);
+
+void tmc_sim_line_set_time_scale(double scale);
+
+void tmc_sim_line_set_monitor(TMC_SimLineMonitor monitor);
+
+/* ################ Console ################ */
+void tmc_sim_console_attach(UART_HandleTypeDef* huart, int fd);
+
+void tmc_sim_console_receive(UART_HandleTypeDef* huart, const uint8_t* data, uint16_t length);
+
+void tmc_sim_console_drain(UART_HandleTypeDef* huart);
+
+/* ################ OS ################ */
+void tmc_sim_os_set_timeouts(double scale, uint32_t slack_ms);
+
+#endif /* TMC_SIM_H_ */
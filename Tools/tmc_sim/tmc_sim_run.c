@@ -0,0 +1,702 @@
+/*
+ * tmc_sim_run.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ *
+ * Runs unmodified TMC2226 driver and bus layer against simulated node on huart1 and reports
+ * throughput and latency of read_access and write_access, see tmc_sim.h
+ *
+ * Build:	gcc -O2 -pthread -I. -I../../Core/Inc -o tmc_sim_run tmc_sim_run.c tmc_sim.c sim_hal.c sim_os.c \
+ * 			../../Core/Src/TMC2226.c ../../Core/Src/TMC2226_bus.c ../../Core/Src/TMC2226_step.c \
+ * 			../../Core/Src/TMC2226_motion.c ../../Core/Src/TMC2226_axes.c ../../Core/Src/TMC2226_capture.c
+ * Run:		./tmc_sim_run [-n transfers] [-b baud] [-s time scale] [-c corrupt every n] [-j noise every n]
+ * 			[-m max node baud] [-l] [-a axes] [-u buses] [-t timeout slack ms] [-p]
+ *
+ * -s 0 drops wire time entirely, what is left is the cost of the software path.
+ * -l runs TMC_link_bringup first, with -m it has to settle below the node limit.
+ * -j puts a glitch and a false sync byte before every n-th reply, the bus receiver has to skip them.
+ * -a adds a phase reading IFCNT of that many axes in batches of TMC_axes_read, spread over -u buses
+ * (huart1, huart3), reads/s of -u 2 against -u 1 shows how throughput scales with buses.
+ * -t adds slack to every driver timeout (default 50 ms), timeouts are also stretched by -s above 1.
+ * Driver margin is a few ms, host scheduling jitter alone would fail transfers of a clean line.
+ * -p adds nodes 1-3 to huart1 and runs a scenario mixing all priorities with mailbox setpoints:
+ * transfers queued behind a timeout leave by priority, a full mailbox and queued reads take turns,
+ * per node stats match the datagrams seen on the wire. Any failed check makes exit status 1.
+ * Failed counts transfers the driver saw fail (timeout, CRC), mismatch the ones it took for good
+ * although the value differs from the node model. Exit status is 1 when there is any mismatch,
+ * or any failure while no fault is injected (-c, -j, -m below the rate in use)
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "TMC2226.h"
+#include "TMC2226_axes.h"
+#include "tmc_sim.h"
+
+/**
+ * \brief			Latency of one kind of transfer
+ */
+typedef struct {
+	const char* name;
+	uint32_t count;
+	uint32_t failures;							/* Driver noticed the transfer went wrong */
+	uint32_t mismatches;						/* Driver took wrong value for a good one */
+	uint64_t total_ns;
+	uint64_t min_ns;
+	uint64_t max_ns;
+	uint32_t wire_bits;							/* Theoretical bit times on the wire per transfer */
+} Measurement;
+
+static TMC_HandleTypeDef htmc;
+static TMC_SimNode node;
+static TMC_AxesTypeDef haxes;
+static TMC_HandleTypeDef axis_handles[TMC_AXES_MAX];
+static TMC_SimNode axis_nodes[TMC_AXES_MAX];
+
+/* Master datagrams of the scenario in wire order, filled by the line monitor */
+#define SCENARIO_LOG_LENGTH		65536u
+#define SCENARIO_READS			7u
+
+typedef struct {
+	uint8_t node;
+	uint8_t register_byte;						/* Register address with the write bit */
+} ScenarioEntry;
+
+static TMC_HandleTypeDef* scenario_handles[TMC_BUS_NODE_COUNT];
+static TMC_SimNode* scenario_nodes[TMC_BUS_NODE_COUNT];
+static TMC_HandleTypeDef scenario_extra_handles[TMC_BUS_NODE_COUNT];
+static TMC_SimNode scenario_extra_nodes[TMC_BUS_NODE_COUNT];
+static ScenarioEntry scenario_log[SCENARIO_LOG_LENGTH];
+static uint32_t scenario_log_count;
+static volatile uint8_t poster_stop;
+static volatile uint8_t poster_done;
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/* read_access hides the status, the bus counts every failed transfer of the node */
+static uint32_t bus_failures(void)
+{
+	TMC_BusNodeStats stats;
+	TMC_bus_get_node_stats(htmc.hbus, TMC2226_ADDR_0, &stats);
+	return stats.failures;
+}
+
+static void record(Measurement* measurement, uint64_t start_ns)
+{
+	uint64_t elapsed = now_ns() - start_ns;
+	measurement->count++;
+	measurement->total_ns += elapsed;
+	if (measurement->count == 1 || elapsed < measurement->min_ns)
+	{
+		measurement->min_ns = elapsed;
+	}
+	if (elapsed > measurement->max_ns)
+	{
+		measurement->max_ns = elapsed;
+	}
+}
+
+static void report(const Measurement* measurement, uint64_t elapsed_ns, uint32_t baud_rate)
+{
+	double mean_us = (double)measurement->total_ns / measurement->count / 1000.0;
+	double wire_us = (double)measurement->wire_bits * 1e6 / baud_rate;
+	printf("%-6s %7u  %8.0f/s  mean %7.1f us  min %7.1f us  max %8.1f us  wire %6.1f us %6.1f%%  failed %u  mismatch %u\n",
+			measurement->name, measurement->count, measurement->count * 1e9 / (double)elapsed_ns,
+			mean_us, measurement->min_ns / 1000.0, measurement->max_ns / 1000.0, wire_us,
+			100.0 * wire_us / mean_us, measurement->failures, measurement->mismatches);
+}
+
+/* Reads IFCNT, node counter is stable because nothing else writes meanwhile */
+static void run_reads(Measurement* measurement, uint32_t transfers)
+{
+	uint8_t senddelay = TMC_FIELD_GET(htmc.shadow[SHADOW_NODECONF], TMC_NODECONF_SENDDELAY);
+	measurement->name = "read";
+	measurement->wire_bits = 4 * 10 + (senddelay | 0x01) * 8 + 8 * 10;
+	for (uint32_t i = 0; i < transfers; i++)
+	{
+		uint32_t failures = bus_failures();
+		uint64_t start = now_ns();
+		uint32_t value = read_access(&htmc, R_IFCNT);
+		record(measurement, start);
+		if (bus_failures() != failures)
+		{
+			measurement->failures++;
+		}
+		else if (value != node.interface_counter)
+		{
+			measurement->mismatches++;
+		}
+	}
+}
+
+/* Toggles I_scale_analog of GCONF, every write has to land in the node */
+static void run_writes(Measurement* measurement, uint32_t transfers)
+{
+	measurement->name = "write";
+	measurement->wire_bits = 8 * 10;
+	uint32_t gconf = htmc.shadow[SHADOW_GCONF];
+	for (uint32_t i = 0; i < transfers; i++)
+	{
+		uint32_t value = gconf ^ ((i & 1u) ? TMC_GCONF_I_SCALE_ANALOG_Msk : 0);
+		uint64_t start = now_ns();
+		write_access(&htmc, W_GCONF, value);
+		record(measurement, start);
+		// Failed write leaves the register dirty, a completed one has to be in the node already
+		if (htmc.dirty & (1u << SHADOW_GCONF))
+		{
+			measurement->failures++;
+		}
+		else if (node.registers[W_GCONF] != value)
+		{
+			measurement->mismatches++;
+		}
+	}
+	write_access(&htmc, W_GCONF, gconf);
+}
+
+/* Write followed by readback of the same register, what TMC_flush_verified does per register */
+static void run_round_trips(Measurement* measurement, uint32_t transfers)
+{
+	uint8_t senddelay = TMC_FIELD_GET(htmc.shadow[SHADOW_NODECONF], TMC_NODECONF_SENDDELAY);
+	measurement->name = "w+r";
+	measurement->wire_bits = 8 * 10 + 4 * 10 + (senddelay | 0x01) * 8 + 8 * 10;
+	for (uint32_t i = 0; i < transfers; i++)
+	{
+		uint32_t value = (htmc.shadow[SHADOW_CHOPCONF] & ~TMC_CHOPCONF_TOFF_Msk) | TMC_FIELD_SET(TMC_CHOPCONF_TOFF, 1 + i % 15);
+		uint32_t failures = bus_failures();
+		uint64_t start = now_ns();
+		write_access(&htmc, W_CHOPCONF, value);
+		uint32_t readback = read_access(&htmc, R_CHOPCONF);
+		record(measurement, start);
+		if (bus_failures() != failures)
+		{
+			measurement->failures++;
+		}
+		else if (readback != (value & TMC_CHOPCONF_MASK))
+		{
+			measurement->mismatches++;
+		}
+	}
+}
+
+/* Batches of IFCNT reads over all axes, every batch has to return the counter of every node */
+static void run_axes(Measurement* measurement, uint32_t transfers, uint8_t axis_count, uint8_t bus_count)
+{
+	UART_HandleTypeDef* const huarts[] = { &huart1, &huart3 };
+	huart3.Init.BaudRate = TMC_bus_get_baud_rate(htmc.hbus);
+	TMC_axes_init(&haxes, huarts, bus_count);
+	for (uint8_t axis = 0; axis < axis_count; axis++)
+	{
+		TMC2226_NodeAddress address = (TMC2226_NodeAddress)(axis / bus_count);
+		// Node of the first phases already sits at address 0 of huart1
+		if (axis != 0)
+		{
+			tmc_sim_node_init(&axis_nodes[axis], address);
+			tmc_sim_line_attach(huarts[axis % bus_count], &axis_nodes[axis]);
+		}
+		TMC_axes_add(&haxes, &axis_handles[axis], &htim2, 200);
+	}
+
+	// Batch lasts as long as the reads of the bus with the most axes
+	uint8_t senddelay = TMC_FIELD_GET(htmc.shadow[SHADOW_NODECONF], TMC_NODECONF_SENDDELAY);
+	measurement->name = "axes";
+	measurement->wire_bits = (4 * 10 + (senddelay | 0x01) * 8 + 8 * 10) * ((axis_count + bus_count - 1) / bus_count);
+	uint32_t values[TMC_AXES_MAX];
+	for (uint32_t i = 0; i < transfers / axis_count; i++)
+	{
+		uint64_t start = now_ns();
+		TMC_BusStatus status = TMC_axes_read(&haxes, R_IFCNT, values);
+		record(measurement, start);
+		for (uint8_t axis = 0; axis < axis_count; axis++)
+		{
+			TMC_SimNode* axis_node = (axis == 0) ? &node : &axis_nodes[axis];
+			if (status != TMC_BUS_OK || haxes.reads[axis].transfer.status != TMC_BUS_OK)
+			{
+				measurement->failures++;
+			}
+			else if (values[axis] != axis_node->interface_counter)
+			{
+				measurement->mismatches++;
+			}
+		}
+	}
+}
+
+static void scenario_monitor(UART_HandleTypeDef* huart, const uint8_t* datagram, uint8_t length)
+{
+	(void)huart;
+	(void)length;
+	uint32_t index = __atomic_fetch_add(&scenario_log_count, 1, __ATOMIC_RELAXED);
+	if (index < SCENARIO_LOG_LENGTH)
+	{
+		scenario_log[index].node = datagram[1];
+		scenario_log[index].register_byte = datagram[2];
+	}
+}
+
+static uint32_t scenario_logged(void)
+{
+	return __atomic_load_n(&scenario_log_count, __ATOMIC_ACQUIRE);
+}
+
+/* Waits until the monitor saw given number of datagrams, 0 when they did not come within a second */
+static uint8_t scenario_wait_logged(uint32_t count)
+{
+	for (uint32_t i = 0; i < 1000 && scenario_logged() < count; i++)
+	{
+		osDelay(1);
+	}
+	return scenario_logged() >= count;
+}
+
+/* Fills transfer with register access to given node, register_byte carries the write bit */
+static void scenario_transfer(TMC_TransferTypeDef* transfer, uint8_t node_address, uint8_t register_byte,
+		uint32_t value, TMC_BusPriority priority)
+{
+	uint8_t write = (register_byte & TMC2226_WRITE) != 0;
+	transfer->tx_datagram[0] = TMC2226_SYNC;
+	transfer->tx_datagram[1] = node_address;
+	transfer->tx_datagram[2] = register_byte;
+	transfer->tx_datagram[3] = value >> 24;
+	transfer->tx_datagram[4] = value >> 16;
+	transfer->tx_datagram[5] = value >> 8;
+	transfer->tx_datagram[6] = value;
+	transfer->tx_length = write ? 8 : 4;
+	transfer->tx_datagram[transfer->tx_length - 1] = calculate_CRC(transfer->tx_datagram, transfer->tx_length);
+	transfer->rx_length = write ? 0 : 8;
+	transfer->priority = priority;
+	transfer->timeout = TMC_bus_wire_time_ms(htmc.hbus, 10u * (transfer->tx_length + transfer->rx_length) + 8u * 15u)
+			+ TMC_BUS_TIMEOUT_MARGIN_MS;
+}
+
+/* Streams changing VACTUAL setpoints to every node as fast as it can until told to stop */
+static void scenario_poster(void* argument)
+{
+	(void)argument;
+	for (int32_t i = 1; !poster_stop; i++)
+	{
+		for (uint8_t node_address = 0; node_address < TMC_BUS_NODE_COUNT; node_address++)
+		{
+			int32_t milli_rpm = 1000 + (i % 1000) * 10 + node_address;
+			TMC_set_speed_mrpm(scenario_handles[node_address], milli_rpm);
+		}
+		if ((i & 0x3F) == 0)
+		{
+			osDelay(0);
+		}
+	}
+	poster_done = 1;
+}
+
+/* Logs scenario failure, returns 1 so callers can sum them */
+static uint32_t scenario_fail(const char* message, uint32_t detail)
+{
+	fprintf(stderr, "scenario: %s (%u)\n", message, detail);
+	return 1;
+}
+
+/*
+ * Drives 4 nodes with queued transfers of all priorities and mailbox setpoints at once:
+ * - ordering: transfers queued behind a read that times out on a silent node leave the wire
+ *   by priority, FIFO within a priority
+ * - alternation: while the poster keeps every mailbox full, queued reads still get every
+ *   other turn and the mailbox never gets two in a row, the newest setpoint lands in the end
+ * - stats: per node transfer counts match the datagrams seen on the wire, only the reads
+ *   to the silent node failed
+ * Returns number of failed checks
+ */
+static uint32_t run_scenario(void)
+{
+	uint32_t failures = 0;
+	scenario_handles[0] = &htmc;
+	scenario_nodes[0] = &node;
+	for (uint8_t node_address = 1; node_address < TMC_BUS_NODE_COUNT; node_address++)
+	{
+		scenario_handles[node_address] = &scenario_extra_handles[node_address];
+		scenario_nodes[node_address] = &scenario_extra_nodes[node_address];
+		tmc_sim_node_init(scenario_nodes[node_address], node_address);
+		tmc_sim_line_attach(&huart1, scenario_nodes[node_address]);
+		TMC_Init(scenario_handles[node_address], (TMC2226_NodeAddress)node_address, &htim2, &huart1, 200);
+	}
+	TMC_SimNode* silent_node = scenario_nodes[TMC_BUS_NODE_COUNT - 1];
+	uint32_t baud_rate = TMC_bus_get_baud_rate(htmc.hbus);
+	TMC_bus_reset_stats(htmc.hbus);
+	tmc_sim_line_set_monitor(scenario_monitor);
+
+	// Ordering: reads LOW, configuration NORMAL, setpoints HIGH, all submitted while the wire is taken
+	TMC_TransferTypeDef blocker;
+	TMC_TransferTypeDef writes[TMC_BUS_PRIORITY_COUNT - 1][TMC_BUS_NODE_COUNT];
+	TMC_ReadFuture reads[SCENARIO_READS];
+	silent_node->silent = 1;
+	scenario_transfer(&blocker, silent_node->address, R_IFCNT, 0, TMC_BUS_PRIORITY_NORMAL);
+	TMC_bus_submit(htmc.hbus, &blocker);
+	if (!scenario_wait_logged(1))
+	{
+		return scenario_fail("blocking read never reached the wire", 0);
+	}
+	for (uint8_t node_address = 0; node_address < TMC_BUS_NODE_COUNT - 1; node_address++)
+	{
+		TMC_read_async(scenario_handles[node_address], R_IFCNT, &reads[node_address]);
+	}
+	for (uint8_t node_address = 0; node_address < TMC_BUS_NODE_COUNT; node_address++)
+	{
+		scenario_transfer(&writes[1][node_address], node_address, W_TPOWERDOWN | TMC2226_WRITE,
+				0x40 + node_address, TMC_BUS_PRIORITY_NORMAL);
+		TMC_bus_submit(htmc.hbus, &writes[1][node_address]);
+		scenario_transfer(&writes[0][node_address], node_address, W_VACTUAL | TMC2226_WRITE,
+				0x100 * (node_address + 1), TMC_BUS_PRIORITY_HIGH);
+		TMC_bus_submit(htmc.hbus, &writes[0][node_address]);
+	}
+	if (TMC_bus_await(&blocker) != TMC_BUS_TIMEOUT)
+	{
+		failures += scenario_fail("read of the silent node did not time out", blocker.status);
+	}
+	for (uint8_t node_address = 0; node_address < TMC_BUS_NODE_COUNT; node_address++)
+	{
+		failures += (TMC_bus_await(&writes[0][node_address]) != TMC_BUS_OK)
+				? scenario_fail("HIGH write failed on node", node_address) : 0;
+		failures += (TMC_bus_await(&writes[1][node_address]) != TMC_BUS_OK)
+				? scenario_fail("NORMAL write failed on node", node_address) : 0;
+	}
+	failures += (TMC_read_await_all(reads, TMC_BUS_NODE_COUNT - 1) != TMC_BUS_OK)
+			? scenario_fail("LOW read failed", 0) : 0;
+
+	const ScenarioEntry expected[] = {
+		{ 0, W_VACTUAL | TMC2226_WRITE }, { 1, W_VACTUAL | TMC2226_WRITE },
+		{ 2, W_VACTUAL | TMC2226_WRITE }, { 3, W_VACTUAL | TMC2226_WRITE },
+		{ 0, W_TPOWERDOWN | TMC2226_WRITE }, { 1, W_TPOWERDOWN | TMC2226_WRITE },
+		{ 2, W_TPOWERDOWN | TMC2226_WRITE }, { 3, W_TPOWERDOWN | TMC2226_WRITE },
+		{ 0, R_IFCNT }, { 1, R_IFCNT }, { 2, R_IFCNT }
+	};
+	uint32_t expected_count = sizeof(expected) / sizeof(expected[0]);
+	if (scenario_logged() != 1 + expected_count)
+	{
+		failures += scenario_fail("unexpected datagram count in ordering phase", scenario_logged());
+	}
+	for (uint32_t i = 0; i < expected_count && i + 1 < scenario_logged(); i++)
+	{
+		if (scenario_log[i + 1].node != expected[i].node || scenario_log[i + 1].register_byte != expected[i].register_byte)
+		{
+			failures += scenario_fail("datagram out of priority order at position", i);
+		}
+	}
+	for (uint8_t node_address = 0; node_address < TMC_BUS_NODE_COUNT - 1; node_address++)
+	{
+		if (scenario_nodes[node_address]->registers[W_TPOWERDOWN] != 0x40u + node_address
+				|| scenario_nodes[node_address]->registers[W_VACTUAL] != 0x100u * (node_address + 1))
+		{
+			failures += scenario_fail("write did not land in node", node_address);
+		}
+	}
+	printf("scenario ordering: %u datagrams behind a %u ms timeout, HIGH, NORMAL, LOW in submit order\n",
+			expected_count, blocker.timeout);
+
+	// Alternation: the poster keeps all mailboxes full while another read holds the wire
+	uint32_t phase_start = scenario_logged();
+	poster_stop = 0;
+	poster_done = 0;
+	const osThreadAttr_t poster_attributes = { .name = "poster" };
+	osThreadNew(scenario_poster, NULL, &poster_attributes);
+	scenario_transfer(&blocker, silent_node->address, R_IFCNT, 0, TMC_BUS_PRIORITY_NORMAL);
+	TMC_bus_submit(htmc.hbus, &blocker);
+	uint32_t blocker_index = phase_start;
+	for (uint32_t i = 0; i < 1000; i++)
+	{
+		for (; blocker_index < scenario_logged() && blocker_index < SCENARIO_LOG_LENGTH; blocker_index++)
+		{
+			if (scenario_log[blocker_index].node == silent_node->address && scenario_log[blocker_index].register_byte == R_IFCNT)
+			{
+				break;
+			}
+		}
+		if (blocker_index < scenario_logged())
+		{
+			break;
+		}
+		osDelay(1);
+	}
+	for (uint8_t i = 0; i < SCENARIO_READS; i++)
+	{
+		TMC_read_async(scenario_handles[i % (TMC_BUS_NODE_COUNT - 1)], R_IFCNT, &reads[i]);
+	}
+	// Starved transfers would wait forever, give them a second before the poster is stopped anyway
+	uint8_t ready = 0;
+	for (uint32_t i = 0; i < 1000 && !ready; i++)
+	{
+		ready = (blocker.status != TMC_BUS_PENDING);
+		if (ready)
+		{
+			// Setpoints the silent node dropped meanwhile are replaced by the poster before it stops
+			silent_node->silent = 0;
+		}
+		for (uint8_t read = 0; read < SCENARIO_READS; read++)
+		{
+			ready &= TMC_read_ready(&reads[read]);
+		}
+		osDelay(ready ? 0 : 1);
+	}
+	failures += ready ? 0 : scenario_fail("queued transfers starved by the mailbox", 0);
+	poster_stop = 1;
+	while (!poster_done)
+	{
+		osDelay(1);
+	}
+	TMC_bus_await(&blocker);
+	silent_node->silent = 0;
+	failures += (TMC_read_await_all(reads, SCENARIO_READS) != TMC_BUS_OK)
+			? scenario_fail("read failed while mailboxes were full", 0) : 0;
+
+	// Window runs from the blocking read to the last of the reads queued behind it
+	uint32_t window_end = 0;
+	uint32_t window_reads = 0;
+	uint32_t logged = scenario_logged() < SCENARIO_LOG_LENGTH ? scenario_logged() : SCENARIO_LOG_LENGTH;
+	for (uint32_t i = blocker_index + 1; i < logged && window_reads < SCENARIO_READS; i++)
+	{
+		if (scenario_log[i].register_byte == R_IFCNT)
+		{
+			window_reads++;
+			window_end = i;
+		}
+	}
+	uint32_t setpoints = 0;
+	uint32_t doubled = 0;
+	for (uint32_t i = blocker_index + 1; i <= window_end; i++)
+	{
+		if (scenario_log[i].register_byte == (W_VACTUAL | TMC2226_WRITE))
+		{
+			setpoints++;
+			doubled += (scenario_log[i - 1].register_byte == (W_VACTUAL | TMC2226_WRITE));
+		}
+	}
+	if (doubled != 0)
+	{
+		failures += scenario_fail("mailbox took two turns in a row while reads waited, times", doubled);
+	}
+	if (blocker_index >= logged || window_reads != SCENARIO_READS)
+	{
+		failures += scenario_fail("queued reads missing from the wire", window_reads);
+	}
+	if (setpoints < SCENARIO_READS - 1)
+	{
+		failures += scenario_fail("mailbox starved by queued reads, setpoints sent", setpoints);
+	}
+
+	// Newest setpoint of every node has to reach it once the bus drains
+	for (uint32_t i = 0; i < 1000; i++)
+	{
+		uint8_t full = 0;
+		for (uint8_t node_address = 0; node_address < TMC_BUS_NODE_COUNT; node_address++)
+		{
+			full |= htmc.hbus->mailbox[node_address][TMC_MAILBOX_VACTUAL].full;
+		}
+		if (!full)
+		{
+			break;
+		}
+		osDelay(1);
+	}
+	osDelay(TMC_bus_wire_time_ms(htmc.hbus, 10u * 8u) + TMC_BUS_TIMEOUT_MARGIN_MS);
+	for (uint8_t node_address = 0; node_address < TMC_BUS_NODE_COUNT; node_address++)
+	{
+		uint32_t expected_vactual = TMC_SHADOW(scenario_handles[node_address], VACTUAL) & TMC_VACTUAL_MASK;
+		if (scenario_nodes[node_address]->registers[W_VACTUAL] != expected_vactual)
+		{
+			failures += scenario_fail("newest setpoint did not reach node", node_address);
+		}
+	}
+	printf("scenario alternation: %u reads and %u setpoints after a %u ms timeout, %u setpoints in a row\n",
+			window_reads, setpoints, blocker.timeout, doubled);
+	tmc_sim_line_set_monitor(NULL);
+
+	// Stats: every datagram the wire saw is one completed transfer of its node
+	logged = scenario_logged();
+	if (logged > SCENARIO_LOG_LENGTH)
+	{
+		failures += scenario_fail("log overflow, datagrams", logged);
+		logged = SCENARIO_LOG_LENGTH;
+	}
+	uint32_t superseded = 0;
+	for (uint8_t node_address = 0; node_address < TMC_BUS_NODE_COUNT; node_address++)
+	{
+		uint32_t sent = 0;
+		for (uint32_t i = 0; i < logged; i++)
+		{
+			sent += (scenario_log[i].node == node_address);
+		}
+		TMC_BusNodeStats stats;
+		TMC_bus_get_node_stats(htmc.hbus, node_address, &stats);
+		uint32_t expected_failures = (node_address == silent_node->address) ? 2 : 0;
+		printf("scenario node %u: %u transfers, %u failed, %u superseded, latency mean %u us max %u us\n",
+				node_address, stats.transfers, stats.failures, stats.superseded,
+				stats.transfers ? stats.total_latency_us / stats.transfers : 0, stats.max_latency_us);
+		if (stats.transfers != sent)
+		{
+			failures += scenario_fail("node stats disagree with the wire, datagrams", sent);
+		}
+		if (stats.failures != expected_failures)
+		{
+			failures += scenario_fail("unexpected failures on node", node_address);
+		}
+		superseded += stats.superseded;
+	}
+	if (superseded == 0)
+	{
+		failures += scenario_fail("poster never overwrote a pending setpoint", 0);
+	}
+	if (TMC_bus_get_baud_rate(htmc.hbus) != baud_rate)
+	{
+		failures += scenario_fail("bus fell back, now at baud", TMC_bus_get_baud_rate(htmc.hbus));
+	}
+	return failures;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t transfers = 1000;
+	uint32_t baud_rate = 115200;
+	uint8_t bringup = 0;
+	double time_scale = 1.0;
+	uint32_t axis_count = 0;
+	uint32_t bus_count = 1;
+	uint32_t timeout_slack_ms = 50;
+	uint8_t scenario = 0;
+
+	tmc_sim_node_init(&node, TMC2226_ADDR_0);
+	int option;
+	while ((option = getopt(argc, argv, "n:b:s:c:j:m:la:u:t:p")) != -1)
+	{
+		switch (option)
+		{
+			case 'n':
+				transfers = strtoul(optarg, NULL, 0);
+				break;
+			case 'b':
+				baud_rate = strtoul(optarg, NULL, 0);
+				break;
+			case 's':
+				time_scale = strtod(optarg, NULL);
+				break;
+			case 'c':
+				node.corrupt_every = strtoul(optarg, NULL, 0);
+				break;
+			case 'j':
+				node.noise_every = strtoul(optarg, NULL, 0);
+				break;
+			case 'm':
+				node.max_baud_rate = strtoul(optarg, NULL, 0);
+				break;
+			case 'l':
+				bringup = 1;
+				break;
+			case 'a':
+				axis_count = strtoul(optarg, NULL, 0);
+				break;
+			case 'u':
+				bus_count = strtoul(optarg, NULL, 0);
+				break;
+			case 't':
+				timeout_slack_ms = strtoul(optarg, NULL, 0);
+				break;
+			case 'p':
+				scenario = 1;
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-n transfers] [-b baud] [-s time scale] [-c corrupt every n] "
+						"[-j noise every n] [-m max node baud] [-l] [-a axes] [-u buses] [-t timeout slack ms] [-p]\n",
+						argv[0]);
+				return 2;
+		}
+	}
+	if (bus_count == 0 || bus_count > 2 || axis_count > bus_count * TMC_BUS_NODE_COUNT)
+	{
+		fprintf(stderr, "buses have to be 1 or 2, axes at most %u per bus\n", TMC_BUS_NODE_COUNT);
+		return 2;
+	}
+	if (scenario && (axis_count != 0 || node.corrupt_every != 0 || node.noise_every != 0 || node.max_baud_rate != 0))
+	{
+		fprintf(stderr, "scenario needs all 4 addresses of huart1 and a clean line, -p excludes -a, -c, -j and -m\n");
+		return 2;
+	}
+	if (transfers == 0 || baud_rate == 0)
+	{
+		fprintf(stderr, "transfers and baud have to be above 0\n");
+		return 2;
+	}
+
+	tmc_sim_line_set_time_scale(time_scale);
+	tmc_sim_os_set_timeouts(time_scale, timeout_slack_ms);
+	tmc_sim_line_attach(&huart1, &node);
+	huart1.Init.BaudRate = baud_rate;
+	TMC_Init(&htmc, TMC2226_ADDR_0, &htim2, &huart1, 200);
+	if (htmc.dirty != 0)
+	{
+		fprintf(stderr, "TMC_Init left registers unwritten (dirty 0x%04X), node answers at %u baud?\n",
+				htmc.dirty, node.max_baud_rate);
+	}
+	if (bringup)
+	{
+		uint64_t start = now_ns();
+		uint32_t reliable = TMC_link_bringup(&htmc);
+		printf("link bring-up settled at %u baud in %.1f ms\n", reliable, (now_ns() - start) / 1e6);
+	}
+	baud_rate = TMC_bus_get_baud_rate(htmc.hbus);
+	TMC_bus_reset_stats(htmc.hbus);
+
+	printf("%u transfers per kind at %u baud, wire time x%.2f\n", transfers, baud_rate, time_scale);
+	Measurement measurements[3] = { 0 };
+	void (*runs[3])(Measurement*, uint32_t) = { run_reads, run_writes, run_round_trips };
+	uint32_t mismatches = 0;
+	uint32_t failures = 0;
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		uint64_t start = now_ns();
+		runs[i](&measurements[i], transfers);
+		report(&measurements[i], now_ns() - start, baud_rate);
+		mismatches += measurements[i].mismatches;
+		failures += measurements[i].failures;
+	}
+	if (axis_count != 0)
+	{
+		Measurement axes = { 0 };
+		uint64_t start = now_ns();
+		run_axes(&axes, transfers, (uint8_t)axis_count, (uint8_t)bus_count);
+		uint64_t elapsed = now_ns() - start;
+		report(&axes, elapsed, baud_rate);
+		printf("       batches of %u reads over %u buses, %.0f reads/s\n", axis_count, bus_count,
+				(double)axes.count * axis_count * 1e9 / (double)elapsed);
+		mismatches += axes.mismatches;
+		failures += axes.failures;
+	}
+
+	TMC_BusNodeStats stats;
+	TMC_bus_get_node_stats(htmc.hbus, TMC2226_ADDR_0, &stats);
+	printf("bus    %u transfers, %u failed, latency mean %u us max %u us, %u fallbacks, %u recoveries, now %u baud\n",
+			stats.transfers, stats.failures, stats.transfers ? stats.total_latency_us / stats.transfers : 0,
+			stats.max_latency_us, htmc.hbus->fallbacks, htmc.hbus->recoveries, TMC_bus_get_baud_rate(htmc.hbus));
+	printf("node   %u reads, %u writes, %u CRC errors, %u ignored, %u corrupted replies, %u noisy replies, IFCNT %u\n",
+			node.reads, node.writes, node.crc_errors, node.ignored, node.corrupted, node.noisy,
+			node.interface_counter);
+
+	uint32_t scenario_failures = scenario ? run_scenario() : 0;
+	if (scenario_failures != 0)
+	{
+		fprintf(stderr, "scenario: %u checks failed\n", scenario_failures);
+	}
+
+	uint8_t faults = node.corrupt_every != 0 || node.noise_every != 0
+			|| (node.max_baud_rate != 0 && baud_rate > node.max_baud_rate);
+	if (failures != 0 && !faults)
+	{
+		fprintf(stderr, "%u transfers failed on a clean line\n", failures);
+	}
+	return (mismatches != 0 || (failures != 0 && !faults) || scenario_failures != 0) ? 1 : 0;
+}
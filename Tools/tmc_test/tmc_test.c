@@ -0,0 +1,990 @@
+/*
+ * tmc_test.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: brzan
+ *
+ * Host checks of driver parts that need no bus: register decoders of TMC2226_registers.h
+ * against datasheet words and segment tables of TMC_motion_plan, integrated the way the step
+ * engine plays them, against the analytic move. Datagrams the transport puts on the simulated
+ * line are recorded with their timing at a real baud rate. TMC_move_steps is checked against a
+ * simulated line that fails every datagram, step engine segments and pulse counts against timer
+ * registers it loads chunk by chunk, TMC_flush_verified against a node that loses writes,
+ * TMC_flush after writes that change nothing against the datagrams it sends, read deadlines and
+ * bus priorities against a node that never answers, telemetry rounds and snapshot reads against
+ * a poller publishing meanwhile, baud rate fallback and recovery against nodes that are absent,
+ * reply with wrong CRC or can not follow the rate
+ *
+ * Build:	gcc -O2 -pthread -I../tmc_sim -I../../Core/Inc -o tmc_test tmc_test.c \
+ * 			../tmc_sim/tmc_sim.c ../tmc_sim/sim_hal.c ../tmc_sim/sim_os.c ../../Core/Src/TMC2226.c \
+ * 			../../Core/Src/TMC2226_bus.c ../../Core/Src/TMC2226_step.c ../../Core/Src/TMC2226_motion.c \
+ * 			../../Core/Src/TMC2226_capture.c ../../Core/Src/TMC2226_telemetry.c \
+ * 			../../Core/Src/TMC2226_stream.c -lm
+ * Run:		./tmc_test
+ * 			the same build with -DTMC_TEST_COMPILE_FAIL=1 has to stop at write_read_only
+ *
+ * Every failed check prints its line, exit status is 1 when any check failed
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "main.h"
+#include "cmsis_os.h"
+#include "TMC2226.h"
+#include "TMC2226_registers.h"
+#include "TMC2226_motion.h"
+#include "TMC2226_step.h"
+#include "TMC2226_telemetry.h"
+#include "tmc_sim.h"
+
+/* Move time may differ from the analytic one by this fraction, steps are whole */
+#define MOTION_TIME_TOLERANCE		0.02
+
+/**
+ * \brief			Move checked by test_motion
+ */
+typedef struct {
+	const char* name;
+	int32_t distance;
+	TMC_MotionLimits limits;
+} MotionCase;
+
+static const MotionCase motion_cases[] = {
+	{ "trapezoid", 204800, { 51200, 51200, 0 } },
+	{ "s-curve", 204800, { 51200, 51200, 512000 } },
+	{ "s-curve no const accel", 204800, { 51200, 51200, 5120 } },
+	{ "short trapezoid", -1000, { 51200, 51200, 0 } },
+	{ "short s-curve", 1000, { 51200, 51200, 512000 } },
+	{ "no ramp", 3000, { 1000, 0, 0 } },
+	// Ramps of hours, their duration in us does not fit 32 bits
+	{ "tiny acceleration", 2000000000, { 100000, 1, 0 } },
+	{ "tiny acceleration s-curve", 2000000000, { 100000, 2, 1 } },
+	{ "tiny jerk", 2000000000, { 51200, 51200, 1 } },
+	// Slices of the ramp carry fractions of a single step at a few Hz
+	{ "slow single steps", 100, { 20, 10, 0 } },
+	{ "slow s-curve", 60, { 16, 8, 4 } }
+};
+
+static unsigned checks;
+static unsigned failures;
+
+/* Compares two integers, prints both when they differ */
+#define CHECK_EQUAL(actual, expected) \
+	check_equal((long long)(actual), (long long)(expected), #actual, __LINE__)
+
+static void check_equal(long long actual, long long expected, const char* text, int line)
+{
+	checks++;
+	if (actual != expected)
+	{
+		failures++;
+		printf("tmc_test.c:%d: %s is %lld, expected %lld\n", line, text, actual, expected);
+	}
+}
+
+/*
+ * DRV_STATUS after power on at standstill: STST and STEALTH set, CS_ACTUAL follows IHOLD=16,
+ * then an overheated driver past every threshold and a driver with every short flag set
+ */
+static void test_drv_status(void)
+{
+	uint32_t standstill = 0xC0100000u;
+	CHECK_EQUAL(TMC_FIELD_GET(standstill, TMC_DRV_STATUS_STST), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(standstill, TMC_DRV_STATUS_STEALTH), 1);
+	CHECK_EQUAL(TMC_drv_status_cs_actual(standstill), 16);
+	CHECK_EQUAL(TMC_drv_status_fault(standstill), 0);
+	CHECK_EQUAL(TMC_drv_status_temperature(standstill), 0);
+	CHECK_EQUAL(TMC_FIELD_GET(standstill, TMC_DRV_STATUS_OTPW), 0);
+	CHECK_EQUAL(TMC_FIELD_GET(standstill, TMC_DRV_STATUS_OLA), 0);
+	CHECK_EQUAL(TMC_FIELD_GET(standstill, TMC_DRV_STATUS_OLB), 0);
+	CHECK_EQUAL(standstill & ~TMC_DRV_STATUS_MASK, 0);
+
+	uint32_t overheated = 0x001F0F03u;
+	CHECK_EQUAL(TMC_FIELD_GET(overheated, TMC_DRV_STATUS_OTPW), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(overheated, TMC_DRV_STATUS_OT), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(overheated, TMC_DRV_STATUS_T120), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(overheated, TMC_DRV_STATUS_T143), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(overheated, TMC_DRV_STATUS_T150), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(overheated, TMC_DRV_STATUS_T157), 1);
+	CHECK_EQUAL(TMC_drv_status_temperature(overheated), 157);
+	CHECK_EQUAL(TMC_drv_status_fault(overheated), TMC_DRV_STATUS_OT_Msk);
+	CHECK_EQUAL(TMC_drv_status_cs_actual(overheated), 31);
+	CHECK_EQUAL(TMC_FIELD_GET(overheated, TMC_DRV_STATUS_STST), 0);
+
+	uint32_t shorted = 0x000001FCu;
+	CHECK_EQUAL(TMC_FIELD_GET(shorted, TMC_DRV_STATUS_S2GA), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(shorted, TMC_DRV_STATUS_S2GB), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(shorted, TMC_DRV_STATUS_S2VSA), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(shorted, TMC_DRV_STATUS_S2VSB), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(shorted, TMC_DRV_STATUS_OLA), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(shorted, TMC_DRV_STATUS_OLB), 1);
+	CHECK_EQUAL(TMC_drv_status_fault(shorted), 0x3Cu);
+	CHECK_EQUAL(TMC_drv_status_temperature(shorted), 120);
+
+	// Open load alone is a warning, not a fault
+	CHECK_EQUAL(TMC_drv_status_fault(0x000000C0u), 0);
+	CHECK_EQUAL(TMC_drv_status_temperature(0x00000300u), 143);
+	CHECK_EQUAL(TMC_drv_status_temperature(0x00000700u), 150);
+}
+
+/* IOIN of a TMC2226 in UART mode with address 3, driver enabled, then every input high */
+static void test_ioin(void)
+{
+	uint32_t uart_node_3 = 0x2100004Cu;
+	CHECK_EQUAL(TMC_ioin_version(uart_node_3), TMC_IOIN_VERSION_TMC2226);
+	CHECK_EQUAL(TMC_FIELD_GET(uart_node_3, TMC_IOIN_ENN), 0);
+	CHECK_EQUAL(TMC_FIELD_GET(uart_node_3, TMC_IOIN_MS1), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(uart_node_3, TMC_IOIN_MS2), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(uart_node_3, TMC_IOIN_DIAG), 0);
+	CHECK_EQUAL(TMC_FIELD_GET(uart_node_3, TMC_IOIN_PDN_UART), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(uart_node_3, TMC_IOIN_STEP), 0);
+	CHECK_EQUAL(TMC_FIELD_GET(uart_node_3, TMC_IOIN_SPREAD_EN), 0);
+	CHECK_EQUAL(TMC_FIELD_GET(uart_node_3, TMC_IOIN_DIR), 0);
+
+	uint32_t all_high = 0x210003DDu;
+	CHECK_EQUAL(TMC_ioin_version(all_high), 0x21);
+	CHECK_EQUAL(TMC_FIELD_GET(all_high, TMC_IOIN_ENN), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(all_high, TMC_IOIN_MS1), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(all_high, TMC_IOIN_MS2), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(all_high, TMC_IOIN_DIAG), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(all_high, TMC_IOIN_PDN_UART), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(all_high, TMC_IOIN_STEP), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(all_high, TMC_IOIN_SPREAD_EN), 1);
+	CHECK_EQUAL(TMC_FIELD_GET(all_high, TMC_IOIN_DIR), 1);
+	CHECK_EQUAL(all_high & ~TMC_IOIN_MASK, 0);
+}
+
+/* PWM_SCALE with the signed 9 bit PWM_SCALE_AUTO at both ends, zero and reserved bits set */
+static void test_pwm_scale(void)
+{
+	CHECK_EQUAL(TMC_pwm_scale_sum(0x00000000u), 0);
+	CHECK_EQUAL(TMC_pwm_scale_auto(0x00000000u), 0);
+
+	uint32_t regulating_down = 0x01F00024u;
+	CHECK_EQUAL(TMC_pwm_scale_sum(regulating_down), 36);
+	CHECK_EQUAL(TMC_pwm_scale_auto(regulating_down), -16);
+
+	CHECK_EQUAL(TMC_pwm_scale_sum(0x00FF00FFu), 255);
+	CHECK_EQUAL(TMC_pwm_scale_auto(0x00FF00FFu), 255);
+	CHECK_EQUAL(TMC_pwm_scale_auto(0x01010000u), -255);
+	CHECK_EQUAL(TMC_pwm_scale_auto(0x01000000u), -256);
+
+	// Reserved bits read as 0 on a healthy link, decoders must not pick them up anyway
+	CHECK_EQUAL(TMC_pwm_scale_sum(0xFE00FF80u), 0x80);
+	CHECK_EQUAL(TMC_pwm_scale_auto(0xFE00FF80u), 0);
+	CHECK_EQUAL(0xFE00FF80u & TMC_PWM_SCALE_MASK, 0x00000080u);
+}
+
+/* Remaining decoders on the reset value of CHOPCONF and typical MSCURACT and PWM_AUTO words */
+static void test_other_decoders(void)
+{
+	uint32_t chopconf = 0x10000053u;
+	CHECK_EQUAL(TMC_FIELD_GET(chopconf, TMC_CHOPCONF_TOFF), 3);
+	CHECK_EQUAL(TMC_FIELD_GET(chopconf, TMC_CHOPCONF_HSTRT), 5);
+	CHECK_EQUAL(TMC_FIELD_GET(chopconf, TMC_CHOPCONF_HEND), 0);
+	CHECK_EQUAL(TMC_FIELD_GET(chopconf, TMC_CHOPCONF_TBL), 0);
+	CHECK_EQUAL(TMC_FIELD_GET(chopconf, TMC_CHOPCONF_VSENSE), 0);
+	CHECK_EQUAL(TMC_FIELD_GET(chopconf, TMC_CHOPCONF_MRES), 0);
+	CHECK_EQUAL(TMC_FIELD_GET(chopconf, TMC_CHOPCONF_INTPOL), 1);
+	CHECK_EQUAL(TMC_chopconf_microsteps(chopconf), 256);
+	CHECK_EQUAL(TMC_chopconf_microsteps(0x18000053u), 1);
+	CHECK_EQUAL(TMC_chopconf_microsteps(0x1F000053u), 1);
+
+	// Coil A at the top of the sine, coil B through zero going negative
+	CHECK_EQUAL(TMC_mscuract_cur_a(0x000000F7u), 247);
+	CHECK_EQUAL(TMC_mscuract_cur_b(0x000000F7u), 0);
+	CHECK_EQUAL(TMC_mscuract_cur_a(0x01FF0109u), -247);
+	CHECK_EQUAL(TMC_mscuract_cur_b(0x01FF0109u), -1);
+
+	CHECK_EQUAL(TMC_pwm_auto_ofs(0x000E0024u), 36);
+	CHECK_EQUAL(TMC_pwm_auto_grad(0x000E0024u), 14);
+}
+
+/*
+ * Ideal move: ramp up, cruise at peak velocity, ramp down. Ramps are symmetric in velocity,
+ * so every ramp covers peak * t_ramp / 2 and the whole move takes t_ramp + distance / peak
+ */
+static double analytic_move_time(uint32_t distance, uint32_t peak, const TMC_MotionLimits* limits)
+{
+	double v = peak;
+	double a = limits->acceleration;
+	double j = limits->jerk;
+	double ramp;
+	if (a == 0.0)
+	{
+		ramp = 0.0;
+	}
+	else if (j == 0.0)
+	{
+		ramp = v / a;
+	}
+	else if (v * j >= a * a)
+	{
+		ramp = v / a + a / j;
+	}
+	else
+	{
+		ramp = 2.0 * sqrt(v / j);
+	}
+	return ramp + distance / v;
+}
+
+/* Plans every motion case and plays its table on paper with the timer clock of the step engine */
+static void test_motion(void)
+{
+	uint32_t clock = 2u * HAL_RCC_GetPCLK1Freq();
+	for (uint8_t c = 0; c < sizeof(motion_cases) / sizeof(motion_cases[0]); c++)
+	{
+		const MotionCase* test = &motion_cases[c];
+		static TMC_MotionProfile profile;
+		TMC_motion_plan(&profile, test->distance, &test->limits);
+
+		uint64_t steps = 0;
+		double time = 0.0;
+		double peak_rate = 0.0;
+		for (uint16_t i = 0; i < profile.segment_count; i++)
+		{
+			const TMC_StepSegment* segment = &profile.segments[i];
+			double period = (segment->prescaler + 1.0) * (segment->period + 1.0) / clock;
+			steps += segment->steps;
+			time += segment->steps * period;
+			if (segment->steps != 0 && 1.0 / period > peak_rate)
+			{
+				peak_rate = 1.0 / period;
+			}
+		}
+
+		uint32_t distance = (test->distance < 0) ? -(uint32_t)test->distance : (uint32_t)test->distance;
+		double expected = analytic_move_time(distance, profile.peak_velocity, &test->limits);
+		double error = fabs(time - expected) / expected;
+		printf("motion %-24s %10llu steps, peak %9.1f/s, %12.3f s, analytic %12.3f s, %+.2f%%\n", test->name,
+				(unsigned long long)steps, peak_rate, time, expected, 100.0 * (time - expected) / expected);
+
+		CHECK_EQUAL(steps, distance);
+		CHECK_EQUAL(profile.direction, (test->distance < 0) ? -1 : 1);
+		// Timer period is whole ticks, rounding may only make it longer, never faster than the limit
+		CHECK_EQUAL(peak_rate <= test->limits.max_velocity, 1);
+		CHECK_EQUAL(profile.peak_velocity <= test->limits.max_velocity, 1);
+		CHECK_EQUAL(error <= MOTION_TIME_TOLERANCE, 1);
+	}
+}
+
+static TMC_SimNode node;
+static TMC_HandleTypeDef htmc;
+
+/* Node 0 on the simulated line with a step engine, wire time is not waited for */
+static void init_node(void)
+{
+	tmc_sim_node_init(&node, TMC2226_ADDR_0);
+	tmc_sim_line_set_time_scale(0.0);
+	tmc_sim_line_attach(&huart1, &node);
+	TMC_step_init(&htim2, &htim3, GPIOA, GPIO_PIN_5);
+	TMC_Init(&htmc, TMC2226_ADDR_0, &htim2, &huart1, 200);
+}
+
+/**
+ * \brief			Datagram the master put on the line
+ */
+typedef struct {
+	uint8_t datagram[TMC_BUS_MAX_DATAGRAM];
+	uint8_t length;
+	uint64_t time_us;							/* Monotonic time its last stop bit left the wire */
+} SentFrame;
+
+/* Datagrams on the line in order, filled by the line monitor */
+static SentFrame sent_frames[16];
+static volatile uint32_t sent_frame_count;
+
+static uint64_t clock_us(clockid_t clock)
+{
+	struct timespec now;
+	clock_gettime(clock, &now);
+	return (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+}
+
+static void record_frames(UART_HandleTypeDef* huart, const uint8_t* datagram, uint8_t length)
+{
+	(void)huart;
+	if (sent_frame_count < sizeof(sent_frames) / sizeof(sent_frames[0]))
+	{
+		SentFrame* frame = &sent_frames[sent_frame_count];
+		memcpy(frame->datagram, datagram, length);
+		frame->length = length;
+		frame->time_us = clock_us(CLOCK_MONOTONIC);
+		sent_frame_count++;
+	}
+}
+
+/*
+ * Write and read datagram leave whole through the interrupt driven transport, recorded on the
+ * line with their CRC. At 9600 baud the wire time is real: the caller returns only after its
+ * frame, SENDDELAY and the reply took that long, and it sleeps meanwhile instead of spinning
+ */
+static void test_transport(void)
+{
+	static const uint8_t write_frame[] = { TMC2226_SYNC, TMC2226_ADDR_0, W_TPOWERDOWN | TMC2226_WRITE, 0x00, 0x00, 0x01, 0x2A };
+	static const uint8_t read_frame[] = { TMC2226_SYNC, TMC2226_ADDR_0, R_IFCNT };
+	TMC_BusTypeDef* hbus = htmc.hbus;
+	CHECK_EQUAL(TMC_bus_set_baud_rate(hbus, 9600u), TMC_BUS_OK);
+	tmc_sim_line_set_time_scale(1.0);
+	tmc_sim_os_set_timeouts(1.0, 50);
+	sent_frame_count = 0;
+	tmc_sim_line_set_monitor(record_frames);
+
+	uint64_t cpu = clock_us(CLOCK_THREAD_CPUTIME_ID);
+	uint64_t write_start = clock_us(CLOCK_MONOTONIC);
+	write_access(&htmc, W_TPOWERDOWN, 0x0000012Au);
+	uint64_t read_start = clock_us(CLOCK_MONOTONIC);
+	uint32_t counter = read_access(&htmc, R_IFCNT);
+	uint64_t read_end = clock_us(CLOCK_MONOTONIC);
+	cpu = clock_us(CLOCK_THREAD_CPUTIME_ID) - cpu;
+
+	tmc_sim_line_set_monitor(NULL);
+	tmc_sim_line_set_time_scale(0.0);
+	tmc_sim_os_set_timeouts(1.0, 0);
+	CHECK_EQUAL(TMC_bus_set_baud_rate(hbus, 115200u), TMC_BUS_OK);
+
+	CHECK_EQUAL(sent_frame_count, 2);
+	CHECK_EQUAL(sent_frames[0].length, 8);
+	CHECK_EQUAL(memcmp(sent_frames[0].datagram, write_frame, sizeof(write_frame)), 0);
+	CHECK_EQUAL(sent_frames[0].datagram[7], tmc_sim_crc(write_frame, sizeof(write_frame)));
+	CHECK_EQUAL(sent_frames[1].length, 4);
+	CHECK_EQUAL(memcmp(sent_frames[1].datagram, read_frame, sizeof(read_frame)), 0);
+	CHECK_EQUAL(sent_frames[1].datagram[3], tmc_sim_crc(read_frame, sizeof(read_frame)));
+	CHECK_EQUAL(node.registers[W_TPOWERDOWN], 0x0000012Au);
+	CHECK_EQUAL(counter, node.interface_counter);
+
+	// 10 bit times per byte, reply follows at least 8 bit times of SENDDELAY after the request
+	CHECK_EQUAL(sent_frames[0].time_us - write_start >= 80u * 1000000u / 9600u, 1);
+	CHECK_EQUAL(read_start >= sent_frames[0].time_us, 1);
+	CHECK_EQUAL(sent_frames[1].time_us - read_start >= 40u * 1000000u / 9600u, 1);
+	CHECK_EQUAL(read_end - read_start >= (40u + 8u + 80u) * 1000000u / 9600u, 1);
+	// Spinning on the peripheral would burn the whole 30 ms
+	CHECK_EQUAL(cpu < 2000u, 1);
+}
+
+/*
+ * Name API lands in the shadow slot of its register. Addresses that are not WRITE registers
+ * have no slot and must not end up in any, GCONF used to take them
+ */
+static void test_register_writes(void)
+{
+	TMC_WRITE(&htmc, TPOWERDOWN, 0x20u);
+	CHECK_EQUAL(TMC_SHADOW(&htmc, TPOWERDOWN), 0x20u);
+	CHECK_EQUAL(TMC_get_shadow(&htmc, W_TPOWERDOWN), 0x20u);
+
+	uint32_t gconf = TMC_SHADOW(&htmc, GCONF);
+	uint16_t dirty = htmc.dirty;
+	TMC_write_register(&htmc, (TMC2226_WriteRegisters)R_TSTEP, 0x1234u);
+	TMC_modify_register(&htmc, (TMC2226_WriteRegisters)R_IOIN, 0xFFu, 0xFFu);
+	TMC_write_register(&htmc, (TMC2226_WriteRegisters)0x80u, 0x1234u);
+	CHECK_EQUAL(TMC_SHADOW(&htmc, GCONF), gconf);
+	CHECK_EQUAL(htmc.dirty, dirty);
+	CHECK_EQUAL(TMC_get_shadow(&htmc, (TMC2226_WriteRegisters)R_TSTEP), 0);
+	CHECK_EQUAL(get_shadow_index((TMC2226_WriteRegisters)R_TSTEP), SHADOW_NONE);
+	CHECK_EQUAL(get_shadow_index(W_GCONF), SHADOW_GCONF);
+	CHECK_EQUAL(get_shadow_index(WC_GSTAT), SHADOW_GSTAT);
+	CHECK_EQUAL(get_shadow_index(W_PWMCONF), SHADOW_PWMCONF);
+
+	uint32_t writes = node.writes;
+	write_access(&htmc, (TMC2226_WriteRegisters)R_TSTEP, 0x1234u);
+	CHECK_EQUAL(node.writes, writes);
+}
+
+/*
+ * Move has to clear VACTUAL first, driver ignores STEP otherwise. When the zero does not get
+ * through the move must not start and VACTUAL stays dirty, once the line is back it goes
+ */
+static void test_move_steps(void)
+{
+	CHECK_EQUAL(htmc.hstep != NULL, 1);
+
+	TMC_set_speed_mrpm(&htmc, 60000);
+	CHECK_EQUAL(TMC_flush(&htmc), TMC_BUS_OK);
+	CHECK_EQUAL(htmc.shadow[SHADOW_VACTUAL] != 0, 1);
+
+	node.jam_line = 1;
+	CHECK_EQUAL(TMC_move_steps(&htmc, 1000), HAL_ERROR);
+	CHECK_EQUAL((htmc.dirty >> SHADOW_VACTUAL) & 1u, 1);
+	CHECK_EQUAL(TMC_step_busy(htmc.hstep), 0);
+
+	node.jam_line = 0;
+	CHECK_EQUAL(TMC_move_steps(&htmc, 1000), HAL_OK);
+	CHECK_EQUAL((htmc.dirty >> SHADOW_VACTUAL) & 1u, 0);
+	CHECK_EQUAL(node.registers[W_VACTUAL], 0);
+	CHECK_EQUAL(TMC_step_busy(htmc.hstep), 1);
+
+	// Posted zero may go out after the blocking write, later tests count datagrams from a quiet line
+	while (htmc.hbus->mailbox[TMC2226_ADDR_0][TMC_MAILBOX_VACTUAL].full)
+	{
+		osDelay(1);
+	}
+	read_access(&htmc, R_IFCNT);
+}
+
+/**
+ * \brief			Pulse timer setting and pulse count the step engine loaded for one chunk
+ */
+typedef struct {
+	uint16_t prescaler;
+	uint16_t period;
+	uint16_t compare;
+	uint32_t pulses;
+} PlayedChunk;
+
+/* Overflows the counter timer chunk after chunk like the hardware does, records what every chunk played */
+static uint32_t play_move(TMC_StepEngineTypeDef* hstep, PlayedChunk* chunks, uint32_t max_chunks)
+{
+	uint32_t count = 0;
+	while (TMC_step_busy(hstep) && count < max_chunks)
+	{
+		chunks[count].prescaler = hstep->htim_pulse->Instance->PSC;
+		chunks[count].period = hstep->htim_pulse->Instance->ARR;
+		chunks[count].compare = hstep->htim_pulse->Instance->CCR1;
+		chunks[count].pulses = hstep->htim_count->Instance->ARR + 1u;
+		count++;
+		TMC_step_PeriodElapsedCallback(hstep->htim_count);
+	}
+	return count;
+}
+
+static void count_done(void* context)
+{
+	(*(uint32_t*)context)++;
+}
+
+/*
+ * Step engine plays the move of test_move_steps to its end. Then a table with an empty segment
+ * and one longer than the counter timer can take at once: every chunk runs at the rate of its
+ * segment, empty segment is skipped, pulses add up to the table and the move ends with one
+ * done callback and both timers stopped. Stop in the middle keeps pulses already counted
+ */
+static void test_step_engine(void)
+{
+	TMC_StepEngineTypeDef* hstep = htmc.hstep;
+	static PlayedChunk chunks[TMC_MOTION_MAX_SEGMENTS + 1];
+	int32_t position = TMC_step_get_position(hstep);
+	uint32_t count = play_move(hstep, chunks, TMC_MOTION_MAX_SEGMENTS + 1);
+	uint32_t pulses = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		pulses += chunks[i].pulses;
+	}
+	CHECK_EQUAL(TMC_step_busy(hstep), 0);
+	CHECK_EQUAL(pulses, 1000);
+	CHECK_EQUAL(TMC_step_get_position(hstep), position + 1000);
+
+	static TMC_StepSegment segments[4];
+	TMC_step_compute_segment(1000, TMC_STEP_CHUNK + 4464, &segments[0]);
+	TMC_step_compute_segment(20000, 0, &segments[1]);
+	TMC_step_compute_segment(5, 300, &segments[2]);
+	TMC_step_compute_segment(40000, 1, &segments[3]);
+	static const uint8_t played_segments[] = { 0, 0, 2, 3 };
+	static const uint32_t played_pulses[] = { TMC_STEP_CHUNK, 4464, 300, 1 };
+	// 5 Hz does not fit 16 bits of ARR, prescaler has to take the rest
+	CHECK_EQUAL(segments[2].prescaler != 0, 1);
+
+	uint32_t done = 0;
+	position = TMC_step_get_position(hstep);
+	CHECK_EQUAL(TMC_step_start_segments(hstep, -1, segments, 4, count_done, &done), HAL_OK);
+	CHECK_EQUAL(TMC_step_busy(hstep), 1);
+	CHECK_EQUAL(GPIOA->ODR & GPIO_PIN_5, 0);
+	CHECK_EQUAL(TMC_step_start(hstep, 10, 1000, NULL, NULL), HAL_BUSY);
+	count = play_move(hstep, chunks, TMC_MOTION_MAX_SEGMENTS + 1);
+
+	CHECK_EQUAL(count, 4);
+	for (uint32_t i = 0; i < count && i < 4; i++)
+	{
+		const TMC_StepSegment* segment = &segments[played_segments[i]];
+		CHECK_EQUAL(chunks[i].prescaler, segment->prescaler);
+		CHECK_EQUAL(chunks[i].period, segment->period);
+		CHECK_EQUAL(chunks[i].compare, (segment->period + 1u) / 2u);
+		CHECK_EQUAL(chunks[i].pulses, played_pulses[i]);
+	}
+	CHECK_EQUAL(done, 1);
+	CHECK_EQUAL(TMC_step_busy(hstep), 0);
+	CHECK_EQUAL(TMC_step_get_position(hstep), position - (int32_t)(TMC_STEP_CHUNK + 4464 + 300 + 1));
+	CHECK_EQUAL(htim2.Instance->CR1 & 0x01u, 0);
+	CHECK_EQUAL(htim3.Instance->CR1 & 0x01u, 0);
+
+	position = TMC_step_get_position(hstep);
+	CHECK_EQUAL(TMC_step_start(hstep, 100, 1000, count_done, &done), HAL_OK);
+	CHECK_EQUAL(GPIOA->ODR & GPIO_PIN_5, GPIO_PIN_5);
+	__HAL_TIM_SET_COUNTER(&htim3, 40);
+	CHECK_EQUAL(TMC_step_get_position(hstep), position + 40);
+	TMC_step_stop(hstep);
+	CHECK_EQUAL(TMC_step_get_position(hstep), position + 40);
+	CHECK_EQUAL(TMC_step_busy(hstep), 0);
+	CHECK_EQUAL(done, 1);
+}
+
+/* Write datagrams on the line by register address, filled by the line monitor */
+static unsigned sent_writes[0x80];
+
+static void count_writes(UART_HandleTypeDef* huart, const uint8_t* datagram, uint8_t length)
+{
+	(void)huart;
+	if (length == 8)
+	{
+		sent_writes[datagram[2] & 0x7F]++;
+	}
+}
+
+/*
+ * Verified flush against a node that drops every 5th write and corrupts every 3rd reply.
+ * Groups that come up short are sent again in halves, each group has its own retries and
+ * OTP_PROG goes alone and exactly once. Every register ends up in the node, nothing stays dirty
+ */
+static void test_flush_verified(void)
+{
+	static const TMC2226_WriteRegisters registers[] = {
+		W_TPOWERDOWN, W_TPWMTHRS, W_TCOOLTHRS, W_SGTHRS, W_COOLCONF, W_CHOPCONF
+	};
+	CHECK_EQUAL(TMC_flush(&htmc), TMC_BUS_OK);
+	for (uint8_t i = 0; i < sizeof(registers) / sizeof(registers[0]); i++)
+	{
+		TMC_write_register(&htmc, registers[i], htmc.shadow[get_shadow_index(registers[i])] ^ (1u + i));
+	}
+	TMC_WRITE(&htmc, OTP_PROG, 0x0101u);
+
+	node.writes = 0;
+	node.reads = 0;
+	node.lose_write_every = 5;
+	node.corrupt_every = 3;
+	htmc.verify_writes = 1;
+	tmc_sim_line_set_monitor(count_writes);
+	CHECK_EQUAL(TMC_flush(&htmc), TMC_BUS_OK);
+	tmc_sim_line_set_monitor(NULL);
+	htmc.verify_writes = 0;
+	node.lose_write_every = 0;
+	node.corrupt_every = 0;
+
+	/*
+	 * OTP_PROG alone is write 1. TPOWERDOWN..SGTHRS are writes 2-5, 5 is lost, the group comes
+	 * up one short and its halves go again as 6-7 and 8-9. COOLCONF and CHOPCONF are 10-11,
+	 * 10 is lost, they go again one by one. Corrupted IFCNT replies are read again, those and
+	 * the two short checks of the first group would have used up a budget shared by the flush
+	 */
+	CHECK_EQUAL(htmc.dirty, 0);
+	CHECK_EQUAL(node.lost, 2);
+	CHECK_EQUAL(node.corrupted, 3);
+	CHECK_EQUAL(sent_writes[W_OTP_PROG], 1);
+	CHECK_EQUAL(sent_writes[W_TPOWERDOWN], 2);
+	CHECK_EQUAL(sent_writes[W_TPWMTHRS], 2);
+	CHECK_EQUAL(sent_writes[W_TCOOLTHRS], 2);
+	CHECK_EQUAL(sent_writes[W_SGTHRS], 2);
+	CHECK_EQUAL(sent_writes[W_COOLCONF], 2);
+	CHECK_EQUAL(sent_writes[W_CHOPCONF], 2);
+	CHECK_EQUAL(TMC_SHADOW(&htmc, OTP_PROG), 0);
+	CHECK_EQUAL(node.registers[W_OTP_PROG], 0x0101u);
+	for (uint8_t i = 0; i < sizeof(registers) / sizeof(registers[0]); i++)
+	{
+		CHECK_EQUAL(node.registers[registers[i]], htmc.shadow[get_shadow_index(registers[i])]);
+	}
+}
+
+/*
+ * Setters and whole register writes that repeat what the driver already has mark nothing
+ * dirty, so the flush after them puts nothing on the line. One changed field sends its
+ * register and nothing else
+ */
+static void test_flush_unchanged(void)
+{
+	CHECK_EQUAL(TMC_flush(&htmc), TMC_BUS_OK);
+	uint32_t chopconf = TMC_SHADOW(&htmc, CHOPCONF);
+	uint32_t ihold_irun = TMC_SHADOW(&htmc, IHOLD_IRUN);
+	uint8_t toff = TMC_FIELD_GET(chopconf, TMC_CHOPCONF_TOFF);
+	TMC_set_toff(&htmc, toff);
+	TMC_set_current(&htmc, TMC_FIELD_GET(ihold_irun, TMC_IHOLD_IRUN_IHOLD),
+			TMC_FIELD_GET(ihold_irun, TMC_IHOLD_IRUN_IRUN), TMC_FIELD_GET(ihold_irun, TMC_IHOLD_IRUN_IHOLDDELAY));
+	TMC_set_shaft(&htmc, TMC_FIELD_GET(TMC_SHADOW(&htmc, GCONF), TMC_GCONF_SHAFT));
+	TMC_WRITE(&htmc, TPOWERDOWN, TMC_SHADOW(&htmc, TPOWERDOWN));
+	// VACTUAL is 0 since test_move_steps, an unchanged setpoint is not posted either
+	TMC_set_speed_mrpm(&htmc, 0);
+	CHECK_EQUAL(htmc.dirty, 0);
+	CHECK_EQUAL(htmc.hbus->mailbox[TMC2226_ADDR_0][TMC_MAILBOX_VACTUAL].full, 0);
+
+	uint32_t writes = node.writes;
+	uint32_t reads = node.reads;
+	memset(sent_writes, 0, sizeof(sent_writes));
+	tmc_sim_line_set_monitor(count_writes);
+	CHECK_EQUAL(TMC_flush(&htmc), TMC_BUS_OK);
+	CHECK_EQUAL(node.writes, writes);
+	CHECK_EQUAL(node.reads, reads);
+
+	uint8_t changed_toff = (toff == 3) ? 4 : 3;
+	TMC_set_toff(&htmc, changed_toff);
+	CHECK_EQUAL(htmc.dirty, 1u << SHADOW_CHOPCONF);
+	CHECK_EQUAL(TMC_flush(&htmc), TMC_BUS_OK);
+	tmc_sim_line_set_monitor(NULL);
+	CHECK_EQUAL(htmc.dirty, 0);
+	CHECK_EQUAL(node.writes, writes + 1);
+	CHECK_EQUAL(sent_writes[W_CHOPCONF], 1);
+	CHECK_EQUAL(node.registers[W_CHOPCONF], TMC_SHADOW(&htmc, CHOPCONF));
+	CHECK_EQUAL(TMC_FIELD_GET(TMC_SHADOW(&htmc, CHOPCONF), TMC_CHOPCONF_TOFF), changed_toff);
+	CHECK_EQUAL(TMC_SHADOW(&htmc, CHOPCONF) & ~TMC_CHOPCONF_TOFF_Msk, chopconf & ~TMC_CHOPCONF_TOFF_Msk);
+}
+
+/*
+ * Reads in flight together with one to a node that never answers. Its deadline follows SENDDELAY
+ * of its NODECONF, it ends in a timeout no later than that while the other reads keep their
+ * values. Transfers queued behind it go out by priority, not in the order they were submitted
+ */
+static void test_read_async(void)
+{
+	static TMC_HandleTypeDef absent;
+	TMC_Init(&absent, TMC2226_ADDR_2, NULL, &huart1, 200);
+	CHECK_EQUAL(TMC_bus_set_baud_rate(htmc.hbus, 115200u), TMC_BUS_OK);
+	// 4 byte request, 3 * 8 bit times of SENDDELAY 2 and 8 byte reply take 2 ms at 115200
+	CHECK_EQUAL(read_timeout_ms(&absent), 2 + TMC_BUS_TIMEOUT_MARGIN_MS);
+	TMC_MODIFY(&absent, NODECONF, TMC_NODECONF_SENDDELAY_Msk, TMC_FIELD_SET(TMC_NODECONF_SENDDELAY, 15));
+	CHECK_EQUAL(read_timeout_ms(&absent), 3 + TMC_BUS_TIMEOUT_MARGIN_MS);
+
+	TMC_ReadFuture futures[3];
+	uint32_t start = osKernelGetTickCount();
+	CHECK_EQUAL(TMC_read_async(&htmc, R_IFCNT, &futures[0]), TMC_BUS_PENDING);
+	CHECK_EQUAL(TMC_read_async(&absent, R_IFCNT, &futures[1]), TMC_BUS_PENDING);
+	CHECK_EQUAL(TMC_read_async(&htmc, R_IOIN, &futures[2]), TMC_BUS_PENDING);
+	CHECK_EQUAL(TMC_read_await_all(futures, 3), TMC_BUS_TIMEOUT);
+	uint32_t elapsed = osKernelGetTickCount() - start;
+
+	CHECK_EQUAL(elapsed >= read_timeout_ms(&absent), 1);
+	CHECK_EQUAL(elapsed < read_timeout_ms(&absent) + 100u, 1);
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		CHECK_EQUAL(TMC_read_ready(&futures[i]), 1);
+	}
+	CHECK_EQUAL(futures[0].transfer.status, TMC_BUS_OK);
+	CHECK_EQUAL(futures[0].value, node.interface_counter);
+	CHECK_EQUAL(futures[1].transfer.status, TMC_BUS_TIMEOUT);
+	CHECK_EQUAL(futures[2].transfer.status, TMC_BUS_OK);
+	CHECK_EQUAL(futures[2].value, tmc_sim_node_read(&node, R_IOIN) & get_mask_for_given_register(R_IOIN));
+
+	// Slack keeps the worker waiting for the unanswered read until everything else is queued
+	static const TMC_BusPriority priorities[] = { TMC_BUS_PRIORITY_LOW, TMC_BUS_PRIORITY_NORMAL, TMC_BUS_PRIORITY_HIGH };
+	static const TMC2226_ReadRegisters registers[] = { R_TSTEP, R_SG_RESULT, R_MSCNT };
+	TMC_TransferTypeDef transfers[3];
+	tmc_sim_os_set_timeouts(1.0, 100);
+	sent_frame_count = 0;
+	tmc_sim_line_set_monitor(record_frames);
+	CHECK_EQUAL(TMC_read_async(&absent, R_IFCNT, &futures[0]), TMC_BUS_PENDING);
+	while (sent_frame_count == 0)
+	{
+		osDelay(1);
+	}
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		build_read_datagram(&htmc, registers[i], transfers[i].tx_datagram);
+		transfers[i].tx_length = 4;
+		transfers[i].rx_length = 8;
+		transfers[i].timeout = read_timeout_ms(&htmc);
+		transfers[i].priority = priorities[i];
+		CHECK_EQUAL(TMC_bus_submit(htmc.hbus, &transfers[i]), TMC_BUS_PENDING);
+	}
+	CHECK_EQUAL(TMC_read_ready(&futures[0]), 0);
+	CHECK_EQUAL(TMC_read_await(&futures[0]), TMC_BUS_TIMEOUT);
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		CHECK_EQUAL(TMC_bus_await(&transfers[i]), TMC_BUS_OK);
+	}
+	tmc_sim_line_set_monitor(NULL);
+	tmc_sim_os_set_timeouts(1.0, 0);
+
+	CHECK_EQUAL(sent_frame_count, 4);
+	CHECK_EQUAL(sent_frames[0].datagram[1], TMC2226_ADDR_2);
+	CHECK_EQUAL(sent_frames[1].datagram[2], R_MSCNT);
+	CHECK_EQUAL(sent_frames[2].datagram[2], R_SG_RESULT);
+	CHECK_EQUAL(sent_frames[3].datagram[2], R_TSTEP);
+}
+
+/**
+ * \brief			Read datagram seen on the line
+ */
+typedef struct {
+	uint8_t node;
+	uint8_t register_address;
+} SentRead;
+
+/* Read datagrams on the line in order, filled by the line monitor */
+static SentRead sent_reads[16];
+static uint32_t sent_read_count;
+
+static void record_reads(UART_HandleTypeDef* huart, const uint8_t* datagram, uint8_t length)
+{
+	(void)huart;
+	if (length == 4 && sent_read_count < sizeof(sent_reads) / sizeof(sent_reads[0]))
+	{
+		sent_reads[sent_read_count].node = datagram[1];
+		sent_reads[sent_read_count].register_address = datagram[2];
+		sent_read_count++;
+	}
+}
+
+/* MSCNT closes a round, the next one of node 0 reads SG_RESULT and MSCNT one higher */
+static void number_rounds(UART_HandleTypeDef* huart, const uint8_t* datagram, uint8_t length)
+{
+	(void)huart;
+	if (length == 4 && datagram[1] == TMC2226_ADDR_0 && datagram[2] == R_MSCNT)
+	{
+		node.registers[R_MSCNT] = (node.registers[R_MSCNT] + 1u) & 0x3FFu;
+		node.registers[R_SG_RESULT] = node.registers[R_MSCNT];
+	}
+}
+
+static volatile uint8_t poller_stop;
+static volatile uint8_t poller_done;
+static uint8_t* guard_page;
+static long page_size;
+static uint32_t guard_rounds;					/* Rounds published when the reader hit the guard page */
+
+static void telemetry_poller(void* argument)
+{
+	(void)argument;
+	while (!poller_stop)
+	{
+		TMC_telemetry_poll();
+	}
+	poller_done = 1;
+}
+
+/* Holds the reader in the middle of its copy until the poller published two more rounds */
+static void guard_handler(int signal_number, siginfo_t* info, void* context)
+{
+	(void)signal_number;
+	(void)info;
+	(void)context;
+	TMC_TelemetrySnapshot latest;
+	TMC_telemetry_read(&htmc, &latest);
+	guard_rounds = latest.rounds;
+	while (latest.rounds < guard_rounds + 2u)
+	{
+		osDelay(1);
+		TMC_telemetry_read(&htmc, &latest);
+	}
+	mprotect(guard_page, page_size, PROT_READ | PROT_WRITE);
+}
+
+/*
+ * Telemetry snapshot copied while the poller publishes. Snapshot straddles a page boundary,
+ * copying into the write protected part stops the reader until two more rounds were published,
+ * the second of them rewrote the buffer being copied, so the reader has to start over.
+ * Every round of node 0 reads SG_RESULT and MSCNT equal to its number, a torn copy shows up as
+ * values of another round. Then rounds go node by node in the order of TMC_telemetry_add and
+ * every sample carries the tick its reply arrived at
+ */
+static void test_telemetry(void)
+{
+	TMC_TelemetrySnapshot local;
+	CHECK_EQUAL(TMC_telemetry_read(&htmc, &local), 0);
+	CHECK_EQUAL(TMC_telemetry_add(&htmc), HAL_OK);
+	CHECK_EQUAL(TMC_telemetry_read(&htmc, &local), 0);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	uint8_t* pages = mmap(NULL, 2 * page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	guard_page = pages + page_size;
+	TMC_TelemetrySnapshot* snapshot = (TMC_TelemetrySnapshot*)(guard_page - offsetof(TMC_TelemetrySnapshot, rounds));
+	struct sigaction action = { .sa_sigaction = guard_handler, .sa_flags = SA_SIGINFO };
+	sigaction(SIGSEGV, &action, NULL);
+
+	node.registers[R_MSCNT] = 1;
+	node.registers[R_SG_RESULT] = 1;
+	tmc_sim_line_set_monitor(number_rounds);
+	osThreadNew(telemetry_poller, NULL, NULL);
+	while (TMC_telemetry_read(&htmc, snapshot) == 0)
+	{
+		osDelay(1);
+	}
+	mprotect(guard_page, page_size, PROT_READ);
+	CHECK_EQUAL(TMC_telemetry_read(&htmc, snapshot), 1);
+	signal(SIGSEGV, SIG_DFL);
+	poller_stop = 1;
+	while (!poller_done)
+	{
+		osDelay(1);
+	}
+	tmc_sim_line_set_monitor(NULL);
+
+	CHECK_EQUAL(guard_rounds != 0, 1);
+	CHECK_EQUAL(snapshot->rounds >= guard_rounds + 2u, 1);
+	CHECK_EQUAL(snapshot->samples[TMC_TELEMETRY_SG_RESULT].value, snapshot->rounds & 0x3FFu);
+	CHECK_EQUAL(snapshot->samples[TMC_TELEMETRY_MSCNT].value, snapshot->rounds & 0x3FFu);
+	CHECK_EQUAL(snapshot->failed_reads, 0);
+	TMC_telemetry_read(&htmc, &local);
+	uint32_t rounds = local.rounds;
+	munmap(pages, 2 * page_size);
+
+	static const uint8_t round_registers[TMC_TELEMETRY_REGISTER_COUNT] = { R_SG_RESULT, R_TSTEP, R_DRV_STATUS, R_MSCNT };
+	static TMC_SimNode second_node;
+	static TMC_HandleTypeDef second;
+	tmc_sim_node_init(&second_node, TMC2226_ADDR_1);
+	tmc_sim_line_attach(&huart1, &second_node);
+	TMC_Init(&second, TMC2226_ADDR_1, NULL, &huart1, 200);
+	CHECK_EQUAL(TMC_telemetry_add(&second), HAL_OK);
+
+	// Wire time makes the replies of a round arrive ticks apart, slack keeps host jitter from failing them
+	tmc_sim_line_set_time_scale(1.0);
+	tmc_sim_os_set_timeouts(1.0, 50);
+	sent_read_count = 0;
+	tmc_sim_line_set_monitor(record_reads);
+	uint32_t start = osKernelGetTickCount();
+	TMC_telemetry_poll();
+	TMC_telemetry_poll();
+	uint32_t end = osKernelGetTickCount();
+	tmc_sim_line_set_monitor(NULL);
+	tmc_sim_line_set_time_scale(0.0);
+	tmc_sim_os_set_timeouts(1.0, 0);
+
+	CHECK_EQUAL(sent_read_count, 16);
+	for (uint8_t i = 0; i < sent_read_count; i++)
+	{
+		CHECK_EQUAL(sent_reads[i].node, (i / TMC_TELEMETRY_REGISTER_COUNT) % 2u);
+		CHECK_EQUAL(sent_reads[i].register_address, round_registers[i % TMC_TELEMETRY_REGISTER_COUNT]);
+	}
+
+	TMC_TelemetrySnapshot first_snapshot;
+	TMC_TelemetrySnapshot second_snapshot;
+	CHECK_EQUAL(TMC_telemetry_read(&htmc, &first_snapshot), 1);
+	CHECK_EQUAL(TMC_telemetry_read(&second, &second_snapshot), 1);
+	CHECK_EQUAL(first_snapshot.rounds, rounds + 2u);
+	CHECK_EQUAL(first_snapshot.failed_reads, 0);
+	CHECK_EQUAL(second_snapshot.rounds, 2);
+	CHECK_EQUAL(second_snapshot.node_id, TMC2226_ADDR_1);
+	CHECK_EQUAL(second_snapshot.failed_reads, 0);
+	CHECK_EQUAL(second_snapshot.samples[TMC_TELEMETRY_DRV_STATUS].value,
+			tmc_sim_node_read(&second_node, R_DRV_STATUS) & TMC_DRV_STATUS_MASK);
+	for (uint8_t i = 0; i < TMC_TELEMETRY_REGISTER_COUNT; i++)
+	{
+		CHECK_EQUAL(first_snapshot.samples[i].timestamp_ms >= start, 1);
+		CHECK_EQUAL(second_snapshot.samples[i].timestamp_ms <= end, 1);
+		if (i != 0)
+		{
+			CHECK_EQUAL(first_snapshot.samples[i].timestamp_ms >= first_snapshot.samples[i - 1].timestamp_ms, 1);
+			CHECK_EQUAL(second_snapshot.samples[i].timestamp_ms >= second_snapshot.samples[i - 1].timestamp_ms, 1);
+		}
+	}
+	// Second round of node 1 comes after the second round of node 0
+	CHECK_EQUAL(second_snapshot.samples[0].timestamp_ms >= first_snapshot.samples[TMC_TELEMETRY_MSCNT].timestamp_ms, 1);
+	CHECK_EQUAL(second_snapshot.samples[TMC_TELEMETRY_MSCNT].timestamp_ms
+			> first_snapshot.samples[TMC_TELEMETRY_SG_RESULT].timestamp_ms, 1);
+}
+
+/*
+ * Baud rate fallback: timeouts of one absent node must not drop the rate, CRC errors and
+ * timeouts of two nodes do. Once errors stop the bus climbs back to the rate it was set to.
+ * Node alone on its bus that replied at a lower rate drops the rate with timeouts alone
+ */
+static void test_fallback(void)
+{
+	static TMC_HandleTypeDef absent_2;
+	static TMC_HandleTypeDef absent_3;
+	TMC_BusTypeDef* hbus = htmc.hbus;
+	TMC_Init(&absent_2, TMC2226_ADDR_2, NULL, &huart1, 200);
+	TMC_Init(&absent_3, TMC2226_ADDR_3, NULL, &huart1, 200);
+	CHECK_EQUAL(TMC_bus_set_baud_rate(hbus, 115200u), TMC_BUS_OK);
+	uint32_t fallbacks = hbus->fallbacks;
+
+	for (uint8_t i = 0; i < 2 * TMC_BUS_FALLBACK_ERRORS; i++)
+	{
+		read_access(&absent_3, R_IFCNT);
+	}
+	read_access(&htmc, R_IFCNT);
+	CHECK_EQUAL(TMC_bus_get_baud_rate(hbus), 115200u);
+	CHECK_EQUAL(hbus->fallbacks, fallbacks);
+
+	for (uint8_t i = 0; i < TMC_BUS_FALLBACK_ERRORS; i++)
+	{
+		read_access(&absent_2, R_IFCNT);
+		read_access(&absent_3, R_IFCNT);
+	}
+	CHECK_EQUAL(TMC_bus_get_baud_rate(hbus), 57600u);
+	CHECK_EQUAL(hbus->fallbacks, fallbacks + 1);
+
+	node.corrupt_every = 1;
+	for (uint8_t i = 0; i < TMC_BUS_FALLBACK_ERRORS; i++)
+	{
+		read_access(&htmc, R_IFCNT);
+	}
+	node.corrupt_every = 0;
+	CHECK_EQUAL(TMC_bus_get_baud_rate(hbus), 19200u);
+	CHECK_EQUAL(hbus->fallbacks, fallbacks + 2);
+
+	// Back up one rate per TMC_BUS_RECOVERY_TRANSFERS clean transfers, never above the set rate
+	uint32_t recoveries = hbus->recoveries;
+	for (uint32_t i = 0; i < 3 * TMC_BUS_RECOVERY_TRANSFERS; i++)
+	{
+		read_access(&htmc, R_IFCNT);
+	}
+	CHECK_EQUAL(TMC_bus_get_baud_rate(hbus), 115200u);
+	CHECK_EQUAL(hbus->recoveries, recoveries + 2);
+
+	// Only node of huart3 stops answering above 115200, every failure it sees is a timeout
+	static TMC_SimNode single_node;
+	static TMC_HandleTypeDef single;
+	tmc_sim_node_init(&single_node, TMC2226_ADDR_0);
+	single_node.max_baud_rate = 115200u;
+	tmc_sim_line_attach(&huart3, &single_node);
+	huart3.Init.BaudRate = 115200u;
+	TMC_Init(&single, TMC2226_ADDR_0, NULL, &huart3, 200);
+	hbus = single.hbus;
+	read_access(&single, R_IFCNT);
+	CHECK_EQUAL(TMC_bus_set_baud_rate(hbus, 230400u), TMC_BUS_OK);
+	for (uint8_t i = 0; i < TMC_BUS_FALLBACK_ERRORS; i++)
+	{
+		read_access(&single, R_IFCNT);
+	}
+	CHECK_EQUAL(TMC_bus_get_baud_rate(hbus), 115200u);
+	CHECK_EQUAL(hbus->fallbacks, 1);
+
+	// Recovery climbs back to the set rate the node can not follow, it has to fall back again
+	for (uint32_t i = 0; i < TMC_BUS_RECOVERY_TRANSFERS; i++)
+	{
+		read_access(&single, R_IFCNT);
+	}
+	CHECK_EQUAL(hbus->recoveries, 1);
+	CHECK_EQUAL(TMC_bus_get_baud_rate(hbus), 230400u);
+	for (uint8_t i = 0; i < TMC_BUS_FALLBACK_ERRORS; i++)
+	{
+		read_access(&single, R_IFCNT);
+	}
+	CHECK_EQUAL(TMC_bus_get_baud_rate(hbus), 115200u);
+	CHECK_EQUAL(hbus->fallbacks, 2);
+	CHECK_EQUAL(hbus->recovery_backoff, 1);
+	CHECK_EQUAL(read_access(&single, R_IFCNT), single_node.interface_counter);
+}
+
+#if TMC_TEST_COMPILE_FAIL
+/* Read only register written through the register name API, must not compile */
+static void write_read_only(TMC_HandleTypeDef* htmc)
+{
+	TMC_WRITE(htmc, TSTEP, 0);
+}
+#endif
+
+int main(void)
+{
+	test_drv_status();
+	test_ioin();
+	test_pwm_scale();
+	test_other_decoders();
+	test_motion();
+	init_node();
+	test_transport();
+	test_register_writes();
+	test_move_steps();
+	test_step_engine();
+	test_flush_verified();
+	test_flush_unchanged();
+	test_read_async();
+	test_telemetry();
+	test_fallback();
+
+	printf("%u checks, %u failed\n", checks, failures);
+	return (failures != 0) ? 1 : 0;
+}